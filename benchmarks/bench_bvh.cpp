@@ -0,0 +1,117 @@
+/**
+ *
+ * \file bench_bvh.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "TomoSect/bvh.hpp"
+#include "TomoSect/intersection.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 5;
+
+constexpr size_t num_rays = 1024;
+
+class BvhFixture : public celero::TestFixture
+{
+public:
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of boxes in the scene
+        return { int64_t(100), int64_t(1000), int64_t(10000) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> position(-1.f, 1.f);
+        std::uniform_real_distribution<float> size(0.005f, 0.05f);
+
+        boxes_.clear();
+        for (int64_t i = 0; i < experimentValue.Value; ++i)
+            boxes_.emplace_back(point3<float>(position(gen), position(gen), position(gen)), vec3<float>(size(gen), size(gen), size(gen)));
+
+        rays_.clear();
+        for (size_t i = 0; i < num_rays; ++i) {
+            const point3<float> from(3.f, position(gen), position(gen));
+            const point3<float> to(-3.f, position(gen), position(gen));
+            rays_.push_back(rayFromPoints(from, to));
+        }
+
+        // Packets of 8 consecutive rays
+        packets_.clear();
+        for (size_t i = 0; i < num_rays; i += 8) {
+            pack8<float> o[3], d[3];
+            for (size_t lane = 0; lane < 8; ++lane) {
+                const auto& r = rays_[i + lane];
+                o[0][lane] = r.origin().x();
+                o[1][lane] = r.origin().y();
+                o[2][lane] = r.origin().z();
+                d[0][lane] = r.dir().x();
+                d[1][lane] = r.dir().y();
+                d[2][lane] = r.dir().z();
+            }
+            packets_.emplace_back(point3<pack8<float>>(o[0], o[1], o[2]), vec3<pack8<float>>(d[0], d[1], d[2]),
+                                  ray<pack8<float>>::ray_direction_normalized{});
+        }
+
+        tree_ = std::make_unique<tomosect::bvh<float>>(boxes_);
+    }
+
+    std::vector<aabb<float>> boxes_;
+    std::vector<ray<float>> rays_;
+    std::vector<ray<pack8<float>>> packets_;
+    std::unique_ptr<tomosect::bvh<float>> tree_;
+};
+
+BASELINE_F(Bvh, BoxLoop, BvhFixture, SAMPLES, ITERATIONS)
+{
+    for (const auto& r : rays_) {
+        float best = std::numeric_limits<float>::infinity();
+        for (const auto& box : boxes_) {
+            auto [tmin, tmax, hit] = intersection(r, box, ray_aabb_interval{});
+            tmin = std::max(tmin, 0.f);
+            if (hit && tmin <= tmax && tmin < best)
+                best = tmin;
+        }
+        celero::DoNotOptimizeAway(best);
+    }
+}
+
+BENCHMARK_F(Bvh, Nearest, BvhFixture, SAMPLES, ITERATIONS)
+{
+    for (const auto& r : rays_)
+        celero::DoNotOptimizeAway(tree_->nearest(r));
+}
+
+BENCHMARK_F(Bvh, NearestPackOf8, BvhFixture, SAMPLES, ITERATIONS)
+{
+    for (const auto& r : packets_)
+        celero::DoNotOptimizeAway(tree_->nearest(r));
+}
+
+BENCHMARK_F(Bvh, AllIntervals, BvhFixture, SAMPLES, ITERATIONS)
+{
+    for (const auto& r : rays_)
+        celero::DoNotOptimizeAway(tree_->intervals(r));
+}
+
+BENCHMARK_F(Bvh, Build, BvhFixture, SAMPLES, ITERATIONS)
+{
+    celero::DoNotOptimizeAway(tomosect::bvh<float>(boxes_));
+}
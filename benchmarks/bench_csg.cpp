@@ -0,0 +1,116 @@
+/**
+ *
+ * \file bench_csg.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "TomoSect/csg.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 2;
+
+constexpr size_t detector_size = 256;
+
+class CsgFixture : public celero::TestFixture
+{
+public:
+    class RayCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Rays/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    CsgFixture() : view_(makeView()) { projection_.assign(detector_size * detector_size, 0.f); }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of holes drilled through the block
+        return { int64_t(3), int64_t(7), int64_t(15) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 1.6f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        trajectory.startAngle = 0.3f;
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        // Block with a row of holes along z, seen from the side
+        tree_ = {};
+        auto block = tree_.add(aabb<float>(point3<float>(-0.4f, -0.2f, -0.1f), point3<float>(0.4f, 0.2f, 0.1f)));
+        const auto holes = experimentValue.Value;
+        for (int64_t i = 0; i < holes; ++i) {
+            const float x = -0.35f + 0.7f * (static_cast<float>(i) + 0.5f) / static_cast<float>(holes);
+            const float r = 0.3f / static_cast<float>(holes);
+            block = tree_.subtract(block, tree_.add(tomosect::cylinder<float>({ x, 0, 0 }, { r, r, 0.2f })));
+        }
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        rayCountUDM->addValue((projection_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM };
+    }
+
+    tomosect::projection_view<float> view_;
+    tomosect::csg_tree<float> tree_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<RayCountUDM> rayCountUDM{ new RayCountUDM };
+};
+
+BASELINE_F(CsgProjection, ScalarRays, CsgFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = tree_.pathLength(view_.pixelRay(col, row));
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(CsgProjection, Packets, CsgFixture, SAMPLES, ITERATIONS)
+{
+    using Value = pack8<float>;
+
+    const size_t cols = view_.cols();
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < cols; col += 8) {
+            const size_t n = std::min<size_t>(8, cols - col);
+            const Value length = tree_.pathLength(view_.pixelPacket<Value>(col, row, n));
+            for (size_t lane = 0; lane < n; ++lane)
+                projection_[row * cols + col + lane] = length[lane];
+        }
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
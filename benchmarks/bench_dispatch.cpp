@@ -0,0 +1,108 @@
+/**
+ *
+ * \file bench_dispatch.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TomoSect/dispatch.hpp"
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/projection_stack.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 64;
+constexpr size_t num_views = 180;
+
+class DispatchFixture : public celero::TestFixture
+{
+public:
+    class VoxelCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Voxels/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    DispatchFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)), filtered_(128, 128, num_views)
+    {
+        const tomosect::circular_trajectory<float> trajectory{ num_views, 2.f, 1.f, 128, 128, 0.015f, 0.015f };
+        for (size_t i = 0; i < filtered_.size(); ++i)
+            filtered_.data()[i] = std::sin(static_cast<float>(i));
+        for (size_t k = 0; k < num_views; ++k) {
+            matrices_.push_back(trajectory.view(k).projectionMatrix());
+            rows_.push_back({ filtered_.view(k), 0, 128 });
+        }
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Instruction set levels the CPU supports
+        std::vector<celero::TestFixture::ExperimentValue> levels;
+        for (auto isa : { tomosect::isa_level::sse4_2, tomosect::isa_level::avx2, tomosect::isa_level::avx512 })
+            if (tomosect::kernels_for(isa))
+                levels.push_back(static_cast<int64_t>(isa));
+        return levels;
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        table_ = tomosect::kernels_for(static_cast<tomosect::isa_level>(experimentValue.Value));
+        output_.assign(grid_.size(), 0.f);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        voxelCountUDM->addValue((grid_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->voxelCountUDM };
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::projection_stack<float> filtered_;
+    std::vector<tomosect::projection_matrix<float>> matrices_;
+    std::vector<tomosect::filtered_rows> rows_;
+    const tomosect::kernel_table* table_ = nullptr;
+    std::vector<float> output_;
+
+    std::shared_ptr<VoxelCountUDM> voxelCountUDM{ new VoxelCountUDM };
+};
+
+BASELINE_F(Backprojection, HeaderOnly, DispatchFixture, SAMPLES, ITERATIONS)
+{
+    // Compiled with the flags of the build
+    tomosect::backproject(matrices_, rows_, 128, 1.f, grid_, 0, grid_.nz(), output_.data());
+    celero::DoNotOptimizeAway(output_[0]);
+}
+
+BENCHMARK_F(Backprojection, Dispatched, DispatchFixture, SAMPLES, ITERATIONS)
+{
+    const tomosect::voxel_box box{ 0, grid_.nx(), 0, grid_.ny(), 0, grid_.nz() };
+    table_->backproject(matrices_.data(), rows_.data(), num_views, 128, 1.f, tomosect::kernel_grid::from(grid_), box, output_.data());
+    celero::DoNotOptimizeAway(output_[0]);
+}
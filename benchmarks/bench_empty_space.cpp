@@ -0,0 +1,116 @@
+/**
+ *
+ * \file bench_empty_space.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TomoSect/occupancy_grid.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+constexpr size_t volume_size = 192;
+constexpr size_t detector_size = 128;
+
+class EmptySpaceFixture : public celero::TestFixture
+{
+public:
+    class RayCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Rays/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    EmptySpaceFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          volume_(volume_size, volume_size, volume_size), view_(makeView()), occupancy_(grid_)
+    {
+        projection_.assign(detector_size * detector_size, 0.f);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Percentage of the volume filled by the object
+        return { int64_t(5), int64_t(20), int64_t(50) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 1.6f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        trajectory.startAngle = 0.3f;
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        // Ball with the given fraction of the volume, with some structure inside
+        const float radius = std::cbrt(3.f * static_cast<float>(experimentValue.Value) / (400.f * static_cast<float>(M_PI)));
+        volume_.fill([radius](size_t x, size_t y, size_t z) {
+            auto c = [](size_t i) { return (static_cast<float>(i) + 0.5f) / volume_size - 0.5f; };
+            float r = std::sqrt(c(x) * c(x) + c(y) * c(y) + c(z) * c(z));
+            return r < radius ? 1.f + 0.1f * static_cast<float>((x ^ y ^ z) & 3) : 0.f;
+        });
+
+        occupancy_.invalidate();
+        occupancy_.update(volume_);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        rayCountUDM->addValue((projection_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM };
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::volume<float> volume_;
+    tomosect::projection_view<float> view_;
+    tomosect::occupancy_grid<float> occupancy_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<RayCountUDM> rayCountUDM{ new RayCountUDM };
+};
+
+BASELINE_F(EmptySpace, AllVoxels, EmptySpaceFixture, SAMPLES, ITERATIONS)
+{
+    for (size_t row = 0; row < view_.rows(); ++row)
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = tomosect::project(view_.pixelRay(col, row), grid_, volume_);
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(EmptySpace, OccupiedBricks, EmptySpaceFixture, SAMPLES, ITERATIONS)
+{
+    for (size_t row = 0; row < view_.rows(); ++row)
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = tomosect::project(view_.pixelRay(col, row), grid_, volume_, occupancy_);
+    celero::DoNotOptimizeAway(projection_);
+}
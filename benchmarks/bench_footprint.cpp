@@ -0,0 +1,124 @@
+/**
+ *
+ * \file bench_footprint.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <vector>
+
+#include "TomoSect/footprint.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/phantom.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/supersampling.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+constexpr size_t volume_size = 128;
+
+class FootprintFixture : public celero::TestFixture
+{
+public:
+    class PixelCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Pixels/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    FootprintFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)), volume_(makeVolume(grid_)),
+          pyramid_(grid_, volume_), view_(makeView(32))
+    {
+    }
+
+    static tomosect::volume<float> makeVolume(const tomosect::voxel_grid<float>& grid)
+    {
+        const auto phantom = tomosect::shepp_logan_phantom<float>(0.5f);
+        tomosect::volume<float> vol(volume_size, volume_size, volume_size);
+        vol.fill([&](size_t x, size_t y, size_t z) {
+            const auto c = grid.voxelCenter(x, y, z);
+            return phantom.value({ c.x(), c.y(), c.z() });
+        });
+        return vol;
+    }
+
+    static tomosect::projection_view<float> makeView(size_t n)
+    {
+        return tomosect::circular_trajectory<float>{ 1, 2.f, 1.f, n, n, 1.6f / n, 1.6f / n, 0.3f }.view(0);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Detector pixels per edge, the coarser the detector the more voxels each pixel covers
+        return { int64_t(32), int64_t(64), int64_t(128) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        const auto n = static_cast<size_t>(experimentValue.Value);
+        view_ = makeView(n);
+        projection_.assign(n * n, 0.f);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        pixelCountUDM->addValue((projection_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->pixelCountUDM };
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::volume<float> volume_;
+    tomosect::volume_pyramid<float, float> pyramid_;
+    tomosect::projection_view<float> view_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<PixelCountUDM> pixelCountUDM{ new PixelCountUDM };
+};
+
+BASELINE_F(FootprintProjection, PixelCenters, FootprintFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = tomosect::project(view_.pixelRay(col, row), grid_, volume_);
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(FootprintProjection, Footprint, FootprintFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::project_footprint(view_, pyramid_, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(FootprintProjection, Supersampled4x4, FootprintFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::supersampling<float> options;
+    options.subCols = 4;
+    options.subRows = 4;
+    tomosect::project_supersampled(view_, options, grid_, volume_, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
@@ -0,0 +1,110 @@
+/**
+ *
+ * \file bench_helical.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <vector>
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/helical.hpp"
+#include "TomoSect/projection_stack.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 3;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 64;
+constexpr size_t views_per_turn = 360;
+constexpr size_t turns = 10;
+
+class HelicalFixture : public celero::TestFixture
+{
+public:
+    class VoxelCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Voxels/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    HelicalFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          filtered_(128, 32, views_per_turn * turns)
+    {
+        for (size_t i = 0; i < filtered_.size(); ++i)
+            filtered_.data()[i] = static_cast<float>(i % 31) / 31;
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Pitch in percent, the higher the pitch the fewer views see a voxel
+        return { int64_t(50), int64_t(100), int64_t(150) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        // 32 rows of 0.015 are 0.32 high at the axis
+        const float pitch = static_cast<float>(experimentValue.Value) / 100;
+        const float feed = pitch * 0.32f;
+        trajectory_ = tomosect::helical_trajectory<float>{ views_per_turn * turns, 2.f, 1.f, 128, 32, 0.015f, 0.015f, views_per_turn, feed,
+                                                           0.f, -feed * turns / 2 };
+
+        matrices_.clear();
+        rows_.clear();
+        for (size_t k = 0; k < trajectory_.numViews; ++k) {
+            matrices_.push_back(trajectory_.view(k).projectionMatrix());
+            rows_.push_back({ filtered_.view(k), 0, trajectory_.rows });
+        }
+        output_.assign(grid_.size(), 0.f);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        voxelCountUDM->addValue((grid_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->voxelCountUDM };
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::projection_stack<float> filtered_;
+    tomosect::helical_trajectory<float> trajectory_{ 1, 2.f, 1.f, 1, 1, 1.f, 1.f, 1, 0.f };
+    std::vector<tomosect::projection_matrix<float>> matrices_;
+    std::vector<tomosect::filtered_rows> rows_;
+    std::vector<float> output_;
+
+    std::shared_ptr<VoxelCountUDM> voxelCountUDM{ new VoxelCountUDM };
+};
+
+BASELINE_F(HelicalBackprojection, AllViews, HelicalFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::backproject(matrices_, rows_, trajectory_.cols, 1.f, grid_, 0, grid_.nz(), output_.data());
+    celero::DoNotOptimizeAway(output_[0]);
+}
+
+BENCHMARK_F(HelicalBackprojection, ViewWindows, HelicalFixture, SAMPLES, ITERATIONS)
+{
+    const tomosect::voxel_box box{ 0, grid_.nx(), 0, grid_.ny(), 0, grid_.nz() };
+    tomosect::backproject(trajectory_, filtered_, 1.f, grid_, box, output_.data());
+    celero::DoNotOptimizeAway(output_[0]);
+}
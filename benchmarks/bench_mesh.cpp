@@ -0,0 +1,121 @@
+/**
+ *
+ * \file bench_mesh.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "TomoSect/mesh.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 1;
+
+constexpr size_t detector_size = 256;
+
+class MeshFixture : public celero::TestFixture
+{
+public:
+    MeshFixture() : view_(makeView()) { image_.assign(detector_size * detector_size, 0.f); }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Approximate number of triangles of the sphere
+        return { int64_t(10000), int64_t(100000), int64_t(1000000) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 2.f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        // Only regenerate the file if the size changes, not for every sample
+        if (experimentValue.Value == triangles_)
+            return;
+        triangles_ = experimentValue.Value;
+
+        // Latitude longitude sphere with about twice as many segments as rings
+        const auto rings = static_cast<uint32_t>(std::sqrt(static_cast<double>(triangles_) / 4));
+        const uint32_t segments = 2 * rings;
+
+        std::vector<std::array<float, 3>> vertices;
+        for (uint32_t i = 0; i <= rings; ++i) {
+            const float theta = static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(rings);
+            for (uint32_t j = 0; j < segments; ++j) {
+                const float phi = 2 * static_cast<float>(M_PI) * static_cast<float>(j) / static_cast<float>(segments);
+                vertices.push_back(
+                    { 0.5f * std::sin(theta) * std::cos(phi), 0.5f * std::sin(theta) * std::sin(phi), 0.5f * std::cos(theta) });
+            }
+        }
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        auto at = [segments](uint32_t i, uint32_t j) { return i * segments + j % segments; };
+        for (uint32_t i = 0; i < rings; ++i) {
+            for (uint32_t j = 0; j < segments; ++j) {
+                if (i > 0)
+                    triangles.push_back({ at(i, j), at(i + 1, j), at(i, j + 1) });
+                if (i + 1 < rings)
+                    triangles.push_back({ at(i, j + 1), at(i + 1, j), at(i + 1, j + 1) });
+            }
+        }
+
+        std::filesystem::create_directories(path_.parent_path());
+        tomosect::save_stl(path_.string(), tomosect::triangle_mesh<float>(std::move(vertices), std::move(triangles)));
+        mesh_ = std::make_unique<tomosect::triangle_mesh<float>>(tomosect::load_stl(path_.string()));
+    }
+
+    std::filesystem::path path_ = std::filesystem::temp_directory_path() / "tomosect_bench_mesh" / "sphere.stl";
+    int64_t triangles_ = 0;
+
+    tomosect::projection_view<float> view_;
+    std::unique_ptr<tomosect::triangle_mesh<float>> mesh_;
+    std::vector<float> image_;
+};
+
+BASELINE_F(MeshLoad, ReadFile, MeshFixture, SAMPLES, ITERATIONS)
+{
+    std::ifstream file(path_, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    celero::DoNotOptimizeAway(bytes.size());
+}
+
+BENCHMARK_F(MeshLoad, LoadStl, MeshFixture, SAMPLES, ITERATIONS)
+{
+    auto mesh = tomosect::load_stl(path_.string());
+    celero::DoNotOptimizeAway(mesh.numTriangles());
+}
+
+BASELINE_F(MeshProjection, ScalarRays, MeshFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_for(0, detector_size, [&](size_t row) {
+        for (size_t col = 0; col < detector_size; ++col)
+            image_[row * detector_size + col] = mesh_->pathLength(view_.pixelRay(col, row));
+    });
+    celero::DoNotOptimizeAway(image_[detector_size * detector_size / 2]);
+}
+
+BENCHMARK_F(MeshProjection, Packets, MeshFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::project_mesh(view_, *mesh_, image_.data());
+    celero::DoNotOptimizeAway(image_[detector_size * detector_size / 2]);
+}
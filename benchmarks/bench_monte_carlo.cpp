@@ -0,0 +1,117 @@
+/**
+ *
+ * \file bench_monte_carlo.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+
+#include "TomoSect/monte_carlo.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 64;
+constexpr size_t detector_size = 64;
+constexpr float pixel_size = 1.6f / detector_size;
+constexpr uint64_t num_photons = 1 << 20;
+
+class MonteCarloFixture : public celero::TestFixture
+{
+public:
+    class PhotonCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Photons/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    MonteCarloFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          labels_(volume_size, volume_size, volume_size),
+          materials_(table({ 0.4f, 0.05f, 0.03f }, { 4.f, 0.3f, 0.1f }), table({ 0.9f, 0.8f, 0.7f }, { 1.4f, 1.2f, 1.1f }),
+                     table({ 0.15f, 0.05f, 0.02f }, { 0.5f, 0.15f, 0.06f })),
+          view_(tomosect::circular_trajectory<float>{ 1, 2.f, 1.f, detector_size, detector_size, pixel_size, pixel_size }.view(0))
+    {
+        // Water ball with a bone core, attenuation per unit length of the grid
+        labels_.fill([](size_t x, size_t y, size_t z) -> uint8_t {
+            auto c = [](size_t i) { return (static_cast<float>(i) + 0.5f) / volume_size - 0.5f; };
+            const float r = std::sqrt(c(x) * c(x) + c(y) * c(y) + c(z) * c(z));
+            return r < 0.1f ? 2 : (r < 0.45f ? 1 : 0);
+        });
+
+        for (float e = 20; e <= 120; e += 5) {
+            source_.energies.push_back(e);
+            source_.weights.push_back(e * (120 - e));
+        }
+    }
+
+    static tomosect::material_table<float> table(std::vector<float> water, std::vector<float> bone)
+    {
+        return tomosect::material_table<float>({ "water", "bone" }, { 20.f, 60.f, 120.f }, { std::move(water), std::move(bone) });
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of threads
+        return { int64_t(1), int64_t(2), int64_t(4), int64_t(8) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        threads_ = static_cast<size_t>(experimentValue.Value);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        photonCountUDM->addValue((num_photons * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->photonCountUDM };
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::volume<uint8_t> labels_;
+    tomosect::interaction_table<float> materials_;
+    tomosect::spectrum<float> source_;
+    tomosect::projection_view<float> view_;
+    size_t threads_ = 1;
+
+    std::shared_ptr<PhotonCountUDM> photonCountUDM{ new PhotonCountUDM };
+};
+
+BASELINE_F(MonteCarlo, SingleThread, MonteCarloFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::scatter_options options;
+    options.numThreads = 1;
+    celero::DoNotOptimizeAway(tomosect::simulate_scatter(view_, grid_, labels_, materials_, source_, num_photons, options));
+}
+
+BENCHMARK_F(MonteCarlo, Threads, MonteCarloFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::scatter_options options;
+    options.numThreads = threads_;
+    celero::DoNotOptimizeAway(tomosect::simulate_scatter(view_, grid_, labels_, materials_, source_, num_photons, options));
+}
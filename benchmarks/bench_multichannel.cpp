@@ -0,0 +1,157 @@
+/**
+ *
+ * \file bench_multichannel.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <array>
+#include <vector>
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/multichannel.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 128;
+constexpr size_t detector_size = 128;
+constexpr size_t num_views = 16;
+
+class MultichannelFixture : public celero::TestFixture
+{
+public:
+    MultichannelFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          trajectory_{ num_views, 2.f, 1.f, detector_size, detector_size, 1.6f / detector_size, 1.6f / detector_size }
+    {
+        for (size_t k = 0; k < num_views; ++k)
+            matrices_.push_back(trajectory_.view(k).projectionMatrix());
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of channels
+        return { int64_t(2), int64_t(4), int64_t(8) };
+    }
+
+    static float value(size_t x, size_t y, size_t z, size_t c) { return static_cast<float>((x ^ y ^ z) % 13 + c) * 0.01f; }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        channels_ = static_cast<size_t>(experimentValue.Value);
+
+        separate_.clear();
+        for (size_t c = 0; c < channels_; ++c) {
+            separate_.emplace_back(volume_size, volume_size, volume_size);
+            separate_.back().fill([c](size_t x, size_t y, size_t z) { return value(x, y, z, c); });
+        }
+        interleaved2_ = makeInterleaved<2>();
+        interleaved4_ = makeInterleaved<4>();
+        interleaved8_ = makeInterleaved<8>();
+
+        projections_.assign(channels_ * detector_size * detector_size, 0.f);
+        filtered_.assign(num_views * channels_ * detector_size * detector_size, 0.01f);
+    }
+
+    template <size_t Channels>
+    tomosect::multichannel_volume<float, Channels> makeInterleaved() const
+    {
+        if (channels_ != Channels)
+            return tomosect::multichannel_volume<float, Channels>(1, 1, 1);
+
+        tomosect::multichannel_volume<float, Channels> vol(volume_size, volume_size, volume_size);
+        vol.fill([](size_t x, size_t y, size_t z) {
+            std::array<float, Channels> v;
+            for (size_t c = 0; c < Channels; ++c)
+                v[c] = value(x, y, z, c);
+            return v;
+        });
+        return vol;
+    }
+
+    /// Calls f with the interleaved volume of the current number of channels
+    template <typename Function>
+    void withInterleaved(Function&& f)
+    {
+        if (channels_ == 2)
+            f(interleaved2_);
+        else if (channels_ == 4)
+            f(interleaved4_);
+        else
+            f(interleaved8_);
+    }
+
+    /// Filtered rows of all views, starting at the given offset into the data of each view
+    std::vector<tomosect::filtered_rows> rows(size_t offset) const
+    {
+        std::vector<tomosect::filtered_rows> result;
+        const size_t viewSize = channels_ * detector_size * detector_size;
+        for (size_t k = 0; k < num_views; ++k)
+            result.push_back({ filtered_.data() + k * viewSize + offset, 0, detector_size });
+        return result;
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::circular_trajectory<float> trajectory_;
+    std::vector<tomosect::projection_matrix<float>> matrices_;
+    size_t channels_ = 0;
+
+    std::vector<tomosect::volume<float>> separate_;
+    tomosect::multichannel_volume<float, 2> interleaved2_{ 1, 1, 1 };
+    tomosect::multichannel_volume<float, 4> interleaved4_{ 1, 1, 1 };
+    tomosect::multichannel_volume<float, 8> interleaved8_{ 1, 1, 1 };
+
+    std::vector<float> projections_;
+    std::vector<float> filtered_;
+};
+
+BASELINE_F(MultichannelForward, SeparateVolumes, MultichannelFixture, SAMPLES, ITERATIONS)
+{
+    // One traversal per channel
+    const auto view = trajectory_.view(3);
+    const size_t pixels = detector_size * detector_size;
+    for (size_t c = 0; c < channels_; ++c) {
+        tomosect::parallel_for(0, detector_size, [&](size_t row) {
+            for (size_t col = 0; col < detector_size; ++col)
+                projections_[c * pixels + row * detector_size + col] = tomosect::project(view.pixelRay(col, row), grid_, separate_[c]);
+        });
+    }
+    celero::DoNotOptimizeAway(projections_);
+}
+
+BENCHMARK_F(MultichannelForward, Interleaved, MultichannelFixture, SAMPLES, ITERATIONS)
+{
+    withInterleaved([&](const auto& vol) { tomosect::project_channels(trajectory_.view(3), grid_, vol, projections_.data()); });
+    celero::DoNotOptimizeAway(projections_);
+}
+
+BASELINE_F(MultichannelBackward, SeparateVolumes, MultichannelFixture, SAMPLES, ITERATIONS)
+{
+    // One FDK backprojection per channel, the channels of a view are stored one after another
+    for (size_t c = 0; c < channels_; ++c) {
+        const auto channel = rows(c * detector_size * detector_size);
+        tomosect::backproject(matrices_, channel, detector_size, 1.f, grid_, 0, volume_size, separate_[c].data());
+    }
+    celero::DoNotOptimizeAway(separate_);
+}
+
+BENCHMARK_F(MultichannelBackward, Interleaved, MultichannelFixture, SAMPLES, ITERATIONS)
+{
+    withInterleaved([&](auto& vol) {
+        tomosect::backproject_channels(matrices_, rows(0), detector_size, 1.f, grid_,
+                                       tomosect::voxel_box{ 0, volume_size, 0, volume_size, 0, volume_size }, vol.data());
+    });
+    celero::DoNotOptimizeAway(interleaved8_);
+}
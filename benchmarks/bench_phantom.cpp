@@ -0,0 +1,124 @@
+/**
+ *
+ * \file bench_phantom.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <memory>
+#include <vector>
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/phantom.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+constexpr size_t detector_size = 256;
+
+class PhantomFixture : public celero::TestFixture
+{
+public:
+    class RayCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Rays/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    PhantomFixture() : phantom_(tomosect::shepp_logan_phantom<float>(0.5f)), view_(makeView())
+    {
+        projection_.assign(detector_size * detector_size, 0.f);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Resolution of the voxelised phantom, the analytic projections do not depend on it
+        return { int64_t(64), int64_t(128), int64_t(256) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 1.6f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        trajectory.startAngle = 0.3f;
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        const auto n = static_cast<size_t>(experimentValue.Value);
+        if (volume_ && volume_->nx() == n)
+            return;
+
+        // Sample the phantom at the voxel centers of the cube [-0.5, 0.5]^3
+        const float voxel = 1.f / static_cast<float>(n);
+        grid_ = tomosect::voxel_grid<float>(n, n, n, point3<float>(-0.5f), vec3<float>(voxel));
+        volume_ = std::make_unique<tomosect::volume<float>>(n, n, n);
+        volume_->fill([&](size_t x, size_t y, size_t z) {
+            auto c = [&](size_t i) { return (static_cast<float>(i) + 0.5f) * voxel - 0.5f; };
+            return phantom_.value({ c(x), c(y), c(z) });
+        });
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        rayCountUDM->addValue((projection_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM };
+    }
+
+    tomosect::analytic_phantom<float> phantom_;
+    tomosect::projection_view<float> view_;
+    tomosect::voxel_grid<float> grid_;
+    std::unique_ptr<tomosect::volume<float>> volume_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<RayCountUDM> rayCountUDM{ new RayCountUDM };
+};
+
+BASELINE_F(PhantomProjection, Voxelised, PhantomFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = tomosect::project(view_.pixelRay(col, row), grid_, *volume_);
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(PhantomProjection, AnalyticScalar, PhantomFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < view_.cols(); ++col)
+            projection_[row * view_.cols() + col] = phantom_.lineIntegral(view_.pixelRay(col, row));
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(PhantomProjection, AnalyticPackets, PhantomFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::project_phantom(view_, phantom_, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
@@ -0,0 +1,114 @@
+/**
+ *
+ * \file bench_polychromatic.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/polychromatic.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 64;
+constexpr size_t detector_size = 64;
+
+class PolychromaticFixture : public celero::TestFixture
+{
+public:
+    PolychromaticFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          labels_(volume_size, volume_size, volume_size),
+          materials_({ "water", "bone" }, { 20.f, 40.f, 60.f, 80.f, 120.f },
+                     { { 0.8f, 0.27f, 0.2f, 0.18f, 0.16f }, { 4.0f, 1.0f, 0.5f, 0.35f, 0.28f } }),
+          view_(makeView())
+    {
+        projection_.assign(detector_size * detector_size, 0.f);
+
+        // Water ball with a bone ring and core
+        labels_.fill([](size_t x, size_t y, size_t z) -> uint8_t {
+            auto c = [](size_t i) { return (static_cast<float>(i) + 0.5f) / volume_size - 0.5f; };
+            const float r = std::sqrt(c(x) * c(x) + c(y) * c(y) + c(z) * c(z));
+            if (r > 0.45f)
+                return 0;
+            return (r > 0.38f || r < 0.08f) ? 2 : 1;
+        });
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of energy bins
+        return { int64_t(16), int64_t(64), int64_t(150) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 1.6f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        source_ = {};
+        const auto bins = static_cast<size_t>(experimentValue.Value);
+        for (size_t e = 0; e < bins; ++e) {
+            const float energy = 20.f + 100.f * static_cast<float>(e) / static_cast<float>(bins);
+            source_.energies.push_back(energy);
+            source_.weights.push_back(energy * (120.f - energy));
+        }
+        model_ = std::make_unique<tomosect::polychromatic_model<float>>(source_, materials_);
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::volume<uint8_t> labels_;
+    tomosect::material_table<float> materials_;
+    tomosect::spectrum<float> source_;
+    std::unique_ptr<tomosect::polychromatic_model<float>> model_;
+    tomosect::projection_view<float> view_;
+    std::vector<float> projection_;
+};
+
+BASELINE_F(Polychromatic, ProjectorPerEnergy, PolychromaticFixture, SAMPLES, ITERATIONS)
+{
+    // Monochromatic projection for every energy bin, summed up afterwards
+    tomosect::parallel_for(0, view_.rows(), [&](size_t row) {
+        for (size_t col = 0; col < view_.cols(); ++col) {
+            const auto r = view_.pixelRay(col, row);
+
+            float intensity = 0;
+            for (size_t e = 0; e < source_.size(); ++e) {
+                float integral = 0;
+                tomosect::traverse_cells(r, grid_, [&](size_t x, size_t y, size_t z, float length) {
+                    const uint8_t label = labels_(x, y, z);
+                    if (label != 0)
+                        integral += model_->attenuation(label - 1, e) * length;
+                });
+                intensity += source_.weights[e] * std::exp(-integral);
+            }
+            projection_[row * view_.cols() + col] = -std::log(intensity / model_->flatField());
+        }
+    });
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(Polychromatic, LengthsOnce, PolychromaticFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::project_polychromatic(view_, grid_, labels_, *model_, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
@@ -0,0 +1,101 @@
+/**
+ *
+ * \file bench_pose_batch.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/pose_batch.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 5;
+
+class PoseFixture : public celero::TestFixture
+{
+public:
+    class ViewCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Views/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Number of views
+        return { int64_t(1000), int64_t(10000), int64_t(100000) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        const auto n = static_cast<size_t>(experimentValue.Value);
+        translations_.clear();
+        rotations_.clear();
+        sources_.clear();
+        for (size_t k = 0; k < n; ++k) {
+            const auto a = static_cast<float>(k) * 0.001f;
+            translations_.emplace_back(0.1f * std::sin(a), 0.2f, 0.1f * std::cos(a));
+            rotations_.emplace_back(0.3f * std::sin(7 * a), a, 2 * a);
+            sources_.emplace_back(2 * std::cos(a), 2 * std::sin(a), 0.f);
+        }
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        viewCountUDM->addValue((translations_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->viewCountUDM };
+    }
+
+    const point2<float> pixels_{ 512, 512 };
+    const vec3<float> scale_{ 0.4f, 0.4f, 1.f };
+    std::vector<vec3<float>> translations_;
+    std::vector<vec3<float>> rotations_;
+    std::vector<point3<float>> sources_;
+
+    std::shared_ptr<ViewCountUDM> viewCountUDM{ new ViewCountUDM };
+};
+
+BASELINE_F(Poses, Rectangles, PoseFixture, SAMPLES, ITERATIONS)
+{
+    using Radian = radian<float>;
+
+    std::vector<tomosect::projection_view<float>> views;
+    views.reserve(translations_.size());
+    for (size_t k = 0; k < translations_.size(); ++k) {
+        const auto& r = rotations_[k];
+        views.push_back({ sources_[k], rectangle<float>(pixels_, translations_[k], scale_, Radian(r.x()), Radian(r.y()), Radian(r.z())) });
+    }
+    celero::DoNotOptimizeAway(views.back().source);
+}
+
+BENCHMARK_F(Poses, Batch, PoseFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::pose_batch<float> batch(pixels_, scale_, translations_, rotations_, sources_);
+    const auto views = batch.views();
+    celero::DoNotOptimizeAway(views.back().source);
+}
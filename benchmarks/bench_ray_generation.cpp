@@ -13,6 +13,8 @@
 
 #include "TomoSect/geometry.hpp"
 #include "TomoSect/intersection.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/tile_culling.hpp"
 
 #include "bench_ray_fixture.hpp"
 
@@ -135,4 +137,69 @@ BENCHMARK_F(RayGeneration, CudaArray, IntersectionFixture<enoki::CUDAArray<float
             celero::DoNotOptimizeAway(hit);
         }
     }
-}
\ No newline at end of file
+}
+/// Same rays as NoPack, but only for detector tiles not culled against the box, reports the fraction of culled tiles
+class TileCullingFixture : public IntersectionFixture<float>
+{
+public:
+    class CulledRatioUDM : public celero::UserDefinedMeasurementTemplate<double>
+    {
+        virtual std::string getName() const override { return "Culled tiles"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return false; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return false; }
+        bool reportMax() const override { return false; }
+    };
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        IntersectionFixture<float>::setUp(experimentValue);
+        stats_ = {};
+    }
+
+    void tearDown() override
+    {
+        IntersectionFixture<float>::tearDown();
+        culledRatioUDM->addValue(stats_.culledRatio());
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM, this->culledRatioUDM };
+    }
+
+    tomosect::tile_statistics stats_;
+
+    std::shared_ptr<CulledRatioUDM> culledRatioUDM{ new CulledRatioUDM };
+};
+
+BENCHMARK_F(RayGeneration, TileCulled, TileCullingFixture, SAMPLES, ITERATIONS)
+{
+    using Value = float;
+    const tomosect::projection_view<Value> view{ origin_, rect_ };
+
+    // Tiles of 2 x 2 pixels, rays of tiles inside the box are known to hit it
+    stats_ = tomosect::for_each_visible_tile(view, aabb_, 2, [&](const tomosect::detector_window& tile, tomosect::tile_class c) {
+        for (size_t y = tile.rowBegin; y < tile.rowEnd; ++y) {
+            for (size_t x = tile.colBegin; x < tile.colEnd; ++x) {
+                auto planeCoord = rect_.coordFromLocal(point2<Value>{ static_cast<Value>(x), static_cast<Value>(y) });
+
+                auto r = rayFromPoints(origin_, planeCoord);
+
+                if (c == tomosect::tile_class::inside) {
+                    celero::DoNotOptimizeAway(r);
+                    continue;
+                }
+
+                auto hit = intersection(r, aabb_, ray_aabb_intersection{});
+
+                celero::DoNotOptimizeAway(hit);
+            }
+        }
+    });
+}
@@ -0,0 +1,131 @@
+/**
+ *
+ * \file bench_rebinning.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/rebinning.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+constexpr size_t num_views = 720;
+constexpr size_t num_rows = 64;
+
+class RebinningFixture : public celero::TestFixture
+{
+public:
+    class SampleCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Samples/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Detector columns
+        return { int64_t(128), int64_t(256), int64_t(512) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        const auto cols = static_cast<size_t>(experimentValue.Value);
+        trajectory_ = tomosect::circular_trajectory<float>{ num_views, 2.f, 1.f, cols, num_rows, 2.4f / cols, 2.4f / cols };
+
+        in_ = std::make_unique<tomosect::projection_stack<float>>(cols, num_rows, num_views);
+        out_ = std::make_unique<tomosect::projection_stack<float>>(cols, num_rows, num_views);
+        for (size_t i = 0; i < in_->size(); ++i)
+            in_->data()[i] = static_cast<float>(i % 97);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        sampleCountUDM->addValue((out_->size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->sampleCountUDM };
+    }
+
+    tomosect::circular_trajectory<float> trajectory_{ 1, 2.f, 1.f, 1, 1, 1.f, 1.f };
+    std::unique_ptr<tomosect::projection_stack<float>> in_;
+    std::unique_ptr<tomosect::projection_stack<float>> out_;
+
+    std::shared_ptr<SampleCountUDM> sampleCountUDM{ new SampleCountUDM };
+};
+
+BASELINE_F(Rebinning, Direct, RebinningFixture, SAMPLES, ITERATIONS)
+{
+    // Interpolation positions computed for every sample, one sample at a time
+    const float R = trajectory_.sourceDistance;
+    const float SDD = R + trajectory_.detectorDistance;
+    const size_t cols = trajectory_.cols;
+    const auto views = static_cast<long>(num_views);
+
+    tomosect::parallel_for(0, num_views, [&](size_t k) {
+        for (size_t r = 0; r < num_rows; ++r) {
+            for (size_t j = 0; j < cols; ++j) {
+                const float t = (static_cast<float>(j) - (cols - 1) / 2.f) * trajectory_.pixelWidth * R / SDD;
+                const float z = (static_cast<float>(r) - (num_rows - 1) / 2.f) * trajectory_.pixelHeight * R / SDD;
+                const float gamma = std::asin(t / R);
+                const float c = std::cos(gamma);
+                const float col = SDD * std::tan(gamma) / trajectory_.pixelWidth + (cols - 1) / 2.f;
+                const float row = z * SDD / (R * c * c) / trajectory_.pixelHeight + (num_rows - 1) / 2.f;
+                const float view = static_cast<float>(k) + gamma / trajectory_.step();
+
+                const long v0 = static_cast<long>(std::floor(view));
+                const long c0 = static_cast<long>(std::floor(col));
+                const long r0 = static_cast<long>(std::floor(row));
+                const float wv = view - v0, wc = col - c0, wr = row - r0;
+
+                float sum = 0;
+                for (int a = 0; a < 2; ++a) {
+                    for (int b = 0; b < 2; ++b) {
+                        for (int d = 0; d < 2; ++d) {
+                            const long cc = c0 + b, rr = r0 + d;
+                            if (cc < 0 || cc >= static_cast<long>(cols) || rr < 0 || rr >= static_cast<long>(num_rows))
+                                continue;
+                            const size_t v = static_cast<size_t>(((v0 + a) % views + views) % views);
+                            sum += (a ? wv : 1 - wv) * (b ? wc : 1 - wc) * (d ? wr : 1 - wr) * (*in_)(cc, rr, v);
+                        }
+                    }
+                }
+                (*out_)(j, r, k) = sum;
+            }
+        }
+    });
+    celero::DoNotOptimizeAway(out_->data()[0]);
+}
+
+BENCHMARK_F(Rebinning, Tables, RebinningFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::parallel_rebinning<float> rebinning(trajectory_);
+    rebinning.rebin(*in_, *out_);
+    celero::DoNotOptimizeAway(out_->data()[0]);
+}
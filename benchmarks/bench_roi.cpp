@@ -0,0 +1,71 @@
+/**
+ *
+ * \file bench_roi.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/roi.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 1;
+
+constexpr size_t volume_size = 96;
+constexpr size_t detector_size = 128;
+
+class RoiFixture : public celero::TestFixture
+{
+public:
+    RoiFixture()
+        : trajectory_{ 90, 2.f, 1.f, detector_size, detector_size, 1.6f / detector_size, 1.6f / detector_size },
+          grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          projections_(detector_size, detector_size, 90)
+    {
+        for (size_t k = 0; k < 90; ++k)
+            for (size_t row = 0; row < detector_size; ++row)
+                for (size_t col = 0; col < detector_size; ++col)
+                    projections_(col, row, k) = std::sin(0.1f * static_cast<float>(col + k)) + 0.01f * static_cast<float>(row);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Volume fraction of the ROI in percent
+        return { int64_t(1), int64_t(10), int64_t(50) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        // Cube around the center with the given fraction of the volume
+        float half = 0.5f * std::cbrt(static_cast<float>(experimentValue.Value) / 100.f);
+        roi_ = aabb<float>(point3<float>(-half), point3<float>(half));
+    }
+
+    tomosect::circular_trajectory<float> trajectory_;
+    tomosect::voxel_grid<float> grid_;
+    tomosect::projection_stack<float> projections_;
+    aabb<float> roi_;
+};
+
+BASELINE_F(FDK, Full, RoiFixture, SAMPLES, ITERATIONS)
+{
+    auto result = tomosect::fdk(trajectory_, projections_, grid_);
+    celero::DoNotOptimizeAway(result.data()[0]);
+}
+
+BENCHMARK_F(FDK, Roi, RoiFixture, SAMPLES, ITERATIONS)
+{
+    auto result = tomosect::fdk_roi(trajectory_, projections_, grid_, roi_);
+    celero::DoNotOptimizeAway(result.data.data()[0]);
+}
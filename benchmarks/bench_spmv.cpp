@@ -0,0 +1,120 @@
+/**
+ *
+ * \file bench_spmv.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <random>
+#include <vector>
+
+#include "TomoSect/compressed_matrix.hpp"
+#include "TomoSect/system_matrix.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 10;
+
+class SpMVFixture : public celero::TestFixture
+{
+public:
+    class NonZeroUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Nonzeros/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Edge length of volume and detector
+        return { int64_t(32), int64_t(64) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        using namespace tomosect;
+        using Angle = degree<float>;
+
+        auto n = static_cast<size_t>(experimentValue.Value);
+        auto grid = voxel_grid<float>(n, n, n, point3<float>(-0.25), vec3<float>(0.5f / n));
+
+        // Views rotating around the x-axis, the translation is applied in the rotated frame
+        std::vector<projection_view<float>> views;
+        for (int k = 0; k < 30; ++k) {
+            auto a = Angle(k * 6.f);
+            auto rot = enoki::rotate<enoki::Matrix<float, 4>>(enoki::Array<float, 3>(1, 0, 0), -Angle(k * 6.f).to_radian());
+            auto source = point3<float>(enoki::head<3>(rot * enoki::Array<float, 4>(0, 0, -2, 1)));
+            views.push_back({ source, rectangle<float>(point2<float>(float(n)), vec3<float>(0, 0, 1), 1, a, Angle(0), Angle(0)) });
+        }
+
+        matrix_ = assemble_system_matrix(scan_geometry<float>(grid, views));
+        compressed8_ = compressed_matrix<weight_quantization::unorm8>(matrix_);
+        compressed16_ = compressed_matrix<weight_quantization::fp16>(matrix_);
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> dist(0, 1);
+        x_.resize(matrix_.cols());
+        for (auto& e : x_)
+            e = dist(gen);
+        y_.resize(matrix_.rows());
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        nonZeroUDM->addValue((matrix_.nnz() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->nonZeroUDM };
+    }
+
+    tomosect::csr_matrix matrix_;
+    tomosect::compressed_matrix<tomosect::weight_quantization::unorm8> compressed8_;
+    tomosect::compressed_matrix<tomosect::weight_quantization::fp16> compressed16_;
+    std::vector<float> x_;
+    std::vector<float> y_;
+
+    std::shared_ptr<NonZeroUDM> nonZeroUDM{ new NonZeroUDM };
+};
+
+BASELINE_F(SpMV, CSR, SpMVFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::spmv(matrix_, x_.data(), y_.data());
+    celero::DoNotOptimizeAway(y_);
+}
+
+BENCHMARK_F(SpMV, CompressedUnorm8, SpMVFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::spmv(compressed8_, x_.data(), y_.data());
+    celero::DoNotOptimizeAway(y_);
+}
+
+BENCHMARK_F(SpMV, CompressedFp16, SpMVFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::spmv(compressed16_, x_.data(), y_.data());
+    celero::DoNotOptimizeAway(y_);
+}
+
+BENCHMARK_F(SpMV, CompressedUnorm8Pack16, SpMVFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::spmv<pack16<float>>(compressed8_, x_.data(), y_.data());
+    celero::DoNotOptimizeAway(y_);
+}
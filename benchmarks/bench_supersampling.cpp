@@ -0,0 +1,109 @@
+/**
+ *
+ * \file bench_supersampling.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <vector>
+
+#include "TomoSect/phantom.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/supersampling.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+constexpr size_t detector_size = 128;
+constexpr float pixel_size = 1.6f / detector_size;
+
+class SupersamplingFixture : public celero::TestFixture
+{
+public:
+    class RayCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Rays/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    SupersamplingFixture()
+        : phantom_(tomosect::shepp_logan_phantom<float>(0.5f)),
+          view_(tomosect::circular_trajectory<float>{ 1, 2.f, 1.f, detector_size, detector_size, pixel_size, pixel_size }.view(0))
+    {
+        projection_.assign(detector_size * detector_size, 0.f);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Detector samples per pixel edge, with 2 x 2 focal spot samples on top for the FocalSpot benchmark
+        return { int64_t(1), int64_t(2), int64_t(3), int64_t(4) };
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        options_ = tomosect::supersampling<float>{};
+        options_.subCols = static_cast<size_t>(experimentValue.Value);
+        options_.subRows = static_cast<size_t>(experimentValue.Value);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        rayCountUDM->addValue((projection_.size() * options_.samplesPerPixel() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM };
+    }
+
+    tomosect::analytic_phantom<float> phantom_;
+    tomosect::projection_view<float> view_;
+    tomosect::supersampling<float> options_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<RayCountUDM> rayCountUDM{ new RayCountUDM };
+};
+
+BASELINE_F(Supersampling, PixelCenters, SupersamplingFixture, SAMPLES, ITERATIONS)
+{
+    // One ray per pixel, only counted as such
+    options_ = tomosect::supersampling<float>{};
+    tomosect::project_phantom(view_, phantom_, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(Supersampling, Detector, SupersamplingFixture, SAMPLES, ITERATIONS)
+{
+    tomosect::project_supersampled(
+        view_, options_, [&](const ray<pack8<float>>& r) { return phantom_.lineIntegral(r); }, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(Supersampling, FocalSpot, SupersamplingFixture, SAMPLES, ITERATIONS)
+{
+    options_.focalCols = 2;
+    options_.focalRows = 2;
+    options_.focalWidth = 0.001f;
+    options_.focalHeight = 0.001f;
+    tomosect::project_supersampled(
+        view_, options_, [&](const ray<pack8<float>>& r) { return phantom_.lineIntegral(r); }, projection_.data());
+    celero::DoNotOptimizeAway(projection_);
+}
@@ -0,0 +1,114 @@
+/**
+ *
+ * \file bench_tile_culling.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/tile_culling.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 10;
+int ITERATIONS = 5;
+
+constexpr size_t detector_size = 512;
+
+class TileCullingFixture : public celero::TestFixture
+{
+public:
+    class CulledRatioUDM : public celero::UserDefinedMeasurementTemplate<double>
+    {
+        virtual std::string getName() const override { return "Culled tiles"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return false; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return false; }
+        bool reportMax() const override { return false; }
+    };
+
+    TileCullingFixture() : view_(makeView()), box_(point3<float>(-0.2f, -0.1f, -0.15f), point3<float>(0.15f, 0.2f, 0.1f))
+    {
+        hits_.assign(detector_size * detector_size, 0);
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // Tile size in pixels
+        return { int64_t(8), int64_t(16), int64_t(32) };
+    }
+
+    static tomosect::projection_view<float> makeView()
+    {
+        const float pixel = 2.f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        trajectory.startAngle = 0.4f;
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        tileSize_ = static_cast<size_t>(experimentValue.Value);
+        stats_ = {};
+    }
+
+    void tearDown() override { culledRatioUDM->addValue(stats_.culledRatio()); }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->culledRatioUDM };
+    }
+
+    void testRay(size_t col, size_t row)
+    {
+        auto [tmin, tmax, hit] = intersection(view_.pixelRay(col, row), box_, ray_aabb_interval{});
+        hits_[row * detector_size + col] = hit && tmax >= 0 ? 1 : 0;
+    }
+
+    tomosect::projection_view<float> view_;
+    aabb<float> box_;
+    size_t tileSize_ = 8;
+    tomosect::tile_statistics stats_;
+    std::vector<char> hits_;
+
+    std::shared_ptr<CulledRatioUDM> culledRatioUDM{ new CulledRatioUDM };
+};
+
+BASELINE_F(TileCulling, AllRays, TileCullingFixture, SAMPLES, ITERATIONS)
+{
+    for (size_t row = 0; row < detector_size; ++row)
+        for (size_t col = 0; col < detector_size; ++col)
+            testRay(col, row);
+    celero::DoNotOptimizeAway(hits_);
+}
+
+BENCHMARK_F(TileCulling, VisibleTiles, TileCullingFixture, SAMPLES, ITERATIONS)
+{
+    std::fill(hits_.begin(), hits_.end(), 0);
+
+    stats_ = tomosect::for_each_visible_tile(view_, box_, tileSize_, [&](const tomosect::detector_window& tile, tomosect::tile_class c) {
+        for (size_t row = tile.rowBegin; row < tile.rowEnd; ++row)
+            for (size_t col = tile.colBegin; col < tile.colEnd; ++col) {
+                if (c == tomosect::tile_class::inside)
+                    hits_[row * detector_size + col] = 1;
+                else
+                    testRay(col, row);
+            }
+    });
+    celero::DoNotOptimizeAway(hits_);
+}
@@ -0,0 +1,181 @@
+/**
+ *
+ * \file bench_volume_layout.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include <celero/Celero.h>
+
+#include <vector>
+
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+int main(int argc, char** argv)
+{
+    celero::Run(argc, argv);
+    return 0;
+}
+
+int SAMPLES = 5;
+int ITERATIONS = 2;
+
+// Large enough, that the volume does not fit into any cache
+constexpr size_t volume_size = 256;
+constexpr size_t detector_size = 128;
+
+template <tomosect::volume_layout Layout>
+class VolumeLayoutFixture : public celero::TestFixture
+{
+public:
+    class RayCountUDM : public celero::UserDefinedMeasurementTemplate<size_t>
+    {
+        virtual std::string getName() const override { return "Rays/sec"; }
+        bool reportSize() const override { return false; }
+        bool reportMean() const override { return true; }
+        bool reportVariance() const override { return false; }
+        bool reportStandardDeviation() const override { return true; }
+        bool reportSkewness() const override { return false; }
+        bool reportKurtosis() const override { return false; }
+        bool reportZScore() const override { return false; }
+        bool reportMin() const override { return true; }
+        bool reportMax() const override { return true; }
+    };
+
+    VolumeLayoutFixture()
+        : grid_(volume_size, volume_size, volume_size, point3<float>(-0.5f), vec3<float>(1.f / volume_size)),
+          volume_(volume_size, volume_size, volume_size), view_(makeView(0))
+    {
+        volume_.fill([](size_t x, size_t y, size_t z) { return static_cast<float>((x ^ y ^ z) & 15) / 16.f; });
+    }
+
+    [[nodiscard]] std::vector<celero::TestFixture::ExperimentValue> getExperimentValues() const override
+    {
+        // View angle in degrees, at 0 the central ray runs along x, at 90 along y
+        return { int64_t(0), int64_t(30), int64_t(45), int64_t(90) };
+    }
+
+    /// Single cone beam view, the detector covers the whole volume, so rays are oblique in z as well
+    static tomosect::projection_view<float> makeView(int64_t degrees)
+    {
+        const float pixel = 1.6f / detector_size;
+        tomosect::circular_trajectory<float> trajectory{ 1, 2.f, 1.f, detector_size, detector_size, pixel, pixel };
+        trajectory.startAngle = static_cast<float>(degrees * M_PI / 180);
+        return trajectory.view(0);
+    }
+
+    void setUp(const celero::TestFixture::ExperimentValue& experimentValue) override
+    {
+        view_ = makeView(experimentValue.Value);
+        projection_.assign(detector_size * detector_size, 0.f);
+    }
+
+    void tearDown() override
+    {
+        float iters = getExperimentIterations();
+        float time = getExperimentTime() * 1e-6;
+        rayCountUDM->addValue((projection_.size() * iters) / time);
+    }
+
+    virtual std::vector<std::shared_ptr<celero::UserDefinedMeasurement>> getUserDefinedMeasurements() const override
+    {
+        return { this->rayCountUDM };
+    }
+
+    /// Exact line integrals through the voxels
+    void projectSiddon()
+    {
+        for (size_t row = 0; row < view_.rows(); ++row)
+            for (size_t col = 0; col < view_.cols(); ++col)
+                projection_[row * view_.cols() + col] = tomosect::project(view_.pixelRay(col, row), grid_, volume_);
+    }
+
+    /// Packets of 8 rays sampling the volume with trilinear interpolation every half voxel
+    void projectRayMarching()
+    {
+        using FloatP = pack8<float>;
+
+        const float step = 0.5f / volume_size;
+        const auto bounds = aabb<FloatP>(point3<FloatP>(-0.5f), vec3<FloatP>(1.f));
+
+        for (size_t row = 0; row < view_.rows(); ++row) {
+            for (size_t col = 0; col < view_.cols(); col += FloatP::Size) {
+                FloatP dx, dy, dz;
+                for (size_t i = 0; i < FloatP::Size; ++i) {
+                    auto d = view_.pixelRay(col + i, row).dir();
+                    dx[i] = d.x();
+                    dy[i] = d.y();
+                    dz[i] = d.z();
+                }
+
+                auto o = point3<FloatP>(FloatP(view_.source.x()), FloatP(view_.source.y()), FloatP(view_.source.z()));
+                auto r = ray<FloatP>(o, vec3<FloatP>(dx, dy, dz), ray<FloatP>::ray_direction_normalized{});
+                auto [tmin, tmax, hit] = intersection(r, bounds, ray_aabb_interval{});
+
+                FloatP sum(0);
+                FloatP t = tmin;
+                auto active = hit && t < tmax;
+
+                while (enoki::any(active)) {
+                    auto p = point3<FloatP>(o.x() + t * dx, o.y() + t * dy, o.z() + t * dz);
+                    sum += enoki::select(active, tomosect::sample(grid_, volume_, p), FloatP(0));
+
+                    t += step;
+                    active = active && t < tmax;
+                }
+
+                enoki::store_unaligned(projection_.data() + row * view_.cols() + col, sum * step);
+            }
+        }
+    }
+
+    tomosect::voxel_grid<float> grid_;
+    tomosect::volume<float, Layout> volume_;
+    tomosect::projection_view<float> view_;
+    std::vector<float> projection_;
+
+    std::shared_ptr<RayCountUDM> rayCountUDM{ new RayCountUDM };
+};
+
+using LinearFixture = VolumeLayoutFixture<tomosect::volume_layout::linear>;
+using BrickedFixture = VolumeLayoutFixture<tomosect::volume_layout::bricked>;
+using MortonFixture = VolumeLayoutFixture<tomosect::volume_layout::morton>;
+
+BASELINE_F(SiddonProjection, Linear, LinearFixture, SAMPLES, ITERATIONS)
+{
+    projectSiddon();
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(SiddonProjection, Bricked, BrickedFixture, SAMPLES, ITERATIONS)
+{
+    projectSiddon();
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(SiddonProjection, Morton, MortonFixture, SAMPLES, ITERATIONS)
+{
+    projectSiddon();
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BASELINE_F(RayMarchingProjection, Linear, LinearFixture, SAMPLES, ITERATIONS)
+{
+    projectRayMarching();
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(RayMarchingProjection, Bricked, BrickedFixture, SAMPLES, ITERATIONS)
+{
+    projectRayMarching();
+    celero::DoNotOptimizeAway(projection_);
+}
+
+BENCHMARK_F(RayMarchingProjection, Morton, MortonFixture, SAMPLES, ITERATIONS)
+{
+    projectRayMarching();
+    celero::DoNotOptimizeAway(projection_);
+}
@@ -0,0 +1,602 @@
+/**
+ *
+ * \file bvh.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    struct bvh_options {
+        size_t maxLeafSize = 4;      // Leaves never hold more boxes, unless the boxes can not be separated
+        size_t bins = 16;            // Bins per axis of the SAH sweep, at most 64
+        float traversalCost = 1;     // Cost of a node visit, relative to a box test
+        size_t threads = 0;          // Threads of the builder, 0 for all hardware threads
+        size_t parallelGrain = 4096; // Ranges smaller than this are built by a single thread
+    };
+
+    namespace details
+    {
+        template <typename Value, typename = void>
+        struct bvh_index {
+            using type = uint32_t;
+        };
+
+        template <typename Value>
+        struct bvh_index<Value, std::enable_if_t<enoki::is_array_v<Value>>> {
+            using type = enoki::Packet<uint32_t, Value::Size>;
+        };
+    } // namespace details
+
+    /// Index type matching the lanes of Value: uint32_t for scalars, a packet of them for packets
+    template <typename Value>
+    using bvh_index_t = typename details::bvh_index<Value>::type;
+
+    /// Nearest hit of every lane: distance to the entry point (0 if the ray starts inside) and index of the box
+    template <typename Value>
+    struct bvh_hit {
+        Value t;
+        bvh_index_t<Value> index;
+        typename point3<Value>::Mask mask;
+    };
+
+    /// Part of a ray inside a box
+    template <typename Scalar>
+    struct bvh_interval {
+        uint32_t index;
+        Scalar tEnter;
+        Scalar tExit;
+    };
+
+    namespace details
+    {
+        /// Plain bounds for the builder, not initialized by default, so arrays of bins are cheap to set up
+        template <typename Scalar>
+        struct bvh_bounds {
+            Scalar lo[3];
+            Scalar hi[3];
+
+            static bvh_bounds none()
+            {
+                constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+                return { { inf, inf, inf }, { -inf, -inf, -inf } };
+            }
+
+            void grow(const bvh_bounds& other)
+            {
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = std::min(lo[a], other.lo[a]);
+                    hi[a] = std::max(hi[a], other.hi[a]);
+                }
+            }
+
+            void grow(const Scalar p[3])
+            {
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+
+            bool empty() const { return lo[0] > hi[0]; }
+
+            Scalar area() const
+            {
+                if (empty())
+                    return 0;
+                const Scalar dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+                return 2 * (dx * dy + dy * dz + dz * dx);
+            }
+        };
+    } // namespace details
+
+    /**
+     * Bounding volume hierarchy over axis aligned boxes, built with the surface area heuristic over binned centroids.
+     *
+     * Nodes are stored flat in depth first order: the left child of an inner node directly follows it, so only the
+     * index of the right child is stored. A node is 32 bytes for float, two nodes per cache line. The boxes are kept in
+     * leaf order next to the nodes, so leaves read their boxes contiguously.
+     *
+     * Traversal works on TomoSect rays of scalars or packets, a packet descends into a node if any of its lanes hits it.
+     * Rays start at their origin, distances are along the normalized direction.
+     */
+    template <typename Scalar>
+    class bvh
+    {
+    public:
+        static constexpr size_t max_bins = 64;
+
+        struct node {
+            Scalar lo[3];
+            uint32_t offset; // First box of a leaf, right child of an inner node
+            Scalar hi[3];
+            uint16_t count; // Number of boxes of a leaf, 0 for inner nodes
+            uint8_t axis;   // Split axis of an inner node
+            uint8_t pad;
+
+            bool leaf() const { return count > 0; }
+        };
+
+        /// Build the hierarchy, the builder runs in parallel for large inputs
+        explicit bvh(const std::vector<aabb<Scalar>>& boxes, const bvh_options& options = {})
+            : bvh(
+                  boxes.size(),
+                  [&boxes](size_t i, Scalar lo[3], Scalar hi[3]) {
+                      // aabb::min() and max() go through the transformation matrices, extract them once
+                      const auto min = boxes[i].min();
+                      const auto max = boxes[i].max();
+                      for (int a = 0; a < 3; ++a) {
+                          lo[a] = min.data()[a];
+                          hi[a] = max.data()[a];
+                      }
+                  },
+                  options)
+        {
+        }
+
+        /// Build the hierarchy over count primitives, bounds(i, lo, hi) stores the bounds of primitive i
+        template <typename Bounds>
+        bvh(size_t count, Bounds&& bounds, const bvh_options& options = {}) : options_(options)
+        {
+            if (count > std::numeric_limits<uint32_t>::max())
+                throw std::length_error("bvh: too many boxes");
+            if (options.maxLeafSize == 0 || options.maxLeafSize > std::numeric_limits<uint16_t>::max())
+                throw std::invalid_argument("bvh: leaf size must be in [1, 65535]");
+            if (options.bins < 2 || options.bins > max_bins)
+                throw std::invalid_argument("bvh: number of bins must be in [2, 64]");
+
+            build(count, bounds);
+        }
+
+        /// Number of boxes
+        size_t size() const { return indices_.size(); }
+        bool empty() const { return indices_.empty(); }
+
+        const std::vector<node>& nodes() const { return nodes_; }
+
+        /// Index of the box in the input for slot i of the leaf order
+        uint32_t index(size_t i) const { return indices_[i]; }
+
+        /// Number of node levels, 0 for an empty hierarchy
+        size_t depth() const { return depth_; }
+
+        /// Nearest box hit by every lane of the ray
+        template <typename Value>
+        bvh_hit<Value> nearest(const ray<Value>& r) const
+        {
+            using Mask = typename point3<Value>::Mask;
+            using Index = bvh_index_t<Value>;
+
+            const auto p = prepare(r);
+
+            Value best = std::numeric_limits<Scalar>::infinity();
+            Index index = Index(0);
+            Mask found = Mask(false);
+
+            traverse(p, [&]() { return best; }, [&](uint32_t slot) {
+                auto [tEnter, tExit] = slab(boxes_[slot].lo, boxes_[slot].hi, p, best);
+                Mask closer = tEnter <= tExit && tEnter < best;
+                if (enoki::none(closer))
+                    return;
+
+                best = enoki::select(closer, tEnter, best);
+                index = enoki::select(closer, Index(indices_[slot]), index);
+                found = found || closer;
+            });
+
+            return { best, index, found };
+        }
+
+        /**
+         * Call f(index, tEnter, tExit, mask) for every box hit by any lane of the ray, with the part of the ray inside the
+         * box. Boxes are visited in no particular order, lanes not hitting a box are masked out.
+         */
+        template <typename Value, typename Function>
+        void forEachHit(const ray<Value>& r, Function&& f) const
+        {
+            const auto p = prepare(r);
+            const Value far = std::numeric_limits<Scalar>::infinity();
+
+            traverse(p, [&]() { return far; }, [&](uint32_t slot) {
+                auto [tEnter, tExit] = slab(boxes_[slot].lo, boxes_[slot].hi, p, far);
+                auto mask = tEnter <= tExit;
+                if (enoki::any(mask))
+                    f(indices_[slot], tEnter, tExit, mask);
+            });
+        }
+
+        /**
+         * Call f(slot, mask) for every box hit by any lane of the ray, to test the primitive inside. Slots are in leaf
+         * order, index(slot) gives the input index, so callers can keep their primitives in leaf order too.
+         */
+        template <typename Value, typename Function>
+        void forEachCandidate(const ray<Value>& r, Function&& f) const
+        {
+            const auto p = prepare(r);
+            const Value far = std::numeric_limits<Scalar>::infinity();
+
+            traverse(p, [&]() { return far; }, [&](uint32_t slot) {
+                auto [tEnter, tExit] = slab(boxes_[slot].lo, boxes_[slot].hi, p, far);
+                auto mask = tEnter <= tExit;
+                if (enoki::any(mask))
+                    f(slot, mask);
+            });
+        }
+
+        /// All intervals of a single ray, sorted by their entry distance
+        std::vector<bvh_interval<Scalar>> intervals(const ray<Scalar>& r) const
+        {
+            std::vector<bvh_interval<Scalar>> result;
+            forEachHit(r, [&](uint32_t index, Scalar tEnter, Scalar tExit, bool) { result.push_back({ index, tEnter, tExit }); });
+
+            std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.tEnter < b.tEnter; });
+            return result;
+        }
+
+    private:
+        using bounds = details::bvh_bounds<Scalar>;
+
+        /// Subtree of the upper levels, which are split before the parallel part of the build
+        struct top_node {
+            uint32_t begin, end;
+            size_t depth;
+            uint8_t axis = 0;
+            long left = -1, right = -1; // Children, -1 for ranges built as a task
+            size_t task = 0;
+        };
+
+        struct split {
+            uint32_t mid;
+            uint8_t axis;
+        };
+
+        /// Box during the build, partitioned in place so the builder reads memory sequentially
+        struct prim_ref {
+            bounds box;
+            Scalar centroid[3];
+            uint32_t index;
+        };
+
+        static constexpr size_t stack_size = 128;
+        static constexpr size_t median_depth = 64; // Below this depth only median splits, which bounds the depth
+
+        /// Ray in the form the slab tests need it
+        template <typename Value>
+        struct prepared_ray {
+            Value origin[3];
+            Value inv[3];
+            bool negative[3]; // Direction of the majority of the lanes along each axis
+        };
+
+        template <typename Value>
+        static prepared_ray<Value> prepare(const ray<Value>& r)
+        {
+            const auto o = r.origin();
+            const auto d = r.dir();
+            return { { o.x(), o.y(), o.z() },
+                     { Value(1) / d.x(), Value(1) / d.y(), Value(1) / d.z() },
+                     { enoki::hsum(d.x()) < 0, enoki::hsum(d.y()) < 0, enoki::hsum(d.z()) < 0 } };
+        }
+
+        /// Entry and exit distance of the ray with the box, limited to [0, far]. The ray misses if entry > exit.
+        template <typename Value>
+        static std::pair<Value, Value> slab(const Scalar lo[3], const Scalar hi[3], const prepared_ray<Value>& r, const Value& far)
+        {
+            Value tEnter = Value(0);
+            Value tExit = far;
+            for (int a = 0; a < 3; ++a) {
+                Value t0 = (lo[a] - r.origin[a]) * r.inv[a];
+                Value t1 = (hi[a] - r.origin[a]) * r.inv[a];
+                tEnter = enoki::max(tEnter, enoki::min(t0, t1));
+                tExit = enoki::min(tExit, enoki::max(t0, t1));
+            }
+            return { tEnter, tExit };
+        }
+
+        /**
+         * Visit all leaves whose node is hit by any lane before far(), calling leaf(slot) for their boxes. Near children
+         * are visited first, judged by the direction of the packet along the split axis.
+         */
+        template <typename Value, typename Far, typename Leaf>
+        void traverse(const prepared_ray<Value>& r, Far&& far, Leaf&& leaf) const
+        {
+            if (nodes_.empty())
+                return;
+
+            uint32_t stack[stack_size];
+            size_t top = 0;
+            stack[top++] = 0;
+
+            while (top > 0) {
+                const node& n = nodes_[stack[--top]];
+
+                auto [tEnter, tExit] = slab(n.lo, n.hi, r, far());
+                if (enoki::none(tEnter <= tExit))
+                    continue;
+
+                if (n.leaf()) {
+                    for (uint32_t slot = n.offset; slot < n.offset + n.count; ++slot)
+                        leaf(slot);
+                    continue;
+                }
+
+                const uint32_t left = static_cast<uint32_t>(&n - nodes_.data()) + 1;
+                if (r.negative[n.axis]) {
+                    stack[top++] = left;
+                    stack[top++] = n.offset;
+                } else {
+                    stack[top++] = n.offset;
+                    stack[top++] = left;
+                }
+            }
+        }
+
+        template <typename Bounds>
+        void build(size_t count, Bounds& boxBounds)
+        {
+            if (count == 0)
+                return;
+
+            refs_.resize(count);
+            parallel_for(
+                0, count,
+                [&](size_t i) {
+                    auto& ref = refs_[i];
+                    boxBounds(i, ref.box.lo, ref.box.hi);
+                    for (int a = 0; a < 3; ++a)
+                        ref.centroid[a] = (ref.box.lo[a] + ref.box.hi[a]) / 2;
+                    ref.index = static_cast<uint32_t>(i);
+                },
+                1024, options_.threads);
+
+            // Split the upper levels sequentially, until there are enough ranges to keep all threads busy
+            const size_t threads = options_.threads == 0 ? hardware_threads() : options_.threads;
+            std::vector<top_node> top;
+            std::vector<size_t> taskNodes;
+            size_t topDepth = 0;
+            buildTop(top, taskNodes, 0, static_cast<uint32_t>(count), 0, 4 * threads, topDepth);
+
+            std::vector<std::vector<node>> subtrees(taskNodes.size());
+            std::vector<size_t> subtreeDepths(taskNodes.size());
+            parallel_for(
+                0, taskNodes.size(),
+                [&](size_t i) {
+                    const auto& t = top[taskNodes[i]];
+                    subtreeDepths[i] = buildRecursive(subtrees[i], t.begin, t.end, t.depth);
+                },
+                1, options_.threads);
+
+            depth_ = topDepth;
+            for (size_t i = 0; i < taskNodes.size(); ++i)
+                depth_ = std::max(depth_, subtreeDepths[i]);
+
+            nodes_.reserve(2 * count);
+            emit(top, subtrees, 0);
+
+            // Boxes in leaf order
+            boxes_.resize(count);
+            indices_.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                boxes_[i] = refs_[i].box;
+                indices_[i] = refs_[i].index;
+            }
+            refs_ = {};
+        }
+
+        void buildTop(std::vector<top_node>& top, std::vector<size_t>& tasks, uint32_t begin, uint32_t end, size_t depth, size_t wanted,
+                      size_t& maxDepth)
+        {
+            const size_t self = top.size();
+            top.push_back({ begin, end, depth });
+            maxDepth = std::max(maxDepth, depth + 1);
+
+            std::optional<split> s;
+            if (end - begin >= options_.parallelGrain && (size_t{ 1 } << depth) < wanted)
+                s = findSplit(begin, end, depth, rangeBounds(begin, end));
+
+            if (!s) {
+                top[self].task = tasks.size();
+                tasks.push_back(self);
+                return;
+            }
+
+            top[self].axis = s->axis;
+            top[self].left = static_cast<long>(top.size());
+            buildTop(top, tasks, begin, s->mid, depth + 1, wanted, maxDepth);
+            top[self].right = static_cast<long>(top.size());
+            buildTop(top, tasks, s->mid, end, depth + 1, wanted, maxDepth);
+        }
+
+        /// Append the nodes of the top levels and the subtrees in depth first order, returns the index of the node
+        uint32_t emit(const std::vector<top_node>& top, const std::vector<std::vector<node>>& subtrees, size_t i)
+        {
+            const auto& t = top[i];
+            const uint32_t self = static_cast<uint32_t>(nodes_.size());
+
+            if (t.left < 0) {
+                for (node n : subtrees[t.task]) {
+                    if (!n.leaf())
+                        n.offset += self;
+                    nodes_.push_back(n);
+                }
+                return self;
+            }
+
+            nodes_.push_back(makeNode(rangeBounds(t.begin, t.end), 0, 0, t.axis));
+            emit(top, subtrees, static_cast<size_t>(t.left));
+            nodes_[self].offset = emit(top, subtrees, static_cast<size_t>(t.right));
+            return self;
+        }
+
+        /// Build the subtree of a range into nodes, with child indices relative to its root. Returns the depth reached.
+        size_t buildRecursive(std::vector<node>& nodes, uint32_t begin, uint32_t end, size_t depth)
+        {
+            const uint32_t self = static_cast<uint32_t>(nodes.size());
+            const auto nodeBounds = rangeBounds(begin, end);
+            nodes.push_back(makeNode(nodeBounds, begin, static_cast<uint16_t>(end - begin), 0));
+
+            auto s = findSplit(begin, end, depth, nodeBounds);
+            if (!s)
+                return depth + 1;
+
+            nodes[self].count = 0;
+            nodes[self].axis = s->axis;
+
+            const size_t left = buildRecursive(nodes, begin, s->mid, depth + 1);
+            nodes[self].offset = static_cast<uint32_t>(nodes.size());
+            const size_t right = buildRecursive(nodes, s->mid, end, depth + 1);
+            return std::max(left, right);
+        }
+
+        static node makeNode(const bounds& b, uint32_t offset, uint16_t count, uint8_t axis)
+        {
+            return { { b.lo[0], b.lo[1], b.lo[2] }, offset, { b.hi[0], b.hi[1], b.hi[2] }, count, axis, 0 };
+        }
+
+        bounds rangeBounds(uint32_t begin, uint32_t end) const
+        {
+            auto b = bounds::none();
+            for (uint32_t i = begin; i < end; ++i)
+                b.grow(refs_[i].box);
+            return b;
+        }
+
+        /**
+         * Best SAH split of the range, or nothing if a leaf is cheaper. Partitions the references accordingly. Ranges larger
+         * than the leaf size are always split, by the centroid median if SAH finds no split.
+         */
+        std::optional<split> findSplit(uint32_t begin, uint32_t end, size_t depth, const bounds& nodeBounds)
+        {
+            const uint32_t count = end - begin;
+            if (count <= 1)
+                return std::nullopt;
+
+            auto centroidBounds = bounds::none();
+            for (uint32_t i = begin; i < end; ++i)
+                centroidBounds.grow(refs_[i].centroid);
+
+            const bool mustSplit = count > options_.maxLeafSize;
+            if (depth >= median_depth)
+                return mustSplit ? std::optional<split>(medianSplit(begin, end, centroidBounds)) : std::nullopt;
+
+            // Bin all three axes in one pass over the boxes
+            // Small ranges get fewer bins, the sweeps over the bins would dominate otherwise
+            const size_t numBins = std::min<size_t>(options_.bins, count);
+            bounds binBounds[3 * max_bins], leftBounds[max_bins];
+            uint32_t binCounts[3 * max_bins];
+            std::fill_n(binBounds, 3 * numBins, bounds::none());
+            std::fill_n(binCounts, 3 * numBins, 0u);
+
+            Scalar extent[3];
+            for (int a = 0; a < 3; ++a)
+                extent[a] = centroidBounds.hi[a] - centroidBounds.lo[a];
+
+            for (uint32_t i = begin; i < end; ++i) {
+                const auto& ref = refs_[i];
+                for (int a = 0; a < 3; ++a) {
+                    if (!(extent[a] > 0))
+                        continue;
+                    const size_t b = a * numBins + binOf(ref.centroid[a], centroidBounds.lo[a], extent[a], numBins);
+                    binBounds[b].grow(ref.box);
+                    ++binCounts[b];
+                }
+            }
+
+            Scalar bestCost = std::numeric_limits<Scalar>::infinity();
+            int bestAxis = -1;
+            size_t bestBin = 0;
+
+            for (int a = 0; a < 3; ++a) {
+                if (!(extent[a] > 0))
+                    continue;
+
+                const bounds* axisBounds = binBounds + a * numBins;
+                const uint32_t* axisCounts = binCounts + a * numBins;
+
+                // Sweep from the left, then from the right evaluating the split after every bin
+                auto acc = bounds::none();
+                for (size_t b = 0; b < numBins; ++b) {
+                    acc.grow(axisBounds[b]);
+                    leftBounds[b] = acc;
+                }
+
+                acc = bounds::none();
+                uint32_t rightCount = 0;
+                for (size_t b = numBins - 1; b > 0; --b) {
+                    acc.grow(axisBounds[b]);
+                    rightCount += axisCounts[b];
+
+                    const uint32_t leftCount = count - rightCount;
+                    if (leftCount == 0 || rightCount == 0)
+                        continue;
+
+                    const Scalar cost =
+                        leftBounds[b - 1].area() * static_cast<Scalar>(leftCount) + acc.area() * static_cast<Scalar>(rightCount);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = a;
+                        bestBin = b;
+                    }
+                }
+            }
+
+            if (bestAxis < 0)
+                return mustSplit ? std::optional<split>(medianSplit(begin, end, centroidBounds)) : std::nullopt;
+
+            const Scalar area = nodeBounds.area();
+            const Scalar splitCost = static_cast<Scalar>(options_.traversalCost) + (area > 0 ? bestCost / area : Scalar{ 0 });
+            if (!mustSplit && splitCost >= static_cast<Scalar>(count))
+                return std::nullopt;
+
+            auto mid = std::partition(refs_.begin() + begin, refs_.begin() + end, [&](const prim_ref& ref) {
+                return binOf(ref.centroid[bestAxis], centroidBounds.lo[bestAxis], extent[bestAxis], numBins) < bestBin;
+            });
+
+            return split{ static_cast<uint32_t>(mid - refs_.begin()), static_cast<uint8_t>(bestAxis) };
+        }
+
+        static size_t binOf(Scalar c, Scalar lo, Scalar extent, size_t numBins)
+        {
+            const auto b = static_cast<size_t>(static_cast<Scalar>(numBins) * (c - lo) / extent);
+            return std::min(b, numBins - 1);
+        }
+
+        /// Split at the median centroid along the largest extent, used where SAH gives nothing
+        split medianSplit(uint32_t begin, uint32_t end, const bounds& centroidBounds)
+        {
+            int axis = 0;
+            for (int a = 1; a < 3; ++a)
+                if (centroidBounds.hi[a] - centroidBounds.lo[a] > centroidBounds.hi[axis] - centroidBounds.lo[axis])
+                    axis = a;
+
+            const uint32_t mid = begin + (end - begin) / 2;
+            std::nth_element(refs_.begin() + begin, refs_.begin() + mid, refs_.begin() + end,
+                             [&](const prim_ref& a, const prim_ref& b) { return a.centroid[axis] < b.centroid[axis]; });
+            return { mid, static_cast<uint8_t>(axis) };
+        }
+
+        bvh_options options_;
+        std::vector<node> nodes_;
+        std::vector<bounds> boxes_;  // In leaf order after the build
+        std::vector<uint32_t> indices_; // Input index of every leaf slot
+        std::vector<prim_ref> refs_;    // Only during the build
+        size_t depth_ = 0;
+    };
+} // namespace tomosect
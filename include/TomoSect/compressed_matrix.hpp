@@ -0,0 +1,408 @@
+/**
+ *
+ * \file compressed_matrix.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "enoki/array.h"
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/system_matrix.hpp"
+#include "TomoSect/vector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace tomosect
+{
+    /// How the weights of a compressed_matrix are stored
+    enum class weight_quantization {
+        unorm8, // 8 bit unsigned normalized, scaled by the row maximum
+        fp16    // IEEE half, scaled by the row maximum
+    };
+} // namespace tomosect
+
+namespace tomosect::details
+{
+    template <weight_quantization Q>
+    struct quantized_weight;
+
+    template <>
+    struct quantized_weight<weight_quantization::unorm8> {
+        using Storage = uint8_t;
+        static constexpr uint32_t bits = 8;
+        static constexpr float range = 255.f;
+    };
+
+    template <>
+    struct quantized_weight<weight_quantization::fp16> {
+        using Storage = uint16_t;
+        static constexpr uint32_t bits = 16;
+        static constexpr float range = 1.f;
+    };
+
+    /// Round to nearest even float to half conversion, weights are finite so inf / NaN are not treated specially
+    inline uint16_t float_to_half(float value)
+    {
+        uint32_t f;
+        std::memcpy(&f, &value, sizeof(f));
+
+        uint32_t sign = (f >> 16) & 0x8000u;
+        f &= 0x7fffffffu;
+
+        // Too large for half, saturate to the largest finite value
+        if (f >= 0x477ff000u)
+            return static_cast<uint16_t>(sign | 0x7bffu);
+
+        // Too small for a normal half, go through the FPU to get a correctly rounded denormal
+        if (f < 0x38800000u) {
+            float abs;
+            std::memcpy(&abs, &f, sizeof(abs));
+            return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(abs * 0x1p24f)));
+        }
+
+        uint32_t mantissaOdd = (f >> 13) & 1u;
+        f += 0xc8000fffu + mantissaOdd; // rebias exponent (-112 << 23) and round
+        return static_cast<uint16_t>(sign | (f >> 13));
+    }
+
+    inline float half_to_float(uint16_t h)
+    {
+        uint32_t sign = uint32_t{ h & 0x8000u } << 16;
+        uint32_t magnitude = uint32_t{ h & 0x7fffu } << 13;
+
+        float f;
+        std::memcpy(&f, &magnitude, sizeof(f));
+        f *= 0x1p112f;
+
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        bits |= sign;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    /// Vectorised half to float conversion, works on the lower 16 bits of each lane
+    template <typename UInt32P>
+    auto half_to_float(const UInt32P& h)
+    {
+        using FloatP = enoki::Array<float, UInt32P::Size>;
+
+        UInt32P sign = (h & 0x8000u) << 16;
+        UInt32P magnitude = (h & 0x7fffu) << 13;
+
+        // Shifting the bits in place gives the value scaled by 2^-112, the multiplication fixes it, denormals included
+        FloatP f = enoki::reinterpret_array<FloatP>(magnitude) * 0x1p112f;
+        return enoki::reinterpret_array<FloatP>(enoki::reinterpret_array<UInt32P>(f) | sign);
+    }
+
+    inline uint32_t bit_width(uint32_t value)
+    {
+        uint32_t bits = 0;
+        while (value != 0) {
+            ++bits;
+            value >>= 1;
+        }
+        return bits;
+    }
+
+    /// Write the lowest `bits` bits of value at bit position pos (little endian bit order)
+    inline void put_bits(uint32_t* words, uint64_t pos, uint32_t bits, uint32_t value)
+    {
+        if (bits == 0)
+            return;
+
+        uint64_t word = pos >> 5;
+        uint32_t shift = pos & 31u;
+
+        words[word] |= value << shift;
+        if (shift + bits > 32)
+            words[word + 1] |= value >> (32 - shift);
+    }
+
+    inline uint32_t get_bits(const uint32_t* words, uint64_t pos, uint32_t bits)
+    {
+        if (bits == 0)
+            return 0;
+
+        uint64_t word = pos >> 5;
+        uint32_t shift = pos & 31u;
+
+        uint64_t both = words[word] | (uint64_t{ words[word + 1] } << 32);
+        return static_cast<uint32_t>((both >> shift) & ((uint64_t{ 1 } << bits) - 1));
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * System matrix with compressed rows, meant to stay resident in RAM:
+     *  - column indices are stored as offsets to the smallest column of their row, bit packed with a per row bit width.
+     *    Using the row base instead of the previous entry keeps every entry independently decodable, so a whole packet
+     *    is decoded at once without a prefix scan;
+     *  - weights are quantised (8 bit unorm or fp16) relative to a per row scale.
+     *
+     * Decoding happens on the fly inside spmv() / spmv_transposed().
+     */
+    template <weight_quantization Q>
+    class compressed_matrix
+    {
+    public:
+        using Weight = typename details::quantized_weight<Q>::Storage;
+
+        compressed_matrix() = default;
+
+        explicit compressed_matrix(const csr_matrix& A)
+            : rows_(A.rows()), cols_(A.cols()), nnz_(A.nnz()), rowPtr_(A.rowPtr(), A.rowPtr() + A.rows() + 1), bitOffset_(A.rows() + 1, 0),
+              base_(A.rows(), 0), bits_(A.rows(), 0), scale_(A.rows(), 0.f),
+              weights_((A.nnz() + perWord - 1) / perWord + padding, 0)
+        {
+            const auto* colIdx = A.colIdx();
+            const auto* values = A.values();
+
+            // Per row base column, bit width and weight scale
+            parallel_for(
+                0, rows_,
+                [&](size_t i) {
+                    auto first = rowPtr_[i];
+                    auto last = rowPtr_[i + 1];
+                    if (first == last)
+                        return;
+
+                    auto [minIt, maxIt] = std::minmax_element(colIdx + first, colIdx + last);
+                    base_[i] = *minIt;
+                    bits_[i] = static_cast<uint8_t>(details::bit_width(*maxIt - *minIt));
+
+                    float maxWeight =
+                        *std::max_element(values + first, values + last, [](float a, float b) { return std::abs(a) < std::abs(b); });
+                    scale_[i] = std::abs(maxWeight) / details::quantized_weight<Q>::range;
+                },
+                256);
+
+            // Every row starts on a fresh word, so rows can be written independently and decoded without an offset
+            for (size_t i = 0; i < rows_; ++i) {
+                uint64_t rowBits = (rowPtr_[i + 1] - rowPtr_[i]) * bits_[i];
+                bitOffset_[i + 1] = bitOffset_[i] + ((rowBits + 31) & ~uint64_t{ 31 });
+            }
+
+            indices_.assign((bitOffset_.back() >> 5) + padding, 0);
+            std::vector<Weight> quantized(nnz_);
+
+            parallel_for(
+                0, rows_,
+                [&](size_t i) {
+                    float inv = scale_[i] > 0 ? 1 / scale_[i] : 0.f;
+
+                    for (auto k = rowPtr_[i]; k < rowPtr_[i + 1]; ++k) {
+                        auto pos = bitOffset_[i] + (k - rowPtr_[i]) * bits_[i];
+                        details::put_bits(indices_.data(), pos, bits_[i], colIdx[k] - base_[i]);
+                        quantized[k] = quantize(values[k] * inv);
+                    }
+                },
+                256);
+
+            // Rows do not start on a fresh weight word, so the words are packed in a second pass
+            parallel_for(
+                0, (nnz_ + perWord - 1) / perWord,
+                [&](size_t w) {
+                    uint32_t word = 0;
+                    for (size_t j = 0; j < perWord && w * perWord + j < nnz_; ++j)
+                        word |= uint32_t{ quantized[w * perWord + j] } << (j * wbits);
+                    weights_[w] = word;
+                },
+                4096);
+        }
+
+        size_t rows() const { return rows_; }
+        size_t cols() const { return cols_; }
+        size_t nnz() const { return nnz_; }
+
+        /// First entry of row i
+        uint64_t rowBegin(size_t i) const { return rowPtr_[i]; }
+
+        /// Bytes used by all arrays, to compare against the uncompressed matrix
+        size_t memoryUsage() const
+        {
+            return rowPtr_.size() * sizeof(uint64_t) + bitOffset_.size() * sizeof(uint64_t) + base_.size() * sizeof(uint32_t) + bits_.size()
+                   + scale_.size() * sizeof(float) + indices_.size() * sizeof(uint32_t) + weights_.size() * sizeof(uint32_t);
+        }
+
+        /// Scalar decode of row i, mostly useful for testing
+        void decodeRow(size_t i, std::vector<uint32_t>& cols, std::vector<float>& weights) const
+        {
+            cols.clear();
+            weights.clear();
+
+            for (auto k = rowPtr_[i]; k < rowPtr_[i + 1]; ++k) {
+                auto pos = bitOffset_[i] + (k - rowPtr_[i]) * bits_[i];
+                cols.push_back(base_[i] + details::get_bits(indices_.data(), pos, bits_[i]));
+                weights.push_back(dequantize(weight(k)) * scale_[i]);
+            }
+        }
+
+        /**
+         * Decode entries [k, k + Packet::Size) of row i into column indices and weights, lanes past the end of the row
+         * are masked out.
+         */
+        template <typename FloatP>
+        void decode(size_t i, uint64_t k, enoki::Array<uint32_t, FloatP::Size>& cols, FloatP& weights, enoki::mask_t<FloatP>& mask) const
+        {
+            using UInt32P = enoki::Array<uint32_t, FloatP::Size>;
+
+            auto lane = enoki::arange<UInt32P>();
+            UInt32P local = UInt32P(static_cast<uint32_t>(k - rowPtr_[i])) + lane;
+            enoki::mask_t<UInt32P> active = local < static_cast<uint32_t>(rowPtr_[i + 1] - rowPtr_[i]);
+            mask = enoki::reinterpret_array<enoki::mask_t<FloatP>>(active);
+
+            // Column offsets: every lane fetches the two words its bits may span, rows start word aligned
+            uint32_t bits = bits_[i];
+            if (bits == 0) {
+                cols = UInt32P(base_[i]);
+            } else {
+                const uint32_t* words = indices_.data() + (bitOffset_[i] >> 5);
+                UInt32P pos = local * bits;
+
+                UInt32P word = pos >> 5;
+                UInt32P shift = pos & 31u;
+                UInt32P lo = enoki::gather<UInt32P>(words, word, active);
+                UInt32P hi = enoki::gather<UInt32P>(words, word + 1u, active);
+
+                // hi << (32 - shift) in two steps, every shift stays below 32 and shift == 0 takes nothing from hi
+                UInt32P value = (lo >> shift) | ((hi << 1u) << (31u - shift));
+                UInt32P keep = bits == 32 ? UInt32P(0xffffffffu) : UInt32P((1u << bits) - 1u);
+                cols = (value & keep) + base_[i];
+            }
+
+            // Weights: gather the 32 bit word containing the weight and shift it out
+            constexpr uint32_t perWordShift = perWord == 4 ? 2 : 1;
+
+            UInt32P index = UInt32P(static_cast<uint32_t>(k & (perWord - 1))) + lane;
+            const uint32_t* words = weights_.data() + (k >> perWordShift);
+            UInt32P raw = enoki::gather<UInt32P>(words, index >> perWordShift, active);
+            raw = (raw >> ((index & (perWord - 1)) * wbits)) & ((1u << wbits) - 1u);
+
+            if constexpr (Q == weight_quantization::unorm8)
+                weights = FloatP(raw) * scale_[i];
+            else
+                weights = details::half_to_float(raw) * scale_[i];
+
+            weights = enoki::select(mask, weights, FloatP(0.f));
+        }
+
+    private:
+        // Vector decode may read up to two words past the last entry
+        static constexpr size_t padding = 8;
+
+        // Weights are packed into 32 bit words, entry k in bits [(k % perWord) * wbits, (k % perWord + 1) * wbits) of word k / perWord
+        static constexpr uint32_t wbits = details::quantized_weight<Q>::bits;
+        static constexpr uint32_t perWord = 32 / wbits;
+
+        Weight weight(uint64_t k) const
+        {
+            return static_cast<Weight>(weights_[k / perWord] >> (k % perWord * wbits));
+        }
+
+        /// Weight divided by the row scale, in [0, 255] for unorm8 and [0, 1] for fp16
+        static Weight quantize(float scaled)
+        {
+            if constexpr (Q == weight_quantization::unorm8)
+                return static_cast<Weight>(std::clamp(std::lround(scaled), 0L, 255L));
+            else
+                return details::float_to_half(scaled);
+        }
+
+        static float dequantize(Weight w)
+        {
+            if constexpr (Q == weight_quantization::unorm8)
+                return static_cast<float>(w);
+            else
+                return details::half_to_float(w);
+        }
+
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        size_t nnz_ = 0;
+
+        std::vector<uint64_t> rowPtr_;    // First entry of each row, plus nnz
+        std::vector<uint64_t> bitOffset_; // First bit of each row in indices_, word aligned
+        std::vector<uint32_t> base_;      // Smallest column of each row
+        std::vector<uint8_t> bits_;       // Bits per column offset of each row
+        std::vector<float> scale_;        // Weight scale of each row
+        std::vector<uint32_t> indices_;   // Bit packed column offsets
+        std::vector<uint32_t> weights_;   // Quantised weights, packed
+    };
+
+    /// Forward projection y = A * x with decoding fused into the product, parallel over rows
+    template <typename FloatP = pack8<float>, weight_quantization Q>
+    void spmv(const compressed_matrix<Q>& A, const float* x, float* y)
+    {
+        using UInt32P = enoki::Array<uint32_t, FloatP::Size>;
+
+        parallel_for(
+            0, A.rows(),
+            [&](size_t i) {
+                FloatP sum(0.f);
+                UInt32P cols;
+                FloatP weights;
+                enoki::mask_t<FloatP> mask;
+
+                for (uint64_t k = A.rowBegin(i); k < A.rowBegin(i + 1); k += FloatP::Size) {
+                    A.template decode<FloatP>(i, k, cols, weights, mask);
+                    sum = enoki::fmadd(weights, enoki::gather<FloatP>(x, cols, mask), sum);
+                }
+                y[i] = enoki::hsum(sum);
+            },
+            256);
+    }
+
+    /// Backprojection x = A^T * y with fused decoding, private buffer per thread as for the csr_matrix version
+    template <typename FloatP = pack8<float>, weight_quantization Q>
+    void spmv_transposed(const compressed_matrix<Q>& A, const float* y, float* x, size_t numThreads = 0)
+    {
+        using UInt32P = enoki::Array<uint32_t, FloatP::Size>;
+
+        numThreads = numThreads == 0 ? hardware_threads() : numThreads;
+        numThreads = std::max<size_t>(1, std::min(numThreads, A.rows()));
+
+        std::vector<std::vector<float>> partial(numThreads);
+
+        parallel_for(
+            0, numThreads,
+            [&](size_t t) {
+                auto& acc = partial[t];
+                acc.assign(A.cols(), 0.f);
+
+                UInt32P cols;
+                FloatP weights;
+                enoki::mask_t<FloatP> mask;
+
+                for (size_t i = A.rows() * t / numThreads; i < A.rows() * (t + 1) / numThreads; ++i) {
+                    if (y[i] == 0.f)
+                        continue;
+
+                    // Columns within a row are unique, so the scatter has no conflicts
+                    for (uint64_t k = A.rowBegin(i); k < A.rowBegin(i + 1); k += FloatP::Size) {
+                        A.template decode<FloatP>(i, k, cols, weights, mask);
+                        enoki::scatter_add(acc.data(), weights * y[i], cols, mask);
+                    }
+                }
+            },
+            1, numThreads);
+
+        parallel_for(
+            0, A.cols(),
+            [&](size_t j) {
+                float sum = 0;
+                for (const auto& acc : partial)
+                    sum += acc[j];
+                x[j] = sum;
+            },
+            4096);
+    }
+} // namespace tomosect
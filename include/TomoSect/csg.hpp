@@ -0,0 +1,382 @@
+/**
+ *
+ * \file csg.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/bvh.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/quadric.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tomosect
+{
+    /// Stretch of a ray inside a CSG object
+    template <typename Scalar>
+    struct csg_interval {
+        Scalar tEnter;
+        Scalar tExit;
+    };
+
+    /**
+     * Parts of the lanes of a ray inside an object, with room for Capacity intervals per lane. Boundaries are stored
+     * as begin, end, begin, end, ..., sorted per lane, and padded with infinity. The extra last slot is always
+     * infinity, so a merge can read one past the last interval.
+     */
+    template <typename Value, size_t Capacity>
+    struct csg_intervals {
+        using Scalar = enoki::scalar_t<Value>;
+
+        Value bounds[2 * Capacity + 1];
+
+        csg_intervals() { std::fill(std::begin(bounds), std::end(bounds), Value(std::numeric_limits<Scalar>::infinity())); }
+
+        /// True for lanes with at least one interval
+        auto nonEmpty() const { return bounds[0] < Value(std::numeric_limits<Scalar>::infinity()); }
+
+        /// Total length of the intervals of every lane
+        Value length() const
+        {
+            constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+
+            Value sum = Value(0);
+            for (size_t k = 0; k < Capacity; ++k) {
+                const auto valid = bounds[2 * k] < Value(inf);
+                if (enoki::none(valid))
+                    break;
+                sum += enoki::select(valid, bounds[2 * k + 1] - bounds[2 * k], Value(0));
+            }
+            return sum;
+        }
+    };
+
+    enum class csg_op : uint8_t { primitive, unite, intersect, subtract };
+
+    namespace details
+    {
+        enum class csg_shape : uint8_t { box, ellipsoid, cylinder };
+
+        template <typename Index>
+        Index lane_offsets()
+        {
+            if constexpr (enoki::is_array_v<Index>)
+                return enoki::arange<Index>();
+            else
+                return Index(0);
+        }
+
+        /// Entry and exit distance through the box [lo, hi], the mask is set for rays hitting it
+        template <typename Value, typename Scalar>
+        IntervalResult<Value> box_interval(const Scalar lo[3], const Scalar hi[3], const Value o[3], const Value invDir[3])
+        {
+            Value tEnter = Value(-std::numeric_limits<Scalar>::infinity());
+            Value tExit = Value(std::numeric_limits<Scalar>::infinity());
+            for (int a = 0; a < 3; ++a) {
+                const Value t0 = (lo[a] - o[a]) * invDir[a];
+                const Value t1 = (hi[a] - o[a]) * invDir[a];
+                tEnter = enoki::max(tEnter, enoki::min(t0, t1));
+                tExit = enoki::min(tExit, enoki::max(t0, t1));
+            }
+            return { tEnter, tExit, tEnter <= tExit };
+        }
+
+        /**
+         * Boolean combination of two interval lists, walking the boundaries of both in order for all lanes in lockstep.
+         * Each lane reads its next boundaries with a gather, and the result is only written where being inside changes.
+         */
+        template <csg_op Op, typename Value, size_t Capacity>
+        csg_intervals<Value, Capacity> combine(const csg_intervals<Value, Capacity>& a, const csg_intervals<Value, Capacity>& b)
+        {
+            using Scalar = enoki::scalar_t<Value>;
+            using Index = bvh_index_t<Value>;
+            using Mask = typename point3<Value>::Mask;
+
+            constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+            constexpr uint32_t lanes = static_cast<uint32_t>(enoki::array_size_v<Value>);
+
+            const Index lane = lane_offsets<Index>();
+            const auto* aBounds = reinterpret_cast<const Scalar*>(a.bounds);
+            const auto* bBounds = reinterpret_cast<const Scalar*>(b.bounds);
+
+            csg_intervals<Value, Capacity> result;
+            auto* outBounds = reinterpret_cast<Scalar*>(result.bounds);
+
+            Index ia = Index(0), ib = Index(0), out = Index(0);
+            Mask inA = Mask(false), inB = Mask(false), inside = Mask(false);
+            while (true) {
+                const Value ha = enoki::gather<Value>(aBounds, ia * lanes + lane);
+                const Value hb = enoki::gather<Value>(bBounds, ib * lanes + lane);
+                const Value t = enoki::min(ha, hb);
+
+                const Mask active = t < Value(inf);
+                if (enoki::none(active))
+                    break;
+
+                // Equal boundaries of both are passed together, so touching intervals leave no empty pieces
+                const Mask takeA = active && ha <= hb;
+                const Mask takeB = active && hb <= ha;
+                inA = enoki::select(takeA, !inA, inA);
+                inB = enoki::select(takeB, !inB, inB);
+                ia += enoki::select(takeA, Index(1), Index(0));
+                ib += enoki::select(takeB, Index(1), Index(0));
+
+                Mask now;
+                if constexpr (Op == csg_op::unite)
+                    now = inA || inB;
+                else if constexpr (Op == csg_op::intersect)
+                    now = inA && inB;
+                else
+                    now = inA && !inB;
+
+                const Mask emit = active && (now ^ inside);
+                if constexpr (enoki::is_array_v<Value>)
+                    enoki::scatter(outBounds, t, out * lanes + lane, emit);
+                else if (emit)
+                    outBounds[out] = t;
+                out += enoki::select(emit, Index(1), Index(0));
+                inside = now;
+            }
+            return result;
+        }
+    } // namespace details
+
+    /**
+     * Constructive solid geometry over boxes, ellipsoids and cylinders. Nodes are added bottom up, each operation
+     * returns the id of the new node, and the node added last is the root.
+     *
+     * Every ray packet carries a list of up to Capacity intervals per lane through the tree. All primitives are convex
+     * and add at most two boundaries, so a tree with at most Capacity primitives below every node can never overflow;
+     * trees which could are rejected when they are built. Subtrees whose bounding box is missed by all lanes are
+     * skipped.
+     */
+    template <typename Scalar, size_t Capacity = 16>
+    class csg_tree
+    {
+    public:
+        using node_id = uint32_t;
+
+        struct node {
+            csg_op op;
+            details::csg_shape shape; // Kind of primitive, for op == primitive
+            uint32_t left;            // Primitive index for op == primitive
+            uint32_t right;
+            uint32_t maxIntervals;    // Upper bound of the intervals per lane
+            Scalar lo[3], hi[3];      // Bounds of everything inside the node
+        };
+
+        node_id add(const aabb<Scalar>& box)
+        {
+            const auto min = box.min();
+            const auto max = box.max();
+            std::array<Scalar, 6> b = { min.x(), min.y(), min.z(), max.x(), max.y(), max.z() };
+            boxes_.push_back(b);
+            return addPrimitive(details::csg_shape::box, boxes_.size() - 1, b.data(), b.data() + 3);
+        }
+
+        node_id add(const ellipsoid<Scalar>& shape)
+        {
+            ellipsoids_.push_back(shape);
+            Scalar lo[3], hi[3];
+            shape.bounds(lo, hi);
+            return addPrimitive(details::csg_shape::ellipsoid, ellipsoids_.size() - 1, lo, hi);
+        }
+
+        node_id add(const cylinder<Scalar>& shape)
+        {
+            cylinders_.push_back(shape);
+            Scalar lo[3], hi[3];
+            shape.bounds(lo, hi);
+            return addPrimitive(details::csg_shape::cylinder, cylinders_.size() - 1, lo, hi);
+        }
+
+        /// Points inside of a or b
+        node_id unite(node_id a, node_id b) { return addOperation(csg_op::unite, a, b); }
+
+        /// Points inside of a and b
+        node_id intersect(node_id a, node_id b) { return addOperation(csg_op::intersect, a, b); }
+
+        /// Points inside of a but not of b
+        node_id subtract(node_id a, node_id b) { return addOperation(csg_op::subtract, a, b); }
+
+        size_t size() const { return nodes_.size(); }
+        bool empty() const { return nodes_.empty(); }
+        node_id root() const { return static_cast<node_id>(nodes_.size() - 1); }
+        const std::vector<node>& nodes() const { return nodes_; }
+
+        /// Intervals of every lane of the ray inside the object, in front of the origin
+        template <typename Value>
+        csg_intervals<Value, Capacity> intervals(const ray<Value>& r) const
+        {
+            Value o[3], d[3];
+            details::ray_components(r, o, d);
+            return intervals(o, d);
+        }
+
+        template <typename Value>
+        csg_intervals<Value, Capacity> intervals(const Value o[3], const Value d[3]) const
+        {
+            if (nodes_.empty())
+                return {};
+
+            const Value invDir[3] = { 1 / d[0], 1 / d[1], 1 / d[2] };
+            return evaluate(root(), o, d, invDir);
+        }
+
+        /// Length of every lane of the ray inside the object
+        template <typename Value>
+        Value pathLength(const ray<Value>& r) const
+        {
+            return intervals(r).length();
+        }
+
+        template <typename Value>
+        Value pathLength(const Value o[3], const Value d[3]) const
+        {
+            return intervals(o, d).length();
+        }
+
+        /// Intervals of a single ray, sorted
+        std::vector<csg_interval<Scalar>> intervalList(const ray<Scalar>& r) const
+        {
+            const auto list = intervals(r);
+
+            std::vector<csg_interval<Scalar>> result;
+            for (size_t k = 0; k < Capacity && list.bounds[2 * k] < std::numeric_limits<Scalar>::infinity(); ++k)
+                result.push_back({ list.bounds[2 * k], list.bounds[2 * k + 1] });
+            return result;
+        }
+
+        bool contains(const std::array<Scalar, 3>& p) const { return !nodes_.empty() && contains(root(), p); }
+
+    private:
+        node_id addPrimitive(details::csg_shape shape, size_t index, const Scalar lo[3], const Scalar hi[3])
+        {
+            node n{ csg_op::primitive, shape, static_cast<uint32_t>(index), 0, 1, {}, {} };
+            std::copy(lo, lo + 3, n.lo);
+            std::copy(hi, hi + 3, n.hi);
+            nodes_.push_back(n);
+            return root();
+        }
+
+        node_id addOperation(csg_op op, node_id a, node_id b)
+        {
+            if (a >= nodes_.size() || b >= nodes_.size())
+                throw std::out_of_range("csg_tree: node " + std::to_string(std::max(a, b)) + " does not exist");
+
+            const node& l = nodes_[a];
+            const node& r = nodes_[b];
+
+            node n{ op, details::csg_shape::box, a, b, l.maxIntervals + r.maxIntervals, {}, {} };
+            if (n.maxIntervals > Capacity)
+                throw std::length_error("csg_tree: up to " + std::to_string(n.maxIntervals) + " intervals per ray, but the capacity is "
+                                        + std::to_string(Capacity));
+
+            for (int i = 0; i < 3; ++i) {
+                switch (op) {
+                case csg_op::unite:
+                    n.lo[i] = std::min(l.lo[i], r.lo[i]);
+                    n.hi[i] = std::max(l.hi[i], r.hi[i]);
+                    break;
+                case csg_op::intersect:
+                    n.lo[i] = std::max(l.lo[i], r.lo[i]);
+                    n.hi[i] = std::min(l.hi[i], r.hi[i]);
+                    break;
+                default:
+                    n.lo[i] = l.lo[i];
+                    n.hi[i] = l.hi[i];
+                }
+            }
+            nodes_.push_back(n);
+            return root();
+        }
+
+        template <typename Value>
+        csg_intervals<Value, Capacity> evaluate(node_id id, const Value o[3], const Value d[3], const Value invDir[3]) const
+        {
+            const node& n = nodes_[id];
+
+            csg_intervals<Value, Capacity> result;
+            if (n.op == csg_op::primitive) {
+                IntervalResult<Value> hit;
+                switch (n.shape) {
+                case details::csg_shape::box:
+                    hit = details::box_interval(boxes_[n.left].data(), boxes_[n.left].data() + 3, o, invDir);
+                    break;
+                case details::csg_shape::ellipsoid:
+                    hit = details::ellipsoid_interval(ellipsoids_[n.left].transform(), o, d);
+                    break;
+                case details::csg_shape::cylinder:
+                    hit = details::cylinder_interval(cylinders_[n.left].transform(), o, d);
+                    break;
+                }
+
+                // Only the part in front of the origin counts
+                auto [tEnter, tExit, mask] = hit;
+                tEnter = enoki::max(tEnter, Value(0));
+                mask = mask && tEnter < tExit;
+
+                constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+                result.bounds[0] = enoki::select(mask, tEnter, Value(inf));
+                result.bounds[1] = enoki::select(mask, tExit, Value(inf));
+                return result;
+            }
+
+            auto [tEnter, tExit, mask] = details::box_interval(n.lo, n.hi, o, invDir);
+            if (enoki::none(mask && tExit > Value(0)))
+                return result;
+
+            auto a = evaluate(n.left, o, d, invDir);
+            const bool aEmpty = enoki::none(a.nonEmpty());
+            if (aEmpty && n.op != csg_op::unite)
+                return result;
+
+            auto b = evaluate(n.right, o, d, invDir);
+            if (enoki::none(b.nonEmpty()))
+                return n.op == csg_op::intersect ? result : a;
+            if (aEmpty)
+                return b;
+
+            switch (n.op) {
+            case csg_op::unite: return details::combine<csg_op::unite>(a, b);
+            case csg_op::intersect: return details::combine<csg_op::intersect>(a, b);
+            default: return details::combine<csg_op::subtract>(a, b);
+            }
+        }
+
+        bool contains(node_id id, const std::array<Scalar, 3>& p) const
+        {
+            const node& n = nodes_[id];
+            switch (n.op) {
+            case csg_op::unite: return contains(n.left, p) || contains(n.right, p);
+            case csg_op::intersect: return contains(n.left, p) && contains(n.right, p);
+            case csg_op::subtract: return contains(n.left, p) && !contains(n.right, p);
+            default: break;
+            }
+
+            switch (n.shape) {
+            case details::csg_shape::ellipsoid: return ellipsoids_[n.left].contains(p);
+            case details::csg_shape::cylinder: return cylinders_[n.left].contains(p);
+            default: break;
+            }
+
+            const auto& b = boxes_[n.left];
+            return p[0] >= b[0] && p[1] >= b[1] && p[2] >= b[2] && p[0] <= b[3] && p[1] <= b[4] && p[2] <= b[5];
+        }
+
+        std::vector<node> nodes_;
+        std::vector<std::array<Scalar, 6>> boxes_; // min x, y, z and max x, y, z
+        std::vector<ellipsoid<Scalar>> ellipsoids_;
+        std::vector<cylinder<Scalar>> cylinders_;
+    };
+} // namespace tomosect
@@ -0,0 +1,119 @@
+/**
+ *
+ * \file dispatch.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+
+#include <cstddef>
+
+#if defined(__GNUC__)
+#define TOMOSECT_KERNELS_EXPORT __attribute__((visibility("default")))
+#else
+#define TOMOSECT_KERNELS_EXPORT
+#endif
+
+namespace tomosect
+{
+    /// Instruction set levels the kernels are built for, each one includes the ones before
+    enum class isa_level { sse4_2, avx2, avx512 };
+
+    const char* isa_name(isa_level isa);
+
+    /// Highest level supported by the CPU and the operating system (CPUID and XGETBV)
+    isa_level detect_isa();
+
+    /*
+     * The kernels are built once per level, with different pack implementations of enoki. The layout of enoki arrays
+     * (and so of point3, vec3, voxel_grid, ...) depends on the instruction set, therefore only plain structs of floats
+     * cross between caller and kernel.
+     */
+
+    /// count rays as structure of arrays: ray i starts at (origin[0][i], origin[1][i], origin[2][i]) along dir
+    struct kernel_rays {
+        const float* origin[3];
+        const float* dir[3];
+        size_t count;
+    };
+
+    /// Voxel grid of n[0] x n[1] x n[2] voxels of size spacing, its minimum corner at min
+    struct kernel_grid {
+        size_t n[3];
+        float min[3];
+        float spacing[3];
+
+        static kernel_grid from(const voxel_grid<float>& grid)
+        {
+            const auto lo = grid.min();
+            const auto h = grid.spacing();
+            return { { grid.nx(), grid.ny(), grid.nz() }, { lo.x(), lo.y(), lo.z() }, { h.x(), h.y(), h.z() } };
+        }
+    };
+
+    /// Pixel lattice of a flat detector: pixel (col, row) is centered at first + col * colStep + row * rowStep
+    struct kernel_view {
+        float source[3];
+        float first[3];
+        float colStep[3];
+        float rowStep[3];
+        size_t cols;
+        size_t rows;
+
+        static kernel_view from(const projection_view<float>& view)
+        {
+            const auto first = view.detector.coordFromLocal(point2<float>(0, 0));
+            const auto colStep = view.detector.coordFromLocal(point2<float>(1, 0)) - first;
+            const auto rowStep = view.detector.coordFromLocal(point2<float>(0, 1)) - first;
+            return { { view.source.x(), view.source.y(), view.source.z() },
+                     { first.x(), first.y(), first.z() },
+                     { colStep.x(), colStep.y(), colStep.z() },
+                     { rowStep.x(), rowStep.y(), rowStep.z() },
+                     view.cols(),
+                     view.rows() };
+        }
+    };
+
+    /// Kernels built for one instruction set level
+    struct kernel_table {
+        isa_level isa;
+
+        /// Entry and exit distances of the rays through the box, rays missing it get tmin = tmax = 0
+        void (*intersectBox)(const kernel_rays& rays, const float boxMin[3], const float boxMax[3], float* tmin, float* tmax);
+
+        /// Line integrals through a linear volume for all pixels of a view, row major into out, see project
+        void (*project)(const kernel_view& view, const kernel_grid& grid, const float* volume, float* out);
+
+        /// FDK backprojection of numViews views into a box of the grid, see backproject in fdk.hpp
+        void (*backproject)(const projection_matrix<float>* matrices, const filtered_rows* rows, size_t numViews, size_t cols,
+                            float scale, const kernel_grid& grid, const voxel_box& box, float* output);
+    };
+
+    /**
+     * Kernels of a level, nullptr if the CPU does not support it or the kernels are not built (only x86 with GCC or
+     * Clang). The build of a level is a module loaded on the first request, and only after the CPU check, so code using
+     * instructions the CPU lacks is never mapped. Throws runtime_error if the module can't be loaded.
+     */
+    const kernel_table* kernels_for(isa_level isa);
+
+    /**
+     * Kernels of the highest level the CPU supports, selected on the first call. The environment variable TOMOSECT_ISA
+     * (sse4_2, avx2 or avx512) caps the level, e.g. to compare results or timings between levels on one machine.
+     * Throws runtime_error if the CPU lacks SSE4.2, the kernels are not built or TOMOSECT_ISA names an unknown level.
+     *
+     * Only the kernels of the table are dispatched. fdk(), backproject(), project() and the rest of the header only code
+     * are compiled with the flags of the including target, as before.
+     */
+    const kernel_table& kernels();
+
+    namespace details
+    {
+        /// Symbol of every kernel module returning its table (extern "C", see src/dispatch_kernels.cpp)
+        constexpr const char* kernel_entry = "tomosect_kernel_table";
+    } // namespace details
+} // namespace tomosect
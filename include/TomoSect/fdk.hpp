@@ -0,0 +1,241 @@
+/**
+ *
+ * \file fdk.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Weighting and filtering step of FDK for a circular trajectory with flat detector: every pixel is multiplied with
+     * the cosine of the angle between its ray and the central ray, then every detector row is convolved with the
+     * Ram-Lak ramp filter (spatial domain, Kak & Slaney), using the pixel spacing scaled to the rotation axis. Rows are
+     * filtered independently, so any range of rows can be filtered on its own.
+     */
+    template <typename Scalar>
+    class fdk_filter
+    {
+    public:
+        explicit fdk_filter(const circular_trajectory<Scalar>& trajectory)
+            : cols_(trajectory.cols), rows_(trajectory.rows), weights_(trajectory.cols * trajectory.rows), kernel_(2 * trajectory.cols - 1)
+        {
+            const Scalar S = trajectory.sourceDistance;
+            const Scalar magnification = (trajectory.sourceDistance + trajectory.detectorDistance) / S;
+            const Scalar du = trajectory.pixelWidth / magnification;
+            const Scalar dv = trajectory.pixelHeight / magnification;
+
+            for (size_t r = 0; r < rows_; ++r) {
+                Scalar b = (static_cast<Scalar>(r) - static_cast<Scalar>(rows_ - 1) / 2) * dv;
+                for (size_t c = 0; c < cols_; ++c) {
+                    Scalar a = (static_cast<Scalar>(c) - static_cast<Scalar>(cols_ - 1) / 2) * du;
+                    weights_[r * cols_ + c] = static_cast<float>(S / std::sqrt(S * S + a * a + b * b));
+                }
+            }
+
+            // Kernel including the integration weight du, centered at index cols - 1
+            const auto center = static_cast<long>(cols_) - 1;
+            for (long n = -center; n <= center; ++n) {
+                Scalar h = 0;
+                if (n == 0)
+                    h = 1 / (4 * du * du);
+                else if (n % 2 != 0)
+                    h = -1 / (static_cast<Scalar>(n * n) * static_cast<Scalar>(M_PI * M_PI) * du * du);
+
+                kernel_[static_cast<size_t>(n + center)] = static_cast<float>(h * du);
+            }
+        }
+
+        size_t cols() const { return cols_; }
+        size_t rows() const { return rows_; }
+
+        /**
+         * Weight and filter the detector rows [rowBegin, rowEnd) of a single view. in and out point to the first of
+         * these rows, cols() values per row, and must not overlap. Only the columns [colBegin, colEnd) of the output are
+         * computed, the input is always needed for whole rows, as the ramp filter is not local.
+         */
+        void filterRows(const float* in, float* out, size_t rowBegin, size_t rowEnd, size_t colBegin = 0, size_t colEnd = SIZE_MAX) const
+        {
+            std::vector<float> weighted(cols_);
+            const auto center = cols_ - 1;
+            colEnd = std::min(colEnd, cols_);
+
+            for (size_t r = rowBegin; r < rowEnd; ++r) {
+                const float* src = in + (r - rowBegin) * cols_;
+                float* dst = out + (r - rowBegin) * cols_;
+                const float* w = weights_.data() + r * cols_;
+
+                for (size_t c = 0; c < cols_; ++c)
+                    weighted[c] = src[c] * w[c];
+
+                for (size_t i = colBegin; i < colEnd; ++i) {
+                    // Only the center and odd offsets of the kernel are nonzero
+                    float sum = kernel_[center] * weighted[i];
+                    for (size_t j = (i + 1) % 2; j < cols_; j += 2)
+                        sum += kernel_[i + center - j] * weighted[j];
+                    dst[i] = sum;
+                }
+            }
+        }
+
+    private:
+        size_t cols_;
+        size_t rows_;
+        std::vector<float> weights_; // Cosine weight per pixel
+        std::vector<float> kernel_;  // Ramp filter taps, 2 * cols - 1
+    };
+
+    /// Filtered detector rows [rowBegin, rowEnd) of one view, cols values per row
+    struct filtered_rows {
+        const float* data;
+        size_t rowBegin;
+        size_t rowEnd;
+    };
+
+    namespace details
+    {
+        /// Pixel i of filtered rows, an enoki array Value reads its Size interleaved channels
+        template <typename Value>
+        Value load_pixel(const float* data, size_t i)
+        {
+            if constexpr (enoki::is_array_v<Value>) {
+                Value result;
+                for (size_t c = 0; c < Value::Size; ++c)
+                    result[c] = data[i * Value::Size + c];
+                return result;
+            } else {
+                return data[i];
+            }
+        }
+
+        /**
+         * Backprojection of one view into a line of nx voxels along x, the first one centered at (x0, y, z) and hx apart.
+         * See backproject below for the interpolation and weighting. With an enoki array as Value, the filtered rows hold
+         * Value::Size interleaved channels per pixel and all of them are interpolated with the same weights.
+         */
+        template <typename Scalar, typename Value = float>
+        void backproject_line(const projection_matrix<Scalar>& P, const filtered_rows& view, size_t cols, Scalar scale, Scalar x0,
+                              Scalar hx, Scalar y, Scalar z, size_t nx, Value* out)
+        {
+            const auto numRows = static_cast<long>(view.rowEnd - view.rowBegin);
+
+            // Projection is linear in x along the line
+            auto start = P.project(x0, y, z);
+            const Scalar step[3] = { P.rows[0][0] * hx, P.rows[1][0] * hx, P.rows[2][0] * hx };
+
+            auto at = [&](long c, long r) {
+                if (c < 0 || c >= static_cast<long>(cols) || r < 0 || r >= numRows)
+                    return Value(0);
+                return load_pixel<Value>(view.data, static_cast<size_t>(r) * cols + static_cast<size_t>(c));
+            };
+
+            for (size_t x = 0; x < nx; ++x) {
+                Scalar u = start[0] + static_cast<Scalar>(x) * step[0];
+                Scalar v = start[1] + static_cast<Scalar>(x) * step[1];
+                Scalar w = start[2] + static_cast<Scalar>(x) * step[2];
+
+                Scalar inv = 1 / w;
+                Scalar col = u * inv;
+                Scalar row = v * inv - static_cast<Scalar>(view.rowBegin);
+
+                Scalar c0 = std::floor(col);
+                Scalar r0 = std::floor(row);
+                auto ci = static_cast<long>(c0);
+                auto ri = static_cast<long>(r0);
+                auto fc = static_cast<float>(col - c0);
+                auto fr = static_cast<float>(row - r0);
+
+                const Value top = at(ci, ri) + fc * (at(ci + 1, ri) - at(ci, ri));
+                const Value bottom = at(ci, ri + 1) + fc * (at(ci + 1, ri + 1) - at(ci, ri + 1));
+
+                out[x] += static_cast<float>(scale * inv * inv) * (top + fr * (bottom - top));
+            }
+        }
+    } // namespace details
+
+    /**
+     * Voxel driven FDK backprojection of the given views into a box of voxels of the grid. Every voxel is projected
+     * onto each detector with its projection matrix and the filtered data is interpolated bilinearly, pixels outside of
+     * the given rows count as zero. The contribution is weighted with scale / w^2, w being the distance of the voxel
+     * from the source. The output holds the box's voxels (x fastest), contributions are added to it.
+     */
+    template <typename Scalar>
+    void backproject(const std::vector<projection_matrix<Scalar>>& matrices, const std::vector<filtered_rows>& rows, size_t cols,
+                     Scalar scale, const voxel_grid<Scalar>& grid, const voxel_box& box, float* output)
+    {
+        const size_t nx = box.nx();
+        const size_t ny = box.ny();
+        const auto first = grid.voxelCenter(box.xBegin, box.yBegin, box.zBegin);
+        const auto h = grid.spacing();
+
+        parallel_for(0, ny * box.nz(), [&](size_t line) {
+            size_t y = line % ny;
+            size_t z = line / ny;
+            float* out = output + line * nx;
+
+            Scalar wy = first.y() + static_cast<Scalar>(y) * h.y();
+            Scalar wz = first.z() + static_cast<Scalar>(z) * h.z();
+
+            for (size_t k = 0; k < matrices.size(); ++k)
+                details::backproject_line(matrices[k], rows[k], cols, scale, first.x(), h.x(), wy, wz, nx, out);
+        });
+    }
+
+    /// Backprojection into the z-slices [zBegin, zEnd) of the grid, the slab holds nx * ny * (zEnd - zBegin) values
+    template <typename Scalar>
+    void backproject(const std::vector<projection_matrix<Scalar>>& matrices, const std::vector<filtered_rows>& rows, size_t cols,
+                     Scalar scale, const voxel_grid<Scalar>& grid, size_t zBegin, size_t zEnd, float* slab)
+    {
+        backproject(matrices, rows, cols, scale, grid, voxel_box{ 0, grid.nx(), 0, grid.ny(), zBegin, zEnd }, slab);
+    }
+
+    /// Backprojection weight of FDK for a trajectory: arc / (2 * numViews) * sourceDistance^2
+    template <typename Scalar>
+    Scalar fdk_scale(const circular_trajectory<Scalar>& trajectory)
+    {
+        return trajectory.arc / (2 * static_cast<Scalar>(trajectory.numViews)) * trajectory.sourceDistance * trajectory.sourceDistance;
+    }
+
+    /**
+     * FDK reconstruction (Feldkamp, Davis & Kress) of a full circular scan, with all projections and the whole volume
+     * in memory. Short scans are not weighted (no Parker weights), so they are only approximate.
+     */
+    template <typename Scalar, typename T>
+    volume<float> fdk(const circular_trajectory<Scalar>& trajectory, const projection_stack<T>& projections, const voxel_grid<Scalar>& grid)
+    {
+        if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows || projections.numViews() != trajectory.numViews)
+            throw std::invalid_argument("fdk: projections do not match the trajectory");
+
+        fdk_filter<Scalar> filter(trajectory);
+        projection_stack<float> filtered(trajectory.cols, trajectory.rows, trajectory.numViews);
+
+        parallel_for(0, trajectory.numViews,
+                     [&](size_t k) { filter.filterRows(projections.view(k), filtered.view(k), 0, trajectory.rows); });
+
+        std::vector<projection_matrix<Scalar>> matrices;
+        std::vector<filtered_rows> rows;
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+            rows.push_back({ filtered.view(k), 0, trajectory.rows });
+        }
+
+        volume<float> result(grid.nx(), grid.ny(), grid.nz());
+        backproject(matrices, rows, trajectory.cols, fdk_scale(trajectory), grid, 0, grid.nz(), result.data());
+        return result;
+    }
+} // namespace tomosect
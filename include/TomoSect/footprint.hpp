@@ -0,0 +1,207 @@
+/**
+ *
+ * \file footprint.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Width of the cone of rays hitting a detector pixel, a ray differential: the footprint is width0 at the ray origin
+     * and grows linearly by spread per unit length along the ray. Widths are measured perpendicular to the ray.
+     */
+    template <typename Scalar>
+    struct ray_footprint {
+        Scalar width0 = 0;
+        Scalar spread = 0;
+
+        Scalar width(Scalar t) const { return width0 + spread * t; }
+
+        /// Distance along the ray at which the footprint is w wide, infinity if never
+        Scalar distance(Scalar w) const
+        {
+            const Scalar t = spread != 0 ? (w - width0) / spread : -1;
+            return t >= 0 ? t : std::numeric_limits<Scalar>::infinity();
+        }
+    };
+
+    /**
+     * Footprint of the ray from the source through the center of pixel (col, row): the focal spot width at the source and
+     * the pixel seen from the ray direction at the detector. The pixel size is the geometric mean of its edges, foreshortened
+     * by the cosine of the angle between ray and detector normal.
+     */
+    template <typename Scalar>
+    ray_footprint<Scalar> pixel_footprint(const projection_view<Scalar>& view, size_t col, size_t row, Scalar focalSpot = 0)
+    {
+        const auto first = view.detector.coordFromLocal(point2<Scalar>(0, 0));
+        const auto colStep = view.detector.coordFromLocal(point2<Scalar>(1, 0)) - first;
+        const auto rowStep = view.detector.coordFromLocal(point2<Scalar>(0, 1)) - first;
+        const auto normal = normalize(cross(colStep, rowStep));
+        const Scalar pitch = std::sqrt(std::sqrt(dot(colStep, colStep) * dot(rowStep, rowStep)));
+
+        const auto toPixel = view.detector.coordFromLocal(point2<Scalar>(static_cast<Scalar>(col), static_cast<Scalar>(row))) - view.source;
+        const Scalar distance = std::sqrt(dot(toPixel, toPixel));
+        const Scalar cosine = std::abs(dot(toPixel, normal)) / distance;
+
+        return { focalSpot, (pitch * cosine - focalSpot) / distance };
+    }
+
+    /**
+     * Mip pyramid of a volume: level 0 is the volume itself, every further level halves the number of voxels along each
+     * axis (rounding up) and stores the mean of the 2x2x2 voxels below it. Voxels past the border of an odd sized level
+     * count as zero: coarser levels may stick out of the volume, but keep the line integrals through it. Meant for
+     * floating point values, integers are truncated by the averaging.
+     */
+    template <typename Scalar, typename T, volume_layout Layout = volume_layout::linear>
+    class volume_pyramid
+    {
+    public:
+        /// Build levels down to a single voxel, or at most maxLevels of them (0 for no limit)
+        volume_pyramid(const voxel_grid<Scalar>& grid, const volume<T, Layout>& vol, size_t maxLevels = 0)
+        {
+            if (vol.nx() != grid.nx() || vol.ny() != grid.ny() || vol.nz() != grid.nz())
+                throw std::invalid_argument("volume_pyramid: volume does not match the grid");
+
+            const auto h = grid.spacing();
+            voxelSize_ = std::max({ h.x(), h.y(), h.z() });
+
+            grids_.push_back(grid);
+            levels_.push_back(vol);
+            while ((maxLevels == 0 || levels_.size() < maxLevels) && levels_.back().size() > 1)
+                addLevel();
+        }
+
+        size_t levels() const { return levels_.size(); }
+
+        const volume<T, Layout>& level(size_t l) const { return levels_[l]; }
+
+        const voxel_grid<Scalar>& grid(size_t l) const { return grids_[l]; }
+
+        /// Largest edge of the voxels of level 0
+        Scalar voxelSize() const { return voxelSize_; }
+
+        /// Coarsest level whose voxels are not larger than the footprint width, level 0 for footprints below a voxel
+        size_t levelFor(Scalar width) const
+        {
+            if (!(width > voxelSize_))
+                return 0;
+            const auto l = static_cast<size_t>(std::floor(std::log2(width / voxelSize_)));
+            return std::min(l, levels_.size() - 1);
+        }
+
+    private:
+        void addLevel()
+        {
+            const auto& fine = levels_.back();
+            const auto& fineGrid = grids_.back();
+            const size_t n[3] = { (fine.nx() + 1) / 2, (fine.ny() + 1) / 2, (fine.nz() + 1) / 2 };
+
+            volume<T, Layout> coarse(n[0], n[1], n[2]);
+            parallel_for(0, n[2], [&](size_t z) {
+                for (size_t y = 0; y < n[1]; ++y) {
+                    for (size_t x = 0; x < n[0]; ++x) {
+                        Scalar sum = 0;
+                        for (size_t fz = 2 * z; fz < std::min(2 * z + 2, fine.nz()); ++fz)
+                            for (size_t fy = 2 * y; fy < std::min(2 * y + 2, fine.ny()); ++fy)
+                                for (size_t fx = 2 * x; fx < std::min(2 * x + 2, fine.nx()); ++fx)
+                                    sum += static_cast<Scalar>(fine(fx, fy, fz));
+                        coarse(x, y, z) = static_cast<T>(sum / 8);
+                    }
+                }
+            });
+
+            grids_.emplace_back(n[0], n[1], n[2], fineGrid.min(), fineGrid.spacing() * Scalar(2));
+            levels_.push_back(coarse);
+        }
+
+        Scalar voxelSize_;
+        std::vector<voxel_grid<Scalar>> grids_;
+        std::vector<volume<T, Layout>> levels_;
+    };
+
+    /**
+     * Line integral along a ray with a footprint: the ray is cut where its width crosses the voxel size of a pyramid
+     * level, and each piece is traced through the level matching the width there. Nearly the cost of a single ray, as
+     * coarser levels have fewer voxels to step through, with the filtering of a ray bundle covering the footprint.
+     */
+    template <typename Scalar, typename T, volume_layout Layout>
+    Scalar project_footprint(const ray<Scalar>& r, const ray_footprint<Scalar>& footprint, const volume_pyramid<Scalar, T, Layout>& pyramid)
+    {
+        // The coarsest grid contains all others
+        auto [tmin, tmax, hit] = intersection(r, pyramid.grid(pyramid.levels() - 1).bounds(), ray_aabb_interval{});
+        tmin = std::max(tmin, Scalar{ 0 });
+        if (!hit || tmax <= tmin)
+            return 0;
+
+        // Level changes inside the volume, the width is monotonic along the ray
+        Scalar cuts[65];
+        size_t numCuts = 0;
+        for (size_t l = 1; l < pyramid.levels() && numCuts < 64; ++l) {
+            const Scalar t = footprint.distance(pyramid.voxelSize() * std::ldexp(Scalar(1), static_cast<int>(l)));
+            if (t > tmin && t < tmax)
+                cuts[numCuts++] = t;
+        }
+        std::sort(cuts, cuts + numCuts);
+        cuts[numCuts] = tmax;
+
+        Scalar sum = 0;
+        Scalar begin = tmin;
+        for (size_t c = 0; c <= numCuts; ++c) {
+            const Scalar end = cuts[c];
+            if (end <= begin)
+                continue;
+
+            const size_t l = pyramid.levelFor(footprint.width((begin + end) / 2));
+            const auto& grid = pyramid.grid(l);
+            const auto& vol = pyramid.level(l);
+
+            // Finer levels of odd size end before the coarser ones
+            auto [lmin, lmax, inside] = intersection(r, grid.bounds(), ray_aabb_interval{});
+            const Scalar from = std::max(begin, lmin);
+            const Scalar to = std::min(end, lmax);
+            begin = end;
+            if (!inside || to <= from)
+                continue;
+
+            const long first[3] = { 0, 0, 0 };
+            const long last[3] = { static_cast<long>(grid.nx()), static_cast<long>(grid.ny()), static_cast<long>(grid.nz()) };
+            details::walk_cells(r, grid, from, to, first, last,
+                                [&](size_t x, size_t y, size_t z, Scalar length) { sum += length * static_cast<Scalar>(vol(x, y, z)); });
+        }
+        return sum;
+    }
+
+    /**
+     * Projection of all pixels of a view with footprints, in row major order into out (cols * rows values). Rows are
+     * processed in parallel.
+     */
+    template <typename Scalar, typename T, volume_layout Layout>
+    void project_footprint(const projection_view<Scalar>& view, const volume_pyramid<Scalar, T, Layout>& pyramid, float* out,
+                           Scalar focalSpot = 0)
+    {
+        const size_t cols = view.cols();
+        parallel_for(0, view.rows(), [&](size_t row) {
+            for (size_t col = 0; col < cols; ++col) {
+                const auto footprint = pixel_footprint(view, col, row, focalSpot);
+                out[row * cols + col] = static_cast<float>(project_footprint(view.pixelRay(col, row), footprint, pyramid));
+            }
+        });
+    }
+} // namespace tomosect
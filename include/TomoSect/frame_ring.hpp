@@ -0,0 +1,527 @@
+/**
+ *
+ * \file frame_ring.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tomosect
+{
+    /// What the writer does when the reader falls behind by more than the number of slots
+    enum class ring_policy {
+        overwrite, // Never wait, the reader drops frames instead. Any number of readers.
+        block      // Wait for the reader to release frames. Exactly one reader.
+    };
+
+    namespace details
+    {
+        constexpr uint32_t frame_ring_magic = 0x544d5352; // "TMSR"
+        constexpr uint32_t frame_ring_version = 2;
+        constexpr size_t frame_ring_alignment = 4096;
+
+        /// Layout at the start of the shared memory object, slots follow at slotOffset
+        struct frame_ring_header {
+            std::atomic<uint32_t> magic; // Stored last by the writer, with release ordering
+            uint32_t version;
+            uint64_t slotCount;
+            uint64_t slotStride; // Bytes from one slot to the next, page aligned
+            uint64_t slotOffset;
+            uint32_t cols;
+            uint32_t rows;
+            uint32_t policy;
+            std::atomic<uint32_t> closed;
+            std::atomic<uint64_t> published; // Number of frames written so far
+            std::atomic<uint64_t> released;  // Number of frames the reader is done with (block policy)
+        };
+
+        /**
+         * Every slot starts with a sequence number: 2n while it holds frame n (counting from 1), odd while frame n is
+         * being written. Readers check it before and after using a frame, like a seqlock.
+         */
+        struct frame_slot_header {
+            std::atomic<uint64_t> sequence;
+            uint64_t view;
+            uint64_t geometryId;
+        };
+
+        constexpr size_t frame_slot_data = 64; // Offset of the pixels within a slot, keeps them 64 byte aligned
+
+        static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+                      "frame_ring: shared atomics have to be lock-free");
+        static_assert(sizeof(frame_slot_header) <= frame_slot_data);
+
+        /// Wait strategy of both sides: frames arrive every few milliseconds, no need to burn a core waiting for them
+        inline void ring_backoff(unsigned spins)
+        {
+            if (spins < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        inline size_t align_up(size_t n, size_t alignment) { return (n + alignment - 1) / alignment * alignment; }
+
+        /// Owns a mapping of a shared memory object
+        class shm_mapping
+        {
+        public:
+            shm_mapping() = default;
+
+            shm_mapping(const std::string& name, bool create, size_t size)
+            {
+                int fd = ::shm_open(name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+                if (fd < 0)
+                    throw std::system_error(errno, std::generic_category(), "frame_ring: cannot open shared memory " + name);
+
+                if (create && ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    int err = errno;
+                    ::close(fd);
+                    ::shm_unlink(name.c_str());
+                    throw std::system_error(err, std::generic_category(), "frame_ring: cannot resize shared memory " + name);
+                }
+
+                if (!create) {
+                    struct stat st {
+                    };
+                    if (::fstat(fd, &st) != 0) {
+                        int err = errno;
+                        ::close(fd);
+                        throw std::system_error(err, std::generic_category(), "frame_ring: cannot stat shared memory " + name);
+                    }
+                    size = static_cast<size_t>(st.st_size);
+                }
+
+                void* ptr = size > 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+                int err = errno;
+                ::close(fd);
+
+                if (ptr == MAP_FAILED) {
+                    if (create)
+                        ::shm_unlink(name.c_str());
+                    throw std::system_error(size > 0 ? err : EINVAL, std::generic_category(),
+                                            "frame_ring: cannot map shared memory " + name);
+                }
+
+                data_ = static_cast<char*>(ptr);
+                size_ = size;
+                name_ = create ? name : std::string();
+            }
+
+            shm_mapping(const shm_mapping&) = delete;
+            shm_mapping& operator=(const shm_mapping&) = delete;
+
+            shm_mapping(shm_mapping&& other) noexcept
+                : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)), name_(std::move(other.name_))
+            {
+                other.name_.clear();
+            }
+
+            shm_mapping& operator=(shm_mapping&& other) noexcept
+            {
+                if (this != &other) {
+                    release();
+                    data_ = std::exchange(other.data_, nullptr);
+                    size_ = std::exchange(other.size_, 0);
+                    name_ = std::move(other.name_);
+                    other.name_.clear();
+                }
+                return *this;
+            }
+
+            ~shm_mapping() { release(); }
+
+            char* data() const { return data_; }
+            size_t size() const { return size_; }
+
+        private:
+            void release()
+            {
+                if (data_)
+                    ::munmap(data_, size_);
+
+                // The creator removes the name, existing mappings stay valid until they are unmapped
+                if (!name_.empty())
+                    ::shm_unlink(name_.c_str());
+
+                data_ = nullptr;
+                size_ = 0;
+                name_.clear();
+            }
+
+            char* data_ = nullptr;
+            size_t size_ = 0;
+            std::string name_; // Only set for the creating side
+        };
+    } // namespace details
+
+    /**
+     * Producer side of a ring buffer of detector frames in POSIX shared memory, usually living in the acquisition
+     * process. Frames are either written in place (claim() and commit(), no copy at all) or copied in with publish().
+     * With the overwrite policy the writer never waits, readers falling behind by more than the number of slots notice
+     * that frames were overwritten. Destroying the writer closes the ring and removes the shared memory object, readers
+     * that still have it mapped finish the frames left in it.
+     */
+    class frame_ring_writer
+    {
+    public:
+        /// Create a new ring, name has to start with a slash and must not exist yet
+        frame_ring_writer(const std::string& name, size_t cols, size_t rows, size_t slots, ring_policy policy = ring_policy::overwrite)
+        {
+            if (cols == 0 || rows == 0 || slots == 0)
+                throw std::invalid_argument("frame_ring_writer: frame size and number of slots must not be zero");
+
+            const size_t slotOffset = details::align_up(sizeof(details::frame_ring_header), details::frame_ring_alignment);
+            const size_t slotStride =
+                details::align_up(details::frame_slot_data + cols * rows * sizeof(float), details::frame_ring_alignment);
+
+            shm_ = details::shm_mapping(name, true, slotOffset + slots * slotStride);
+
+            // Fresh shared memory is zero filled, so all slot sequences start out empty
+            auto* header = new (shm_.data()) details::frame_ring_header{};
+            header->slotCount = slots;
+            header->slotStride = slotStride;
+            header->slotOffset = slotOffset;
+            header->cols = static_cast<uint32_t>(cols);
+            header->rows = static_cast<uint32_t>(rows);
+            header->policy = static_cast<uint32_t>(policy);
+            header->version = details::frame_ring_version;
+
+            // Readers only accept the ring once the magic is visible
+            header->magic.store(details::frame_ring_magic, std::memory_order_release);
+        }
+
+        frame_ring_writer(frame_ring_writer&&) noexcept = default;
+        frame_ring_writer& operator=(frame_ring_writer&& other) noexcept
+        {
+            if (this != &other) {
+                closeRing();
+                shm_ = std::move(other.shm_);
+                claimed_ = std::exchange(other.claimed_, false);
+            }
+            return *this;
+        }
+
+        /// A writer going away, e.g. on an exception in the acquisition, must not leave readers waiting forever
+        ~frame_ring_writer() { closeRing(); }
+
+        size_t cols() const { return header().cols; }
+        size_t rows() const { return header().rows; }
+        size_t slots() const { return header().slotCount; }
+
+        /// Number of frames published so far
+        uint64_t published() const { return header().published.load(std::memory_order_relaxed); }
+
+        /**
+         * Slot of the next frame, to be filled with cols * rows values and handed to readers with commit(). With the
+         * block policy, this waits until the reader released the frame last stored in the slot.
+         */
+        float* claim()
+        {
+            if (claimed_)
+                throw std::logic_error("frame_ring_writer: previous frame was not committed");
+
+            auto& h = header();
+            const uint64_t n = h.published.load(std::memory_order_relaxed) + 1;
+
+            if (static_cast<ring_policy>(h.policy) == ring_policy::block) {
+                for (unsigned spins = 0; n - h.released.load(std::memory_order_acquire) > h.slotCount; ++spins)
+                    details::ring_backoff(spins);
+            }
+
+            auto* slot = slotOf(n);
+            slot->sequence.store(2 * n - 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            claimed_ = true;
+            return reinterpret_cast<float*>(reinterpret_cast<char*>(slot) + details::frame_slot_data);
+        }
+
+        /// Make the claimed frame visible to readers
+        void commit(size_t view, uint64_t geometryId = 0)
+        {
+            if (!claimed_)
+                throw std::logic_error("frame_ring_writer: no frame was claimed");
+
+            auto& h = header();
+            const uint64_t n = h.published.load(std::memory_order_relaxed) + 1;
+
+            auto* slot = slotOf(n);
+            slot->view = view;
+            slot->geometryId = geometryId;
+
+            slot->sequence.store(2 * n, std::memory_order_release);
+            h.published.store(n, std::memory_order_release);
+            claimed_ = false;
+        }
+
+        /// Copy a frame of cols * rows values into the next slot and make it visible to readers
+        void publish(size_t view, const float* pixels, uint64_t geometryId = 0)
+        {
+            std::memcpy(claim(), pixels, cols() * rows() * sizeof(float));
+            commit(view, geometryId);
+        }
+
+        /// Signal the end of the acquisition, readers finish the frames still in the ring
+        void close() { header().closed.store(1, std::memory_order_release); }
+
+    private:
+        details::frame_ring_header& header() const { return *reinterpret_cast<details::frame_ring_header*>(shm_.data()); }
+
+        void closeRing()
+        {
+            if (shm_.data())
+                close();
+        }
+
+        details::frame_slot_header* slotOf(uint64_t n) const
+        {
+            auto& h = header();
+            return reinterpret_cast<details::frame_slot_header*>(shm_.data() + h.slotOffset + ((n - 1) % h.slotCount) * h.slotStride);
+        }
+
+        details::shm_mapping shm_;
+        bool claimed_ = false;
+    };
+
+    /// Metadata of a frame taken from a ring
+    struct frame_info {
+        uint64_t sequence; // Counting from 1 in the order of publication
+        size_t view;
+        uint64_t geometryId;
+    };
+
+    class frame_ring_reader;
+
+    /**
+     * A frame in place in the shared memory of a ring, no copy involved. With the overwrite policy the writer may
+     * reuse the slot at any time, release() tells whether that happened while the frame was in use, and everything
+     * computed from it has to be discarded then. With the block policy the slot is kept until the frame is released.
+     * Frames have to be released in the order they were acquired, destruction releases as well.
+     */
+    class frame_view
+    {
+    public:
+        frame_view(const frame_view&) = delete;
+        frame_view& operator=(const frame_view&) = delete;
+
+        frame_view(frame_view&& other) noexcept
+            : reader_(std::exchange(other.reader_, nullptr)), slot_(other.slot_), pixels_(other.pixels_), info_(other.info_)
+        {
+        }
+
+        frame_view& operator=(frame_view&& other) noexcept
+        {
+            if (this != &other) {
+                release();
+                reader_ = std::exchange(other.reader_, nullptr);
+                slot_ = other.slot_;
+                pixels_ = other.pixels_;
+                info_ = other.info_;
+            }
+            return *this;
+        }
+
+        ~frame_view() { release(); }
+
+        const frame_info& info() const { return info_; }
+
+        /// cols * rows pixels of the frame, 64 byte aligned
+        const float* data() const { return pixels_; }
+
+        /// True as long as the writer did not start to overwrite the frame
+        bool valid() const { return slot_->sequence.load(std::memory_order_acquire) == 2 * info_.sequence; }
+
+        /// Give the slot back to the writer, returns false if the frame was overwritten in the meantime
+        inline bool release();
+
+    private:
+        friend class frame_ring_reader;
+
+        frame_view(frame_ring_reader* reader, const details::frame_slot_header* slot, const float* pixels, const frame_info& info)
+            : reader_(reader), slot_(slot), pixels_(pixels), info_(info)
+        {
+        }
+
+        frame_ring_reader* reader_ = nullptr; // Null once released
+        const details::frame_slot_header* slot_;
+        const float* pixels_;
+        frame_info info_;
+    };
+
+    /**
+     * Consumer side of a frame ring, usually in the reconstruction process. Frames are read in order of publication,
+     * starting with the oldest one still in the ring. Frames overwritten before or while they were read are skipped and
+     * counted in dropped(). acquire() hands out frames in place, read() copies them.
+     */
+    class frame_ring_reader
+    {
+    public:
+        explicit frame_ring_reader(const std::string& name) : shm_(name, false, 0)
+        {
+            if (shm_.size() < sizeof(details::frame_ring_header))
+                throw std::runtime_error("frame_ring_reader: " + name + " is not a frame ring");
+
+            auto& h = header();
+            if (h.magic.load(std::memory_order_acquire) != details::frame_ring_magic || h.version != details::frame_ring_version)
+                throw std::runtime_error("frame_ring_reader: " + name + " is not a frame ring or has an incompatible version");
+
+            if (shm_.size() < h.slotOffset + h.slotCount * h.slotStride)
+                throw std::runtime_error("frame_ring_reader: " + name + " is truncated");
+
+            // A blocking ring continues where the previous reader stopped
+            const uint64_t published = h.published.load(std::memory_order_acquire);
+            next_ = published > h.slotCount ? published - h.slotCount + 1 : 1;
+            if (policy() == ring_policy::block)
+                next_ = std::max(next_, h.released.load(std::memory_order_acquire) + 1);
+        }
+
+        frame_ring_reader(const frame_ring_reader&) = delete;
+        frame_ring_reader& operator=(const frame_ring_reader&) = delete;
+
+        size_t cols() const { return header().cols; }
+        size_t rows() const { return header().rows; }
+        size_t pixelsPerFrame() const { return cols() * rows(); }
+        ring_policy policy() const { return static_cast<ring_policy>(header().policy); }
+
+        /// Frames overwritten by the writer before they were read, or while they were in use
+        uint64_t dropped() const { return dropped_; }
+
+        /// The next frame in place, returns nothing if no new frame is available
+        std::optional<frame_view> tryAcquire()
+        {
+            auto& h = header();
+
+            for (;;) {
+                const uint64_t published = h.published.load(std::memory_order_acquire);
+                if (next_ > published)
+                    return std::nullopt;
+
+                // Lapped by the writer, continue with the oldest frame still there
+                if (published - next_ >= h.slotCount) {
+                    dropped_ += published - h.slotCount + 1 - next_;
+                    next_ = published - h.slotCount + 1;
+                }
+
+                auto* slot = slotOf(next_);
+                const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+                if (sequence != 2 * next_) {
+                    // Already being overwritten, try again with the new published count
+                    ++dropped_;
+                    ++next_;
+                    continue;
+                }
+
+                frame_info info{ next_, static_cast<size_t>(slot->view), slot->geometryId };
+                auto* pixels = reinterpret_cast<const float*>(reinterpret_cast<const char*>(slot) + details::frame_slot_data);
+
+                ++next_;
+                return frame_view(this, slot, pixels, info);
+            }
+        }
+
+        /**
+         * The next frame in place, waiting for it if necessary. Returns nothing once the writer closed the ring and all
+         * frames are read, or after the timeout passed without a new frame.
+         */
+        std::optional<frame_view> acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            for (unsigned spins = 0;; ++spins) {
+                if (auto frame = tryAcquire())
+                    return frame;
+
+                // Frames published before closing are still delivered
+                if (header().closed.load(std::memory_order_acquire))
+                    return tryAcquire();
+
+                if (timeout != std::chrono::milliseconds::max() && std::chrono::steady_clock::now() - start >= timeout)
+                    return std::nullopt;
+
+                details::ring_backoff(spins);
+            }
+        }
+
+        /// Copy the next frame (cols * rows values) to dst, returns nothing if no new frame is available
+        std::optional<frame_info> tryRead(float* dst)
+        {
+            while (auto frame = tryAcquire()) {
+                std::memcpy(dst, frame->data(), pixelsPerFrame() * sizeof(float));
+                if (frame->release())
+                    return frame->info();
+            }
+            return std::nullopt;
+        }
+
+        /// Copy the next frame to dst, waiting for it if necessary, see acquire()
+        std::optional<frame_info> read(float* dst, std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+        {
+            while (auto frame = acquire(timeout)) {
+                std::memcpy(dst, frame->data(), pixelsPerFrame() * sizeof(float));
+                if (frame->release())
+                    return frame->info();
+            }
+            return std::nullopt;
+        }
+
+        bool closed() const { return header().closed.load(std::memory_order_acquire) != 0; }
+
+    private:
+        friend class frame_view;
+
+        details::frame_ring_header& header() const { return *reinterpret_cast<details::frame_ring_header*>(shm_.data()); }
+
+        details::frame_slot_header* slotOf(uint64_t n) const
+        {
+            auto& h = header();
+            return reinterpret_cast<details::frame_slot_header*>(shm_.data() + h.slotOffset + ((n - 1) % h.slotCount) * h.slotStride);
+        }
+
+        bool release(const frame_view& frame)
+        {
+            // Check before handing the slot back, afterwards the writer may legitimately reuse it
+            const bool valid = frame.valid();
+            if (!valid)
+                ++dropped_;
+
+            header().released.store(frame.info().sequence, std::memory_order_release);
+            return valid;
+        }
+
+        details::shm_mapping shm_;
+        uint64_t next_ = 1;
+        uint64_t dropped_ = 0;
+    };
+
+    bool frame_view::release()
+    {
+        if (!reader_)
+            return true;
+
+        // Pixels have to be read completely before the sequence is checked again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return std::exchange(reader_, nullptr)->release(*this);
+    }
+} // namespace tomosect
@@ -239,6 +239,31 @@ public:
         normal_ = calcNormal();
     }
 
+    /**
+     * Rectangle given by its center and the two (full length) edge vectors, local x runs along u and local y along v.
+     * Useful for trajectories, where the detector frame is known directly.
+     */
+    rectangle(const point2<Value>& pixels, const point3<Value>& center, const vec3<Value>& u, const vec3<Value>& v)
+        : pixels_(pixels), m_(), inv_(), normal_(0)
+    {
+        auto origin = center.data() - (u.data() + v.data()) * Scalar{ 0.5 };
+        auto n = enoki::normalize(enoki::cross(u.data(), v.data()));
+
+        m_ = Matrix4x4::from_rows(Vector4{ u.x(), v.x(), n.x(), origin.x() }, Vector4{ u.y(), v.y(), n.y(), origin.y() },
+                                  Vector4{ u.z(), v.z(), n.z(), origin.z() }, Vector4{ 0, 0, 0, 1 });
+        inv_ = enoki::inverse(m_);
+        normal_ = calcNormal();
+    }
+
+    /**
+     * Rectangle given by both of its matrices, local to global and global to local, which have to be inverse to each
+     * other. For callers computing many frames at once, e.g. pose_batch, without a matrix inversion per rectangle.
+     */
+    rectangle(const point2<Value>& pixels, const Matrix4x4& m, const Matrix4x4& inv)
+        : pixels_(pixels), m_(m), inv_(inv), normal_(calcNormal())
+    {
+    }
+
     rectangle(const point2<Value>& pixels, const point2<Value>& t, const vec2<Value>& s) : pixels_(pixels), m_(), inv_(), normal_(0)
     {
         /*enoki::Array<Value, 3> tmp_scale = enoki::concat(1 / s.data(),
@@ -289,6 +314,16 @@ public:
         return point3<Value>(m_ * enoki::concat(pixelCenter, enoki::Array<Value, 2>{ 0, 1 }));
     }
 
+    /**
+     * Inverse of coordFromLocal: x and y are the continuous pixel coordinates of p (pixel centers at whole numbers), z
+     * is the offset of p from the plane in local units.
+     */
+    point3<Value> localFromCoord(const point3<Value>& p) const
+    {
+        auto local = inv_ * enoki::concat(p.data(), enoki::Array<Value, 1>{ 1 });
+        return point3<Value>(local.x() * pixels_.x() - Value{ 0.5 }, local.y() * pixels_.y() - Value{ 0.5 }, local.z());
+    }
+
     point3<Value> min() const { return point3<Value>(m_ * enoki::Array<Value, 4>{ 0, 0, 0, 1 }); }
 
     point3<Value> max() const { return point3<Value>(m_ * enoki::Array<Value, 4>{ 1, 1, 0, 1 }); }
@@ -297,6 +332,8 @@ public:
 
     vec3<Value> normal() const { return normal_; }
 
+    point2<Value> pixels() const { return pixels_; }
+
 private:
     vec3<Value> calcNormal() const
     {
@@ -394,6 +431,8 @@ public:
 
     auto angle() const { return theta_.to_radian(); }
 
+    point2<Value> pixels() const { return pixels_; }
+
     template <typename Vec>
     Vec toLocal(const Vec& p) const
     {
@@ -0,0 +1,214 @@
+/**
+ *
+ * \file helical.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /// Views [begin, end) of a trajectory
+    struct view_range {
+        size_t begin, end;
+
+        size_t size() const { return end - begin; }
+    };
+
+    /**
+     * Helical cone beam trajectory around the z-axis: source and flat detector rotate as for circular_trajectory, while
+     * the table moves the object by feed along z per turn. In the frame of the object source and detector move by -feed,
+     * which is the same helix with the opposite sign, so feed is given as the z-shift of source and detector per turn.
+     * View k is at angle startAngle + k * step() and height startZ + k * feed / viewsPerTurn.
+     */
+    template <typename Scalar>
+    struct helical_trajectory {
+        size_t numViews;
+        Scalar sourceDistance;   // Source to rotation axis
+        Scalar detectorDistance; // Rotation axis to detector center
+        size_t cols;
+        size_t rows;
+        Scalar pixelWidth;
+        Scalar pixelHeight;
+        size_t viewsPerTurn;
+        Scalar feed; // Rise of source and detector per turn
+        Scalar startAngle = 0;
+        Scalar startZ = 0;
+
+        /// Angle step between two consecutive views
+        Scalar step() const { return static_cast<Scalar>(2 * M_PI) / static_cast<Scalar>(viewsPerTurn); }
+
+        Scalar angle(size_t k) const { return startAngle + static_cast<Scalar>(k) * step(); }
+
+        /// Height of source and detector center of view k
+        Scalar height(size_t k) const { return startZ + static_cast<Scalar>(k) * feed / static_cast<Scalar>(viewsPerTurn); }
+
+        /// Feed per turn relative to the height of the detector scaled to the rotation axis
+        Scalar pitch() const
+        {
+            return feed * (sourceDistance + detectorDistance) / (sourceDistance * pixelHeight * static_cast<Scalar>(rows));
+        }
+
+        /// Pose at an arbitrary angle, the height follows from the angle
+        projection_view<Scalar> viewAt(Scalar phi) const
+        {
+            const auto c = std::cos(phi);
+            const auto s = std::sin(phi);
+            const auto z = startZ + feed * (phi - startAngle) / static_cast<Scalar>(2 * M_PI);
+
+            auto source = point3<Scalar>(sourceDistance * c, sourceDistance * s, z);
+            auto center = point3<Scalar>(-detectorDistance * c, -detectorDistance * s, z);
+            auto u = vec3<Scalar>(-s * pixelWidth * cols, c * pixelWidth * cols, 0);
+            auto v = vec3<Scalar>(0, 0, pixelHeight * rows);
+
+            return { source, rectangle<Scalar>(point2<Scalar>(static_cast<Scalar>(cols), static_cast<Scalar>(rows)), center, u, v) };
+        }
+
+        projection_view<Scalar> view(size_t k) const { return viewAt(angle(k)); }
+
+        std::vector<projection_view<Scalar>> views() const
+        {
+            std::vector<projection_view<Scalar>> result;
+            result.reserve(numViews);
+            for (size_t k = 0; k < numViews; ++k)
+                result.push_back(view(k));
+            return result;
+        }
+
+        /**
+         * Views that may illuminate a point at height z and distance radius from the rotation axis: all views whose
+         * detector rows, including the border used by bilinear interpolation, can reach the point. The distance of the
+         * point from the source is at most sourceDistance + radius, which bounds the height difference to the source
+         * independent of the angle. All views if there is no feed.
+         */
+        view_range viewWindow(Scalar z, Scalar radius) const
+        {
+            if (feed == 0)
+                return { 0, numViews };
+
+            const Scalar reach =
+                (static_cast<Scalar>(rows) + 1) / 2 * pixelHeight * (sourceDistance + radius) / (sourceDistance + detectorDistance);
+            const Scalar rise = feed / static_cast<Scalar>(viewsPerTurn);
+
+            Scalar first = (z - reach - startZ) / rise;
+            Scalar last = (z + reach - startZ) / rise;
+            if (first > last)
+                std::swap(first, last);
+
+            const auto n = static_cast<Scalar>(numViews);
+            const auto begin = static_cast<size_t>(std::clamp(std::floor(first), Scalar{ 0 }, n));
+            const auto end = static_cast<size_t>(std::clamp(std::floor(last) + 1, Scalar{ 0 }, n));
+            return { begin, std::max(begin, end) };
+        }
+
+        view_range viewWindow(const point3<Scalar>& p) const { return viewWindow(p.z(), std::sqrt(p.x() * p.x() + p.y() * p.y())); }
+    };
+
+    /**
+     * Voxel driven backprojection of a helical scan into a box of voxels of the grid, with the interpolation and
+     * weighting of the circular backproject. Each line of voxels along x only visits the views of its view window,
+     * about 1 / pitch turns, instead of all of them. filtered holds all views with whole detectors. If counts is given,
+     * the number of views in which a voxel projects onto the detector rows is added to it, one value per voxel.
+     */
+    template <typename Scalar>
+    void backproject(const helical_trajectory<Scalar>& trajectory, const projection_stack<float>& filtered, Scalar scale,
+                     const voxel_grid<Scalar>& grid, const voxel_box& box, float* output, float* counts = nullptr)
+    {
+        if (filtered.cols() != trajectory.cols || filtered.rows() != trajectory.rows || filtered.numViews() != trajectory.numViews)
+            throw std::invalid_argument("backproject: projections do not match the trajectory");
+
+        std::vector<projection_matrix<Scalar>> matrices;
+        matrices.reserve(trajectory.numViews);
+        for (size_t k = 0; k < trajectory.numViews; ++k)
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+
+        const size_t nx = box.nx();
+        const size_t ny = box.ny();
+        const auto first = grid.voxelCenter(box.xBegin, box.yBegin, box.zBegin);
+        const auto h = grid.spacing();
+        const auto lastX = first.x() + static_cast<Scalar>(nx - 1) * h.x();
+        const auto rowLimit = static_cast<Scalar>(trajectory.rows) - Scalar(0.5);
+
+        parallel_for(0, ny * box.nz(), [&](size_t line) {
+            size_t y = line % ny;
+            size_t z = line / ny;
+            float* out = output + line * nx;
+
+            Scalar wy = first.y() + static_cast<Scalar>(y) * h.y();
+            Scalar wz = first.z() + static_cast<Scalar>(z) * h.z();
+
+            // The distance from the axis along the line is largest at one of its ends
+            const Scalar radius = std::sqrt(std::max(first.x() * first.x(), lastX * lastX) + wy * wy);
+            const auto window = trajectory.viewWindow(wz, radius);
+
+            for (size_t k = window.begin; k < window.end; ++k)
+                details::backproject_line(matrices[k], filtered_rows{ filtered.view(k), 0, trajectory.rows }, trajectory.cols, scale,
+                                          first.x(), h.x(), wy, wz, nx, out);
+
+            if (!counts)
+                return;
+
+            float* count = counts + line * nx;
+            for (size_t k = window.begin; k < window.end; ++k) {
+                const auto& P = matrices[k];
+                const auto start = P.project(first.x(), wy, wz);
+                for (size_t x = 0; x < nx; ++x) {
+                    const Scalar v = start[1] + static_cast<Scalar>(x) * P.rows[1][0] * h.x();
+                    const Scalar w = start[2] + static_cast<Scalar>(x) * P.rows[2][0] * h.x();
+                    const Scalar row = v / w;
+                    if (row >= Scalar(-0.5) && row < rowLimit)
+                        count[x] += 1;
+                }
+            }
+        });
+    }
+
+    /**
+     * Approximate FDK reconstruction of a helical scan: rows are weighted and ramp filtered as for a circular scan, and
+     * every voxel is backprojected from the views that illuminate it. The backprojection is normalized by the angle
+     * over which each voxel is seen, so voxels seen for more than a turn are averaged over their redundant views.
+     * Accurate for small cone angles and pitches up to about 1, voxels never on the detector stay zero.
+     */
+    template <typename Scalar, typename T>
+    volume<float> helical_fdk(const helical_trajectory<Scalar>& trajectory, const projection_stack<T>& projections,
+                              const voxel_grid<Scalar>& grid)
+    {
+        if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows || projections.numViews() != trajectory.numViews)
+            throw std::invalid_argument("helical_fdk: projections do not match the trajectory");
+
+        // Weights and filter only depend on the detector and the distances
+        const circular_trajectory<Scalar> turn{ trajectory.viewsPerTurn, trajectory.sourceDistance, trajectory.detectorDistance,
+                                                trajectory.cols,         trajectory.rows,           trajectory.pixelWidth,
+                                                trajectory.pixelHeight };
+        fdk_filter<Scalar> filter(turn);
+        projection_stack<float> filtered(trajectory.cols, trajectory.rows, trajectory.numViews);
+
+        parallel_for(0, trajectory.numViews,
+                     [&](size_t k) { filter.filterRows(projections.view(k), filtered.view(k), 0, trajectory.rows); });
+
+        // FDK weights a full turn of N views with pi / N * sourceDistance^2, N is the number of views seeing the voxel
+        const Scalar scale = static_cast<Scalar>(M_PI) * trajectory.sourceDistance * trajectory.sourceDistance;
+        volume<float> result(grid.nx(), grid.ny(), grid.nz());
+        std::vector<float> counts(result.size());
+        backproject(trajectory, filtered, scale, grid, voxel_box{ 0, grid.nx(), 0, grid.ny(), 0, grid.nz() }, result.data(), counts.data());
+
+        float* data = result.data();
+        for (size_t i = 0; i < counts.size(); ++i)
+            data[i] = counts[i] > 0 ? data[i] / counts[i] : 0.f;
+        return result;
+    }
+} // namespace tomosect
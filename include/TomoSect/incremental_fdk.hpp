@@ -0,0 +1,188 @@
+/**
+ *
+ * \file incremental_fdk.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/frame_ring.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /// Copy of a partial reconstruction and the number of views it contains
+    struct fdk_snapshot {
+        volume<float> data;
+        size_t views;
+    };
+
+    /**
+     * FDK reconstruction that is updated while the scan is running: projections are added one at a time or in small
+     * batches, in any order, and backprojected into a persistent volume right away. Views are weighted as part of the
+     * full scan, so once all views were added, the volume equals the one of fdk().
+     *
+     * Filtering runs outside of any lock, backprojection and snapshot() are mutually exclusive, so a snapshot always
+     * contains complete views only. add() and snapshot() may be called from different threads.
+     */
+    template <typename Scalar>
+    class incremental_fdk
+    {
+    public:
+        incremental_fdk(const circular_trajectory<Scalar>& trajectory, const voxel_grid<Scalar>& grid)
+            : trajectory_(trajectory), grid_(grid), filter_(trajectory), volume_(grid.nx(), grid.ny(), grid.nz())
+        {
+            for (size_t k = 0; k < trajectory.numViews; ++k)
+                matrices_.push_back(trajectory.view(k).projectionMatrix());
+        }
+
+        const circular_trajectory<Scalar>& trajectory() const { return trajectory_; }
+        const voxel_grid<Scalar>& grid() const { return grid_; }
+
+        /// Add a single projection (cols * rows values) of the given view
+        void add(size_t view, const float* projection) { add({ { view, projection } }); }
+
+        /// Add a batch of projections, filtered in parallel and backprojected together
+        void add(const std::vector<std::pair<size_t, const float*>>& projections)
+        {
+            for (const auto& p : projections)
+                checkView(p.first);
+
+            std::vector<float> filtered(projections.size() * pixels());
+            parallel_for(0, projections.size(), [&](size_t i) { filter(projections[i].second, filtered.data() + i * pixels()); });
+
+            std::vector<size_t> views;
+            for (const auto& p : projections)
+                views.push_back(p.first);
+            addFiltered(views, filtered.data());
+        }
+
+        /**
+         * Add frames from a shared memory ring until the writer closes it, batchSize frames at a time if that many are
+         * waiting. Frames are filtered straight out of the shared memory, without copying them first. Frames overwritten
+         * by the writer while they were filtered are dropped, just like frames with a different geometry id, if one is
+         * given. Returns the number of frames added.
+         */
+        size_t ingest(frame_ring_reader& ring, size_t batchSize = 4, std::optional<uint64_t> geometryId = std::nullopt)
+        {
+            if (ring.cols() != trajectory_.cols || ring.rows() != trajectory_.rows)
+                throw std::invalid_argument("incremental_fdk: frame size does not match the trajectory");
+
+            batchSize = std::max<size_t>(1, batchSize);
+
+            std::vector<float> filtered(batchSize * pixels());
+            std::vector<frame_view> frames;
+            std::vector<size_t> views;
+            size_t count = 0;
+
+            while (auto first = ring.acquire()) {
+                frames.clear();
+                frames.push_back(std::move(*first));
+
+                while (frames.size() < batchSize) {
+                    auto next = ring.tryAcquire();
+                    if (!next)
+                        break;
+                    frames.push_back(std::move(*next));
+                }
+
+                parallel_for(0, frames.size(), [&](size_t i) { filter(frames[i].data(), filtered.data() + i * pixels()); });
+
+                // Compact the frames that were still intact after filtering
+                views.clear();
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    const auto info = frames[i].info();
+                    if (!frames[i].release() || (geometryId && info.geometryId != *geometryId))
+                        continue;
+
+                    checkView(info.view);
+                    if (views.size() != i)
+                        std::copy_n(filtered.data() + i * pixels(), pixels(), filtered.data() + views.size() * pixels());
+                    views.push_back(info.view);
+                }
+
+                addFiltered(views, filtered.data());
+                count += views.size();
+            }
+
+            return count;
+        }
+
+        /// Number of views added so far
+        size_t views() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return views_;
+        }
+
+        /// Copy of the current reconstruction, never containing a partially backprojected view
+        fdk_snapshot snapshot() const
+        {
+            volume<float> copy(grid_.nx(), grid_.ny(), grid_.nz());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::copy(volume_.data(), volume_.data() + volume_.size(), copy.data());
+            return { copy, views_ };
+        }
+
+        /// Start over with an empty volume
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::fill(volume_.data(), volume_.data() + volume_.size(), 0.f);
+            views_ = 0;
+        }
+
+    private:
+        size_t pixels() const { return trajectory_.cols * trajectory_.rows; }
+
+        void checkView(size_t view) const
+        {
+            if (view >= trajectory_.numViews)
+                throw std::out_of_range("incremental_fdk: view " + std::to_string(view) + " is not part of the trajectory");
+        }
+
+        void filter(const float* projection, float* filtered) const { filter_.filterRows(projection, filtered, 0, trajectory_.rows); }
+
+        /// Backproject already filtered projections, stored one after the other
+        void addFiltered(const std::vector<size_t>& views, const float* filtered)
+        {
+            if (views.empty())
+                return;
+
+            std::vector<projection_matrix<Scalar>> matrices;
+            std::vector<filtered_rows> rows;
+            for (size_t i = 0; i < views.size(); ++i) {
+                matrices.push_back(matrices_[views[i]]);
+                rows.push_back({ filtered + i * pixels(), 0, trajectory_.rows });
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            backproject(matrices, rows, trajectory_.cols, fdk_scale(trajectory_), grid_, 0, grid_.nz(), volume_.data());
+            views_ += views.size();
+        }
+
+        circular_trajectory<Scalar> trajectory_;
+        voxel_grid<Scalar> grid_;
+        fdk_filter<Scalar> filter_;
+        std::vector<projection_matrix<Scalar>> matrices_;
+
+        mutable std::mutex mutex_; // Guards volume_ and views_
+        volume<float> volume_;
+        size_t views_ = 0;
+    };
+} // namespace tomosect
@@ -18,13 +18,40 @@ struct ray_curved_rectangle_intersection {
 };
 struct ray_aabb_intersection {
 };
+struct ray_aabb_interval {
+};
 
 // Intersection result, return a point and a mask, for valid hits
 template <typename Value>
 using IntersectionResult = std::tuple<point3<Value>, typename point3<Value>::Mask>;
 
+// Interval result, return the entry and exit distance along the ray and a mask, for valid hits
 template <typename Value>
-IntersectionResult<Value> intersection(const ray<Value>& ray, const aabb<Value>& aabb, ray_aabb_intersection)
+using IntervalResult = std::tuple<Value, Value, typename point3<Value>::Mask>;
+
+/**
+ * Real roots t0 <= t1 of a * t^2 + b * t + c = 0, the mask is set where there are two distinct ones. The roots are
+ * computed as q / a and c / q with q = -(b + sign(b) * sqrt(b^2 - 4ac)) / 2, which avoids the cancellation of the
+ * textbook formula for rays passing far from the surface.
+ */
+template <typename Value>
+IntervalResult<Value> quadratic_roots(const Value& a, const Value& b, const Value& c)
+{
+    using mask_t = typename point3<Value>::Mask;
+
+    Value determinant = b * b - 4 * a * c;
+    mask_t mask = determinant > 0;
+
+    Value root = enoki::sqrt(enoki::max(determinant, Value{ 0 }));
+    Value q = Value{ -0.5 } * (b + enoki::select(b < 0, -root, root));
+
+    Value r0 = q / a;
+    Value r1 = c / q;
+    return { enoki::min(r0, r1), enoki::max(r0, r1), mask };
+}
+
+template <typename Value>
+IntervalResult<Value> intersection(const ray<Value>& ray, const aabb<Value>& aabb, ray_aabb_interval)
 {
     using mask_t = typename point3<Value>::Mask;
 
@@ -43,6 +70,14 @@ IntersectionResult<Value> intersection(const ray<Value>& ray, const aabb<Value>&
 
     mask_t mask = tmin < tmax;
 
+    return { tmin, tmax, mask };
+}
+
+template <typename Value>
+IntersectionResult<Value> intersection(const ray<Value>& ray, const aabb<Value>& aabb, ray_aabb_intersection)
+{
+    auto [tmin, tmax, mask] = intersection(ray, aabb, ray_aabb_interval{});
+
     auto tmp = point3<Value>(ray.origin().data() + ray.dir().data() * tmin);
     return { tmp, mask };
 }
@@ -76,15 +111,10 @@ IntersectionResult<Value> intersection(const ray<Value>& ray, const curved_recta
     auto b = 2 * rd.x() * ro.x() + 2 * rd.z() * ro.z();
     auto c = enoki::dot(ro2d, ro2d) - Value{ 1 };
 
-    auto determinant = enoki::pow(b, 2) - (4 * a * c);
-
-    // Solve quadratic equation
-    auto t1 = enoki::select(determinant > 0, (-b + enoki::sqrt(determinant)) / (2 * a), -1);
-    auto t2 = enoki::select(determinant > 0, (-b - enoki::sqrt(determinant)) / (2 * a), -1);
-
-    // find minimum
-    auto tmin = enoki::min(t1, t2);
-    auto tmax = enoki::max(t1, t2);
+    // Solve quadratic equation, misses get -1
+    auto [r0, r1, solved] = quadratic_roots<Value>(a, b, c);
+    auto tmin = enoki::select(solved, r0, Value{ -1 });
+    auto tmax = enoki::select(solved, r1, Value{ -1 });
 
     // take max, if min value is smaller than 0
     auto t = enoki::select(tmin > 0, tmin, tmax);
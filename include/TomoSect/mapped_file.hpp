@@ -0,0 +1,210 @@
+/**
+ *
+ * \file mapped_file.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tomosect
+{
+    /// Expected access pattern of a mapping, passed on to the OS as read-ahead hint
+    enum class map_access { normal, sequential, random };
+
+    enum class map_mode {
+        read_only,     // Pages are shared with the page cache and can not be written
+        copy_on_write, // Writes are private to the process, the file stays untouched
+        read_write     // Writes go to the file
+    };
+
+    struct map_options {
+        map_access access = map_access::normal;
+        map_mode mode = map_mode::read_only;
+
+        /// Ask for transparent huge pages. Best effort, depends on kernel and file system support.
+        bool hugePages = false;
+
+        /// Start reading the whole file in the background right away
+        bool prefetch = false;
+    };
+
+    /**
+     * Pass an access hint for the given address range on to the OS. The range is widened to whole pages, errors are
+     * ignored, as hints are never required for correctness.
+     */
+    inline void advise(const void* addr, size_t length, map_access access)
+    {
+        if (length == 0)
+            return;
+
+        auto page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        auto begin = reinterpret_cast<uintptr_t>(addr) & ~(page - 1);
+        auto end = reinterpret_cast<uintptr_t>(addr) + length;
+
+        int advice = access == map_access::sequential ? MADV_SEQUENTIAL : access == map_access::random ? MADV_RANDOM : MADV_NORMAL;
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+    }
+
+    /// Ask the OS to start reading the given address range, without waiting for it
+    inline void prefetch(const void* addr, size_t length)
+    {
+        if (length == 0)
+            return;
+
+        auto page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        auto begin = reinterpret_cast<uintptr_t>(addr) & ~(page - 1);
+        auto end = reinterpret_cast<uintptr_t>(addr) + length;
+
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+    }
+
+    /**
+     * Memory mapping of a whole file (POSIX). Pages are loaded lazily by the OS on first access, so mapping even very
+     * large files is cheap. Move-only, the mapping is released on destruction.
+     */
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+
+        explicit mapped_file(const std::string& path, const map_options& options = {})
+        {
+            int flags = options.mode == map_mode::read_write ? O_RDWR : O_RDONLY;
+            int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "mapped_file: cannot open " + path);
+
+            struct stat st {
+            };
+            if (::fstat(fd, &st) != 0) {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "mapped_file: cannot stat " + path);
+            }
+
+            map(fd, static_cast<size_t>(st.st_size), options, path);
+        }
+
+        /// Create (or truncate) a file of the given size and map it writable
+        static mapped_file create(const std::string& path, size_t size, map_options options = {})
+        {
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "mapped_file: cannot create " + path);
+
+            if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "mapped_file: cannot resize " + path);
+            }
+
+            options.mode = map_mode::read_write;
+
+            mapped_file file;
+            file.map(fd, size, options, path);
+            return file;
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+              writable_(std::exchange(other.writable_, false))
+        {
+        }
+
+        mapped_file& operator=(mapped_file&& other) noexcept
+        {
+            if (this != &other) {
+                unmap();
+                data_ = std::exchange(other.data_, nullptr);
+                size_ = std::exchange(other.size_, 0);
+                writable_ = std::exchange(other.writable_, false);
+            }
+            return *this;
+        }
+
+        ~mapped_file() { unmap(); }
+
+        const void* data() const { return data_; }
+
+        /// Writable pointer to the mapping, only valid for copy_on_write and read_write mappings
+        void* mutableData() const { return writable_ ? data_ : nullptr; }
+
+        size_t size() const { return size_; }
+
+        /// Typed pointer to the given byte offset in the file
+        template <typename T>
+        const T* at(size_t offset) const
+        {
+            return reinterpret_cast<const T*>(static_cast<const char*>(data_) + offset);
+        }
+
+        /// Write modified pages of a read_write mapping back to the file and wait for it
+        void flush() const
+        {
+            if (data_ && ::msync(data_, size_, MS_SYNC) != 0)
+                throw std::system_error(errno, std::generic_category(), "mapped_file: cannot sync");
+        }
+
+    private:
+        void map(int fd, size_t size, const map_options& options, const std::string& path)
+        {
+            size_ = size;
+
+            if (size_ > 0) {
+                int prot = options.mode == map_mode::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+                int flags = options.mode == map_mode::read_write ? MAP_SHARED : MAP_PRIVATE;
+
+                void* ptr = ::mmap(nullptr, size_, prot, flags, fd, 0);
+                if (ptr == MAP_FAILED) {
+                    int err = errno;
+                    ::close(fd);
+                    size_ = 0;
+                    throw std::system_error(err, std::generic_category(), "mapped_file: cannot map " + path);
+                }
+                data_ = ptr;
+                writable_ = options.mode != map_mode::read_only;
+
+                advise(data_, size_, options.access);
+
+#ifdef MADV_HUGEPAGE
+                if (options.hugePages)
+                    ::madvise(data_, size_, MADV_HUGEPAGE);
+#endif
+                if (options.prefetch)
+                    prefetch(data_, size_);
+            }
+
+            // The mapping stays valid after closing the descriptor
+            ::close(fd);
+        }
+
+        void unmap()
+        {
+            if (data_)
+                ::munmap(data_, size_);
+            data_ = nullptr;
+            size_ = 0;
+            writable_ = false;
+        }
+
+        void* data_ = nullptr;
+        size_t size_ = 0;
+        bool writable_ = false;
+    };
+} // namespace tomosect
@@ -0,0 +1,444 @@
+/**
+ *
+ * \file mesh.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/bvh.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /// Crossing of a ray with the surface of a mesh
+    template <typename Scalar>
+    struct mesh_crossing {
+        Scalar t;
+        uint32_t triangle;
+        bool entering; // The ray passes from the outside to the inside
+    };
+
+    /// Stretch of a ray inside a mesh
+    template <typename Scalar>
+    struct mesh_interval {
+        Scalar tEnter;
+        Scalar tExit;
+    };
+
+    namespace details
+    {
+        /// Triangle prepared for the ray test: vertices, normal (not normalized) and the edges stored against canonical order
+        template <typename Scalar>
+        struct mesh_triangle {
+            Scalar v[3][3];
+            Scalar n[3];
+            uint8_t swapped; // Bit k is set if edge v[k] -> v[k + 1] runs against the canonical (lexicographic) order
+        };
+
+        template <typename Scalar>
+        mesh_triangle<Scalar> prepare_triangle(const std::array<Scalar, 3>& a, const std::array<Scalar, 3>& b,
+                                               const std::array<Scalar, 3>& c)
+        {
+            mesh_triangle<Scalar> tri{};
+            const std::array<Scalar, 3>* v[3] = { &a, &b, &c };
+            for (int k = 0; k < 3; ++k) {
+                for (int i = 0; i < 3; ++i)
+                    tri.v[k][i] = (*v[k])[i];
+                if (*v[(k + 1) % 3] < *v[k])
+                    tri.swapped |= static_cast<uint8_t>(1 << k);
+            }
+
+            const Scalar e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const Scalar e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            tri.n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            tri.n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            tri.n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            return tri;
+        }
+
+        template <typename Value>
+        struct triangle_hit {
+            Value t;
+            typename point3<Value>::Mask mask;
+            typename point3<Value>::Mask entering;
+        };
+
+        /**
+         * Ray triangle test for all lanes of the ray against one triangle, only hits in front of the origin count.
+         *
+         * The ray passes an edge (p, q) on the side given by the sign of dot(d, (p - o) x (q - o)). Each edge function is
+         * evaluated with the endpoints in canonical order and negated afterwards if needed, so neighbouring triangles get
+         * bit identical values for their shared edge. Zeros, i.e. rays through edges or vertices, are decided as if the
+         * origin was moved by (e, e^2, e^3) for an infinitesimal e (simulation of simplicity). That is consistent for all
+         * triangles, so a ray crosses a closed mesh exactly once at every edge or vertex it passes.
+         */
+        template <typename Value, typename Scalar>
+        triangle_hit<Value> intersect_triangle(const Value o[3], const Value d[3], const mesh_triangle<Scalar>& tri)
+        {
+            using Mask = typename point3<Value>::Mask;
+
+            Mask front = Mask(true), back = Mask(true);
+            for (int k = 0; k < 3; ++k) {
+                const bool swapped = (tri.swapped >> k) & 1;
+                const Scalar* p = tri.v[swapped ? (k + 1) % 3 : k];
+                const Scalar* q = tri.v[swapped ? k : (k + 1) % 3];
+
+                const Value a[3] = { p[0] - o[0], p[1] - o[1], p[2] - o[2] };
+                const Value b[3] = { q[0] - o[0], q[1] - o[1], q[2] - o[2] };
+                const Value e =
+                    d[0] * (a[1] * b[2] - a[2] * b[1]) + d[1] * (a[2] * b[0] - a[0] * b[2]) + d[2] * (a[0] * b[1] - a[1] * b[0]);
+
+                Mask positive = e > Value(0);
+                const Mask zero = e == Value(0);
+                if (enoki::any(zero)) {
+                    // Moving the origin by w changes e by dot(w, (p - q) x d)
+                    const Scalar pq[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+                    const Value c[3] = { pq[1] * d[2] - pq[2] * d[1], pq[2] * d[0] - pq[0] * d[2], pq[0] * d[1] - pq[1] * d[0] };
+                    const Mask perturbed =
+                        enoki::select(c[0] != Value(0), c[0] > Value(0), enoki::select(c[1] != Value(0), c[1] > Value(0), c[2] > Value(0)));
+                    positive = enoki::select(zero, perturbed, positive);
+                }
+
+                // Sides of the edge in the direction of the triangle
+                if (swapped) {
+                    front = front && !positive;
+                    back = back && positive;
+                } else {
+                    front = front && positive;
+                    back = back && !positive;
+                }
+            }
+
+            // The edge functions are positive when passing the triangle along its normal, i.e. leaving the mesh
+            const Value denom = d[0] * tri.n[0] + d[1] * tri.n[1] + d[2] * tri.n[2];
+            const Value t = ((tri.v[0][0] - o[0]) * tri.n[0] + (tri.v[0][1] - o[1]) * tri.n[1] + (tri.v[0][2] - o[2]) * tri.n[2]) / denom;
+
+            auto mask = (front || back) && denom != Value(0) && t > Value(0);
+            return { t, mask, back };
+        }
+    } // namespace details
+
+    /**
+     * Closed triangle mesh, e.g. a CAD part, with a BVH over its triangles. Triangles are wound counter clockwise seen
+     * from the outside, so every crossing of a ray with the surface is known to enter or leave the part.
+     *
+     * Rays can be scalars or packets. For path lengths no sorting is needed: the length inside is the sum of the exit
+     * distances minus the sum of the entry distances, with an implicit entry at the origin for rays starting inside.
+     */
+    template <typename Scalar>
+    class triangle_mesh
+    {
+    public:
+        /// Mesh from vertices and triangles given as three vertex indices each
+        triangle_mesh(std::vector<std::array<Scalar, 3>> vertices, std::vector<std::array<uint32_t, 3>> triangles,
+                      const bvh_options& options = {})
+            : vertices_(std::move(vertices)), triangles_(checked(std::move(triangles), vertices_.size())),
+              tree_(triangles_.size(), bounds(), options)
+        {
+            // Prepared triangles in leaf order of the BVH
+            prepared_.resize(triangles_.size());
+            parallel_for(
+                0, triangles_.size(),
+                [&](size_t slot) {
+                    const auto& tri = triangles_[tree_.index(slot)];
+                    prepared_[slot] = details::prepare_triangle(vertices_[tri[0]], vertices_[tri[1]], vertices_[tri[2]]);
+                },
+                4096, options.threads);
+        }
+
+        size_t numVertices() const { return vertices_.size(); }
+        size_t numTriangles() const { return triangles_.size(); }
+
+        const std::vector<std::array<Scalar, 3>>& vertices() const { return vertices_; }
+        const std::vector<std::array<uint32_t, 3>>& triangles() const { return triangles_; }
+        const bvh<Scalar>& tree() const { return tree_; }
+
+        /**
+         * Call f(triangle, t, entering, mask) for every triangle hit by any lane of the ray, in no particular order.
+         * Lanes not hitting the triangle are masked out.
+         */
+        template <typename Value, typename Function>
+        void forEachCrossing(const ray<Value>& r, Function&& f) const
+        {
+            const auto origin = r.origin();
+            const auto dir = r.dir();
+            const Value o[3] = { origin.x(), origin.y(), origin.z() };
+            const Value d[3] = { dir.x(), dir.y(), dir.z() };
+
+            tree_.forEachCandidate(r, [&](uint32_t slot, const auto& candidates) {
+                auto hit = details::intersect_triangle(o, d, prepared_[slot]);
+                auto mask = hit.mask && candidates;
+                if (enoki::any(mask))
+                    f(tree_.index(slot), hit.t, hit.entering, mask);
+            });
+        }
+
+        /// Length of every lane of the ray inside the mesh
+        template <typename Value>
+        Value pathLength(const ray<Value>& r) const
+        {
+            Value length = Value(0);
+            forEachCrossing(r, [&](uint32_t, const Value& t, const auto& entering, const auto& mask) {
+                length += enoki::select(mask, enoki::select(entering, -t, t), Value(0));
+            });
+            return enoki::max(length, Value(0));
+        }
+
+        /// All crossings of a single ray with the surface, sorted by distance
+        std::vector<mesh_crossing<Scalar>> crossings(const ray<Scalar>& r) const
+        {
+            std::vector<mesh_crossing<Scalar>> result;
+            forEachCrossing(r, [&](uint32_t triangle, Scalar t, bool entering, bool) { result.push_back({ t, triangle, entering }); });
+
+            std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.t < b.t; });
+            return result;
+        }
+
+        /**
+         * Entry and exit distances of a single ray, sorted. Nested or overlapping shells are merged, a ray starting inside
+         * the mesh has its first interval starting at 0.
+         */
+        std::vector<mesh_interval<Scalar>> intervals(const ray<Scalar>& r) const
+        {
+            const auto sorted = crossings(r);
+
+            // Number of shells the origin lies in, so that the crossings end up balanced
+            long depth = 0;
+            for (const auto& c : sorted)
+                depth += c.entering ? -1 : 1;
+            depth = std::max(depth, 0l);
+
+            std::vector<mesh_interval<Scalar>> result;
+            Scalar start = 0;
+            for (const auto& c : sorted) {
+                if (c.entering) {
+                    if (depth++ == 0)
+                        start = c.t;
+                } else if (depth > 0 && --depth == 0) {
+                    result.push_back({ start, c.t });
+                }
+            }
+            return result;
+        }
+
+    private:
+        static std::vector<std::array<uint32_t, 3>> checked(std::vector<std::array<uint32_t, 3>> triangles, size_t numVertices)
+        {
+            for (const auto& tri : triangles)
+                for (uint32_t v : tri)
+                    if (v >= numVertices)
+                        throw std::out_of_range("triangle_mesh: vertex index " + std::to_string(v) + " out of range");
+            return triangles;
+        }
+
+        auto bounds() const
+        {
+            return [this](size_t i, Scalar lo[3], Scalar hi[3]) {
+                const auto& tri = triangles_[i];
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = std::min({ vertices_[tri[0]][a], vertices_[tri[1]][a], vertices_[tri[2]][a] });
+                    hi[a] = std::max({ vertices_[tri[0]][a], vertices_[tri[1]][a], vertices_[tri[2]][a] });
+                }
+            };
+        }
+
+        std::vector<std::array<Scalar, 3>> vertices_;
+        std::vector<std::array<uint32_t, 3>> triangles_;
+        bvh<Scalar> tree_;
+        std::vector<details::mesh_triangle<Scalar>> prepared_; // In leaf order of tree_
+    };
+
+    namespace details
+    {
+        /// Flip triangles whose winding disagrees with the facet normal stored in the file, zero normals are ignored
+        template <typename Scalar>
+        void orient_facet(const float normal[3], std::array<std::array<Scalar, 3>, 3>& v)
+        {
+            Scalar e1[3], e2[3];
+            for (int a = 0; a < 3; ++a) {
+                e1[a] = v[1][a] - v[0][a];
+                e2[a] = v[2][a] - v[0][a];
+            }
+            const Scalar n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            if (n[0] * normal[0] + n[1] * normal[1] + n[2] * normal[2] < 0)
+                std::swap(v[1], v[2]);
+        }
+
+        template <typename Scalar>
+        struct stl_builder {
+            std::vector<std::array<Scalar, 3>> vertices;
+            std::vector<std::array<uint32_t, 3>> triangles;
+
+            void add(const float normal[3], std::array<std::array<Scalar, 3>, 3> v)
+            {
+                orient_facet(normal, v);
+
+                const auto first = static_cast<uint32_t>(vertices.size());
+                vertices.insert(vertices.end(), v.begin(), v.end());
+                triangles.push_back({ first, first + 1, first + 2 });
+            }
+        };
+
+        template <typename Scalar>
+        void read_binary_stl(const mapped_file& file, size_t count, stl_builder<Scalar>& builder)
+        {
+            builder.vertices.reserve(3 * count);
+            builder.triangles.reserve(count);
+
+            // 50 bytes per facet: normal, three vertices and a 16 bit attribute, little endian and unaligned
+            for (size_t i = 0; i < count; ++i) {
+                float values[12];
+                std::memcpy(values, file.at<char>(84 + 50 * i), sizeof(values));
+
+                std::array<std::array<Scalar, 3>, 3> v;
+                for (int k = 0; k < 3; ++k)
+                    for (int a = 0; a < 3; ++a)
+                        v[k][a] = static_cast<Scalar>(values[3 + 3 * k + a]);
+                builder.add(values, v);
+            }
+        }
+
+        template <typename Scalar>
+        void read_ascii_stl(const mapped_file& file, const std::string& path, stl_builder<Scalar>& builder)
+        {
+            std::istringstream in(std::string(file.at<char>(0), file.size()));
+            std::string word;
+
+            float normal[3] = { 0, 0, 0 };
+            std::array<std::array<Scalar, 3>, 3> v;
+            int numVertices = 0;
+
+            while (in >> word) {
+                if (word == "normal") {
+                    if (!(in >> normal[0] >> normal[1] >> normal[2]))
+                        throw std::runtime_error("load_stl: invalid facet normal in " + path);
+                } else if (word == "vertex") {
+                    if (numVertices == 3)
+                        throw std::runtime_error("load_stl: facet with more than three vertices in " + path);
+                    if (!(in >> v[numVertices][0] >> v[numVertices][1] >> v[numVertices][2]))
+                        throw std::runtime_error("load_stl: invalid vertex in " + path);
+                    ++numVertices;
+                } else if (word == "endfacet") {
+                    if (numVertices != 3)
+                        throw std::runtime_error("load_stl: facet without three vertices in " + path);
+                    builder.add(normal, v);
+                    numVertices = 0;
+                    normal[0] = normal[1] = normal[2] = 0;
+                }
+            }
+        }
+    } // namespace details
+
+    /**
+     * Load an STL file, binary or ASCII. Vertices are not shared between facets, as STL does not store connectivity.
+     * Facets are reoriented to agree with their stored normal, where the file has one.
+     */
+    template <typename Scalar = float>
+    triangle_mesh<Scalar> load_stl(const std::string& path, const bvh_options& options = {})
+    {
+        mapped_file file(path, map_options{ map_access::sequential });
+
+        details::stl_builder<Scalar> builder;
+
+        // Binary files are recognized by their size, some binary files start with "solid" as well
+        bool binary = false;
+        if (file.size() >= 84) {
+            uint32_t count;
+            std::memcpy(&count, file.at<char>(80), sizeof(count));
+            if (file.size() == 84 + 50 * static_cast<size_t>(count)) {
+                details::read_binary_stl(file, count, builder);
+                binary = true;
+            }
+        }
+
+        if (!binary) {
+            if (file.size() < 5 || std::strncmp(file.at<char>(0), "solid", 5) != 0)
+                throw std::runtime_error("load_stl: not an STL file " + path);
+            details::read_ascii_stl(file, path, builder);
+        }
+
+        return triangle_mesh<Scalar>(std::move(builder.vertices), std::move(builder.triangles), options);
+    }
+
+    /// Write a mesh as binary STL, with the facet normals computed from the winding
+    template <typename Scalar>
+    void save_stl(const std::string& path, const triangle_mesh<Scalar>& mesh)
+    {
+        const size_t count = mesh.numTriangles();
+        if (count > std::numeric_limits<uint32_t>::max())
+            throw std::length_error("save_stl: too many triangles for STL");
+
+        auto file = mapped_file::create(path, 84 + 50 * count);
+        auto* out = static_cast<char*>(file.mutableData());
+
+        std::memset(out, 0, 84);
+        std::memcpy(out, "binary stl written by TomoSect", 30);
+        const auto count32 = static_cast<uint32_t>(count);
+        std::memcpy(out + 80, &count32, sizeof(count32));
+
+        for (size_t i = 0; i < count; ++i) {
+            const auto& tri = mesh.triangles()[i];
+            const auto& a = mesh.vertices()[tri[0]];
+            const auto& b = mesh.vertices()[tri[1]];
+            const auto& c = mesh.vertices()[tri[2]];
+
+            const Scalar e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const Scalar e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            Scalar n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const Scalar length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            float values[12];
+            for (int k = 0; k < 3; ++k) {
+                values[k] = length > 0 ? static_cast<float>(n[k] / length) : 0.f;
+                values[3 + k] = static_cast<float>(a[k]);
+                values[6 + k] = static_cast<float>(b[k]);
+                values[9 + k] = static_cast<float>(c[k]);
+            }
+
+            char* facet = out + 84 + 50 * i;
+            std::memcpy(facet, values, sizeof(values));
+            std::memset(facet + 48, 0, 2);
+        }
+
+        file.flush();
+    }
+
+    /**
+     * Path lengths through the mesh of all rays of a view, in row major order into out (cols * rows values). Rows are
+     * processed in parallel, with rays in packets of 8 neighbouring pixels.
+     */
+    template <typename Scalar>
+    void project_mesh(const projection_view<Scalar>& view, const triangle_mesh<Scalar>& mesh, float* out)
+    {
+        using Value = pack8<Scalar>;
+        constexpr size_t lanes = 8;
+
+        const size_t cols = view.cols();
+        parallel_for(0, view.rows(), [&](size_t row) {
+            for (size_t col = 0; col < cols; col += lanes) {
+                const size_t n = std::min(lanes, cols - col);
+                const Value length = mesh.pathLength(view.template pixelPacket<Value>(col, row, n));
+                for (size_t lane = 0; lane < n; ++lane)
+                    out[row * cols + col + lane] = static_cast<float>(length[lane]);
+            }
+        });
+    }
+} // namespace tomosect
@@ -0,0 +1,530 @@
+/**
+ *
+ * \file monte_carlo.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/bvh.hpp"
+#include "TomoSect/csg.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/polychromatic.hpp"
+#include "TomoSect/random.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tomosect
+{
+    /// Electron rest energy in keV
+    constexpr double electron_rest_energy = 510.99895;
+
+    /**
+     * Linear attenuation coefficients of materials split by interaction: photoelectric absorption, Compton (incoherent)
+     * and Rayleigh (coherent) scattering. The curves are resampled on a regular energy grid, so the coefficients for a
+     * packet of photons of different energies are a gather and a linear interpolation. Label 0 is vacuum, label k is
+     * material k - 1 of the given tables, as in material_path_lengths().
+     *
+     * The majorant, the largest total attenuation of any material at an energy, bounds the attenuation everywhere in
+     * the volume, which is what Woodcock tracking samples its steps with.
+     */
+    template <typename Scalar>
+    class interaction_table
+    {
+    public:
+        interaction_table(const material_table<Scalar>& photoelectric, const material_table<Scalar>& compton,
+                          const material_table<Scalar>& rayleigh, Scalar energyStep = Scalar(0.5))
+            : materials_(photoelectric.numMaterials()), step_(energyStep)
+        {
+            if (compton.names() != photoelectric.names() || rayleigh.names() != photoelectric.names())
+                throw std::invalid_argument("interaction_table: all tables must list the same materials");
+            if (!(energyStep > 0))
+                throw std::invalid_argument("interaction_table: energy step must be positive");
+
+            minEnergy_ = std::min({ photoelectric.energies().front(), compton.energies().front(), rayleigh.energies().front() });
+            const Scalar maxEnergy = std::max({ photoelectric.energies().back(), compton.energies().back(), rayleigh.energies().back() });
+            bins_ = static_cast<size_t>(std::ceil((maxEnergy - minEnergy_) / step_)) + 2;
+
+            // Row 0 is vacuum
+            total_.assign((materials_ + 1) * bins_, Scalar(0));
+            compton_.assign((materials_ + 1) * bins_, Scalar(0));
+            rayleigh_.assign((materials_ + 1) * bins_, Scalar(0));
+            majorant_.assign(bins_, Scalar(0));
+
+            for (size_t m = 0; m < materials_; ++m) {
+                for (size_t b = 0; b < bins_; ++b) {
+                    const Scalar energy = minEnergy_ + static_cast<Scalar>(b) * step_;
+                    const size_t i = (m + 1) * bins_ + b;
+                    compton_[i] = compton.attenuation(m, energy);
+                    rayleigh_[i] = rayleigh.attenuation(m, energy);
+                    total_[i] = photoelectric.attenuation(m, energy) + compton_[i] + rayleigh_[i];
+                    majorant_[b] = std::max(majorant_[b], total_[i]);
+                }
+            }
+        }
+
+        size_t numMaterials() const { return materials_; }
+
+        /// Lowest tabulated energy, photons below it are absorbed
+        Scalar minEnergy() const { return minEnergy_; }
+
+        /// Total attenuation of material m (not the label) at any energy, scalar reference of lookup()
+        Scalar total(size_t m, Scalar energy) const
+        {
+            auto [i, w] = position(energy);
+            const size_t row = (m + 1) * bins_;
+            return (1 - w) * total_[row + i] + w * total_[row + i + 1];
+        }
+
+        /**
+         * Coefficients for a packet of photons with the given labels and energies: total attenuation and its Compton
+         * and Rayleigh parts, the rest is photoelectric absorption.
+         */
+        template <typename Value, typename Index>
+        void lookup(const Index& label, const Value& energy, Value& total, Value& compton, Value& rayleigh) const
+        {
+            auto [i, w] = position(energy);
+            const Index at = label * static_cast<uint32_t>(bins_) + i;
+            total = interpolate<Value>(total_, at, w);
+            compton = interpolate<Value>(compton_, at, w);
+            rayleigh = interpolate<Value>(rayleigh_, at, w);
+        }
+
+        /// Upper bound of the total attenuation of all materials at the given energies
+        template <typename Value>
+        Value majorant(const Value& energy) const
+        {
+            auto [i, w] = position(energy);
+            return interpolate<Value>(majorant_, i, w);
+        }
+
+    private:
+        /// Bin index below the energy and the interpolation weight, clamped to the table
+        template <typename Value>
+        auto position(const Value& energy) const
+        {
+            using Index = bvh_index_t<Value>;
+
+            const Value u = enoki::clamp((energy - minEnergy_) / step_, Value(0), Value(static_cast<Scalar>(bins_ - 2)));
+            const Value lower = enoki::floor(u);
+            return std::make_pair(Index(lower), Value(u - lower));
+        }
+
+        template <typename Value, typename Index>
+        static Value interpolate(const std::vector<Scalar>& table, const Index& i, const Value& w)
+        {
+            const Value a = enoki::gather<Value>(table.data(), i);
+            const Value b = enoki::gather<Value>(table.data(), i + 1u);
+            return enoki::fmadd(w, b - a, a);
+        }
+
+        size_t materials_;
+        size_t bins_ = 0;
+        Scalar minEnergy_ = 0;
+        Scalar step_;
+        std::vector<Scalar> total_;    // Per label, bins_ values each
+        std::vector<Scalar> compton_;  // Per label
+        std::vector<Scalar> rayleigh_; // Per label
+        std::vector<Scalar> majorant_; // Maximum of total_ over all labels
+    };
+
+    /// Settings of a scatter simulation
+    struct scatter_options {
+        uint64_t seed = default_seed;
+        size_t batchSize = 4096; // Photons per random stream, the unit of work of a thread
+        uint32_t maxOrder = 32;  // Photons scattered more often are dropped
+        size_t numThreads = 0;   // 0 means hardware_threads()
+    };
+
+    /**
+     * Energy (keV) arriving at every detector pixel, in row major order: from photons that were not scattered on their
+     * way and from photons that were scattered at least once. Both are sums over all photons, divided by photons they
+     * are the energy per emitted photon, comparable between simulations of different length.
+     */
+    struct scatter_tally {
+        size_t cols = 0;
+        size_t rows = 0;
+        uint64_t photons = 0;
+        std::vector<double> primary;
+        std::vector<double> scatter;
+    };
+
+    namespace details
+    {
+        /// Packet of photons moving through the volume, one per lane
+        template <typename Value>
+        struct photon_packet {
+            using Mask = typename point3<Value>::Mask;
+
+            Value position[3];
+            Value direction[3];
+            Value energy;
+            Value weight;
+            Value scatters; // Number of interactions so far
+            Mask alive;
+        };
+
+        /**
+         * Compton scattering angle and energy after the scattering for photons of the given energies (keV), sampled
+         * from the Klein-Nishina cross section with Kahn's rejection method. All lanes draw until every lane accepted.
+         * Binding effects of the electrons (the incoherent scattering function) are ignored.
+         */
+        template <typename Value>
+        void sample_compton(const Value& energy, random_stream<Value>& rng, Value& cosTheta, Value& scattered)
+        {
+            using Scalar = enoki::scalar_t<Value>;
+            using Mask = typename point3<Value>::Mask;
+
+            const Value k = energy / static_cast<Scalar>(electron_rest_energy);
+            Value eta = Value(1);
+            Mask pending = Mask(true);
+
+            while (enoki::any(pending)) {
+                const Value r1 = rng.uniform(), r2 = rng.uniform(), r3 = rng.uniform();
+
+                // Branch one samples 1 + 2k r2, branch two (1 + 2k) / (1 + 2k r2)
+                const Mask first = r1 * (9 + 2 * k) <= 1 + 2 * k;
+                const Value e = enoki::select(first, 1 + 2 * k * r2, (1 + 2 * k) / (1 + 2 * k * r2));
+                const Value mu = 1 - (e - 1) / k;
+                const Mask accept = enoki::select(first, r3 <= 4 * (1 / e - 1 / (e * e)), r3 <= Scalar(0.5) * (mu * mu + 1 / e));
+
+                const Mask done = pending && accept;
+                eta = enoki::select(done, e, eta);
+                pending = pending && !accept;
+            }
+
+            cosTheta = 1 - (eta - 1) / k;
+            scattered = energy / eta;
+        }
+
+        /**
+         * Rayleigh scattering angle from the Thomson phase function (1 + cos^2) / 2, inverted in closed form: the
+         * cosine solves mu^3 + 3 mu = 8 u - 4. The atomic form factor, which favours small angles, is ignored.
+         */
+        template <typename Value>
+        Value sample_rayleigh(random_stream<Value>& rng)
+        {
+            const Value b = 4 * rng.uniform() - 2;
+            const Value a = enoki::cbrt(b + enoki::sqrt(b * b + 1));
+            return enoki::clamp(a - 1 / a, Value(-1), Value(1));
+        }
+
+        /// Turn the unit direction d by the polar angle with the given cosine and the azimuth phi around itself
+        template <typename Value>
+        void rotate_direction(Value d[3], const Value& cosTheta, const Value& phi)
+        {
+            using Scalar = enoki::scalar_t<Value>;
+
+            const Value sinTheta = enoki::sqrt(enoki::max(Value(0), 1 - cosTheta * cosTheta));
+            const Value cosPhi = enoki::cos(phi), sinPhi = enoki::sin(phi);
+
+            // Directions along z have no unique frame, use the fixed one there
+            const auto alongZ = enoki::abs(d[2]) > Scalar(0.99999);
+            const Value s = enoki::sqrt(enoki::max(Value(1e-12f), 1 - d[2] * d[2]));
+
+            const Value x = sinTheta * (d[0] * d[2] * cosPhi - d[1] * sinPhi) / s + d[0] * cosTheta;
+            const Value y = sinTheta * (d[1] * d[2] * cosPhi + d[0] * sinPhi) / s + d[1] * cosTheta;
+            const Value z = -sinTheta * cosPhi * s + d[2] * cosTheta;
+
+            d[0] = enoki::select(alongZ, sinTheta * cosPhi, x);
+            d[1] = enoki::select(alongZ, sinTheta * sinPhi, y);
+            d[2] = enoki::select(alongZ, enoki::sign(d[2]) * cosTheta, z);
+        }
+
+        /// Flat detector of a view: a rectangle of packets to intersect with, and its corner and edges to aim at
+        template <typename Value>
+        struct detector_target {
+            using Scalar = enoki::scalar_t<Value>;
+
+            explicit detector_target(const projection_view<Scalar>& view) : cols(view.cols()), rows(view.rows())
+            {
+                // Outer corners of the first pixel and of the ends of the first row and column
+                const Scalar first = Scalar(-0.5);
+                const auto c = view.detector.coordFromLocal(point2<Scalar>(first, first));
+                const auto u = view.detector.coordFromLocal(point2<Scalar>(static_cast<Scalar>(cols) + first, first)) - c;
+                const auto v = view.detector.coordFromLocal(point2<Scalar>(first, static_cast<Scalar>(rows) + first)) - c;
+                const auto n = view.detector.normal();
+
+                const Scalar cs[3] = { c.x(), c.y(), c.z() }, us[3] = { u.x(), u.y(), u.z() }, vs[3] = { v.x(), v.y(), v.z() };
+                const Scalar ns[3] = { n.x(), n.y(), n.z() }, ss[3] = { view.source.x(), view.source.y(), view.source.z() };
+                for (int k = 0; k < 3; ++k) {
+                    source[k] = ss[k];
+                    origin[k] = cs[k];
+                    along[k] = us[k];
+                    across[k] = vs[k];
+                    normal[k] = ns[k];
+                }
+
+                auto broadcast = [](const Scalar p[3]) { return enoki::Array<Value, 3>(Value(p[0]), Value(p[1]), Value(p[2])); };
+                plane = rectangle<Value>(point2<Value>(Value(static_cast<Scalar>(cols)), Value(static_cast<Scalar>(rows))),
+                                         point3<Value>(broadcast(origin) + (broadcast(along) + broadcast(across)) * Value(Scalar(0.5))),
+                                         vec3<Value>(broadcast(along)), vec3<Value>(broadcast(across)));
+            }
+
+            size_t cols;
+            size_t rows;
+            rectangle<Value> plane;
+            Scalar source[3];
+            Scalar origin[3]; // Outer corner of pixel (0, 0)
+            Scalar along[3];  // Full edge along a row
+            Scalar across[3]; // Full edge along a column
+            Scalar normal[3];
+        };
+
+        /**
+         * Add the energy of the photons leaving the volume to the pixel they hit, using the ray-rectangle intersection
+         * of the detector. Photons missing the detector or flying away from it are lost.
+         */
+        template <typename Value>
+        void tally_escapes(const photon_packet<Value>& photons, const typename point3<Value>::Mask& escaping,
+                           const detector_target<Value>& detector, double* primary, double* scatter)
+        {
+            using Scalar = enoki::scalar_t<Value>;
+            constexpr size_t lanes = Value::Size;
+
+            const ray<Value> r(point3<Value>(photons.position[0], photons.position[1], photons.position[2]),
+                               vec3<Value>(photons.direction[0], photons.direction[1], photons.direction[2]),
+                               typename ray<Value>::ray_direction_normalized{});
+            auto [hit, mask] = intersection(r, detector.plane, ray_rectangle_intersection{});
+            const auto pixel = detector.plane.localFromCoord(hit);
+
+            const Value col = enoki::floor(pixel.x() + Scalar(0.5));
+            const Value row = enoki::floor(pixel.y() + Scalar(0.5));
+            const auto inside = escaping && mask && col >= 0 && row >= 0 && col < static_cast<Scalar>(detector.cols)
+                                && row < static_cast<Scalar>(detector.rows);
+            if (enoki::none(inside))
+                return;
+
+            const Value deposit = photons.energy * photons.weight;
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                if (!inside[lane])
+                    continue;
+                const size_t i = static_cast<size_t>(row[lane]) * detector.cols + static_cast<size_t>(col[lane]);
+                (photons.scatters[lane] == 0 ? primary : scatter)[i] += static_cast<double>(deposit[lane]);
+            }
+        }
+
+        /**
+         * Transport count photons (at most one packet) from the source through the volume with Woodcock tracking: free
+         * paths are sampled with the majorant, and at each tentative collision the real attenuation of the voxel decides
+         * whether it happens. Real collisions absorb the photon or scatter it (Compton or Rayleigh) into a new direction.
+         */
+        template <typename Value, volume_layout Layout>
+        void transport_packet(size_t count, const detector_target<Value>& detector, const voxel_grid<enoki::scalar_t<Value>>& grid,
+                              const volume<uint8_t, Layout>& labels, const interaction_table<enoki::scalar_t<Value>>& materials,
+                              const std::vector<enoki::scalar_t<Value>>& spectrumCdf, const std::vector<enoki::scalar_t<Value>>& energies,
+                              const scatter_options& options, random_stream<Value>& rng, double* primary, double* scatter)
+        {
+            using Scalar = enoki::scalar_t<Value>;
+            using Index = bvh_index_t<Value>;
+            using Mask = typename point3<Value>::Mask;
+            constexpr size_t lanes = Value::Size;
+
+            const Scalar lo[3] = { grid.min().x(), grid.min().y(), grid.min().z() };
+            const Scalar h[3] = { grid.spacing().x(), grid.spacing().y(), grid.spacing().z() };
+            const Scalar hi[3] = { lo[0] + h[0] * grid.nx(), lo[1] + h[1] * grid.ny(), lo[2] + h[2] * grid.nz() };
+            const Scalar last[3] = { static_cast<Scalar>(grid.nx() - 1), static_cast<Scalar>(grid.ny() - 1),
+                                     static_cast<Scalar>(grid.nz() - 1) };
+
+            photon_packet<Value> photons;
+
+            // Energies from the spectrum, by inverting its distribution function
+            const Value pick = rng.uniform();
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const auto bin = std::upper_bound(spectrumCdf.begin(), spectrumCdf.end() - 1, pick[lane]) - spectrumCdf.begin();
+                photons.energy[lane] = energies[static_cast<size_t>(bin)];
+            }
+
+            // Directions towards uniform points on the detector, weighted with cos^3 so the source is isotropic
+            const Value a = rng.uniform(), b = rng.uniform();
+            Value length2 = Value(0), facing = Value(0);
+            for (int k = 0; k < 3; ++k) {
+                photons.position[k] = Value(detector.source[k]);
+                photons.direction[k] = detector.origin[k] + a * detector.along[k] + b * detector.across[k] - detector.source[k];
+                length2 = enoki::fmadd(photons.direction[k], photons.direction[k], length2);
+            }
+            const Value invLength = 1 / enoki::sqrt(length2);
+            for (int k = 0; k < 3; ++k) {
+                photons.direction[k] *= invLength;
+                facing = enoki::fmadd(photons.direction[k], Value(detector.normal[k]), facing);
+            }
+            facing = enoki::abs(facing);
+            photons.weight = facing * facing * facing;
+            photons.scatters = Value(0);
+
+            const Mask valid = enoki::arange<Value>() < static_cast<Scalar>(count);
+
+            // Enter the volume, photons missing it fly to the detector unscattered
+            auto boxExit = [&](const Mask& active) {
+                Value invDir[3];
+                for (int k = 0; k < 3; ++k)
+                    invDir[k] = 1 / photons.direction[k];
+                auto [tEnter, tExit, hit] = box_interval(lo, hi, photons.position, invDir);
+                return std::make_tuple(enoki::max(tEnter, Value(0)), tExit, active && hit && tExit > 0);
+            };
+
+            auto [tEnter, tExit, hit] = boxExit(valid);
+            tally_escapes(photons, valid && !hit, detector, primary, scatter);
+            for (int k = 0; k < 3; ++k)
+                photons.position[k] =
+                    enoki::select(hit, enoki::fmadd(photons.direction[k], tEnter, photons.position[k]), photons.position[k]);
+            Value remaining = enoki::select(hit, tExit - tEnter, Value(0));
+            photons.alive = hit;
+
+            while (enoki::any(photons.alive)) {
+                // Tentative collision at the majorant's free path length
+                const Value step = -enoki::log(1 - rng.uniform()) / materials.majorant(photons.energy);
+                const Mask leaving = photons.alive && step >= remaining;
+                if (enoki::any(leaving)) {
+                    tally_escapes(photons, leaving, detector, primary, scatter);
+                    photons.alive = photons.alive && !leaving;
+                }
+
+                const Value moved = enoki::select(photons.alive, step, Value(0));
+                for (int k = 0; k < 3; ++k)
+                    photons.position[k] = enoki::fmadd(photons.direction[k], moved, photons.position[k]);
+                remaining -= moved;
+
+                // Material of the voxel the photons are in
+                Index voxel[3];
+                for (int k = 0; k < 3; ++k)
+                    voxel[k] = Index(enoki::clamp(enoki::floor((photons.position[k] - lo[k]) / h[k]), Value(0), Value(last[k])));
+                const Index label = Index(labels.template gather<enoki::Array<uint8_t, lanes>>(voxel[0], voxel[1], voxel[2]));
+
+                Value total, compton, rayleigh;
+                materials.lookup(label, photons.energy, total, compton, rayleigh);
+
+                const Value majorant = materials.majorant(photons.energy);
+                const Mask real = photons.alive && rng.uniform() * majorant < total;
+                if (enoki::none(real))
+                    continue;
+
+                // Pick the interaction in proportion to its share of the attenuation
+                const Value choice = rng.uniform() * total;
+                const Mask isRayleigh = real && choice < rayleigh;
+                const Mask isCompton = real && !isRayleigh && choice < rayleigh + compton;
+                const Mask absorbed = real && !isRayleigh && !isCompton;
+
+                Value cosTheta = Value(1), scattered = photons.energy;
+                if (enoki::any(isCompton))
+                    sample_compton(photons.energy, rng, cosTheta, scattered);
+                if (enoki::any(isRayleigh))
+                    cosTheta = enoki::select(isRayleigh, sample_rayleigh(rng), cosTheta);
+
+                const Mask scattering = isCompton || isRayleigh;
+                Value turned[3] = { photons.direction[0], photons.direction[1], photons.direction[2] };
+                rotate_direction(turned, cosTheta, rng.uniform() * static_cast<Scalar>(2 * M_PI));
+                for (int k = 0; k < 3; ++k)
+                    photons.direction[k] = enoki::select(scattering, turned[k], photons.direction[k]);
+
+                photons.energy = enoki::select(isCompton, scattered, photons.energy);
+                photons.scatters = enoki::select(scattering, photons.scatters + 1, photons.scatters);
+
+                // Photons below the tables and photons scattered too often are absorbed on the spot
+                const Mask exhausted = photons.energy < materials.minEnergy() || photons.scatters > static_cast<Scalar>(options.maxOrder);
+                const Mask dropped = scattering && exhausted;
+                photons.alive = photons.alive && !absorbed && !dropped;
+
+                const Mask turning = scattering && photons.alive;
+                if (enoki::any(turning)) {
+                    auto [newEnter, newExit, inside] = boxExit(turning);
+                    remaining = enoki::select(turning, enoki::select(inside, newExit, Value(0)), remaining);
+                }
+            }
+        }
+    } // namespace details
+
+    /**
+     * Monte Carlo simulation of the photons of one view through a label volume, splitting what reaches the detector
+     * into primary and scattered radiation. Photons leave the point source towards the detector with energies drawn
+     * from the spectrum, are tracked through the voxels with Woodcock tracking, scattered (Compton, Rayleigh) or
+     * absorbed (photoelectric) and tallied where they hit the flat detector. Fluorescence is not modelled.
+     *
+     * Photons are simulated in packets of 8 and in batches of options.batchSize, batch b always draws from random
+     * stream b of the seed, so the same photons are simulated for any number of threads. Threads tally into their own
+     * buffers, which are added up in a fixed order at the end.
+     */
+    template <typename Scalar, volume_layout Layout>
+    scatter_tally simulate_scatter(const projection_view<Scalar>& view, const voxel_grid<Scalar>& grid,
+                                   const volume<uint8_t, Layout>& labels, const interaction_table<Scalar>& materials,
+                                   const spectrum<Scalar>& source, uint64_t photons, const scatter_options& options = {})
+    {
+        using Value = pack8<Scalar>;
+        constexpr size_t lanes = 8;
+
+        if (labels.nx() != grid.nx() || labels.ny() != grid.ny() || labels.nz() != grid.nz())
+            throw std::invalid_argument("simulate_scatter: labels do not match the grid");
+        if (source.energies.empty() || source.weights.size() != source.energies.size())
+            throw std::invalid_argument("simulate_scatter: spectrum needs one weight per energy");
+        if (options.batchSize == 0)
+            throw std::invalid_argument("simulate_scatter: batch size must be positive");
+
+        for (size_t z = 0; z < labels.nz(); ++z)
+            for (size_t y = 0; y < labels.ny(); ++y)
+                for (size_t x = 0; x < labels.nx(); ++x)
+                    if (labels(x, y, z) > materials.numMaterials())
+                        throw std::out_of_range("simulate_scatter: label " + std::to_string(labels(x, y, z)) + " without material");
+
+        // Distribution function of the spectrum, normalised to 1
+        std::vector<Scalar> cdf(source.size());
+        Scalar sum = 0;
+        for (size_t e = 0; e < source.size(); ++e)
+            cdf[e] = sum += source.weights[e];
+        if (!(sum > 0))
+            throw std::invalid_argument("simulate_scatter: spectrum without photons");
+        for (auto& c : cdf)
+            c /= sum;
+
+        const details::detector_target<Value> detector(view);
+        const size_t pixels = view.cols() * view.rows();
+        const size_t batches = static_cast<size_t>((photons + options.batchSize - 1) / options.batchSize);
+        const size_t tasks = std::max<size_t>(1, std::min(options.numThreads == 0 ? hardware_threads() : options.numThreads, batches));
+
+        std::vector<std::vector<double>> primary(tasks), scatter(tasks);
+        parallel_for(
+            0, tasks,
+            [&](size_t task) {
+                primary[task].assign(pixels, 0.0);
+                scatter[task].assign(pixels, 0.0);
+
+                for (size_t b = task; b < batches; b += tasks) {
+                    random_stream<Value> rng(b, options.seed);
+                    const uint64_t first = static_cast<uint64_t>(b) * options.batchSize;
+                    const uint64_t count = std::min<uint64_t>(options.batchSize, photons - first);
+                    for (uint64_t p = 0; p < count; p += lanes)
+                        details::transport_packet(static_cast<size_t>(std::min<uint64_t>(lanes, count - p)), detector, grid, labels,
+                                                  materials, cdf, source.energies, options, rng, primary[task].data(),
+                                                  scatter[task].data());
+                }
+            },
+            1, tasks);
+
+        scatter_tally result;
+        result.cols = view.cols();
+        result.rows = view.rows();
+        result.photons = photons;
+        result.primary.assign(pixels, 0.0);
+        result.scatter.assign(pixels, 0.0);
+        for (size_t task = 0; task < tasks; ++task) {
+            for (size_t i = 0; i < pixels; ++i) {
+                result.primary[i] += primary[task][i];
+                result.scatter[i] += scatter[task][i];
+            }
+        }
+        return result;
+    }
+} // namespace tomosect
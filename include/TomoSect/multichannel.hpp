@@ -0,0 +1,159 @@
+/**
+ *
+ * \file multichannel.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "enoki/array.h"
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Volume with several values per voxel (energy bins, material bases, time frames), stored interleaved: all channels
+     * of a voxel are next to each other, so one address computation and one cache line serve every channel. Any
+     * layout of volume works, the layout orders whole voxels.
+     */
+    template <typename T, size_t Channels, volume_layout Layout = volume_layout::linear>
+    using multichannel_volume = volume<std::array<T, Channels>, Layout>;
+
+    namespace details
+    {
+        /// All channels of a voxel (or pixel) as one array
+        template <typename Scalar, typename T, size_t Channels>
+        enoki::Array<Scalar, Channels> load_channels(const T* values)
+        {
+            enoki::Array<Scalar, Channels> result;
+            for (size_t c = 0; c < Channels; ++c)
+                result[c] = static_cast<Scalar>(values[c]);
+            return result;
+        }
+    } // namespace details
+
+    /// Line integrals of all channels along the ray, traversing the grid once
+    template <typename Scalar, typename T, size_t Channels, volume_layout Layout>
+    enoki::Array<Scalar, Channels> project_channels(const ray<Scalar>& r, const voxel_grid<Scalar>& grid,
+                                                    const multichannel_volume<T, Channels, Layout>& vol)
+    {
+        using Values = enoki::Array<Scalar, Channels>;
+
+        Values sum = Values(0);
+        traverse_cells(r, grid, [&](size_t x, size_t y, size_t z, Scalar length) {
+            sum = enoki::fmadd(details::load_channels<Scalar, T, Channels>(vol(x, y, z).data()), Values(length), sum);
+        });
+        return sum;
+    }
+
+    /**
+     * Line integrals of all channels for all rays of a view, rows in parallel. out holds one image per channel, one
+     * after another, each cols * rows values in row major order.
+     */
+    template <typename Scalar, typename T, size_t Channels, volume_layout Layout>
+    void project_channels(const projection_view<Scalar>& view, const voxel_grid<Scalar>& grid,
+                          const multichannel_volume<T, Channels, Layout>& vol, float* out)
+    {
+        const size_t cols = view.cols();
+        const size_t pixels = cols * view.rows();
+        parallel_for(0, view.rows(), [&](size_t row) {
+            for (size_t col = 0; col < cols; ++col) {
+                const auto sum = project_channels(view.pixelRay(col, row), grid, vol);
+                for (size_t c = 0; c < Channels; ++c)
+                    out[c * pixels + row * cols + col] = static_cast<float>(sum[c]);
+            }
+        });
+    }
+
+    /**
+     * Voxel driven FDK backprojection of multi-channel views, as backproject() in fdk.hpp: the filtered rows hold
+     * Channels interleaved values per pixel and the output holds the box's voxels (x fastest) with Channels values
+     * each. Projecting the voxel onto the detector and the interpolation weights are computed once for all channels.
+     */
+    template <typename Scalar, size_t Channels>
+    void backproject_channels(const std::vector<projection_matrix<Scalar>>& matrices, const std::vector<filtered_rows>& rows, size_t cols,
+                              Scalar scale, const voxel_grid<Scalar>& grid, const voxel_box& box, std::array<float, Channels>* output)
+    {
+        using Values = enoki::Array<float, Channels>;
+
+        const size_t nx = box.nx();
+        const size_t ny = box.ny();
+        const auto first = grid.voxelCenter(box.xBegin, box.yBegin, box.zBegin);
+        const auto h = grid.spacing();
+
+        parallel_for(0, ny * box.nz(), [&](size_t line) {
+            size_t y = line % ny;
+            size_t z = line / ny;
+            std::array<float, Channels>* out = output + line * nx;
+
+            Scalar wy = first.y() + static_cast<Scalar>(y) * h.y();
+            Scalar wz = first.z() + static_cast<Scalar>(z) * h.z();
+
+            // Accumulated over all views, added to the output once per voxel
+            std::vector<Values> sum(nx, Values(0));
+            for (size_t k = 0; k < matrices.size(); ++k)
+                details::backproject_line(matrices[k], rows[k], cols, scale, first.x(), h.x(), wy, wz, nx, sum.data());
+
+            for (size_t x = 0; x < nx; ++x)
+                for (size_t c = 0; c < Channels; ++c)
+                    out[x][c] += sum[x][c];
+        });
+    }
+
+    /**
+     * FDK reconstruction of all channels of a full circular scan, one projection stack per channel. Every channel is
+     * filtered on its own, the filtered views are interleaved and backprojected in a single pass over the volume.
+     */
+    template <size_t Channels, typename Scalar, typename T>
+    multichannel_volume<float, Channels> fdk_channels(const circular_trajectory<Scalar>& trajectory,
+                                                      const std::vector<projection_stack<T>>& channels, const voxel_grid<Scalar>& grid)
+    {
+        if (channels.size() != Channels)
+            throw std::invalid_argument("fdk_channels: expected " + std::to_string(Channels) + " projection stacks");
+        for (const auto& projections : channels) {
+            if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows
+                || projections.numViews() != trajectory.numViews)
+                throw std::invalid_argument("fdk_channels: projections do not match the trajectory");
+        }
+
+        fdk_filter<Scalar> filter(trajectory);
+        const size_t pixels = trajectory.cols * trajectory.rows;
+        std::vector<float> filtered(pixels * Channels * trajectory.numViews);
+
+        parallel_for(0, trajectory.numViews, [&](size_t k) {
+            std::vector<float> channel(pixels);
+            float* view = filtered.data() + k * pixels * Channels;
+            for (size_t c = 0; c < Channels; ++c) {
+                filter.filterRows(channels[c].view(k), channel.data(), 0, trajectory.rows);
+                for (size_t i = 0; i < pixels; ++i)
+                    view[i * Channels + c] = channel[i];
+            }
+        });
+
+        std::vector<projection_matrix<Scalar>> matrices;
+        std::vector<filtered_rows> rows;
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+            rows.push_back({ filtered.data() + k * pixels * Channels, 0, trajectory.rows });
+        }
+
+        multichannel_volume<float, Channels> result(grid.nx(), grid.ny(), grid.nz());
+        const voxel_box box{ 0, grid.nx(), 0, grid.ny(), 0, grid.nz() };
+        backproject_channels(matrices, rows, trajectory.cols, fdk_scale(trajectory), grid, box, result.data());
+        return result;
+    }
+} // namespace tomosect
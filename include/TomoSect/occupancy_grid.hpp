@@ -0,0 +1,215 @@
+/**
+ *
+ * \file occupancy_grid.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Coarse min-max grid over a volume: the voxels are grouped into bricks of brickSize^3 voxels (smaller at the upper
+     * boundaries), and for every brick the smallest and largest value are kept. A brick is empty, if all its values lie
+     * within [-threshold, threshold]. Traversals can skip empty bricks as a whole.
+     *
+     * When the volume changes, the changed voxels are invalidated and update() recomputes only the bricks affected.
+     */
+    template <typename Scalar>
+    class occupancy_grid
+    {
+    public:
+        explicit occupancy_grid(const voxel_grid<Scalar>& grid, size_t brickSize = 8, float threshold = 0)
+            : grid_(grid), brickSize_(brickSize), threshold_(threshold)
+        {
+            if (brickSize == 0)
+                throw std::invalid_argument("occupancy_grid: brick size must not be zero");
+
+            n_[0] = (grid.nx() + brickSize - 1) / brickSize;
+            n_[1] = (grid.ny() + brickSize - 1) / brickSize;
+            n_[2] = (grid.nz() + brickSize - 1) / brickSize;
+
+            // Bricks at the upper boundaries may reach outside of the volume
+            macroGrid_ = voxel_grid<Scalar>(n_[0], n_[1], n_[2], grid.min(), grid.spacing() * vec3<Scalar>(static_cast<Scalar>(brickSize)));
+
+            min_.assign(bricks(), 0.f);
+            max_.assign(bricks(), 0.f);
+            occupied_.assign(bricks(), 1);
+            dirty_.assign(bricks(), 1);
+        }
+
+        /// Build the grid for the given volume right away
+        template <typename T, volume_layout Layout>
+        occupancy_grid(const voxel_grid<Scalar>& grid, const volume<T, Layout>& vol, size_t brickSize = 8, float threshold = 0)
+            : occupancy_grid(grid, brickSize, threshold)
+        {
+            update(vol);
+        }
+
+        size_t brickSize() const { return brickSize_; }
+        float threshold() const { return threshold_; }
+
+        size_t nx() const { return n_[0]; }
+        size_t ny() const { return n_[1]; }
+        size_t nz() const { return n_[2]; }
+        size_t bricks() const { return n_[0] * n_[1] * n_[2]; }
+
+        /// Grid with one cell per brick, it has the same origin as the volume grid, but might be larger
+        const voxel_grid<Scalar>& macroGrid() const { return macroGrid_; }
+
+        size_t index(size_t bx, size_t by, size_t bz) const { return bx + n_[0] * (by + n_[1] * bz); }
+
+        float min(size_t bx, size_t by, size_t bz) const { return min_[index(bx, by, bz)]; }
+        float max(size_t bx, size_t by, size_t bz) const { return max_[index(bx, by, bz)]; }
+        bool occupied(size_t bx, size_t by, size_t bz) const { return occupied_[index(bx, by, bz)] != 0; }
+
+        /// Fraction of bricks which are not empty
+        double occupancy() const
+        {
+            return static_cast<double>(std::count(occupied_.begin(), occupied_.end(), uint8_t{ 1 })) / static_cast<double>(bricks());
+        }
+
+        /// Voxels of a brick
+        voxel_box brickVoxels(size_t bx, size_t by, size_t bz) const
+        {
+            return { bx * brickSize_, std::min((bx + 1) * brickSize_, grid_.nx()),
+                     by * brickSize_, std::min((by + 1) * brickSize_, grid_.ny()),
+                     bz * brickSize_, std::min((bz + 1) * brickSize_, grid_.nz()) };
+        }
+
+        /// World space box of a brick, clipped to the volume
+        aabb<Scalar> brickBounds(size_t bx, size_t by, size_t bz) const
+        {
+            const auto v = brickVoxels(bx, by, bz);
+            const auto lo = grid_.min();
+            const auto h = grid_.spacing();
+
+            auto at = [](Scalar origin, Scalar spacing, size_t i) { return origin + static_cast<Scalar>(i) * spacing; };
+            return aabb<Scalar>(point3<Scalar>(at(lo.x(), h.x(), v.xBegin), at(lo.y(), h.y(), v.yBegin), at(lo.z(), h.z(), v.zBegin)),
+                                point3<Scalar>(at(lo.x(), h.x(), v.xEnd), at(lo.y(), h.y(), v.yEnd), at(lo.z(), h.z(), v.zEnd)));
+        }
+
+        /// Mark the bricks containing any of the given voxels for recomputation
+        void invalidate(const voxel_box& changed)
+        {
+            if (changed.size() == 0)
+                return;
+
+            for (size_t bz = changed.zBegin / brickSize_; bz <= (changed.zEnd - 1) / brickSize_; ++bz)
+                for (size_t by = changed.yBegin / brickSize_; by <= (changed.yEnd - 1) / brickSize_; ++by)
+                    for (size_t bx = changed.xBegin / brickSize_; bx <= (changed.xEnd - 1) / brickSize_; ++bx)
+                        dirty_[index(bx, by, bz)] = 1;
+        }
+
+        /// Mark all bricks for recomputation, e.g. after an update of the whole volume
+        void invalidate() { std::fill(dirty_.begin(), dirty_.end(), uint8_t{ 1 }); }
+
+        /// Recompute all invalidated bricks from the volume, returns their number
+        template <typename T, volume_layout Layout>
+        size_t update(const volume<T, Layout>& vol)
+        {
+            if (vol.nx() != grid_.nx() || vol.ny() != grid_.ny() || vol.nz() != grid_.nz())
+                throw std::invalid_argument("occupancy_grid: volume does not match the grid");
+
+            std::vector<size_t> dirty;
+            for (size_t i = 0; i < bricks(); ++i)
+                if (dirty_[i])
+                    dirty.push_back(i);
+
+            parallel_for(0, dirty.size(), [&](size_t j) {
+                const size_t i = dirty[j];
+                const auto v = brickVoxels(i % n_[0], (i / n_[0]) % n_[1], i / (n_[0] * n_[1]));
+
+                float lo = std::numeric_limits<float>::infinity();
+                float hi = -std::numeric_limits<float>::infinity();
+                for (size_t z = v.zBegin; z < v.zEnd; ++z)
+                    for (size_t y = v.yBegin; y < v.yEnd; ++y)
+                        for (size_t x = v.xBegin; x < v.xEnd; ++x) {
+                            auto value = static_cast<float>(vol(x, y, z));
+                            lo = std::min(lo, value);
+                            hi = std::max(hi, value);
+                        }
+
+                min_[i] = lo;
+                max_[i] = hi;
+                occupied_[i] = lo < -threshold_ || hi > threshold_ ? 1 : 0;
+                dirty_[i] = 0;
+            });
+
+            return dirty.size();
+        }
+
+    private:
+        voxel_grid<Scalar> grid_;
+        voxel_grid<Scalar> macroGrid_;
+        size_t brickSize_;
+        float threshold_;
+        size_t n_[3];
+
+        std::vector<float> min_;
+        std::vector<float> max_;
+        std::vector<uint8_t> occupied_; // Bytes instead of bits, written concurrently by update()
+        std::vector<uint8_t> dirty_;
+    };
+
+    /**
+     * Two level version of traverse_cells: the slab test with the volume bounds gives the part of the ray inside the
+     * volume, along it the bricks of the occupancy grid are walked, and only inside the occupied ones the voxels. Calls
+     * f(x, y, z, length) for the voxels of occupied bricks, in ray order.
+     */
+    template <typename Scalar, typename Function>
+    void traverse_occupied(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, const occupancy_grid<Scalar>& occupancy, Function&& f)
+    {
+        auto [tmin, tmax, hit] = intersection(r, grid.bounds(), ray_aabb_interval{});
+        tmin = std::max(tmin, Scalar{ 0 });
+
+        if (!hit || tmax <= tmin)
+            return;
+
+        const long bricksFirst[3] = { 0, 0, 0 };
+        const long bricksLast[3] = { static_cast<long>(occupancy.nx()), static_cast<long>(occupancy.ny()),
+                                     static_cast<long>(occupancy.nz()) };
+
+        // Bricks are visited in ray order, so their entry distance is the sum of the lengths before
+        Scalar t = tmin;
+        auto brick = [&](size_t bx, size_t by, size_t bz, Scalar length) {
+            const Scalar tEnter = t;
+            t += length;
+
+            if (!occupancy.occupied(bx, by, bz))
+                return;
+
+            const auto v = occupancy.brickVoxels(bx, by, bz);
+            const long first[3] = { static_cast<long>(v.xBegin), static_cast<long>(v.yBegin), static_cast<long>(v.zBegin) };
+            const long last[3] = { static_cast<long>(v.xEnd), static_cast<long>(v.yEnd), static_cast<long>(v.zEnd) };
+            details::walk_cells(r, grid, tEnter, std::min(t, tmax), first, last, f);
+        };
+        details::walk_cells(r, occupancy.macroGrid(), tmin, tmax, bricksFirst, bricksLast, brick);
+    }
+
+    /// Line integral of the volume along the ray, skipping empty bricks
+    template <typename Scalar, typename T, volume_layout Layout>
+    Scalar project(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, const volume<T, Layout>& vol,
+                   const occupancy_grid<Scalar>& occupancy)
+    {
+        Scalar sum = 0;
+        traverse_occupied(r, grid, occupancy,
+                          [&](size_t x, size_t y, size_t z, Scalar length) { sum += length * static_cast<Scalar>(vol(x, y, z)); });
+        return sum;
+    }
+} // namespace tomosect
@@ -0,0 +1,189 @@
+/**
+ *
+ * \file out_of_core.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/roi.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /// Range of detector rows [first, second) the box projects onto, see project_box
+    template <typename Scalar>
+    std::pair<size_t, size_t> detector_rows(const projection_matrix<Scalar>& P, const aabb<Scalar>& box, size_t numRows)
+    {
+        // Columns do not matter here
+        auto window = project_box(P, box, 1, numRows);
+        return { window.rowBegin, window.rowEnd };
+    }
+
+    /// A slab of z-slices and the detector rows each view needs for it
+    struct volume_slab {
+        size_t zBegin;
+        size_t zEnd;
+        std::vector<std::pair<size_t, size_t>> rows; // Per view
+        size_t numRows = 0;                          // Sum over all views
+    };
+
+    /**
+     * Decomposition of the volume into slabs of equal thickness (the last one might be thinner), as thick as the memory
+     * budget allows. Peak memory of an out-of-core reconstruction is one slab of voxels plus two sets of filtered
+     * detector rows, one being backprojected while the other one is loaded.
+     */
+    template <typename Scalar>
+    class slab_plan
+    {
+    public:
+        slab_plan(const circular_trajectory<Scalar>& trajectory, const voxel_grid<Scalar>& grid, size_t memoryBudget)
+        {
+            std::vector<projection_matrix<Scalar>> matrices;
+            for (size_t k = 0; k < trajectory.numViews; ++k)
+                matrices.push_back(trajectory.view(k).projectionMatrix());
+
+            for (size_t thickness = grid.nz(); thickness > 0; thickness = thickness == 1 ? 0 : (thickness + 1) / 2) {
+                std::vector<volume_slab> slabs;
+                size_t maxRows = 0;
+
+                for (size_t z = 0; z < grid.nz(); z += thickness) {
+                    volume_slab slab{ z, std::min(z + thickness, grid.nz()), {} };
+
+                    auto lo = grid.min();
+                    auto box = aabb<Scalar>(point3<Scalar>(lo.x(), lo.y(), lo.z() + static_cast<Scalar>(slab.zBegin) * grid.spacing().z()),
+                                            point3<Scalar>(grid.bounds().max().x(), grid.bounds().max().y(),
+                                                           lo.z() + static_cast<Scalar>(slab.zEnd) * grid.spacing().z()));
+
+                    for (const auto& P : matrices) {
+                        slab.rows.push_back(detector_rows(P, box, trajectory.rows));
+                        slab.numRows += slab.rows.back().second - slab.rows.back().first;
+                    }
+
+                    maxRows = std::max(maxRows, slab.numRows);
+                    slabs.push_back(std::move(slab));
+                }
+
+                size_t memory = (grid.nx() * grid.ny() * thickness + 2 * maxRows * trajectory.cols) * sizeof(float);
+                if (memory <= memoryBudget) {
+                    slabs_ = std::move(slabs);
+                    thickness_ = thickness;
+                    maxRows_ = maxRows;
+                    memoryUsage_ = memory;
+                    return;
+                }
+            }
+
+            throw std::length_error("slab_plan: memory budget is too small for a single slice");
+        }
+
+        const std::vector<volume_slab>& slabs() const { return slabs_; }
+
+        size_t thickness() const { return thickness_; }
+
+        /// Largest number of detector rows (over all views) of a slab
+        size_t maxRows() const { return maxRows_; }
+
+        /// Peak memory of the reconstruction in bytes
+        size_t memoryUsage() const { return memoryUsage_; }
+
+    private:
+        std::vector<volume_slab> slabs_;
+        size_t thickness_ = 0;
+        size_t maxRows_ = 0;
+        size_t memoryUsage_ = 0;
+    };
+
+    /**
+     * FDK reconstruction for volumes and projection stacks larger than memory, typically both memory mapped (see
+     * map_projections and create_volume). The volume is processed in z-slabs sized to the memory budget, for each slab
+     * only the detector rows it projects onto are read and filtered. Loading and filtering the rows of the next slab
+     * runs in the background while the current slab is backprojected. The result overwrites the output volume.
+     */
+    template <typename Scalar, typename T>
+    void fdk_out_of_core(const circular_trajectory<Scalar>& trajectory, const projection_stack<T>& projections,
+                         const voxel_grid<Scalar>& grid, volume<float>& output, size_t memoryBudget)
+    {
+        if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows || projections.numViews() != trajectory.numViews)
+            throw std::invalid_argument("fdk_out_of_core: projections do not match the trajectory");
+
+        if (output.nx() != grid.nx() || output.ny() != grid.ny() || output.nz() != grid.nz())
+            throw std::invalid_argument("fdk_out_of_core: output volume does not match the grid");
+
+        const size_t cols = trajectory.cols;
+        const size_t sliceSize = grid.nx() * grid.ny();
+
+        slab_plan<Scalar> plan(trajectory, grid, memoryBudget);
+        fdk_filter<Scalar> filter(trajectory);
+
+        std::vector<projection_matrix<Scalar>> matrices;
+        for (size_t k = 0; k < trajectory.numViews; ++k)
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+
+        // Filtered rows of two slabs, one being loaded while the other is backprojected
+        std::vector<float> buffers[2] = { std::vector<float>(plan.maxRows() * cols), std::vector<float>(plan.maxRows() * cols) };
+        std::vector<filtered_rows> rows[2];
+
+        // Loading mostly waits for I/O, a few threads are enough to keep the disk busy
+        const size_t loadThreads = std::max<size_t>(1, hardware_threads() / 4);
+
+        auto load = [&](size_t s, int b) {
+            const auto& slab = plan.slabs()[s];
+
+            std::vector<float*> targets;
+            rows[b].clear();
+
+            float* target = buffers[b].data();
+            for (const auto& [first, last] : slab.rows) {
+                targets.push_back(target);
+                rows[b].push_back({ target, first, last });
+                target += (last - first) * cols;
+            }
+
+            // Let the OS read all needed rows at once, before touching them one view at a time
+            for (size_t k = 0; k < slab.rows.size(); ++k) {
+                const auto [first, last] = slab.rows[k];
+                prefetch(projections.view(k) + first * cols, (last - first) * cols * sizeof(float));
+            }
+
+            parallel_for(
+                0, slab.rows.size(),
+                [&](size_t k) {
+                    const auto& r = rows[b][k];
+                    filter.filterRows(projections.view(k) + r.rowBegin * cols, targets[k], r.rowBegin, r.rowEnd);
+                },
+                1, loadThreads);
+        };
+
+        auto next = std::async(std::launch::async, load, size_t{ 0 }, 0);
+
+        for (size_t s = 0; s < plan.slabs().size(); ++s) {
+            next.get();
+
+            int b = static_cast<int>(s % 2);
+            if (s + 1 < plan.slabs().size())
+                next = std::async(std::launch::async, load, s + 1, 1 - b);
+
+            const auto& slab = plan.slabs()[s];
+            float* out = output.data() + slab.zBegin * sliceSize;
+
+            std::fill(out, out + (slab.zEnd - slab.zBegin) * sliceSize, 0.f);
+            backproject(matrices, rows[b], cols, fdk_scale(trajectory), grid, slab.zBegin, slab.zEnd, out);
+        }
+    }
+} // namespace tomosect
@@ -0,0 +1,87 @@
+/**
+ *
+ * \file parallel.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tomosect
+{
+    /// Number of worker threads used by default, at least one
+    inline size_t hardware_threads()
+    {
+        auto n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : static_cast<size_t>(n);
+    }
+
+    /**
+     * Call f(i) for every i in [begin, end) on a pool of threads. Indices are handed out dynamically in chunks of `grain`, so
+     * uneven work per index (e.g. rays missing the volume) still balances. The first exception thrown by any worker is
+     * rethrown on the calling thread.
+     *
+     * @param begin first index
+     * @param end one past the last index
+     * @param f callable taking a size_t
+     * @param grain number of consecutive indices a worker takes at once
+     * @param numThreads number of threads, 0 means hardware_threads()
+     */
+    template <typename Function>
+    void parallel_for(size_t begin, size_t end, Function&& f, size_t grain = 1, size_t numThreads = 0)
+    {
+        if (end <= begin)
+            return;
+
+        grain = std::max<size_t>(grain, 1);
+        numThreads = numThreads == 0 ? hardware_threads() : numThreads;
+        numThreads = std::min(numThreads, (end - begin + grain - 1) / grain);
+
+        std::atomic<size_t> next{ begin };
+        std::exception_ptr error = nullptr;
+        std::mutex errorMutex;
+
+        auto worker = [&]() {
+            try {
+                for (;;) {
+                    size_t first = next.fetch_add(grain);
+                    if (first >= end)
+                        return;
+
+                    size_t last = std::min(first + grain, end);
+                    for (size_t i = first; i < last; ++i)
+                        f(i);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+
+                // Make the remaining workers run out of work
+                next.store(end);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads - 1);
+        for (size_t t = 1; t < numThreads; ++t)
+            threads.emplace_back(worker);
+
+        // The calling thread works as well
+        worker();
+
+        for (auto& t : threads)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+} // namespace tomosect
@@ -0,0 +1,148 @@
+/**
+ *
+ * \file phantom.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/csg.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/quadric.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/vector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Analytic phantom as sum of ellipsoids, cylinders and CSG objects, each adding its attenuation to the points inside
+     * it (as in the Shepp-Logan phantom, where inner shapes have negative values to carve out the outer ones). Line
+     * integrals are exact: the sum over all shapes of attenuation times chord length.
+     */
+    template <typename Scalar>
+    class analytic_phantom
+    {
+    public:
+        template <typename Shape>
+        struct component {
+            Shape shape;
+            Scalar attenuation;
+        };
+
+        void add(const ellipsoid<Scalar>& shape, Scalar attenuation) { ellipsoids_.push_back({ shape, attenuation }); }
+        void add(const cylinder<Scalar>& shape, Scalar attenuation) { cylinders_.push_back({ shape, attenuation }); }
+        void add(const csg_tree<Scalar>& shape, Scalar attenuation) { objects_.push_back({ shape, attenuation }); }
+
+        size_t size() const { return ellipsoids_.size() + cylinders_.size() + objects_.size(); }
+        bool empty() const { return size() == 0; }
+
+        const std::vector<component<ellipsoid<Scalar>>>& ellipsoids() const { return ellipsoids_; }
+        const std::vector<component<cylinder<Scalar>>>& cylinders() const { return cylinders_; }
+        const std::vector<component<csg_tree<Scalar>>>& objects() const { return objects_; }
+
+        /// Line integral of every lane of the ray, starting at its origin
+        template <typename Value>
+        Value lineIntegral(const ray<Value>& r) const
+        {
+            Value o[3], d[3];
+            details::ray_components(r, o, d);
+
+            // The ray is transformed once per shape, all lanes at once
+            Value sum = Value(0);
+            for (const auto& e : ellipsoids_) {
+                auto [tEnter, tExit, mask] = details::ellipsoid_interval(e.shape.transform(), o, d);
+                if (enoki::any(mask))
+                    sum += e.attenuation * details::chord_length(tEnter, tExit, mask);
+            }
+            for (const auto& c : cylinders_) {
+                auto [tEnter, tExit, mask] = details::cylinder_interval(c.shape.transform(), o, d);
+                if (enoki::any(mask))
+                    sum += c.attenuation * details::chord_length(tEnter, tExit, mask);
+            }
+            for (const auto& object : objects_)
+                sum += object.attenuation * object.shape.pathLength(o, d);
+            return sum;
+        }
+
+        /// Attenuation at a point
+        Scalar value(const std::array<Scalar, 3>& p) const
+        {
+            Scalar sum = 0;
+            for (const auto& e : ellipsoids_)
+                if (e.shape.contains(p))
+                    sum += e.attenuation;
+            for (const auto& c : cylinders_)
+                if (c.shape.contains(p))
+                    sum += c.attenuation;
+            for (const auto& object : objects_)
+                if (object.shape.contains(p))
+                    sum += object.attenuation;
+            return sum;
+        }
+
+    private:
+        std::vector<component<ellipsoid<Scalar>>> ellipsoids_;
+        std::vector<component<cylinder<Scalar>>> cylinders_;
+        std::vector<component<csg_tree<Scalar>>> objects_;
+    };
+
+    /**
+     * Modified 3D Shepp-Logan phantom (Kak & Slaney, with the higher contrast of Toft) inside the cube [-1, 1]^3,
+     * scaled by the given factor. Centers are given in world coordinates.
+     */
+    template <typename Scalar>
+    analytic_phantom<Scalar> shepp_logan_phantom(Scalar scale = 1)
+    {
+        // attenuation, semi-axes a b c, center x y z, Euler angles phi theta psi in degrees
+        constexpr double table[10][10] = { { 1.0, 0.6900, 0.920, 0.810, 0, 0, 0, 0, 0, 0 },
+                                           { -0.8, 0.6624, 0.874, 0.780, 0, -0.0184, 0, 0, 0, 0 },
+                                           { -0.2, 0.1100, 0.310, 0.220, 0.22, 0, 0, -18, 0, 10 },
+                                           { -0.2, 0.1600, 0.410, 0.280, -0.22, 0, 0, 18, 0, 10 },
+                                           { 0.1, 0.2100, 0.250, 0.410, 0, 0.35, -0.15, 0, 0, 0 },
+                                           { 0.1, 0.0460, 0.046, 0.050, 0, 0.1, 0.25, 0, 0, 0 },
+                                           { 0.1, 0.0460, 0.046, 0.050, 0, -0.1, 0.25, 0, 0, 0 },
+                                           { 0.1, 0.0460, 0.023, 0.050, -0.08, -0.605, 0, 0, 0, 0 },
+                                           { 0.1, 0.0230, 0.023, 0.020, 0, -0.606, 0, 0, 0, 0 },
+                                           { 0.1, 0.0230, 0.046, 0.020, 0.06, -0.605, 0, 0, 0, 0 } };
+
+        auto s = [](double v) { return static_cast<Scalar>(v); };
+        const double degree = M_PI / 180;
+
+        analytic_phantom<Scalar> phantom;
+        for (const auto& row : table) {
+            std::array<Scalar, 3> semiAxes = { s(scale * row[1]), s(scale * row[2]), s(scale * row[3]) };
+            std::array<Scalar, 3> center = { s(scale * row[4]), s(scale * row[5]), s(scale * row[6]) };
+            std::array<Scalar, 3> angles = { s(row[7] * degree), s(row[8] * degree), s(row[9] * degree) };
+            phantom.add(ellipsoid<Scalar>(center, semiAxes, angles), s(row[0]));
+        }
+        return phantom;
+    }
+
+    /**
+     * Line integrals through the phantom of all rays of a view, in row major order into out (cols * rows values). Rows
+     * are processed in parallel, with rays in packets of 8 neighbouring pixels.
+     */
+    template <typename Scalar>
+    void project_phantom(const projection_view<Scalar>& view, const analytic_phantom<Scalar>& phantom, float* out)
+    {
+        using Value = pack8<Scalar>;
+        constexpr size_t lanes = 8;
+
+        const size_t cols = view.cols();
+        parallel_for(0, view.rows(), [&](size_t row) {
+            for (size_t col = 0; col < cols; col += lanes) {
+                const size_t n = std::min(lanes, cols - col);
+                const Value integral = phantom.lineIntegral(view.template pixelPacket<Value>(col, row, n));
+                for (size_t lane = 0; lane < n; ++lane)
+                    out[row * cols + col + lane] = static_cast<float>(integral[lane]);
+            }
+        });
+    }
+} // namespace tomosect
@@ -0,0 +1,191 @@
+/**
+ *
+ * \file pipeline.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/spsc_queue.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tomosect
+{
+    struct pipeline_options {
+        /// Projections in flight between two stages, bounds memory to about 2 * queueDepth + batchSize projections
+        size_t queueDepth = 4;
+
+        /// Number of views backprojected together, when that many are ready
+        size_t batchSize = 4;
+
+        /// Threads filtering rows of a single projection, 0 for half of the hardware threads
+        size_t filterThreads = 0;
+    };
+
+    /**
+     * FDK reconstruction as a pipeline of three stages: loading, weighting/filtering and backprojection, each running
+     * on its own thread and connected by bounded lock-free queues. Buffers cycle between the stages, so a slow stage
+     * makes the ones before it wait instead of piling up projections. load(k, dst) has to write projection k
+     * (cols * rows values) to dst, views are loaded in order.
+     */
+    template <typename Scalar, typename Loader, typename = std::enable_if_t<std::is_invocable_v<Loader&, size_t, float*>>>
+    volume<float> fdk_pipelined(const circular_trajectory<Scalar>& trajectory, Loader&& load, const voxel_grid<Scalar>& grid,
+                                const pipeline_options& options = {})
+    {
+        struct item {
+            size_t view;
+            size_t buffer;
+        };
+
+        const size_t pixels = trajectory.cols * trajectory.rows;
+        const size_t depth = std::max<size_t>(1, options.queueDepth);
+        const size_t batch = std::max<size_t>(1, options.batchSize);
+        const size_t filterThreads = options.filterThreads == 0 ? std::max<size_t>(1, hardware_threads() / 2) : options.filterThreads;
+
+        fdk_filter<Scalar> filter(trajectory);
+
+        std::vector<std::vector<float>> raw(depth, std::vector<float>(pixels));
+        std::vector<std::vector<float>> filtered(depth + batch, std::vector<float>(pixels));
+
+        // Loaded and filtered projections flow forward, emptied buffers flow back
+        spsc_queue<item> loadedQueue(depth);
+        spsc_queue<item> filteredQueue(depth + batch);
+        spsc_queue<size_t> freeRaw(raw.size());
+        spsc_queue<size_t> freeFiltered(filtered.size());
+
+        for (size_t i = 0; i < raw.size(); ++i)
+            freeRaw.tryPush(i);
+        for (size_t i = 0; i < filtered.size(); ++i)
+            freeFiltered.tryPush(i);
+
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto fail = [&](std::exception_ptr e) {
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = e;
+            }
+            loadedQueue.close();
+            filteredQueue.close();
+            freeRaw.close();
+            freeFiltered.close();
+        };
+
+        std::thread reader([&] {
+            try {
+                for (size_t k = 0; k < trajectory.numViews; ++k) {
+                    auto buffer = freeRaw.pop();
+                    if (!buffer)
+                        return;
+
+                    load(k, raw[*buffer].data());
+
+                    if (!loadedQueue.push({ k, *buffer }))
+                        return;
+                }
+                loadedQueue.close();
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        });
+
+        std::thread filterer([&] {
+            try {
+                while (auto in = loadedQueue.pop()) {
+                    auto out = freeFiltered.pop();
+                    if (!out)
+                        return;
+
+                    const float* src = raw[in->buffer].data();
+                    float* dst = filtered[*out].data();
+
+                    // Blocks of rows in parallel
+                    const size_t blocks = std::min(filterThreads, trajectory.rows);
+                    parallel_for(
+                        0, blocks,
+                        [&](size_t b) {
+                            size_t first = trajectory.rows * b / blocks;
+                            size_t last = trajectory.rows * (b + 1) / blocks;
+                            filter.filterRows(src + first * trajectory.cols, dst + first * trajectory.cols, first, last);
+                        },
+                        1, blocks);
+
+                    if (!freeRaw.push(in->buffer) || !filteredQueue.push({ in->view, *out }))
+                        return;
+                }
+                filteredQueue.close();
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        });
+
+        volume<float> result(grid.nx(), grid.ny(), grid.nz());
+
+        try {
+            std::vector<item> ready;
+            std::vector<projection_matrix<Scalar>> matrices;
+            std::vector<filtered_rows> rows;
+
+            while (auto first = filteredQueue.pop()) {
+                ready.assign(1, *first);
+                while (ready.size() < batch) {
+                    auto next = filteredQueue.tryPop();
+                    if (!next)
+                        break;
+                    ready.push_back(*next);
+                }
+
+                matrices.clear();
+                rows.clear();
+                for (const auto& r : ready) {
+                    matrices.push_back(trajectory.view(r.view).projectionMatrix());
+                    rows.push_back({ filtered[r.buffer].data(), 0, trajectory.rows });
+                }
+
+                backproject(matrices, rows, trajectory.cols, fdk_scale(trajectory), grid, 0, grid.nz(), result.data());
+
+                for (const auto& r : ready)
+                    freeFiltered.push(r.buffer);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+
+        reader.join();
+        filterer.join();
+
+        if (error)
+            std::rethrow_exception(error);
+
+        return result;
+    }
+
+    /// Pipelined FDK reading from a (typically memory mapped) projection stack
+    template <typename Scalar, typename T>
+    volume<float> fdk_pipelined(const circular_trajectory<Scalar>& trajectory, const projection_stack<T>& projections,
+                                const voxel_grid<Scalar>& grid, const pipeline_options& options = {})
+    {
+        if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows || projections.numViews() != trajectory.numViews)
+            throw std::invalid_argument("fdk_pipelined: projections do not match the trajectory");
+
+        auto load = [&](size_t k, float* dst) { std::copy(projections.view(k), projections.view(k) + projections.pixelsPerView(), dst); };
+        return fdk_pipelined(trajectory, load, grid, options);
+    }
+} // namespace tomosect
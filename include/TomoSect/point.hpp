@@ -8,8 +8,8 @@
 #pragma once
 
 #include "enoki/array.h"
-#include "enoki/random.h"
 
+#include "TomoSect/random.hpp"
 #include "TomoSect/vector.hpp"
 
 template <size_t Size, typename Value>
@@ -94,20 +94,21 @@ public:
 
     Vector data() const { return data_; }
 
-    static Self Random()
-    {
-        using RNG_16x = enoki::PCG32<Vector>;
-        RNG_16x my_rng;
-
-        if constexpr (std::is_same_v<Type, float>) {
-            Self point(my_rng.next_float32());
+    /// Random point with components in [0, 1) (any value for integers), from the generator of the calling thread
+    static Self Random() { return Random(tomosect::thread_random_stream<Value>()); }
 
-            return point;
-        } else if constexpr (std::is_same_v<Type, int>) {
-            Self point(my_rng.next_uint32());
-
-            return point;
+    /// Random point drawn from the given stream
+    template <typename Stream>
+    static Self Random(Stream& stream)
+    {
+        Vector v;
+        for (size_t i = 0; i < Size; ++i) {
+            if constexpr (std::is_floating_point_v<Type>)
+                v[i] = stream.uniform();
+            else
+                v[i] = Value(stream.next_uint32());
         }
+        return Self(v);
     }
 
 private:
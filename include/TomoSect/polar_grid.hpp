@@ -0,0 +1,182 @@
+/**
+ *
+ * \file polar_grid.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Cylindrical voxel grid around the z-axis: nr rings of equal width, nphi angular sectors starting at angle 0 and
+     * nz slices along z. Cells are numbered with the angle as fastest running index: index = phi + nphi * (r + nr * z),
+     * so rotating the volume by whole sectors only permutes the phi part of the index.
+     */
+    template <typename Scalar>
+    class polar_grid
+    {
+    public:
+        polar_grid(size_t nr, size_t nphi, size_t nz, Scalar radius, Scalar zmin, Scalar sliceThickness)
+            : nr_(nr), nphi_(nphi), nz_(nz), radius_(radius), zmin_(zmin), dz_(sliceThickness)
+        {
+        }
+
+        size_t nr() const { return nr_; }
+        size_t nphi() const { return nphi_; }
+        size_t nz() const { return nz_; }
+
+        /// Number of cells
+        size_t size() const { return nr_ * nphi_ * nz_; }
+
+        size_t index(size_t r, size_t phi, size_t z) const { return phi + nphi_ * (r + nr_ * z); }
+
+        Scalar radius() const { return radius_; }
+        Scalar zmin() const { return zmin_; }
+        Scalar zmax() const { return zmin_ + dz_ * static_cast<Scalar>(nz_); }
+
+        Scalar ringWidth() const { return radius_ / static_cast<Scalar>(nr_); }
+        Scalar sectorAngle() const { return static_cast<Scalar>(2 * M_PI) / static_cast<Scalar>(nphi_); }
+        Scalar sliceThickness() const { return dz_; }
+
+        /// Index of the cell the given cell moves to, if the volume is rotated by the given number of sectors
+        size_t rotate(size_t index, long sectors) const
+        {
+            auto n = static_cast<long>(nphi_);
+            auto phi = static_cast<long>(index % nphi_);
+            auto shifted = ((phi + sectors) % n + n) % n;
+            return index - static_cast<size_t>(phi) + static_cast<size_t>(shifted);
+        }
+
+        /// Index of the cell containing the point, the point is expected to be inside the grid
+        size_t cellOf(const point3<Scalar>& p) const
+        {
+            auto r = std::hypot(p.x(), p.y());
+            auto phi = std::atan2(p.y(), p.x());
+            if (phi < 0)
+                phi += static_cast<Scalar>(2 * M_PI);
+
+            auto ir = std::min(static_cast<size_t>(r / ringWidth()), nr_ - 1);
+            auto iphi = std::min(static_cast<size_t>(phi / sectorAngle()), nphi_ - 1);
+            auto iz = static_cast<size_t>(std::clamp(std::floor((p.z() - zmin_) / dz_), Scalar{ 0 }, static_cast<Scalar>(nz_ - 1)));
+
+            return index(ir, iphi, iz);
+        }
+
+    private:
+        size_t nr_;
+        size_t nphi_;
+        size_t nz_;
+        Scalar radius_;
+        Scalar zmin_;
+        Scalar dz_;
+    };
+
+    /**
+     * Call f(cellIndex, length) for every cell of the polar grid the ray passes through, in ray order. Unlike the
+     * regular grid, cell boundaries are not equidistant along the ray, so all crossings with rings, sector half-planes
+     * and slices inside the cylinder are collected and sorted first (Siddon).
+     */
+    template <typename Scalar, typename Function>
+    void traverse(const ray<Scalar>& r, const polar_grid<Scalar>& grid, Function&& f)
+    {
+        const Scalar ox = r.origin().x(), oy = r.origin().y(), oz = r.origin().z();
+        const Scalar dx = r.dir().x(), dy = r.dir().y(), dz = r.dir().z();
+        constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+
+        // Interval inside the outer cylinder
+        Scalar a = dx * dx + dy * dy;
+        Scalar b = ox * dx + oy * dy;
+        Scalar tmin = -inf;
+        Scalar tmax = inf;
+
+        if (a > 0) {
+            Scalar disc = b * b - a * (ox * ox + oy * oy - grid.radius() * grid.radius());
+            if (disc <= 0)
+                return;
+
+            Scalar root = std::sqrt(disc);
+            tmin = (-b - root) / a;
+            tmax = (-b + root) / a;
+        } else if (ox * ox + oy * oy >= grid.radius() * grid.radius()) {
+            return;
+        }
+
+        // Intersect with the slab between the bottom and top slice
+        if (dz != 0) {
+            Scalar t0 = (grid.zmin() - oz) / dz;
+            Scalar t1 = (grid.zmax() - oz) / dz;
+            tmin = std::max(tmin, std::min(t0, t1));
+            tmax = std::min(tmax, std::max(t0, t1));
+        } else if (oz < grid.zmin() || oz >= grid.zmax()) {
+            return;
+        }
+
+        tmin = std::max(tmin, Scalar{ 0 });
+        if (tmax <= tmin)
+            return;
+
+        std::vector<Scalar> ts{ tmin, tmax };
+        auto add = [&](Scalar t) {
+            if (t > tmin && t < tmax)
+                ts.push_back(t);
+        };
+
+        // Inner rings
+        if (a > 0) {
+            for (size_t i = 1; i < grid.nr(); ++i) {
+                Scalar ri = grid.ringWidth() * static_cast<Scalar>(i);
+                Scalar disc = b * b - a * (ox * ox + oy * oy - ri * ri);
+                if (disc <= 0)
+                    continue;
+
+                Scalar root = std::sqrt(disc);
+                add((-b - root) / a);
+                add((-b + root) / a);
+            }
+        }
+
+        // Sector boundaries are half-planes starting at the axis, only crossings on the correct half count
+        if (grid.nphi() > 1) {
+            for (size_t j = 0; j < grid.nphi(); ++j) {
+                Scalar theta = grid.sectorAngle() * static_cast<Scalar>(j);
+                Scalar c = std::cos(theta);
+                Scalar s = std::sin(theta);
+
+                Scalar denom = dy * c - dx * s;
+                if (denom == 0)
+                    continue;
+
+                Scalar t = (ox * s - oy * c) / denom;
+                if ((ox + t * dx) * c + (oy + t * dy) * s > 0)
+                    add(t);
+            }
+        }
+
+        // Inner slices
+        if (dz != 0) {
+            for (size_t k = 1; k < grid.nz(); ++k)
+                add((grid.zmin() + grid.sliceThickness() * static_cast<Scalar>(k) - oz) / dz);
+        }
+
+        std::sort(ts.begin(), ts.end());
+
+        for (size_t i = 0; i + 1 < ts.size(); ++i) {
+            Scalar length = ts[i + 1] - ts[i];
+            if (length <= 0)
+                continue;
+
+            Scalar tm = (ts[i] + ts[i + 1]) / 2;
+            f(grid.cellOf(point3<Scalar>(ox + tm * dx, oy + tm * dy, oz + tm * dz)), length);
+        }
+    }
+} // namespace tomosect
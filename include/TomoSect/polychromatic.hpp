@@ -0,0 +1,322 @@
+/**
+ *
+ * \file polychromatic.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tomosect
+{
+    namespace details
+    {
+        /// Numeric CSV file with an optional header line, comments start with '#'
+        struct csv_table {
+            std::vector<std::string> header;
+            std::vector<std::vector<double>> rows;
+        };
+
+        inline std::vector<std::string> split_csv_line(const std::string& line)
+        {
+            std::vector<std::string> fields;
+            std::istringstream in(line);
+            std::string field;
+            while (std::getline(in, field, ',')) {
+                const auto begin = field.find_first_not_of(" \t\r");
+                const auto end = field.find_last_not_of(" \t\r");
+                fields.push_back(begin == std::string::npos ? std::string() : field.substr(begin, end - begin + 1));
+            }
+            return fields;
+        }
+
+        inline csv_table read_csv(const std::string& path, const std::string& caller)
+        {
+            mapped_file file(path, map_options{ map_access::sequential });
+            std::istringstream in(file.size() > 0 ? std::string(file.at<char>(0), file.size()) : std::string());
+
+            csv_table table;
+            std::string line;
+            size_t lineNumber = 0;
+            while (std::getline(in, line)) {
+                ++lineNumber;
+                const auto fields = split_csv_line(line.substr(0, line.find('#')));
+                if (fields.empty() || (fields.size() == 1 && fields[0].empty()))
+                    continue;
+
+                std::vector<double> values;
+                for (const auto& f : fields) {
+                    char* end = nullptr;
+                    const double v = std::strtod(f.c_str(), &end);
+                    if (f.empty() || *end != '\0')
+                        break;
+                    values.push_back(v);
+                }
+
+                if (values.size() != fields.size()) {
+                    // Only the first line may be a header
+                    if (!table.header.empty() || !table.rows.empty())
+                        throw std::runtime_error(caller + ": invalid number in line " + std::to_string(lineNumber) + " of " + path);
+                    table.header = fields;
+                    continue;
+                }
+
+                const size_t columns =
+                    table.header.empty() ? (table.rows.empty() ? values.size() : table.rows[0].size()) : table.header.size();
+                if (values.size() != columns)
+                    throw std::runtime_error(caller + ": wrong number of columns in line " + std::to_string(lineNumber) + " of " + path);
+                table.rows.push_back(std::move(values));
+            }
+
+            if (table.rows.empty())
+                throw std::runtime_error(caller + ": no data in " + path);
+            return table;
+        }
+
+        /// Energies of the first column, checked to increase strictly
+        inline void check_energies(const csv_table& table, const std::string& caller, const std::string& path)
+        {
+            for (size_t i = 0; i < table.rows.size(); ++i) {
+                if (!(table.rows[i][0] > 0) || (i > 0 && !(table.rows[i][0] > table.rows[i - 1][0])))
+                    throw std::runtime_error(caller + ": energies must be positive and increasing in " + path);
+            }
+        }
+    } // namespace details
+
+    /// Source spectrum: photon counts (or relative weights) per energy bin
+    template <typename Scalar>
+    struct spectrum {
+        std::vector<Scalar> energies; // keV, increasing
+        std::vector<Scalar> weights;
+
+        size_t size() const { return energies.size(); }
+    };
+
+    /// Spectrum from a CSV file with two columns, energy in keV and weight
+    template <typename Scalar = float>
+    spectrum<Scalar> load_spectrum(const std::string& path)
+    {
+        const auto table = details::read_csv(path, "load_spectrum");
+        if (table.rows[0].size() != 2)
+            throw std::runtime_error("load_spectrum: expected energy and weight columns in " + path);
+        details::check_energies(table, "load_spectrum", path);
+
+        spectrum<Scalar> result;
+        for (const auto& row : table.rows) {
+            if (row[1] < 0)
+                throw std::runtime_error("load_spectrum: negative weight in " + path);
+            result.energies.push_back(static_cast<Scalar>(row[0]));
+            result.weights.push_back(static_cast<Scalar>(row[1]));
+        }
+        return result;
+    }
+
+    /**
+     * Linear attenuation coefficients of several materials, tabulated over energy. Units are up to the caller, but
+     * have to be the inverse of the units of the path lengths.
+     */
+    template <typename Scalar>
+    class material_table
+    {
+    public:
+        material_table(std::vector<std::string> names, std::vector<Scalar> energies, std::vector<std::vector<Scalar>> attenuation)
+            : names_(std::move(names)), energies_(std::move(energies)), attenuation_(std::move(attenuation))
+        {
+            if (energies_.empty() || attenuation_.size() != names_.size())
+                throw std::invalid_argument("material_table: need energies and one attenuation curve per material");
+            for (const auto& curve : attenuation_)
+                if (curve.size() != energies_.size())
+                    throw std::invalid_argument("material_table: attenuation curves must have one value per energy");
+        }
+
+        size_t numMaterials() const { return names_.size(); }
+        const std::vector<std::string>& names() const { return names_; }
+        const std::vector<Scalar>& energies() const { return energies_; }
+
+        /// Index of the material with the given name
+        size_t index(const std::string& name) const
+        {
+            auto it = std::find(names_.begin(), names_.end(), name);
+            if (it == names_.end())
+                throw std::out_of_range("material_table: no material " + name);
+            return static_cast<size_t>(it - names_.begin());
+        }
+
+        /// Attenuation at any energy, linearly interpolated and clamped to the tabulated range
+        Scalar attenuation(size_t material, Scalar energy) const
+        {
+            const auto& curve = attenuation_[material];
+            if (energy <= energies_.front())
+                return curve.front();
+            if (energy >= energies_.back())
+                return curve.back();
+
+            const size_t i = static_cast<size_t>(std::upper_bound(energies_.begin(), energies_.end(), energy) - energies_.begin());
+            const Scalar w = (energy - energies_[i - 1]) / (energies_[i] - energies_[i - 1]);
+            return (1 - w) * curve[i - 1] + w * curve[i];
+        }
+
+    private:
+        std::vector<std::string> names_;
+        std::vector<Scalar> energies_;
+        std::vector<std::vector<Scalar>> attenuation_; // One curve per material
+    };
+
+    /// Materials from a CSV file: a header "energy, name, name, ..." and one line per energy in keV
+    template <typename Scalar = float>
+    material_table<Scalar> load_materials(const std::string& path)
+    {
+        const auto table = details::read_csv(path, "load_materials");
+        if (table.header.size() < 2)
+            throw std::runtime_error("load_materials: expected a header with energy and material names in " + path);
+        details::check_energies(table, "load_materials", path);
+
+        std::vector<std::string> names(table.header.begin() + 1, table.header.end());
+        std::vector<Scalar> energies;
+        std::vector<std::vector<Scalar>> attenuation(names.size());
+        for (const auto& row : table.rows) {
+            energies.push_back(static_cast<Scalar>(row[0]));
+            for (size_t m = 0; m < names.size(); ++m)
+                attenuation[m].push_back(static_cast<Scalar>(row[m + 1]));
+        }
+        return material_table<Scalar>(std::move(names), std::move(energies), std::move(attenuation));
+    }
+
+    /**
+     * Polychromatic forward model: the detected intensity of a ray with path length L_m through material m is
+     * sum_E S(E) * exp(-sum_m mu_m(E) * L_m). The attenuation is resampled at the energies of the spectrum and stored
+     * per material, padded to whole packets, so the sum runs over packets of energy bins.
+     */
+    template <typename Scalar>
+    class polychromatic_model
+    {
+    public:
+        using Packet = pack8<Scalar>;
+        static constexpr size_t lanes = 8;
+
+        /// Upper limit of materials in a model
+        static constexpr size_t max_materials = 64;
+
+        polychromatic_model(const spectrum<Scalar>& source, const material_table<Scalar>& materials)
+            : bins_(source.size()), padded_((bins_ + lanes - 1) / lanes * lanes), materials_(materials.numMaterials())
+        {
+            if (source.energies.empty() || source.weights.size() != source.energies.size())
+                throw std::invalid_argument("polychromatic_model: spectrum needs one weight per energy");
+            if (materials_ > max_materials)
+                throw std::invalid_argument("polychromatic_model: at most " + std::to_string(max_materials) + " materials");
+
+            // Padded bins have zero weight, so they do not contribute
+            weights_.assign(padded_, Scalar(0));
+            std::copy(source.weights.begin(), source.weights.end(), weights_.begin());
+            flat_ = 0;
+            for (auto w : source.weights)
+                flat_ += w;
+            if (!(flat_ > 0))
+                throw std::invalid_argument("polychromatic_model: spectrum weights must have a positive sum");
+
+            attenuation_.assign(materials_ * padded_, Scalar(0));
+            for (size_t m = 0; m < materials_; ++m)
+                for (size_t e = 0; e < bins_; ++e)
+                    attenuation_[m * padded_ + e] = materials.attenuation(m, source.energies[e]);
+        }
+
+        size_t numBins() const { return bins_; }
+        size_t numMaterials() const { return materials_; }
+
+        /// Intensity without any object in the beam
+        Scalar flatField() const { return flat_; }
+
+        /// Attenuation of material m at energy bin e of the spectrum
+        Scalar attenuation(size_t m, size_t e) const { return attenuation_[m * padded_ + e]; }
+
+        /// Detected intensity for path lengths through all materials (numMaterials() values)
+        Scalar intensity(const Scalar* lengths) const
+        {
+            // Only materials the ray actually passes through
+            size_t used[max_materials];
+            size_t numUsed = 0;
+            for (size_t m = 0; m < materials_; ++m)
+                if (lengths[m] > 0)
+                    used[numUsed++] = m;
+            if (numUsed == 0)
+                return flat_;
+
+            Packet sum = Packet(0);
+            for (size_t e = 0; e < padded_; e += lanes) {
+                Packet exponent = Packet(0);
+                for (size_t k = 0; k < numUsed; ++k) {
+                    const size_t m = used[k];
+                    exponent = enoki::fmadd(enoki::load_unaligned<Packet>(&attenuation_[m * padded_ + e]), Packet(lengths[m]), exponent);
+                }
+                sum = enoki::fmadd(enoki::load_unaligned<Packet>(&weights_[e]), enoki::exp(-exponent), sum);
+            }
+            return enoki::hsum(sum);
+        }
+
+        /// Line integral as measured after the log transform, -log(I / I0), including beam hardening
+        Scalar projection(const Scalar* lengths) const { return -std::log(intensity(lengths) / flat_); }
+
+    private:
+        size_t bins_;
+        size_t padded_;
+        size_t materials_;
+        Scalar flat_;
+        std::vector<Scalar> weights_;     // Per energy bin, padded with zeros
+        std::vector<Scalar> attenuation_; // Per material, padded_ bins each
+    };
+
+    /**
+     * Path lengths of the ray through the materials of a label volume: label 0 is empty, label k is material k - 1.
+     * Adds to lengths, which holds numMaterials values.
+     */
+    template <typename Scalar, volume_layout Layout>
+    void material_path_lengths(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, const volume<uint8_t, Layout>& labels,
+                               size_t numMaterials, Scalar* lengths)
+    {
+        traverse_cells(r, grid, [&](size_t x, size_t y, size_t z, Scalar length) {
+            const uint8_t label = labels(x, y, z);
+            if (label == 0)
+                return;
+            if (label > numMaterials)
+                throw std::out_of_range("material_path_lengths: label " + std::to_string(label) + " without material");
+            lengths[label - 1] += length;
+        });
+    }
+
+    /**
+     * Polychromatic projection of a label volume for all rays of a view, as -log(I / I0) in row major order into out
+     * (cols * rows values). The voxels are traversed once per ray, independent of the number of energy bins.
+     */
+    template <typename Scalar, volume_layout Layout>
+    void project_polychromatic(const projection_view<Scalar>& view, const voxel_grid<Scalar>& grid, const volume<uint8_t, Layout>& labels,
+                               const polychromatic_model<Scalar>& model, float* out)
+    {
+        const size_t materials = model.numMaterials();
+        const size_t cols = view.cols();
+        parallel_for(0, view.rows(), [&](size_t row) {
+            Scalar lengths[polychromatic_model<Scalar>::max_materials];
+            for (size_t col = 0; col < cols; ++col) {
+                std::fill_n(lengths, materials, Scalar(0));
+                material_path_lengths(view.pixelRay(col, row), grid, labels, materials, lengths);
+                out[row * cols + col] = static_cast<float>(model.projection(lengths));
+            }
+        });
+    }
+} // namespace tomosect
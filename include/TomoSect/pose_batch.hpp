@@ -0,0 +1,146 @@
+/**
+ *
+ * \file pose_batch.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/vector.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Detector frames and sources of many views with arbitrary poses, e.g. for robotic CT or laminography. View k has
+     * the frame of rectangle(pixels, translations[k], scale, rotX, rotY, rotZ) with the angles of rotations[k] (radians),
+     * and its source at sources[k].
+     *
+     * The frames are built in packets of 8 views: the rotation Rz * Ry * Rx is written out from the sines and cosines of
+     * the angles, and as it is orthonormal the local to global matrix follows from the transposed rotation instead of a
+     * matrix inversion. Both matrices are stored per view (structure of arrays), so frames can be handed out without
+     * further work.
+     */
+    template <typename Scalar>
+    class pose_batch
+    {
+    public:
+        using Matrix4x4 = typename rectangle<Scalar>::Matrix4x4;
+        using Vector4 = typename rectangle<Scalar>::Vector4;
+
+        pose_batch(const point2<Scalar>& pixels, const vec3<Scalar>& scale, const std::vector<vec3<Scalar>>& translations,
+                   const std::vector<vec3<Scalar>>& rotations, std::vector<point3<Scalar>> sources)
+            : pixels_(pixels), sources_(std::move(sources)), size_(translations.size())
+        {
+            if (rotations.size() != size_ || sources_.size() != size_)
+                throw std::invalid_argument("pose_batch: translations, rotations and sources differ in number");
+
+            // Padded to whole packets
+            const size_t padded = (size_ + lanes - 1) / lanes * lanes;
+            for (auto& entry : local_)
+                entry.resize(padded);
+            for (auto& entry : global_)
+                entry.resize(padded);
+
+            const Scalar s[3] = { scale.x(), scale.y(), scale.z() };
+            for (size_t first = 0; first < size_; first += lanes)
+                buildPacket(first, s, translations, rotations);
+        }
+
+        size_t size() const { return size_; }
+
+        point2<Scalar> pixels() const { return pixels_; }
+
+        /// Detector of view k
+        rectangle<Scalar> detector(size_t k) const
+        {
+            return rectangle<Scalar>(pixels_, matrix(global_, k), matrix(local_, k));
+        }
+
+        projection_view<Scalar> view(size_t k) const { return { sources_[k], detector(k) }; }
+
+        std::vector<projection_view<Scalar>> views() const
+        {
+            std::vector<projection_view<Scalar>> result;
+            result.reserve(size_);
+            for (size_t k = 0; k < size_; ++k)
+                result.push_back(view(k));
+            return result;
+        }
+
+    private:
+        using Value = pack8<Scalar>;
+        static constexpr size_t lanes = 8;
+
+        /// Matrix of view k from its upper 3x4 part
+        static Matrix4x4 matrix(const std::vector<Scalar> (&entries)[12], size_t k)
+        {
+            return Matrix4x4::from_rows(Vector4{ entries[0][k], entries[1][k], entries[2][k], entries[3][k] },
+                                        Vector4{ entries[4][k], entries[5][k], entries[6][k], entries[7][k] },
+                                        Vector4{ entries[8][k], entries[9][k], entries[10][k], entries[11][k] }, Vector4{ 0, 0, 0, 1 });
+        }
+
+        void buildPacket(size_t first, const Scalar (&s)[3], const std::vector<vec3<Scalar>>& translations,
+                         const std::vector<vec3<Scalar>>& rotations)
+        {
+            // Lanes past the end repeat the last view and are dropped when storing
+            Value angle[3], t[3];
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const size_t k = std::min(first + lane, size_ - 1);
+                angle[0][lane] = rotations[k].x();
+                angle[1][lane] = rotations[k].y();
+                angle[2][lane] = rotations[k].z();
+                t[0][lane] = translations[k].x();
+                t[1][lane] = translations[k].y();
+                t[2][lane] = translations[k].z();
+            }
+
+            const Value sx = enoki::sin(angle[0]), cx = enoki::cos(angle[0]);
+            const Value sy = enoki::sin(angle[1]), cy = enoki::cos(angle[1]);
+            const Value sz = enoki::sin(angle[2]), cz = enoki::cos(angle[2]);
+
+            // R = Rz * Ry * Rx
+            const Value R[3][3] = { { cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx },
+                                    { sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx },
+                                    { -sy, cy * sx, cy * cx } };
+
+            // Global to local: scale down, rotate, then move by (0.5, 0.5, 0) - t (see affine_transformation)
+            const Scalar offset[3] = { Scalar(0.5), Scalar(0.5), 0 };
+            Value shift[3]; // t - (0.5, 0.5, 0)
+            for (int r = 0; r < 3; ++r) {
+                shift[r] = t[r] - Value(offset[r]);
+                for (int c = 0; c < 3; ++c)
+                    store(local_[4 * r + c], first, R[r][c] * Value(1 / s[c]));
+                store(local_[4 * r + 3], first, -shift[r]);
+            }
+
+            // Local to global: move back, rotate back with the transposed rotation, scale up
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 3; ++c)
+                    store(global_[4 * r + c], first, R[c][r] * Value(s[r]));
+                store(global_[4 * r + 3], first, (R[0][r] * shift[0] + R[1][r] * shift[1] + R[2][r] * shift[2]) * Value(s[r]));
+            }
+        }
+
+        static void store(std::vector<Scalar>& entry, size_t first, const Value& value)
+        {
+            enoki::store_unaligned(entry.data() + first, value);
+        }
+
+        point2<Scalar> pixels_;
+        std::vector<point3<Scalar>> sources_;
+        size_t size_;
+
+        // Upper 3x4 part of the matrices, row major, one array per entry over all views
+        std::vector<Scalar> local_[12];  // Global to local
+        std::vector<Scalar> global_[12]; // Local to global
+    };
+} // namespace tomosect
@@ -0,0 +1,68 @@
+/**
+ *
+ * \file projection_stack.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Measured (or simulated) projections of a scan, cols * rows values per view. Stored view after view, row after row,
+     * which is the row numbering of the system matrix, so the data can be used directly as right hand side.
+     *
+     * The storage is either owned or external (e.g. a memory mapped file), copies of a stack share the storage.
+     */
+    template <typename T>
+    class projection_stack
+    {
+    public:
+        projection_stack(size_t cols, size_t rows, size_t numViews, T value = T{})
+            : projection_stack(cols, rows, numViews, nullptr, nullptr)
+        {
+            auto buffer = std::make_shared<std::vector<T>>(size(), value);
+            data_ = buffer->data();
+            owner_ = std::move(buffer);
+        }
+
+        /// Stack using external storage of size() values, the owner is kept alive as long as the stack exists
+        projection_stack(size_t cols, size_t rows, size_t numViews, T* data, std::shared_ptr<void> owner)
+            : cols_(cols), rows_(rows), numViews_(numViews), owner_(std::move(owner)), data_(data)
+        {
+        }
+
+        size_t cols() const { return cols_; }
+        size_t rows() const { return rows_; }
+        size_t numViews() const { return numViews_; }
+
+        /// Number of pixels of a single view
+        size_t pixelsPerView() const { return cols_ * rows_; }
+
+        /// Number of values over all views
+        size_t size() const { return cols_ * rows_ * numViews_; }
+
+        T* view(size_t k) { return data_ + k * pixelsPerView(); }
+        const T* view(size_t k) const { return data_ + k * pixelsPerView(); }
+
+        T& operator()(size_t col, size_t row, size_t k) { return view(k)[row * cols_ + col]; }
+        const T& operator()(size_t col, size_t row, size_t k) const { return view(k)[row * cols_ + col]; }
+
+        T* data() { return data_; }
+        const T* data() const { return data_; }
+
+    private:
+        size_t cols_;
+        size_t rows_;
+        size_t numViews_;
+
+        std::shared_ptr<void> owner_; // Keeps the storage alive
+        T* data_;
+    };
+} // namespace tomosect
@@ -0,0 +1,256 @@
+/**
+ *
+ * \file quadric.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace tomosect
+{
+    namespace details
+    {
+        /**
+         * Affine map from world coordinates into the local coordinates of a quadric, in which it is the unit sphere or
+         * the unit cylinder. Rows of m are the local axes divided by the semi-axes.
+         */
+        template <typename Scalar>
+        struct quadric_transform {
+            Scalar m[3][3];
+            Scalar c[3];
+
+            /// Euler angles phi, theta, psi rotate by phi around z, theta around the new x and psi around the new z
+            quadric_transform(const std::array<Scalar, 3>& center, const std::array<Scalar, 3>& semiAxes,
+                              const std::array<Scalar, 3>& angles)
+            {
+                for (auto s : semiAxes)
+                    if (!(s > 0))
+                        throw std::invalid_argument("quadric: semi-axes must be positive");
+
+                const Scalar cphi = std::cos(angles[0]), sphi = std::sin(angles[0]);
+                const Scalar ctheta = std::cos(angles[1]), stheta = std::sin(angles[1]);
+                const Scalar cpsi = std::cos(angles[2]), spsi = std::sin(angles[2]);
+
+                const Scalar axes[3][3] = { { cpsi * cphi - ctheta * sphi * spsi, cpsi * sphi + ctheta * cphi * spsi, spsi * stheta },
+                                            { -spsi * cphi - ctheta * sphi * cpsi, -spsi * sphi + ctheta * cphi * cpsi, cpsi * stheta },
+                                            { stheta * sphi, -stheta * cphi, ctheta } };
+
+                for (int i = 0; i < 3; ++i) {
+                    c[i] = 0;
+                    for (int j = 0; j < 3; ++j) {
+                        m[i][j] = axes[i][j] / semiAxes[i];
+                        c[i] -= m[i][j] * center[j];
+                    }
+                }
+            }
+
+            template <typename Value>
+            void toLocal(const Value o[3], const Value d[3], Value lo[3], Value ld[3]) const
+            {
+                for (int i = 0; i < 3; ++i) {
+                    lo[i] = o[0] * m[i][0] + o[1] * m[i][1] + o[2] * m[i][2] + c[i];
+                    ld[i] = d[0] * m[i][0] + d[1] * m[i][1] + d[2] * m[i][2];
+                }
+            }
+
+            std::array<Scalar, 3> toLocal(const std::array<Scalar, 3>& p) const
+            {
+                std::array<Scalar, 3> result;
+                for (int i = 0; i < 3; ++i)
+                    result[i] = p[0] * m[i][0] + p[1] * m[i][1] + p[2] * m[i][2] + c[i];
+                return result;
+            }
+        };
+
+        /// Entry and exit distance of the rays o + t * d through the ellipsoid, the mask is set for rays hitting it
+        template <typename Value, typename Scalar>
+        IntervalResult<Value> ellipsoid_interval(const quadric_transform<Scalar>& tf, const Value o[3], const Value d[3])
+        {
+            Value lo[3], ld[3];
+            tf.toLocal(o, d, lo, ld);
+
+            // |lo + t * ld|^2 = 1
+            const Value a = ld[0] * ld[0] + ld[1] * ld[1] + ld[2] * ld[2];
+            const Value b = 2 * (lo[0] * ld[0] + lo[1] * ld[1] + lo[2] * ld[2]);
+            const Value c = lo[0] * lo[0] + lo[1] * lo[1] + lo[2] * lo[2] - 1;
+            return quadratic_roots<Value>(a, b, c);
+        }
+
+        /// Entry and exit distance of the rays o + t * d through the finite cylinder, the mask is set for rays hitting it
+        template <typename Value, typename Scalar>
+        IntervalResult<Value> cylinder_interval(const quadric_transform<Scalar>& tf, const Value o[3], const Value d[3])
+        {
+            constexpr Scalar inf = std::numeric_limits<Scalar>::infinity();
+
+            Value lo[3], ld[3];
+            tf.toLocal(o, d, lo, ld);
+
+            // Mantle x^2 + y^2 = 1, rays parallel to the axis are inside everywhere or nowhere
+            const Value a = ld[0] * ld[0] + ld[1] * ld[1];
+            const Value b = 2 * (lo[0] * ld[0] + lo[1] * ld[1]);
+            const Value c = lo[0] * lo[0] + lo[1] * lo[1] - 1;
+            auto [r0, r1, mask] = quadratic_roots<Value>(a, b, c);
+
+            const auto parallel = a == Value(0);
+            r0 = enoki::select(parallel, Value(-inf), r0);
+            r1 = enoki::select(parallel, Value(inf), r1);
+            mask = enoki::select(parallel, c < Value(0), mask);
+
+            // Caps at z = -1 and z = 1, division by zero gives the right infinities for rays parallel to them
+            const Value z0 = (-1 - lo[2]) / ld[2];
+            const Value z1 = (1 - lo[2]) / ld[2];
+
+            const Value tEnter = enoki::max(r0, enoki::min(z0, z1));
+            const Value tExit = enoki::min(r1, enoki::max(z0, z1));
+            return { tEnter, tExit, mask && tEnter < tExit };
+        }
+
+        /// Length of [tEnter, tExit] in front of the origin, zero for masked out lanes
+        template <typename Value, typename Mask>
+        Value chord_length(const Value& tEnter, const Value& tExit, const Mask& mask)
+        {
+            return enoki::select(mask, enoki::max(tExit - enoki::max(tEnter, Value(0)), Value(0)), Value(0));
+        }
+
+        template <typename Value>
+        void ray_components(const ray<Value>& r, Value o[3], Value d[3])
+        {
+            const auto origin = r.origin();
+            const auto dir = r.dir();
+            o[0] = origin.x();
+            o[1] = origin.y();
+            o[2] = origin.z();
+            d[0] = dir.x();
+            d[1] = dir.y();
+            d[2] = dir.z();
+        }
+
+        /// Axis aligned bounds of the transformed unit cylinder (radial = true) or unit sphere
+        template <typename Scalar>
+        void quadric_bounds(const std::array<Scalar, 3>& center, const std::array<Scalar, 3>& semiAxes, const quadric_transform<Scalar>& tf,
+                            bool cylinder, Scalar lo[3], Scalar hi[3])
+        {
+            for (int j = 0; j < 3; ++j) {
+                // Component j of the scaled local axes
+                Scalar e[3];
+                for (int i = 0; i < 3; ++i)
+                    e[i] = tf.m[i][j] * semiAxes[i] * semiAxes[i];
+
+                const Scalar extent = cylinder ? std::sqrt(e[0] * e[0] + e[1] * e[1]) + std::abs(e[2])
+                                               : std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+                lo[j] = center[j] - extent;
+                hi[j] = center[j] + extent;
+            }
+        }
+    } // namespace details
+
+    /**
+     * Ellipsoid with the given center, semi-axes along its local x, y and z axis, and orientation given as Euler angles
+     * (see details::quadric_transform). Rays can be scalars or packets; distances are measured in units of the ray
+     * parameter, i.e. world units for normalized directions.
+     */
+    template <typename Scalar>
+    class ellipsoid
+    {
+    public:
+        ellipsoid(const std::array<Scalar, 3>& center, const std::array<Scalar, 3>& semiAxes, const std::array<Scalar, 3>& angles = {})
+            : center_(center), semiAxes_(semiAxes), angles_(angles), transform_(center, semiAxes, angles)
+        {
+        }
+
+        const std::array<Scalar, 3>& center() const { return center_; }
+        const std::array<Scalar, 3>& semiAxes() const { return semiAxes_; }
+        const std::array<Scalar, 3>& angles() const { return angles_; }
+        const details::quadric_transform<Scalar>& transform() const { return transform_; }
+
+        /// Entry and exit distance of the ray's line, which may lie behind the origin
+        template <typename Value>
+        IntervalResult<Value> interval(const ray<Value>& r) const
+        {
+            Value o[3], d[3];
+            details::ray_components(r, o, d);
+            return details::ellipsoid_interval(transform_, o, d);
+        }
+
+        /// Length of the ray inside, starting at its origin
+        template <typename Value>
+        Value chordLength(const ray<Value>& r) const
+        {
+            auto [tEnter, tExit, mask] = interval(r);
+            return details::chord_length(tEnter, tExit, mask);
+        }
+
+        bool contains(const std::array<Scalar, 3>& p) const
+        {
+            const auto l = transform_.toLocal(p);
+            return l[0] * l[0] + l[1] * l[1] + l[2] * l[2] <= 1;
+        }
+
+        void bounds(Scalar lo[3], Scalar hi[3]) const { details::quadric_bounds(center_, semiAxes_, transform_, false, lo, hi); }
+
+    private:
+        std::array<Scalar, 3> center_;
+        std::array<Scalar, 3> semiAxes_;
+        std::array<Scalar, 3> angles_;
+        details::quadric_transform<Scalar> transform_;
+    };
+
+    /**
+     * Finite elliptic cylinder around its local z axis: semi-axes x and y are the radii, semi-axis z is half the length.
+     * Center and orientation as for ellipsoid.
+     */
+    template <typename Scalar>
+    class cylinder
+    {
+    public:
+        cylinder(const std::array<Scalar, 3>& center, const std::array<Scalar, 3>& semiAxes, const std::array<Scalar, 3>& angles = {})
+            : center_(center), semiAxes_(semiAxes), angles_(angles), transform_(center, semiAxes, angles)
+        {
+        }
+
+        const std::array<Scalar, 3>& center() const { return center_; }
+        const std::array<Scalar, 3>& semiAxes() const { return semiAxes_; }
+        const std::array<Scalar, 3>& angles() const { return angles_; }
+        const details::quadric_transform<Scalar>& transform() const { return transform_; }
+
+        /// Entry and exit distance of the ray's line, which may lie behind the origin
+        template <typename Value>
+        IntervalResult<Value> interval(const ray<Value>& r) const
+        {
+            Value o[3], d[3];
+            details::ray_components(r, o, d);
+            return details::cylinder_interval(transform_, o, d);
+        }
+
+        /// Length of the ray inside, starting at its origin
+        template <typename Value>
+        Value chordLength(const ray<Value>& r) const
+        {
+            auto [tEnter, tExit, mask] = interval(r);
+            return details::chord_length(tEnter, tExit, mask);
+        }
+
+        bool contains(const std::array<Scalar, 3>& p) const
+        {
+            const auto l = transform_.toLocal(p);
+            return l[0] * l[0] + l[1] * l[1] <= 1 && std::abs(l[2]) <= 1;
+        }
+
+        void bounds(Scalar lo[3], Scalar hi[3]) const { details::quadric_bounds(center_, semiAxes_, transform_, true, lo, hi); }
+
+    private:
+        std::array<Scalar, 3> center_;
+        std::array<Scalar, 3> semiAxes_;
+        std::array<Scalar, 3> angles_;
+        details::quadric_transform<Scalar> transform_;
+    };
+} // namespace tomosect
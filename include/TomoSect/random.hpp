@@ -0,0 +1,91 @@
+/**
+ *
+ * \file random.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "enoki/array.h"
+#include "enoki/random.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace tomosect
+{
+    /// Seed used when none is given, the default initial state of PCG32
+    constexpr uint64_t default_seed = 0x853c49e6748fea9bull;
+
+    /**
+     * Numbered stream of random numbers: a PCG32 generator per lane, seeded with the seed and a sequence selected by the
+     * stream index. The same seed and index always give the same numbers, different indices are independent. Lane l of
+     * stream s uses sequence s * max_lanes + l, so scalar and packet streams of the same index do not overlap either.
+     *
+     * Work split into numbered pieces (batches, rows, views) should use the piece's index, not the thread's, then the
+     * result does not depend on the number of threads or on which thread got which piece.
+     */
+    template <typename Value>
+    class random_stream
+    {
+    public:
+        using Generator = enoki::PCG32<Value>;
+        using Scalar = enoki::scalar_t<Value>;
+
+        static constexpr size_t max_lanes = 64;
+
+        explicit random_stream(uint64_t index, uint64_t seed = default_seed) : rng_(seeds(seed), sequences(index)) {}
+
+        /// Uniform in [0, 1)
+        Value uniform()
+        {
+            if constexpr (std::is_same_v<Scalar, double>)
+                return Value(rng_.next_float64());
+            else
+                return Value(rng_.next_float32());
+        }
+
+        auto next_uint32() { return rng_.next_uint32(); }
+
+        Generator& generator() { return rng_; }
+
+    private:
+        using UInt64 = typename Generator::UInt64;
+
+        static UInt64 seeds(uint64_t seed) { return UInt64(seed); }
+
+        static UInt64 sequences(uint64_t index)
+        {
+            if constexpr (enoki::is_array_v<Value>)
+                return enoki::arange<UInt64>() + UInt64(index * max_lanes);
+            else
+                return index * max_lanes;
+        }
+
+        Generator rng_;
+    };
+
+    namespace details
+    {
+        /// Stream index for the next thread asking for its own generator
+        inline uint64_t next_thread_stream()
+        {
+            static std::atomic<uint64_t> next{ 0 };
+            return next.fetch_add(1);
+        }
+    } // namespace details
+
+    /**
+     * Generator of the calling thread, created on first use. Threads get consecutive stream indices in the order they
+     * first ask for one, so a single threaded program always sees the same numbers, and threads never share a stream.
+     */
+    template <typename Value>
+    random_stream<Value>& thread_random_stream()
+    {
+        static thread_local random_stream<Value> stream(details::next_thread_stream());
+        return stream;
+    }
+} // namespace tomosect
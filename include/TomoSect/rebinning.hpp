@@ -0,0 +1,262 @@
+/**
+ *
+ * \file rebinning.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/vector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Shape of the detector of a circular scan: flat (as in circular_trajectory), or cylindrical around the source with
+     * equiangular columns. For a cylindrical detector pixelWidth of the trajectory is the arc length of a column at the
+     * detector radius, sourceDistance + detectorDistance.
+     */
+    enum class detector_shape { flat, cylindrical };
+
+    /**
+     * Rebinning of circular cone beam scans to parallel beam views on a virtual cylindrical detector through the rotation
+     * axis (wedge rebinning). The ray from the source at angle beta through fan angle gamma becomes column
+     * t = R sin(gamma) of the parallel view at angle theta = beta - gamma (for detector columns running in the direction
+     * of rotation, else beta + gamma), and its height where it passes the axis closest becomes the row. Parallel views,
+     * columns and rows are uniformly spaced, which is what the FFT based filters want: views on the angles of the
+     * trajectory, columns and rows with the pixel pitch scaled to the rotation axis.
+     *
+     * The interpolation positions only depend on the output column (and row), not on the view, so they are computed once
+     * per geometry. Each output value is interpolated trilinearly between two views, two columns and two rows. Samples
+     * needing views outside of a partial arc, or pixels outside of the detector, are zero. For a full circle the views
+     * wrap around.
+     */
+    template <typename Scalar>
+    class parallel_rebinning
+    {
+    public:
+        parallel_rebinning(const circular_trajectory<Scalar>& trajectory, detector_shape shape = detector_shape::flat)
+            : trajectory_(trajectory), shape_(shape), cols_(trajectory.cols), rows_(trajectory.rows),
+              padded_((trajectory.cols + lanes - 1) / lanes * lanes), colDir_(axis(trajectory, 1, 0)), rowDir_(axis(trajectory, 0, 1))
+        {
+            if (trajectory.numViews == 0 || trajectory.cols == 0 || trajectory.rows == 0)
+                throw std::invalid_argument("parallel_rebinning: empty trajectory");
+            // The gathers in rebinView() address the input stack with signed 32 bit offsets
+            if (static_cast<uint64_t>(cols_) * rows_ * trajectory.numViews > INT32_MAX)
+                throw std::out_of_range("parallel_rebinning: projections have more than 2^31 - 1 values, too many for 32 bit offsets");
+
+            const Scalar R = trajectory.sourceDistance;
+            const Scalar SDD = trajectory.sourceDistance + trajectory.detectorDistance;
+            spacing_ = trajectory.pixelWidth * R / SDD;
+            rowSpacing_ = trajectory.pixelHeight * R / SDD;
+            fullCircle_ = std::abs(std::abs(trajectory.arc) - static_cast<Scalar>(2 * M_PI)) < static_cast<Scalar>(1e-4);
+
+            // Do the detector columns run in the direction of rotation
+            const Scalar phi = trajectory.angle(0);
+            sign_ = colDir_.x() * -std::sin(phi) + colDir_.y() * std::cos(phi) < 0 ? Scalar(-1) : Scalar(1);
+
+            colIndex_.assign(padded_, -2);
+            colWeight_.assign(padded_, 0.f);
+            viewIndex_.assign(padded_, 0);
+            viewWeight_.assign(padded_, 0.f);
+            rowIndex_.assign(rows_ * padded_, -2);
+            rowWeight_.assign(rows_ * padded_, 0.f);
+            gamma_.assign(cols_, 0);
+
+            const Scalar colCenter = static_cast<Scalar>(cols_ - 1) / 2;
+            const Scalar rowCenter = static_cast<Scalar>(rows_ - 1) / 2;
+            for (size_t j = 0; j < cols_; ++j) {
+                const Scalar t = offset(j);
+                if (std::abs(t) >= R)
+                    continue; // Past the source circle, no ray passes there
+
+                const Scalar gamma = std::asin(t / R);
+                gamma_[j] = gamma;
+
+                // Input column of the fan angle
+                const Scalar u = shape == detector_shape::flat ? SDD * std::tan(gamma) : SDD * gamma;
+                split(u / trajectory.pixelWidth + colCenter, colIndex_[j], colWeight_[j]);
+
+                // Input view: beta = theta + sign * gamma, in steps of the trajectory
+                split(sign_ * gamma / trajectory.step(), viewIndex_[j], viewWeight_[j]);
+
+                // Heights scale from the axis to the detector with the distance along the ray, which is R cos(gamma) to
+                // the point closest to the axis and SDD / cos(gamma) (flat) or SDD (cylindrical) to the detector
+                const Scalar c = std::cos(gamma);
+                const Scalar scale = shape == detector_shape::flat ? SDD / (R * c * c) : SDD / (R * c);
+                for (size_t r = 0; r < rows_; ++r) {
+                    const Scalar z = height(r);
+                    split(z * scale / trajectory.pixelHeight + rowCenter, rowIndex_[r * padded_ + j], rowWeight_[r * padded_ + j]);
+                }
+            }
+        }
+
+        size_t numViews() const { return trajectory_.numViews; }
+        size_t cols() const { return cols_; }
+        size_t rows() const { return rows_; }
+
+        detector_shape shape() const { return shape_; }
+
+        /// Angle of the parallel rays of view k, the direction they point to is -(cos(theta), sin(theta), 0)
+        Scalar angle(size_t k) const { return trajectory_.angle(k); }
+
+        /// Signed distance of column j from the rotation axis
+        Scalar offset(size_t j) const { return (static_cast<Scalar>(j) - static_cast<Scalar>(cols_ - 1) / 2) * spacing_; }
+
+        /// Height of row r where its rays pass the rotation axis closest
+        Scalar height(size_t r) const { return (static_cast<Scalar>(r) - static_cast<Scalar>(rows_ - 1) / 2) * rowSpacing_; }
+
+        Scalar spacing() const { return spacing_; }
+        Scalar rowSpacing() const { return rowSpacing_; }
+
+        /**
+         * Source ray of the rebinned sample (col, row) of parallel view k: it starts at the source and passes the point
+         * offset(col) along the column direction and height(row) along the row direction of the virtual detector.
+         */
+        ray<Scalar> sampleRay(size_t k, size_t col, size_t row) const
+        {
+            const Scalar theta = angle(k);
+            const Scalar beta = theta + sign_ * gamma_[col];
+            const Scalar R = trajectory_.sourceDistance;
+
+            const point3<Scalar> source(R * std::cos(beta), R * std::sin(beta), 0);
+            const vec3<Scalar> across(-sign_ * std::sin(theta), sign_ * std::cos(theta), 0);
+            const point3<Scalar> target = point3<Scalar>(0, 0, 0) + across * offset(col) + rowDir_ * height(row);
+            return rayFromPoints(source, target);
+        }
+
+        /**
+         * Rebin all views of a scan, parallel over the output views. Both stacks hold cols() * rows() values per view and
+         * numViews() views, in is in the geometry of the trajectory.
+         */
+        void rebin(const projection_stack<float>& in, projection_stack<float>& out) const
+        {
+            auto matches = [this](const projection_stack<float>& s) {
+                return s.cols() == cols_ && s.rows() == rows_ && s.numViews() == numViews();
+            };
+            if (!matches(in) || !matches(out))
+                throw std::invalid_argument("parallel_rebinning::rebin: stacks do not match the trajectory");
+
+            parallel_for(0, numViews(), [&](size_t k) { rebinView(in.data(), k, out.view(k)); });
+        }
+
+        /// Rebin parallel view k from the whole stack of input views (view after view) into out, cols() * rows() values
+        void rebinView(const float* in, size_t k, float* out) const
+        {
+            using FloatP = pack8<float>;
+            using Int32P = enoki::Array<int32_t, lanes>;
+            using MaskP = enoki::mask_t<Int32P>;
+
+            const auto views = static_cast<int32_t>(numViews());
+            const auto cols = static_cast<int32_t>(cols_);
+            const auto rows = static_cast<int32_t>(rows_);
+
+            for (size_t j = 0; j < padded_; j += lanes) {
+                // Two neighbouring views, wrapped or masked
+                Int32P v0 = Int32P(static_cast<int32_t>(k)) + enoki::load_unaligned<Int32P>(&viewIndex_[j]);
+                Int32P v1 = v0 + 1;
+                MaskP v0Valid = true, v1Valid = true;
+                if (fullCircle_) {
+                    v0 = enoki::select(v0 < 0, v0 + views, enoki::select(v0 >= views, v0 - views, v0));
+                    v1 = enoki::select(v1 < 0, v1 + views, enoki::select(v1 >= views, v1 - views, v1));
+                } else {
+                    v0Valid = (v0 >= 0) & (v0 < views);
+                    v1Valid = (v1 >= 0) & (v1 < views);
+                    v0 = enoki::select(v0Valid, v0, Int32P(0));
+                    v1 = enoki::select(v1Valid, v1, Int32P(0));
+                }
+
+                // Indices outside of the input are zeroed, so offsets never exceed the size of the stack
+                Int32P c0 = enoki::load_unaligned<Int32P>(&colIndex_[j]);
+                Int32P c1 = c0 + 1;
+                const MaskP c0Valid = (c0 >= 0) & (c0 < cols);
+                const MaskP c1Valid = (c1 >= 0) & (c1 < cols);
+                c0 = enoki::select(c0Valid, c0, Int32P(0));
+                c1 = enoki::select(c1Valid, c1, Int32P(0));
+
+                const FloatP wc = enoki::load_unaligned<FloatP>(&colWeight_[j]);
+                const FloatP wv = enoki::load_unaligned<FloatP>(&viewWeight_[j]);
+
+                // Offsets of the four view / column corners, rows are added below
+                const Int32P base[4] = { v0 * rows, v0 * rows, v1 * rows, v1 * rows };
+                const Int32P col[4] = { c0, c1, c0, c1 };
+                const MaskP valid[4] = { v0Valid & c0Valid, v0Valid & c1Valid, v1Valid & c0Valid, v1Valid & c1Valid };
+                const FloatP weight[4] = { (1.f - wv) * (1.f - wc), (1.f - wv) * wc, wv * (1.f - wc), wv * wc };
+
+                const size_t n = std::min(lanes, cols_ - j);
+                for (size_t r = 0; r < rows_; ++r) {
+                    Int32P r0 = enoki::load_unaligned<Int32P>(&rowIndex_[r * padded_ + j]);
+                    Int32P r1 = r0 + 1;
+                    const MaskP r0Valid = (r0 >= 0) & (r0 < rows);
+                    const MaskP r1Valid = (r1 >= 0) & (r1 < rows);
+                    r0 = enoki::select(r0Valid, r0, Int32P(0));
+                    r1 = enoki::select(r1Valid, r1, Int32P(0));
+                    const FloatP wr = enoki::load_unaligned<FloatP>(&rowWeight_[r * padded_ + j]);
+
+                    FloatP sum(0.f);
+                    for (int corner = 0; corner < 4; ++corner) {
+                        const MaskP m0 = valid[corner] & r0Valid;
+                        const MaskP m1 = valid[corner] & r1Valid;
+                        const FloatP lower = enoki::gather<FloatP>(in, (base[corner] + r0) * cols + col[corner], m0);
+                        const FloatP upper = enoki::gather<FloatP>(in, (base[corner] + r1) * cols + col[corner], m1);
+                        sum = enoki::fmadd(weight[corner], enoki::fmadd(wr, upper - lower, lower), sum);
+                    }
+
+                    for (size_t lane = 0; lane < n; ++lane)
+                        out[r * cols_ + j + lane] = sum[lane];
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t lanes = 8;
+
+        /// Direction of the detector columns (1, 0) or rows (0, 1) in the first view
+        static vec3<Scalar> axis(const circular_trajectory<Scalar>& trajectory, Scalar col, Scalar row)
+        {
+            const auto view = trajectory.view(0);
+            return normalize(view.detector.coordFromLocal(point2<Scalar>(col, row)) - view.detector.coordFromLocal(point2<Scalar>(0, 0)));
+        }
+
+        /// Integer part and fraction of an interpolation position
+        static void split(Scalar position, int32_t& index, float& weight)
+        {
+            const Scalar f = std::floor(position);
+            // Far outside positions only need to stay outside, keep them in the range of int32
+            index = static_cast<int32_t>(std::clamp(f, Scalar(-(INT32_MAX / 2)), Scalar(INT32_MAX / 2)));
+            weight = static_cast<float>(position - f);
+        }
+
+        circular_trajectory<Scalar> trajectory_;
+        detector_shape shape_;
+        size_t cols_;
+        size_t rows_;
+        size_t padded_; // Columns rounded up to whole packets
+        vec3<Scalar> colDir_;
+        vec3<Scalar> rowDir_;
+        Scalar spacing_;
+        Scalar rowSpacing_;
+        bool fullCircle_;
+        Scalar sign_; // +1 if the detector columns run in the direction of rotation
+
+        // Per output column: input column and view offset; per output row and column: input row
+        std::vector<int32_t> colIndex_;
+        std::vector<float> colWeight_;
+        std::vector<int32_t> viewIndex_;
+        std::vector<float> viewWeight_;
+        std::vector<int32_t> rowIndex_;
+        std::vector<float> rowWeight_;
+        std::vector<Scalar> gamma_; // Fan angle of each output column
+    };
+} // namespace tomosect
@@ -0,0 +1,145 @@
+/**
+ *
+ * \file roi.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Window of the detector the box projects onto, including one pixel to the right and below for bilinear
+     * interpolation. The projection of a box is the convex hull of its projected corners, the projection matrix maps
+     * them to detector coordinates. If part of the box is behind the source, the whole detector is returned.
+     */
+    template <typename Scalar>
+    detector_window project_box(const projection_matrix<Scalar>& P, const aabb<Scalar>& box, size_t numCols, size_t numRows)
+    {
+        const auto lo = box.min();
+        const auto hi = box.max();
+
+        Scalar umin = std::numeric_limits<Scalar>::infinity(), umax = -umin;
+        Scalar vmin = umin, vmax = -umin;
+
+        for (int corner = 0; corner < 8; ++corner) {
+            auto [u, v, w] = P.project(corner & 1 ? hi.x() : lo.x(), corner & 2 ? hi.y() : lo.y(), corner & 4 ? hi.z() : lo.z());
+            if (w <= 0)
+                return { 0, numCols, 0, numRows };
+
+            umin = std::min(umin, u / w);
+            umax = std::max(umax, u / w);
+            vmin = std::min(vmin, v / w);
+            vmax = std::max(vmax, v / w);
+        }
+
+        auto clampTo = [](Scalar p, size_t n) { return static_cast<size_t>(std::clamp(p, Scalar{ 0 }, static_cast<Scalar>(n))); };
+        return { clampTo(std::floor(umin), numCols), clampTo(std::floor(umax) + 2, numCols), clampTo(std::floor(vmin), numRows),
+                 clampTo(std::floor(vmax) + 2, numRows) };
+    }
+
+    /// Voxels of the grid whose centers lie inside the box, empty if there are none
+    template <typename Scalar>
+    voxel_box voxels_inside(const voxel_grid<Scalar>& grid, const aabb<Scalar>& box)
+    {
+        const Scalar lo[3] = { box.min().x(), box.min().y(), box.min().z() };
+        const Scalar hi[3] = { box.max().x(), box.max().y(), box.max().z() };
+        const Scalar origin[3] = { grid.min().x(), grid.min().y(), grid.min().z() };
+        const Scalar h[3] = { grid.spacing().x(), grid.spacing().y(), grid.spacing().z() };
+        const size_t n[3] = { grid.nx(), grid.ny(), grid.nz() };
+
+        size_t begin[3], end[3];
+        for (int a = 0; a < 3; ++a) {
+            // Center of voxel i is at origin + (i + 0.5) * h
+            Scalar first = std::ceil((lo[a] - origin[a]) / h[a] - Scalar{ 0.5 });
+            Scalar last = std::floor((hi[a] - origin[a]) / h[a] - Scalar{ 0.5 }) + 1;
+
+            begin[a] = static_cast<size_t>(std::clamp(first, Scalar{ 0 }, static_cast<Scalar>(n[a])));
+            end[a] = std::max(begin[a], static_cast<size_t>(std::clamp(last, Scalar{ 0 }, static_cast<Scalar>(n[a]))));
+        }
+
+        return { begin[0], end[0], begin[1], end[1], begin[2], end[2] };
+    }
+
+    /// Part of a reconstruction: the voxels, the grid they form and where they are in the full grid
+    template <typename Scalar>
+    struct roi_volume {
+        volume<float> data;
+        voxel_grid<Scalar> grid;
+        voxel_box voxels;
+    };
+
+    /**
+     * FDK reconstruction of a region of interest only. Backprojection visits just the voxels inside the ROI, and for
+     * every view only the detector window the ROI projects onto is filtered and backprojected. Reading and filtering
+     * still need whole detector rows of the window, as the ramp filter runs along complete rows. The result is the
+     * same as cutting the ROI out of a full reconstruction.
+     */
+    template <typename Scalar, typename T>
+    roi_volume<Scalar> fdk_roi(const circular_trajectory<Scalar>& trajectory, const projection_stack<T>& projections,
+                               const voxel_grid<Scalar>& grid, const aabb<Scalar>& roi)
+    {
+        if (projections.cols() != trajectory.cols || projections.rows() != trajectory.rows || projections.numViews() != trajectory.numViews)
+            throw std::invalid_argument("fdk_roi: projections do not match the trajectory");
+
+        const auto box = voxels_inside(grid, roi);
+        if (box.size() == 0)
+            throw std::invalid_argument("fdk_roi: region of interest does not contain any voxel");
+
+        const auto h = grid.spacing();
+        const auto corner = grid.voxelCenter(box.xBegin, box.yBegin, box.zBegin) - h / Scalar{ 2 };
+        voxel_grid<Scalar> roiGrid(box.nx(), box.ny(), box.nz(), corner, h);
+
+        const size_t cols = trajectory.cols;
+        fdk_filter<Scalar> filter(trajectory);
+
+        std::vector<projection_matrix<Scalar>> matrices;
+        std::vector<detector_window> windows;
+        std::vector<size_t> offsets;
+        size_t total = 0;
+
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+            windows.push_back(project_box(matrices.back(), roiGrid.bounds(), cols, trajectory.rows));
+            offsets.push_back(total);
+            total += windows.back().rows() * cols;
+        }
+
+        // Filtered rows of the windows, columns outside of the window are never read and stay zero
+        std::vector<float> filtered(total);
+        std::vector<filtered_rows> rows;
+
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            const auto& w = windows[k];
+            prefetch(projections.view(k) + w.rowBegin * cols, w.rows() * cols * sizeof(float));
+            rows.push_back({ filtered.data() + offsets[k], w.rowBegin, w.rowEnd });
+        }
+
+        parallel_for(0, trajectory.numViews, [&](size_t k) {
+            const auto& w = windows[k];
+            filter.filterRows(projections.view(k) + w.rowBegin * cols, filtered.data() + offsets[k], w.rowBegin, w.rowEnd, w.colBegin,
+                              w.colEnd);
+        });
+
+        roi_volume<Scalar> result{ volume<float>(box.nx(), box.ny(), box.nz()), roiGrid, box };
+        backproject(matrices, rows, cols, fdk_scale(trajectory), grid, box, result.data.data());
+        return result;
+    }
+} // namespace tomosect
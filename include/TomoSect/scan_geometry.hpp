@@ -0,0 +1,256 @@
+/**
+ *
+ * \file scan_geometry.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/traversal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace tomosect::details
+{
+    /// FNV-1a over the raw bytes of a trivially copyable value
+    template <typename T>
+    uint64_t hash_bytes(const T& value, uint64_t hash = 14695981039346656037ull)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+
+        for (auto b : bytes) {
+            hash ^= b;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    template <typename Scalar>
+    uint64_t hash_point(const point3<Scalar>& p, uint64_t hash)
+    {
+        hash = hash_bytes(p.x(), hash);
+        hash = hash_bytes(p.y(), hash);
+        return hash_bytes(p.z(), hash);
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * Central projection onto a detector as 3x4 matrix in homogeneous coordinates: for a world point p the detector
+     * pixel coordinates (pixel centers at whole numbers) are (u / w, v / w) with (u, v, w) = project(p). w is the
+     * distance of p from the source along the detector normal (in local units of the detector), positive for points
+     * between source and detector.
+     */
+    template <typename Scalar>
+    struct projection_matrix {
+        Scalar rows[3][4];
+
+        std::array<Scalar, 3> project(Scalar x, Scalar y, Scalar z) const
+        {
+            std::array<Scalar, 3> result;
+            for (int i = 0; i < 3; ++i)
+                result[i] = rows[i][0] * x + rows[i][1] * y + rows[i][2] * z + rows[i][3];
+            return result;
+        }
+    };
+
+    /// Pixels [colBegin, colEnd) x [rowBegin, rowEnd) of a detector
+    struct detector_window {
+        size_t colBegin, colEnd;
+        size_t rowBegin, rowEnd;
+
+        size_t cols() const { return colEnd - colBegin; }
+        size_t rows() const { return rowEnd - rowBegin; }
+        size_t size() const { return cols() * rows(); }
+    };
+
+    /// A single projection: a point source and a flat detector
+    template <typename Scalar>
+    struct projection_view {
+        point3<Scalar> source;
+        rectangle<Scalar> detector;
+
+        size_t cols() const { return static_cast<size_t>(detector.pixels().x()); }
+        size_t rows() const { return static_cast<size_t>(detector.pixels().y()); }
+
+        /// Ray from the source through the center of pixel (col, row)
+        ray<Scalar> pixelRay(size_t col, size_t row) const
+        {
+            auto planeCoord = detector.coordFromLocal(point2<Scalar>(static_cast<Scalar>(col), static_cast<Scalar>(row)));
+            return rayFromPoints(source, planeCoord);
+        }
+
+        /**
+         * Rays through count neighbouring pixels (col, row), (col + 1, row), ... as one packet. Lanes past count repeat
+         * the last ray, so the packet can be traced as a whole and the extra lanes dropped.
+         */
+        template <typename Value>
+        ray<Value> pixelPacket(size_t col, size_t row, size_t count) const
+        {
+            Value o[3], d[3];
+            for (size_t lane = 0; lane < Value::Size; ++lane) {
+                const auto r = pixelRay(col + std::min(lane, count - 1), row);
+                const auto origin = r.origin();
+                const auto dir = r.dir();
+                o[0][lane] = origin.x();
+                o[1][lane] = origin.y();
+                o[2][lane] = origin.z();
+                d[0][lane] = dir.x();
+                d[1][lane] = dir.y();
+                d[2][lane] = dir.z();
+            }
+            return ray<Value>(point3<Value>(o[0], o[1], o[2]), vec3<Value>(d[0], d[1], d[2]),
+                              typename ray<Value>::ray_direction_normalized{});
+        }
+
+        /// Projection matrix of the view, built from the inverse mapping of the detector
+        projection_matrix<Scalar> projectionMatrix() const
+        {
+            // World to local is affine, recover it from the images of the origin and the unit vectors
+            auto o = detector.localFromCoord(point3<Scalar>(0, 0, 0));
+            auto ex = detector.localFromCoord(point3<Scalar>(1, 0, 0));
+            auto ey = detector.localFromCoord(point3<Scalar>(0, 1, 0));
+            auto ez = detector.localFromCoord(point3<Scalar>(0, 0, 1));
+
+            const Scalar local[3][4] = { { ex.x() - o.x(), ey.x() - o.x(), ez.x() - o.x(), o.x() },
+                                         { ex.y() - o.y(), ey.y() - o.y(), ez.y() - o.y(), o.y() },
+                                         { ex.z() - o.z(), ey.z() - o.z(), ez.z() - o.z(), o.z() } };
+
+            // The line from source s to p hits the plane z = 0 at (s.z * p.xy - p.z * s.xy) / (s.z - p.z)
+            auto s = detector.localFromCoord(source);
+
+            projection_matrix<Scalar> P{};
+            for (int j = 0; j < 4; ++j) {
+                P.rows[0][j] = s.z() * local[0][j] - s.x() * local[2][j];
+                P.rows[1][j] = s.z() * local[1][j] - s.y() * local[2][j];
+                P.rows[2][j] = -local[2][j];
+            }
+            P.rows[2][3] += s.z();
+
+            // Make w positive in front of the source
+            if (s.z() < 0) {
+                for (auto& row : P.rows)
+                    for (auto& e : row)
+                        e = -e;
+            }
+            return P;
+        }
+    };
+
+    /**
+     * Circular cone beam trajectory around the z-axis. Views are equiangular over [startAngle, startAngle + arc), the
+     * source sits at angle phi on the x-y plane and the flat detector faces it from the opposite side, its columns
+     * running along the tangent and its rows along z.
+     */
+    template <typename Scalar>
+    struct circular_trajectory {
+        size_t numViews;
+        Scalar sourceDistance;   // Source to rotation axis
+        Scalar detectorDistance; // Rotation axis to detector center
+        size_t cols;
+        size_t rows;
+        Scalar pixelWidth;
+        Scalar pixelHeight;
+        Scalar startAngle = 0;
+        Scalar arc = static_cast<Scalar>(2 * M_PI);
+
+        /// Angle step between two consecutive views
+        Scalar step() const { return arc / static_cast<Scalar>(numViews); }
+
+        Scalar angle(size_t k) const { return startAngle + static_cast<Scalar>(k) * step(); }
+
+        projection_view<Scalar> view(size_t k) const
+        {
+            auto phi = angle(k);
+            auto c = std::cos(phi);
+            auto s = std::sin(phi);
+
+            auto source = point3<Scalar>(sourceDistance * c, sourceDistance * s, 0);
+            auto center = point3<Scalar>(-detectorDistance * c, -detectorDistance * s, 0);
+            auto u = vec3<Scalar>(-s * pixelWidth * cols, c * pixelWidth * cols, 0);
+            auto v = vec3<Scalar>(0, 0, pixelHeight * rows);
+
+            return { source, rectangle<Scalar>(point2<Scalar>(static_cast<Scalar>(cols), static_cast<Scalar>(rows)), center, u, v) };
+        }
+
+        std::vector<projection_view<Scalar>> views() const
+        {
+            std::vector<projection_view<Scalar>> result;
+            result.reserve(numViews);
+            for (size_t k = 0; k < numViews; ++k)
+                result.push_back(view(k));
+            return result;
+        }
+    };
+
+    /**
+     * Full description of a scan: the reconstructed voxel grid and all views. Detector pixels of all views are numbered
+     * consecutively (view after view, row after row), which is the row numbering of the system matrix.
+     */
+    template <typename Scalar>
+    class scan_geometry
+    {
+    public:
+        scan_geometry(const voxel_grid<Scalar>& grid, std::vector<projection_view<Scalar>> views)
+            : grid_(grid), views_(std::move(views)), offsets_(views_.size() + 1, 0)
+        {
+            for (size_t v = 0; v < views_.size(); ++v)
+                offsets_[v + 1] = offsets_[v] + views_[v].cols() * views_[v].rows();
+        }
+
+        const voxel_grid<Scalar>& grid() const { return grid_; }
+
+        const std::vector<projection_view<Scalar>>& views() const { return views_; }
+
+        size_t numViews() const { return views_.size(); }
+
+        /// Total number of detector pixels over all views
+        size_t numPixels() const { return offsets_.back(); }
+
+        /// Index of the first pixel of view v
+        size_t pixelOffset(size_t v) const { return offsets_[v]; }
+
+        /// Ray from the source through the center of pixel (col, row) of view v
+        ray<Scalar> pixelRay(size_t v, size_t col, size_t row) const { return views_[v].pixelRay(col, row); }
+
+        /// Hash identifying grid and views, used to key cached system matrices
+        uint64_t hash() const
+        {
+            uint64_t h = details::hash_bytes(uint64_t{ 0x746f6d6f73656374ull });
+
+            h = details::hash_bytes(static_cast<uint64_t>(grid_.nx()), h);
+            h = details::hash_bytes(static_cast<uint64_t>(grid_.ny()), h);
+            h = details::hash_bytes(static_cast<uint64_t>(grid_.nz()), h);
+            h = details::hash_point(grid_.min(), h);
+            h = details::hash_point(grid_.min() + grid_.spacing(), h);
+
+            for (const auto& view : views_) {
+                h = details::hash_bytes(static_cast<uint64_t>(view.cols()), h);
+                h = details::hash_bytes(static_cast<uint64_t>(view.rows()), h);
+                h = details::hash_point(view.source, h);
+
+                // Three pixel centers fully describe the pixel lattice of the plane
+                h = details::hash_point(view.detector.coordFromLocal(point2<Scalar>(0, 0)), h);
+                h = details::hash_point(view.detector.coordFromLocal(point2<Scalar>(1, 0)), h);
+                h = details::hash_point(view.detector.coordFromLocal(point2<Scalar>(0, 1)), h);
+            }
+            return h;
+        }
+
+    private:
+        voxel_grid<Scalar> grid_;
+        std::vector<projection_view<Scalar>> views_;
+        std::vector<size_t> offsets_; // First pixel index of each view, plus total
+    };
+} // namespace tomosect
@@ -0,0 +1,128 @@
+/**
+ *
+ * \file spsc_queue.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Bounded lock-free queue for exactly one producer and one consumer thread (ring buffer with acquire/release
+     * indices). push() blocks while the queue is full, which is the backpressure between pipeline stages, pop() blocks
+     * while it is empty. After close() pushes fail and pops drain the remaining elements, then fail as well.
+     */
+    template <typename T>
+    class spsc_queue
+    {
+    public:
+        /// Capacity is rounded up to a power of two
+        explicit spsc_queue(size_t capacity)
+        {
+            if (capacity == 0)
+                throw std::invalid_argument("spsc_queue: capacity must not be zero");
+
+            size_t size = 1;
+            while (size < capacity)
+                size *= 2;
+
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        size_t capacity() const { return slots_.size(); }
+
+        /// Producer only. Returns false if the queue is full.
+        bool tryPush(T& value)
+        {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - headCache_ == slots_.size()) {
+                headCache_ = head_.load(std::memory_order_acquire);
+                if (tail - headCache_ == slots_.size())
+                    return false;
+            }
+
+            slots_[tail & mask_] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Consumer only. Returns nothing if the queue is empty.
+        std::optional<T> tryPop()
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head == tailCache_) {
+                tailCache_ = tail_.load(std::memory_order_acquire);
+                if (head == tailCache_)
+                    return std::nullopt;
+            }
+
+            std::optional<T> value(std::move(slots_[head & mask_]));
+            head_.store(head + 1, std::memory_order_release);
+            return value;
+        }
+
+        /// Producer only. Waits while the queue is full, returns false if it was closed.
+        bool push(T value)
+        {
+            for (unsigned spins = 0;; ++spins) {
+                if (closed_.load(std::memory_order_acquire))
+                    return false;
+                if (tryPush(value))
+                    return true;
+                backoff(spins);
+            }
+        }
+
+        /// Consumer only. Waits while the queue is empty, returns nothing once it is closed and drained.
+        std::optional<T> pop()
+        {
+            for (unsigned spins = 0;; ++spins) {
+                if (auto value = tryPop())
+                    return value;
+
+                // Elements pushed before closing are still delivered
+                if (closed_.load(std::memory_order_acquire))
+                    return tryPop();
+
+                backoff(spins);
+            }
+        }
+
+        /// Either side, wakes up a waiting push or pop
+        void close() { closed_.store(true, std::memory_order_release); }
+
+        bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    private:
+        static void backoff(unsigned spins)
+        {
+            // Stages run for milliseconds per element, so yielding early costs nothing
+            if (spins > 64)
+                std::this_thread::yield();
+        }
+
+        std::vector<T> slots_;
+        size_t mask_ = 0;
+
+        // Producer and consumer side on separate cache lines
+        alignas(64) std::atomic<size_t> tail_{ 0 };
+        size_t headCache_ = 0; // Producer's copy of head_
+        alignas(64) std::atomic<size_t> head_{ 0 };
+        size_t tailCache_ = 0; // Consumer's copy of tail_
+        alignas(64) std::atomic<bool> closed_{ false };
+    };
+} // namespace tomosect
@@ -0,0 +1,219 @@
+/**
+ *
+ * \file supersampling.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Sub-rays traced per detector pixel: a regular subCols x subRows grid of points on the pixel (the centers of equal
+     * strata) and a focalCols x focalRows grid of points on the focal spot. The focal spot is a rectangle of focalWidth x
+     * focalHeight around the source, parallel to the detector, its width along the detector columns.
+     */
+    template <typename Scalar>
+    struct supersampling {
+        size_t subCols = 1;
+        size_t subRows = 1;
+        size_t focalCols = 1;
+        size_t focalRows = 1;
+        Scalar focalWidth = 0;
+        Scalar focalHeight = 0;
+
+        size_t detectorSamples() const { return subCols * subRows; }
+        size_t focalSamples() const { return focalCols * focalRows; }
+        size_t samplesPerPixel() const { return detectorSamples() * focalSamples(); }
+    };
+
+    /**
+     * Generator of the supersampled rays of a view. Samples are numbered row by row, within a row sample s of pixel col
+     * has index col * samplesPerPixel() + s, so the samples of a pixel are neighbours in a packet. Within a pixel the
+     * detector samples run fastest, the focal spot samples slowest.
+     */
+    template <typename Scalar>
+    class supersampled_rays
+    {
+    public:
+        supersampled_rays(const projection_view<Scalar>& view, const supersampling<Scalar>& options)
+            : cols_(view.cols()), source_(view.source), first_(view.detector.coordFromLocal(point2<Scalar>(0, 0))),
+              colStep_(view.detector.coordFromLocal(point2<Scalar>(1, 0)) - first_),
+              rowStep_(view.detector.coordFromLocal(point2<Scalar>(0, 1)) - first_), samples_(options.samplesPerPixel())
+        {
+            if (options.samplesPerPixel() == 0)
+                throw std::invalid_argument("supersampled_rays: at least one sample per pixel needed");
+            if (!(options.focalWidth >= 0) || !(options.focalHeight >= 0))
+                throw std::invalid_argument("supersampled_rays: negative focal spot size");
+
+            const Scalar colPitch = std::sqrt(dot(colStep_, colStep_));
+            const Scalar rowPitch = std::sqrt(dot(rowStep_, rowStep_));
+            const vec3<Scalar> focalU = colStep_ * (options.focalWidth / colPitch);
+            const vec3<Scalar> focalV = rowStep_ * (options.focalHeight / rowPitch);
+
+            // Offsets of the stratum centers from the middle, in units of the stratified length
+            auto stratum = [](size_t i, size_t n) { return (static_cast<Scalar>(i) + Scalar(0.5)) / static_cast<Scalar>(n) - Scalar(0.5); };
+
+            offsetCol_.reserve(samples_);
+            offsetRow_.reserve(samples_);
+            focal_.reserve(samples_);
+            for (size_t fr = 0; fr < options.focalRows; ++fr) {
+                for (size_t fc = 0; fc < options.focalCols; ++fc) {
+                    const vec3<Scalar> shift = focalU * stratum(fc, options.focalCols) + focalV * stratum(fr, options.focalRows);
+                    for (size_t r = 0; r < options.subRows; ++r) {
+                        for (size_t c = 0; c < options.subCols; ++c) {
+                            offsetCol_.push_back(stratum(c, options.subCols));
+                            offsetRow_.push_back(stratum(r, options.subRows));
+                            focal_.push_back(shift);
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t samplesPerPixel() const { return samples_; }
+
+        /// Number of samples of a detector row
+        size_t samplesPerRow() const { return cols_ * samples_; }
+
+        /// Sub-ray s of pixel (col, row)
+        ray<Scalar> sample(size_t col, size_t row, size_t s) const
+        {
+            const auto target =
+                first_ + colStep_ * (static_cast<Scalar>(col) + offsetCol_[s]) + rowStep_ * (static_cast<Scalar>(row) + offsetRow_[s]);
+            return rayFromPoints(source_ + focal_[s], target);
+        }
+
+        /**
+         * Samples [first, first + count) of the row as one packet. Lanes past count repeat the last sample, so the packet
+         * can be traced as a whole and the extra lanes dropped.
+         */
+        template <typename Value>
+        ray<Value> packet(size_t row, size_t first, size_t count) const
+        {
+            // Index arithmetic per lane, the points themselves are computed for all lanes at once
+            Value u, v, s[3];
+            for (size_t lane = 0; lane < Value::Size; ++lane) {
+                const size_t index = first + std::min(lane, count - 1);
+                const size_t col = index / samples_;
+                const size_t k = index - col * samples_;
+                u[lane] = static_cast<Scalar>(col) + offsetCol_[k];
+                v[lane] = offsetRow_[k];
+                s[0][lane] = focal_[k].x();
+                s[1][lane] = focal_[k].y();
+                s[2][lane] = focal_[k].z();
+            }
+            v += Value(static_cast<Scalar>(row));
+
+            const point3<Value> target(Value(first_.x()) + u * colStep_.x() + v * rowStep_.x(),
+                                       Value(first_.y()) + u * colStep_.y() + v * rowStep_.y(),
+                                       Value(first_.z()) + u * colStep_.z() + v * rowStep_.z());
+            const point3<Value> origin(Value(source_.x()) + s[0], Value(source_.y()) + s[1], Value(source_.z()) + s[2]);
+            return rayFromPoints(origin, target);
+        }
+
+    private:
+        size_t cols_;
+        point3<Scalar> source_;
+        // Pixel lattice of the plane, continuous pixel coordinates map affinely to points
+        point3<Scalar> first_; // Center of pixel (0, 0)
+        vec3<Scalar> colStep_;
+        vec3<Scalar> rowStep_;
+        size_t samples_;
+
+        // Per sample of a pixel: offset in pixels from its center, offset of the focal spot point from the source
+        std::vector<Scalar> offsetCol_;
+        std::vector<Scalar> offsetRow_;
+        std::vector<vec3<Scalar>> focal_;
+    };
+
+    /**
+     * Supersampled projection of a view: the mean of f over the sub-rays of each pixel, in row major order into out (cols
+     * * rows values). f maps a packet of rays to a packet of line integrals, e.g. the lineIntegral of an analytic phantom.
+     *
+     * Rows are processed in parallel, each one as a stream of packets of 8 consecutive samples. The sums of the pixels are
+     * kept in registers while streaming and written once, as mean, when a pixel is complete: if the samples of a pixel
+     * fill whole packets they are added up lane wise and reduced at the end, otherwise a packet holds several pixels and
+     * its lanes are added to the running sum of their pixel.
+     */
+    template <typename Scalar, typename Function>
+    void project_supersampled(const projection_view<Scalar>& view, const supersampling<Scalar>& options, Function&& f, float* out)
+    {
+        using Value = pack8<Scalar>;
+        constexpr size_t lanes = 8;
+
+        const supersampled_rays<Scalar> rays(view, options);
+        const size_t cols = view.cols();
+        const size_t samples = rays.samplesPerPixel();
+        const size_t perRow = rays.samplesPerRow();
+        const Scalar scale = Scalar(1) / static_cast<Scalar>(samples);
+
+        parallel_for(0, view.rows(), [&](size_t row) {
+            float* pixels = out + row * cols;
+
+            if (samples % lanes == 0) {
+                for (size_t col = 0; col < cols; ++col) {
+                    Value sum(0);
+                    for (size_t s = 0; s < samples; s += lanes)
+                        sum += f(rays.template packet<Value>(row, col * samples + s, lanes));
+                    pixels[col] = static_cast<float>(enoki::hsum(sum) * scale);
+                }
+                return;
+            }
+
+            size_t col = 0;
+            size_t left = samples; // Samples of pixel col not yet added
+            Scalar sum = 0;
+            for (size_t first = 0; first < perRow; first += lanes) {
+                const size_t n = std::min(lanes, perRow - first);
+                const Value integral = f(rays.template packet<Value>(row, first, n));
+                for (size_t lane = 0; lane < n; ++lane) {
+                    sum += integral[lane];
+                    if (--left == 0) {
+                        pixels[col++] = static_cast<float>(sum * scale);
+                        sum = 0;
+                        left = samples;
+                    }
+                }
+            }
+        });
+    }
+
+    /// Supersampled projection of a voxel volume, the lanes of each packet are traced through the grid one by one
+    template <typename Scalar, typename T, volume_layout Layout>
+    void project_supersampled(const projection_view<Scalar>& view, const supersampling<Scalar>& options, const voxel_grid<Scalar>& grid,
+                              const volume<T, Layout>& vol, float* out)
+    {
+        using Value = pack8<Scalar>;
+
+        project_supersampled(
+            view, options,
+            [&](const ray<Value>& r) {
+                const auto o = r.origin();
+                const auto d = r.dir();
+
+                Value result;
+                for (size_t lane = 0; lane < Value::Size; ++lane) {
+                    const ray<Scalar> single(point3<Scalar>(o.x()[lane], o.y()[lane], o.z()[lane]),
+                                             vec3<Scalar>(d.x()[lane], d.y()[lane], d.z()[lane]),
+                                             typename ray<Scalar>::ray_direction_normalized{});
+                    result[lane] = project(single, grid, vol);
+                }
+                return result;
+            },
+            out);
+    }
+} // namespace tomosect
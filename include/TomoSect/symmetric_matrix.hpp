@@ -0,0 +1,210 @@
+/**
+ *
+ * \file symmetric_matrix.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/polar_grid.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/system_matrix.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace tomosect::details
+{
+    /**
+     * Smallest number of views g, such that rotating by g view steps is a rotation by a whole number of sectors of the
+     * grid. Returns {g, sectors}, or {numViews, 0} if no view of the trajectory is such a rotation of an earlier one.
+     */
+    template <typename Scalar>
+    std::pair<size_t, size_t> symmetry_period(const circular_trajectory<Scalar>& trajectory, const polar_grid<Scalar>& grid)
+    {
+        // View step in units of sectors
+        double ratio = static_cast<double>(trajectory.step()) / static_cast<double>(grid.sectorAngle());
+
+        for (size_t g = 1; g < trajectory.numViews; ++g) {
+            double sectors = ratio * static_cast<double>(g);
+            double whole = std::round(sectors);
+
+            if (whole >= 1 && std::abs(sectors - whole) < 1e-6 * std::max(1.0, sectors))
+                return { g, static_cast<size_t>(whole) };
+        }
+        return { trajectory.numViews, 0 };
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * System matrix of a circular scan on a polar grid, which only stores the rows of the first g views. View k is view
+     * (k mod g) with the volume rotated by (k / g) * sectorsPerPeriod sectors, so its entries are the stored ones with
+     * the angular part of the column index shifted on the fly. Memory shrinks by numViews / g compared to the full matrix.
+     */
+    class symmetric_matrix
+    {
+    public:
+        /**
+         * Wrap the matrix of the first viewsPerPeriod views (as assembled or loaded from a cache) for a scan with numViews
+         * views. The grid has to have nphi sectors, with the cell numbering of polar_grid.
+         */
+        symmetric_matrix(csr_matrix sector, size_t numViews, size_t viewsPerPeriod, size_t sectorsPerPeriod, size_t nphi)
+            : sector_(std::move(sector)), numViews_(numViews), viewsPerPeriod_(viewsPerPeriod), sectorsPerPeriod_(sectorsPerPeriod),
+              nphi_(nphi)
+        {
+            if (viewsPerPeriod_ == 0 || numViews_ % viewsPerPeriod_ != 0 || sector_.rows() % viewsPerPeriod_ != 0)
+                throw std::invalid_argument("symmetric_matrix: number of views is not a multiple of the symmetry period");
+
+            if (nphi_ == 0 || sector_.cols() % nphi_ != 0)
+                throw std::invalid_argument("symmetric_matrix: number of columns is not a multiple of the number of sectors");
+
+            pixelsPerView_ = sector_.rows() / viewsPerPeriod_;
+        }
+
+        size_t rows() const { return numViews_ * pixelsPerView_; }
+        size_t cols() const { return sector_.cols(); }
+
+        size_t numViews() const { return numViews_; }
+        size_t viewsPerPeriod() const { return viewsPerPeriod_; }
+        size_t pixelsPerView() const { return pixelsPerView_; }
+
+        /// The stored rows, those of the first viewsPerPeriod() views
+        const csr_matrix& sector() const { return sector_; }
+
+        /// Number of nonzeros of the full matrix this represents
+        size_t nnz() const { return sector_.nnz() * (numViews_ / viewsPerPeriod_); }
+
+        /// Bytes held by the stored rows
+        size_t memoryUsage() const
+        {
+            return (sector_.rows() + 1) * sizeof(uint64_t) + sector_.nnz() * (sizeof(uint32_t) + sizeof(float));
+        }
+
+        /// Stored row and sector shift of global row i
+        std::pair<size_t, size_t> storedRow(size_t i) const
+        {
+            size_t view = i / pixelsPerView_;
+            size_t period = view / viewsPerPeriod_;
+            size_t row = i - period * viewsPerPeriod_ * pixelsPerView_;
+            return { row, (period * sectorsPerPeriod_) % nphi_ };
+        }
+
+        /// Column a stored entry maps to, if the volume is rotated by shift sectors
+        size_t mapColumn(uint32_t col, size_t shift) const
+        {
+            size_t phi = col % nphi_;
+            size_t shifted = phi + shift;
+            return col - phi + (shifted >= nphi_ ? shifted - nphi_ : shifted);
+        }
+
+    private:
+        csr_matrix sector_;
+        size_t numViews_;
+        size_t viewsPerPeriod_;
+        size_t sectorsPerPeriod_;
+        size_t nphi_;
+        size_t pixelsPerView_ = 0;
+    };
+
+    /**
+     * Assemble the system matrix of a circular scan on a polar grid, exploiting the rotational symmetry. Only the views
+     * of the first symmetry period are traced, all others are mapped to them. For numViews views and nphi sectors the
+     * best case is a reduction by gcd(numViews, nphi) (for full 360 degree scans).
+     */
+    template <typename Scalar>
+    symmetric_matrix assemble_symmetric_matrix(const circular_trajectory<Scalar>& trajectory, const polar_grid<Scalar>& grid)
+    {
+        auto [viewsPerPeriod, sectorsPerPeriod] = details::symmetry_period(trajectory, grid);
+
+        // Only whole periods can be mapped, otherwise store everything
+        if (trajectory.numViews % viewsPerPeriod != 0)
+            std::tie(viewsPerPeriod, sectorsPerPeriod) = std::pair<size_t, size_t>{ trajectory.numViews, 0 };
+
+        std::vector<projection_view<Scalar>> views;
+        views.reserve(viewsPerPeriod);
+        for (size_t k = 0; k < viewsPerPeriod; ++k)
+            views.push_back(trajectory.view(k));
+
+        auto traverseRay = [&grid](const ray<Scalar>& r, auto&& f) { traverse(r, grid, f); };
+        auto sector = assemble_system_matrix(views, grid.size(), traverseRay);
+
+        return symmetric_matrix(std::move(sector), trajectory.numViews, viewsPerPeriod, sectorsPerPeriod, grid.nphi());
+    }
+
+    /// Forward projection y = A * x, parallel over rows
+    inline void spmv(const symmetric_matrix& A, const float* x, float* y)
+    {
+        const auto& S = A.sector();
+        const auto* rowPtr = S.rowPtr();
+        const auto* colIdx = S.colIdx();
+        const auto* values = S.values();
+
+        parallel_for(
+            0, A.rows(),
+            [&](size_t i) {
+                auto [row, shift] = A.storedRow(i);
+
+                float sum = 0;
+                for (auto k = rowPtr[row]; k < rowPtr[row + 1]; ++k)
+                    sum += values[k] * x[A.mapColumn(colIdx[k], shift)];
+                y[i] = sum;
+            },
+            256);
+    }
+
+    /**
+     * Backprojection x = A^T * y, with per-thread accumulation buffers as for the plain CSR matrix. Needs
+     * threads * cols() floats of scratch memory.
+     */
+    inline void spmv_transposed(const symmetric_matrix& A, const float* y, float* x, size_t numThreads = 0)
+    {
+        const auto& S = A.sector();
+        const auto* rowPtr = S.rowPtr();
+        const auto* colIdx = S.colIdx();
+        const auto* values = S.values();
+
+        numThreads = numThreads == 0 ? hardware_threads() : numThreads;
+        numThreads = std::max<size_t>(1, std::min(numThreads, A.rows()));
+
+        std::vector<std::vector<float>> partial(numThreads);
+
+        parallel_for(
+            0, numThreads,
+            [&](size_t t) {
+                auto& acc = partial[t];
+                acc.assign(A.cols(), 0.f);
+
+                size_t first = A.rows() * t / numThreads;
+                size_t last = A.rows() * (t + 1) / numThreads;
+
+                for (size_t i = first; i < last; ++i) {
+                    float yi = y[i];
+                    if (yi == 0.f)
+                        continue;
+
+                    auto [row, shift] = A.storedRow(i);
+                    for (auto k = rowPtr[row]; k < rowPtr[row + 1]; ++k)
+                        acc[A.mapColumn(colIdx[k], shift)] += values[k] * yi;
+                }
+            },
+            1, numThreads);
+
+        parallel_for(
+            0, A.cols(),
+            [&](size_t j) {
+                float sum = 0;
+                for (const auto& acc : partial)
+                    sum += acc[j];
+                x[j] = sum;
+            },
+            4096);
+    }
+} // namespace tomosect
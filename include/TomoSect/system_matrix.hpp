@@ -0,0 +1,379 @@
+/**
+ *
+ * \file system_matrix.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/traversal.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tomosect::details
+{
+    /**
+     * Layout of the on-disk system matrix (native endianness). The header is followed by the three CSR arrays, each
+     * starting at a 64 byte aligned offset, so the file can be mapped and used in place.
+     */
+    struct csr_file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t geometryHash;
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t nnz;
+        uint64_t rowPtrOffset;
+        uint64_t colIdxOffset;
+        uint64_t valuesOffset;
+    };
+
+    inline constexpr char csr_magic[8] = { 'T', 'S', 'C', 'S', 'R', 0, 0, 0 };
+    inline constexpr uint32_t csr_version = 1;
+
+    inline uint64_t align64(uint64_t offset) { return (offset + 63) & ~uint64_t{ 63 }; }
+
+    inline csr_file_header make_csr_header(uint64_t hash, uint64_t rows, uint64_t cols, uint64_t nnz)
+    {
+        csr_file_header header{};
+        std::memcpy(header.magic, csr_magic, sizeof(csr_magic));
+        header.version = csr_version;
+        header.headerSize = sizeof(csr_file_header);
+        header.geometryHash = hash;
+        header.rows = rows;
+        header.cols = cols;
+        header.nnz = nnz;
+        header.rowPtrOffset = align64(sizeof(csr_file_header));
+        header.colIdxOffset = align64(header.rowPtrOffset + (rows + 1) * sizeof(uint64_t));
+        header.valuesOffset = align64(header.colIdxOffset + nnz * sizeof(uint32_t));
+        return header;
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * Sparse matrix in compressed sparse row format, with 64 bit row pointers, 32 bit column indices and float weights.
+     * The arrays either live on the heap or in a read-only file mapping, copies share the same storage.
+     */
+    class csr_matrix
+    {
+    public:
+        csr_matrix() = default;
+
+        csr_matrix(size_t rows, size_t cols, std::vector<uint64_t> rowPtr, std::vector<uint32_t> colIdx, std::vector<float> values,
+                   uint64_t geometryHash = 0)
+            : rows_(rows), cols_(cols), nnz_(values.size()), hash_(geometryHash)
+        {
+            if (rowPtr.size() != rows + 1 || colIdx.size() != values.size() || rowPtr.back() != values.size())
+                throw std::invalid_argument("csr_matrix: inconsistent array sizes");
+
+            auto storage = std::make_shared<heap_storage>();
+            storage->rowPtr = std::move(rowPtr);
+            storage->colIdx = std::move(colIdx);
+            storage->values = std::move(values);
+
+            rowPtr_ = storage->rowPtr.data();
+            colIdx_ = storage->colIdx.data();
+            values_ = storage->values.data();
+            storage_ = std::move(storage);
+        }
+
+        size_t rows() const { return rows_; }
+        size_t cols() const { return cols_; }
+        size_t nnz() const { return nnz_; }
+
+        const uint64_t* rowPtr() const { return rowPtr_; }
+        const uint32_t* colIdx() const { return colIdx_; }
+        const float* values() const { return values_; }
+
+        /// Hash of the scan geometry this matrix was assembled for, 0 if unknown
+        uint64_t geometryHash() const { return hash_; }
+
+        /// Write the matrix in the binary format understood by map()
+        void save(const std::string& path) const
+        {
+            auto header = details::make_csr_header(hash_, rows_, cols_, nnz_);
+
+            // Write to a temporary and rename, so a concurrent reader never sees a half written file
+            auto tmp = path + ".tmp";
+            {
+                std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                if (!out)
+                    throw std::runtime_error("csr_matrix: cannot write " + tmp);
+
+                auto write_at = [&out](uint64_t offset, const void* data, size_t bytes) {
+                    static const char zeros[64] = {};
+                    auto pos = static_cast<uint64_t>(out.tellp());
+                    out.write(zeros, static_cast<std::streamsize>(offset - pos));
+                    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+                };
+
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                write_at(header.rowPtrOffset, rowPtr_, (rows_ + 1) * sizeof(uint64_t));
+                write_at(header.colIdxOffset, colIdx_, nnz_ * sizeof(uint32_t));
+                write_at(header.valuesOffset, values_, nnz_ * sizeof(float));
+
+                if (!out)
+                    throw std::runtime_error("csr_matrix: failed writing " + tmp);
+            }
+            std::filesystem::rename(tmp, path);
+        }
+
+        /**
+         * Map a matrix written by save() read-only into memory, nothing is copied. The row pointers and column indices
+         * are checked once, so a corrupt file can't lead to reads outside of the mapping later on.
+         */
+        static csr_matrix map(const std::string& path)
+        {
+            auto file = std::make_shared<mapped_file>(path);
+
+            details::csr_file_header header{};
+            if (file->size() < sizeof(header))
+                throw std::runtime_error("csr_matrix: file too small " + path);
+
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (std::memcmp(header.magic, details::csr_magic, sizeof(header.magic)) != 0 || header.version != details::csr_version)
+                throw std::runtime_error("csr_matrix: not a system matrix file " + path);
+
+            // Bound the counts by the file size first, so the offsets below can't overflow
+            if (header.rows >= file->size() / sizeof(uint64_t) || header.nnz > file->size() / sizeof(float))
+                throw std::runtime_error("csr_matrix: truncated or corrupt file " + path);
+
+            auto expected = details::make_csr_header(header.geometryHash, header.rows, header.cols, header.nnz);
+            if (header.rowPtrOffset != expected.rowPtrOffset || header.colIdxOffset != expected.colIdxOffset
+                || header.valuesOffset != expected.valuesOffset || file->size() < header.valuesOffset + header.nnz * sizeof(float))
+                throw std::runtime_error("csr_matrix: truncated or corrupt file " + path);
+
+            csr_matrix m;
+            m.rows_ = header.rows;
+            m.cols_ = header.cols;
+            m.nnz_ = header.nnz;
+            m.hash_ = header.geometryHash;
+            m.rowPtr_ = file->at<uint64_t>(header.rowPtrOffset);
+            m.colIdx_ = file->at<uint32_t>(header.colIdxOffset);
+            m.values_ = file->at<float>(header.valuesOffset);
+
+            if (m.rowPtr_[0] != 0 || m.rowPtr_[m.rows_] != m.nnz_)
+                throw std::runtime_error("csr_matrix: corrupt row pointers in " + path);
+            for (size_t row = 0; row < m.rows_; ++row)
+                if (m.rowPtr_[row] > m.rowPtr_[row + 1])
+                    throw std::runtime_error("csr_matrix: corrupt row pointers in " + path);
+            for (size_t i = 0; i < m.nnz_; ++i)
+                if (m.colIdx_[i] >= m.cols_)
+                    throw std::runtime_error("csr_matrix: column index out of range in " + path);
+
+            m.storage_ = std::move(file);
+            return m;
+        }
+
+    private:
+        struct heap_storage {
+            std::vector<uint64_t> rowPtr;
+            std::vector<uint32_t> colIdx;
+            std::vector<float> values;
+        };
+
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        size_t nnz_ = 0;
+        uint64_t hash_ = 0;
+
+        const uint64_t* rowPtr_ = nullptr;
+        const uint32_t* colIdx_ = nullptr;
+        const float* values_ = nullptr;
+
+        std::shared_ptr<const void> storage_; // Keeps heap arrays or the file mapping alive
+    };
+
+    /**
+     * Assemble a system matrix from the given views: row i holds the path lengths of the ray through detector pixel i
+     * (view after view, row after row) through every voxel it traverses. traverseRay(ray, f) has to call f(voxel, length)
+     * for every voxel hit, which lets the same assembly work for any voxel grid. Every detector row of every view is an
+     * independent task, the tasks run in parallel. Column indices within a row are sorted.
+     */
+    template <typename Scalar, typename Traverse>
+    csr_matrix assemble_system_matrix(const std::vector<projection_view<Scalar>>& views, size_t numVoxels, Traverse&& traverseRay,
+                                      uint64_t geometryHash = 0)
+    {
+        if (numVoxels > std::numeric_limits<uint32_t>::max())
+            throw std::length_error("assemble_system_matrix: too many voxels for 32 bit column indices");
+
+        // First task and first matrix row of each view, a task is one detector row
+        std::vector<size_t> taskBegin(views.size() + 1, 0);
+        std::vector<size_t> rowBegin(views.size() + 1, 0);
+        for (size_t v = 0; v < views.size(); ++v) {
+            taskBegin[v + 1] = taskBegin[v] + views[v].rows();
+            rowBegin[v + 1] = rowBegin[v] + views[v].rows() * views[v].cols();
+        }
+
+        const size_t numTasks = taskBegin.back();
+        const size_t numRows = rowBegin.back();
+
+        std::vector<std::vector<std::pair<uint32_t, float>>> taskEntries(numTasks);
+        std::vector<uint64_t> rowPtr(numRows + 1, 0);
+
+        auto viewOf = [&](size_t task) {
+            return static_cast<size_t>(std::upper_bound(taskBegin.begin(), taskBegin.end(), task) - taskBegin.begin()) - 1;
+        };
+        auto firstRowOf = [&](size_t task, size_t v) { return rowBegin[v] + (task - taskBegin[v]) * views[v].cols(); };
+
+        parallel_for(0, numTasks, [&](size_t task) {
+            size_t v = viewOf(task);
+            size_t first = firstRowOf(task, v);
+            size_t detectorRow = task - taskBegin[v];
+            auto& entries = taskEntries[task];
+
+            for (size_t col = 0; col < views[v].cols(); ++col) {
+                size_t before = entries.size();
+
+                traverseRay(views[v].pixelRay(col, detectorRow), [&entries](size_t voxel, Scalar length) {
+                    entries.emplace_back(static_cast<uint32_t>(voxel), static_cast<float>(length));
+                });
+
+                std::sort(entries.begin() + before, entries.end());
+                rowPtr[first + col + 1] = entries.size() - before;
+            }
+        });
+
+        // Entries per row to row pointers
+        for (size_t i = 0; i < numRows; ++i)
+            rowPtr[i + 1] += rowPtr[i];
+
+        std::vector<uint32_t> colIdx(rowPtr.back());
+        std::vector<float> values(rowPtr.back());
+
+        parallel_for(0, numTasks, [&](size_t task) {
+            auto offset = rowPtr[firstRowOf(task, viewOf(task))];
+
+            for (const auto& [voxel, length] : taskEntries[task]) {
+                colIdx[offset] = voxel;
+                values[offset] = length;
+                ++offset;
+            }
+
+            std::vector<std::pair<uint32_t, float>>().swap(taskEntries[task]);
+        });
+
+        return csr_matrix(numRows, numVoxels, std::move(rowPtr), std::move(colIdx), std::move(values), geometryHash);
+    }
+
+    /// Assemble the system matrix of a scan on its regular voxel grid, rows are numbered as in scan_geometry
+    template <typename Scalar>
+    csr_matrix assemble_system_matrix(const scan_geometry<Scalar>& geometry)
+    {
+        const auto& grid = geometry.grid();
+        auto traverseRay = [&grid](const ray<Scalar>& r, auto&& f) { traverse(r, grid, f); };
+
+        return assemble_system_matrix(geometry.views(), grid.size(), traverseRay, geometry.hash());
+    }
+
+    /**
+     * Return the system matrix of the scan from the cache directory, assembling and storing it first if no matrix for
+     * this geometry (identified by scan_geometry::hash()) is cached yet. The returned matrix is always file backed.
+     */
+    template <typename Scalar>
+    csr_matrix load_or_assemble(const scan_geometry<Scalar>& geometry, const std::string& cacheDir)
+    {
+        auto hash = geometry.hash();
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "system_matrix_%016llx.tsm", static_cast<unsigned long long>(hash));
+        auto path = (std::filesystem::path(cacheDir) / name).string();
+
+        if (std::filesystem::exists(path)) {
+            try {
+                auto m = csr_matrix::map(path);
+                if (m.geometryHash() == hash && m.rows() == geometry.numPixels() && m.cols() == geometry.grid().size())
+                    return m;
+            } catch (const std::runtime_error&) {
+                // Stale or corrupt cache entry, assemble again below
+            }
+        }
+
+        std::filesystem::create_directories(cacheDir);
+        assemble_system_matrix(geometry).save(path);
+
+        return csr_matrix::map(path);
+    }
+
+    /// Forward projection y = A * x, parallel over rows
+    inline void spmv(const csr_matrix& A, const float* x, float* y)
+    {
+        const auto* rowPtr = A.rowPtr();
+        const auto* colIdx = A.colIdx();
+        const auto* values = A.values();
+
+        parallel_for(
+            0, A.rows(),
+            [&](size_t i) {
+                float sum = 0;
+                for (auto k = rowPtr[i]; k < rowPtr[i + 1]; ++k)
+                    sum += values[k] * x[colIdx[k]];
+                y[i] = sum;
+            },
+            256);
+    }
+
+    /**
+     * Backprojection x = A^T * y. Every thread scatters a contiguous block of rows into a private buffer of size cols(),
+     * the buffers are summed afterwards, again in parallel. Needs threads * cols() floats of scratch memory.
+     */
+    inline void spmv_transposed(const csr_matrix& A, const float* y, float* x, size_t numThreads = 0)
+    {
+        const auto* rowPtr = A.rowPtr();
+        const auto* colIdx = A.colIdx();
+        const auto* values = A.values();
+
+        numThreads = numThreads == 0 ? hardware_threads() : numThreads;
+        numThreads = std::max<size_t>(1, std::min(numThreads, A.rows()));
+
+        std::vector<std::vector<float>> partial(numThreads);
+
+        parallel_for(
+            0, numThreads,
+            [&](size_t t) {
+                auto& acc = partial[t];
+                acc.assign(A.cols(), 0.f);
+
+                size_t first = A.rows() * t / numThreads;
+                size_t last = A.rows() * (t + 1) / numThreads;
+
+                for (size_t i = first; i < last; ++i) {
+                    float yi = y[i];
+                    if (yi == 0.f)
+                        continue;
+
+                    for (auto k = rowPtr[i]; k < rowPtr[i + 1]; ++k)
+                        acc[colIdx[k]] += values[k] * yi;
+                }
+            },
+            1, numThreads);
+
+        parallel_for(
+            0, A.cols(),
+            [&](size_t j) {
+                float sum = 0;
+                for (const auto& acc : partial)
+                    sum += acc[j];
+                x[j] = sum;
+            },
+            4096);
+    }
+} // namespace tomosect
@@ -0,0 +1,158 @@
+/**
+ *
+ * \file tile_culling.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+namespace tomosect
+{
+    /**
+     * Pyramid of all rays leaving the apex through a convex quadrilateral, bounded by the four side planes through the
+     * apex and the plane through the apex facing along the rays (rays start at the apex).
+     */
+    template <typename Scalar>
+    class ray_frustum
+    {
+    public:
+        /// Frustum through the given corners, in order around the quadrilateral (either orientation)
+        ray_frustum(const point3<Scalar>& apex, const std::array<point3<Scalar>, 4>& corners) : apex_(apex)
+        {
+            auto edge = [&](int i) { return corners[static_cast<size_t>(i % 4)] - apex; };
+            const auto center = edge(0) + edge(1) + edge(2) + edge(3);
+
+            for (int i = 0; i < 4; ++i) {
+                auto n = cross(edge(i), edge(i + 1));
+
+                // Normals point into the frustum
+                const Scalar sign = dot(n, center) < 0 ? Scalar{ -1 } : Scalar{ 1 };
+                normals_[i] = { sign * n.x(), sign * n.y(), sign * n.z() };
+            }
+            normals_[4] = { center.x(), center.y(), center.z() };
+        }
+
+        const point3<Scalar>& apex() const { return apex_; }
+
+        /**
+         * Conservative test against a box: false if the box lies completely outside of one of the planes, so no ray of
+         * the frustum can hit it. Boxes close to the frustum's edges might pass without being hit.
+         */
+        bool mayIntersect(const aabb<Scalar>& box) const
+        {
+            const auto lo = box.min() - apex_;
+            const auto hi = box.max() - apex_;
+
+            for (const auto& n : normals_) {
+                // Box corner furthest along the normal
+                Scalar x = n[0] > 0 ? hi.x() : lo.x();
+                Scalar y = n[1] > 0 ? hi.y() : lo.y();
+                Scalar z = n[2] > 0 ? hi.z() : lo.z();
+
+                if (n[0] * x + n[1] * y + n[2] * z < 0)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        point3<Scalar> apex_;
+        std::array<std::array<Scalar, 3>, 5> normals_; // Inward facing plane normals, the planes contain the apex
+    };
+
+    /// Frustum of the rays through the pixel centers of a tile of the detector
+    template <typename Scalar>
+    ray_frustum<Scalar> tile_frustum(const projection_view<Scalar>& view, const detector_window& tile)
+    {
+        auto corner = [&](size_t col, size_t row) {
+            return view.detector.coordFromLocal(point2<Scalar>(static_cast<Scalar>(col), static_cast<Scalar>(row)));
+        };
+
+        const size_t c0 = tile.colBegin, c1 = tile.colEnd - 1;
+        const size_t r0 = tile.rowBegin, r1 = tile.rowEnd - 1;
+        return ray_frustum<Scalar>(view.source, { corner(c0, r0), corner(c1, r0), corner(c1, r1), corner(c0, r1) });
+    }
+
+    enum class tile_class {
+        outside,   // No ray of the tile hits the box
+        inside,    // All rays of the tile hit the box
+        straddling // Some rays might hit the box, rays have to be tested one by one
+    };
+
+    /**
+     * Classify a detector tile against a box with one frustum test and the four corner rays. If all corner rays hit the
+     * box, all rays in between hit it too, as both the box and the tile are convex.
+     */
+    template <typename Scalar>
+    tile_class classify_tile(const projection_view<Scalar>& view, const detector_window& tile, const aabb<Scalar>& box)
+    {
+        if (!tile_frustum(view, tile).mayIntersect(box))
+            return tile_class::outside;
+
+        for (auto [col, row] : { std::pair{ tile.colBegin, tile.rowBegin }, std::pair{ tile.colEnd - 1, tile.rowBegin },
+                                 std::pair{ tile.colEnd - 1, tile.rowEnd - 1 }, std::pair{ tile.colBegin, tile.rowEnd - 1 } }) {
+            auto [tmin, tmax, hit] = intersection(view.pixelRay(col, row), box, ray_aabb_interval{});
+            if (!hit || tmax < 0)
+                return tile_class::straddling;
+        }
+        return tile_class::inside;
+    }
+
+    /// Number of tiles per class, of one or several views
+    struct tile_statistics {
+        size_t outside = 0;
+        size_t inside = 0;
+        size_t straddling = 0;
+
+        size_t tiles() const { return outside + inside + straddling; }
+
+        /// Fraction of tiles culled as a whole
+        double culledRatio() const { return tiles() == 0 ? 0.0 : static_cast<double>(outside) / static_cast<double>(tiles()); }
+
+        tile_statistics& operator+=(const tile_statistics& other)
+        {
+            outside += other.outside;
+            inside += other.inside;
+            straddling += other.straddling;
+            return *this;
+        }
+    };
+
+    /**
+     * Split the detector of the view into tiles of tileSize x tileSize pixels (smaller at the borders) and call
+     * f(tile, tileClass) for every tile which is not completely outside of the box.
+     */
+    template <typename Scalar, typename Function>
+    tile_statistics for_each_visible_tile(const projection_view<Scalar>& view, const aabb<Scalar>& box, size_t tileSize, Function&& f)
+    {
+        if (tileSize == 0)
+            throw std::invalid_argument("for_each_visible_tile: tile size must not be zero");
+
+        tile_statistics stats;
+        for (size_t row = 0; row < view.rows(); row += tileSize) {
+            for (size_t col = 0; col < view.cols(); col += tileSize) {
+                detector_window tile{ col, std::min(col + tileSize, view.cols()), row, std::min(row + tileSize, view.rows()) };
+
+                auto c = classify_tile(view, tile, box);
+                if (c == tile_class::outside) {
+                    ++stats.outside;
+                    continue;
+                }
+
+                ++(c == tile_class::inside ? stats.inside : stats.straddling);
+                f(tile, c);
+            }
+        }
+        return stats;
+    }
+} // namespace tomosect
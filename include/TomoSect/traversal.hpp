@@ -0,0 +1,163 @@
+/**
+ *
+ * \file traversal.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace tomosect
+{
+    /**
+     * Regular voxel grid, placed in world space by the position of its minimum corner and the size of a single voxel.
+     * Voxels are numbered row-major, x is the fastest running index: index = x + nx * (y + ny * z).
+     */
+    template <typename Scalar>
+    class voxel_grid
+    {
+    public:
+        voxel_grid() : voxel_grid(1, 1, 1, point3<Scalar>(0), vec3<Scalar>(1)) {}
+
+        voxel_grid(size_t nx, size_t ny, size_t nz, const point3<Scalar>& min, const vec3<Scalar>& voxelSize)
+            : nx_(nx), ny_(ny), nz_(nz), min_(min), spacing_(voxelSize),
+              bounds_(min, vec3<Scalar>(voxelSize.x() * nx, voxelSize.y() * ny, voxelSize.z() * nz))
+        {
+        }
+
+        size_t nx() const { return nx_; }
+        size_t ny() const { return ny_; }
+        size_t nz() const { return nz_; }
+
+        /// Number of voxels
+        size_t size() const { return nx_ * ny_ * nz_; }
+
+        size_t index(size_t x, size_t y, size_t z) const { return x + nx_ * (y + ny_ * z); }
+
+        point3<Scalar> min() const { return min_; }
+
+        vec3<Scalar> spacing() const { return spacing_; }
+
+        const aabb<Scalar>& bounds() const { return bounds_; }
+
+        point3<Scalar> voxelCenter(size_t x, size_t y, size_t z) const
+        {
+            return point3<Scalar>(min_.x() + (x + Scalar{ 0.5 }) * spacing_.x(), min_.y() + (y + Scalar{ 0.5 }) * spacing_.y(),
+                                  min_.z() + (z + Scalar{ 0.5 }) * spacing_.z());
+        }
+
+    private:
+        size_t nx_;
+        size_t ny_;
+        size_t nz_;
+        point3<Scalar> min_;   // World position of the minimum corner
+        vec3<Scalar> spacing_; // Size of a single voxel
+        aabb<Scalar> bounds_;  // Box enclosing the whole grid
+    };
+
+    /// Box of voxels [xBegin, xEnd) x [yBegin, yEnd) x [zBegin, zEnd) of a grid
+    struct voxel_box {
+        size_t xBegin, xEnd;
+        size_t yBegin, yEnd;
+        size_t zBegin, zEnd;
+
+        size_t nx() const { return xEnd - xBegin; }
+        size_t ny() const { return yEnd - yBegin; }
+        size_t nz() const { return zEnd - zBegin; }
+        size_t size() const { return nx() * ny() * nz(); }
+    };
+
+    namespace details
+    {
+        /**
+         * Amanatides & Woo walk along the ray segment [tmin, tmax], which has to lie inside the grid, restricted to the
+         * voxels [first, last) of the grid. Stops at tmax or when leaving these voxels.
+         */
+        template <typename Scalar, typename Function>
+        void walk_cells(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, Scalar tmin, Scalar tmax, const long first[3],
+                        const long last[3], Function&& f)
+        {
+            const Scalar o[3] = { r.origin().x(), r.origin().y(), r.origin().z() };
+            const Scalar d[3] = { r.dir().x(), r.dir().y(), r.dir().z() };
+            const Scalar lo[3] = { grid.min().x(), grid.min().y(), grid.min().z() };
+            const Scalar h[3] = { grid.spacing().x(), grid.spacing().y(), grid.spacing().z() };
+
+            long cell[3];
+            long step[3];
+            Scalar tNext[3];
+            Scalar tDelta[3];
+
+            for (int a = 0; a < 3; ++a) {
+                // Entry point in voxel units
+                Scalar p = (o[a] + d[a] * tmin - lo[a]) / h[a];
+                cell[a] = std::clamp(static_cast<long>(std::floor(p)), first[a], last[a] - 1);
+
+                if (d[a] > 0) {
+                    step[a] = 1;
+                    tDelta[a] = h[a] / d[a];
+                    tNext[a] = tmin + (cell[a] + 1 - p) * tDelta[a];
+                } else if (d[a] < 0) {
+                    step[a] = -1;
+                    tDelta[a] = -h[a] / d[a];
+                    tNext[a] = tmin + (p - cell[a]) * tDelta[a];
+                } else {
+                    step[a] = 0;
+                    tDelta[a] = std::numeric_limits<Scalar>::infinity();
+                    tNext[a] = std::numeric_limits<Scalar>::infinity();
+                }
+            }
+
+            Scalar t = tmin;
+            while (t < tmax) {
+                // Axis of the next voxel boundary
+                int a = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+
+                Scalar tExit = std::min(tNext[a], tmax);
+                if (tExit > t)
+                    f(static_cast<size_t>(cell[0]), static_cast<size_t>(cell[1]), static_cast<size_t>(cell[2]), tExit - t);
+
+                t = tExit;
+                cell[a] += step[a];
+                tNext[a] += tDelta[a];
+
+                if (cell[a] < first[a] || cell[a] >= last[a])
+                    return;
+            }
+        }
+    } // namespace details
+
+    /**
+     * Walk along the ray through the voxel grid (Amanatides & Woo) and call f(x, y, z, length) for every voxel the ray
+     * passes through, with the length of the ray segment inside that voxel. Voxels are visited in ray order.
+     */
+    template <typename Scalar, typename Function>
+    void traverse_cells(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, Function&& f)
+    {
+        auto [tmin, tmax, hit] = intersection(r, grid.bounds(), ray_aabb_interval{});
+
+        // Start inside the grid, if the origin is already in there
+        tmin = std::max(tmin, Scalar{ 0 });
+
+        if (!hit || tmax <= tmin)
+            return;
+
+        const long first[3] = { 0, 0, 0 };
+        const long last[3] = { static_cast<long>(grid.nx()), static_cast<long>(grid.ny()), static_cast<long>(grid.nz()) };
+        details::walk_cells(r, grid, tmin, tmax, first, last, f);
+    }
+
+    /// As traverse_cells, but calls f(voxelIndex, length) with the row-major index of the voxel in the grid
+    template <typename Scalar, typename Function>
+    void traverse(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, Function&& f)
+    {
+        traverse_cells(r, grid, [&](size_t x, size_t y, size_t z, Scalar length) { f(grid.index(x, y, z), length); });
+    }
+} // namespace tomosect
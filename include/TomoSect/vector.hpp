@@ -8,7 +8,8 @@
 #pragma once
 
 #include "enoki/array.h"
-#include <enoki/random.h>
+
+#include "TomoSect/random.hpp"
 
 template <size_t Size, typename Value>
 class vector
@@ -144,14 +145,17 @@ public:
 
     Vector data() const { return data_; }
 
-    static Self Random()
-    {
-        using RNG_16x = enoki::PCG32<Vector>;
-        RNG_16x my_rng;
-
-        Self point(my_rng.next_float32());
+    /// Random vector with components in [0, 1), from the generator of the calling thread
+    static Self Random() { return Random(tomosect::thread_random_stream<Value>()); }
 
-        return point;
+    /// Random vector with components in [0, 1), drawn from the given stream
+    template <typename Stream>
+    static Self Random(Stream& stream)
+    {
+        Vector v;
+        for (size_t i = 0; i < Size; ++i)
+            v[i] = stream.uniform();
+        return Self(v);
     }
 
 private:
@@ -254,14 +258,14 @@ template <size_t Size, typename Value>
 vector<Size, Value> operator*(const vector<Size, Value>& lhs, const Value& rhs)
 {
     auto copy = lhs;
-    copy += rhs;
+    copy *= rhs;
     return copy;
 }
 
 template <size_t Size, typename Value>
 vector<Size, Value> operator*(const Value& lhs, const vector<Size, Value>& rhs)
 {
-    return rhs + lhs;
+    return rhs * lhs;
 }
 
 template <size_t Size, typename Value>
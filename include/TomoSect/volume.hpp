@@ -0,0 +1,260 @@
+/**
+ *
+ * \file volume.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "enoki/array.h"
+
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/traversal.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * Memory layout of a volume:
+     *  - linear: row-major, x is the fastest running index
+     *  - bricked: 8x8x8 bricks stored one after another (row-major), row-major inside each brick
+     *  - morton: Z-order curve, the bits of x, y and z are interleaved
+     *
+     * Rays not aligned with x touch a new cache line (and for large volumes a new page) in nearly every voxel with the
+     * linear layout, the other two keep neighbouring voxels in all directions close in memory.
+     */
+    enum class volume_layout { linear, bricked, morton };
+} // namespace tomosect
+
+namespace tomosect::details
+{
+    /// Number of bits needed for the indices 0 to n - 1
+    inline uint32_t index_bits(size_t n)
+    {
+        uint32_t bits = 0;
+        while ((size_t{ 1 } << bits) < n)
+            ++bits;
+        return bits;
+    }
+
+    /**
+     * Morton code lookup table of one axis of a possibly non-cubic volume. The bits are interleaved as long as all axes
+     * have bits left, the remaining bits of the longer axes follow, so the curve covers the power of two padded box
+     * without holes. The code of (x, y, z) is tableX[x] | tableY[y] | tableZ[z].
+     */
+    inline std::vector<uint64_t> morton_table(const size_t n[3], int axis)
+    {
+        uint32_t bits[3] = { index_bits(n[0]), index_bits(n[1]), index_bits(n[2]) };
+        uint32_t maxBits = std::max({ bits[0], bits[1], bits[2] });
+
+        // Bit position in the code of bit b of the given axis
+        std::vector<uint32_t> position(bits[axis]);
+        uint32_t pos = 0;
+        for (uint32_t b = 0; b < maxBits; ++b) {
+            for (int a = 0; a < 3; ++a) {
+                if (b < bits[a]) {
+                    if (a == axis)
+                        position[b] = pos;
+                    ++pos;
+                }
+            }
+        }
+
+        std::vector<uint64_t> table(n[axis]);
+        for (size_t v = 0; v < n[axis]; ++v) {
+            uint64_t code = 0;
+            for (uint32_t b = 0; b < bits[axis]; ++b)
+                code |= static_cast<uint64_t>((v >> b) & 1u) << position[b];
+            table[v] = code;
+        }
+        return table;
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * Dense volume of nx * ny * nz values with a selectable memory layout. Voxels are always addressed by their (x, y, z)
+     * coordinates, offset() maps them to the position in storage, for single voxels and for packets of voxels.
+     * Bricked and Morton layouts pad the storage to whole bricks and powers of two respectively.
+     *
+     * The storage is either owned or external (e.g. a memory mapped file), copies of a volume share the storage.
+     */
+    template <typename T, volume_layout Layout = volume_layout::linear>
+    class volume
+    {
+    public:
+        static constexpr size_t brick_size = 8;
+
+        volume(size_t nx, size_t ny, size_t nz, T value = T{}) : volume(nx, ny, nz, nullptr, nullptr)
+        {
+            auto buffer = std::make_shared<std::vector<T>>(storage_, value);
+            data_ = buffer->data();
+            owner_ = std::move(buffer);
+        }
+
+        /**
+         * Volume using external storage of storageSize() values, already in the layout of the volume. The owner is
+         * kept alive as long as the volume (or a copy of it) exists.
+         */
+        volume(size_t nx, size_t ny, size_t nz, T* data, std::shared_ptr<void> owner)
+            : nx_(nx), ny_(ny), nz_(nz), owner_(std::move(owner)), data_(data)
+        {
+            const size_t n[3] = { nx, ny, nz };
+
+            if constexpr (Layout == volume_layout::linear) {
+                storage_ = nx * ny * nz;
+            } else if constexpr (Layout == volume_layout::bricked) {
+                bricksX_ = (nx + brick_size - 1) / brick_size;
+                bricksY_ = (ny + brick_size - 1) / brick_size;
+                size_t bricksZ = (nz + brick_size - 1) / brick_size;
+                storage_ = bricksX_ * bricksY_ * bricksZ * brick_size * brick_size * brick_size;
+            } else {
+                for (int a = 0; a < 3; ++a)
+                    morton_[a] = details::morton_table(n, a);
+                storage_ = size_t{ 1 } << (details::index_bits(nx) + details::index_bits(ny) + details::index_bits(nz));
+            }
+        }
+
+        size_t nx() const { return nx_; }
+        size_t ny() const { return ny_; }
+        size_t nz() const { return nz_; }
+
+        /// Number of voxels
+        size_t size() const { return nx_ * ny_ * nz_; }
+
+        /// Number of stored values, including padding
+        size_t storageSize() const { return storage_; }
+
+        static constexpr volume_layout layout() { return Layout; }
+
+        /**
+         * Position of voxel (x, y, z) in storage, UInt is either an unsigned integer or a packet of them. Packets of
+         * 32 bit offsets can only address the first 2^32 stored values, use size_t for larger volumes.
+         */
+        template <typename UInt>
+        UInt offset(const UInt& x, const UInt& y, const UInt& z) const
+        {
+            if constexpr (Layout == volume_layout::linear) {
+                return x + static_cast<uint32_t>(nx_) * (y + static_cast<uint32_t>(ny_) * z);
+            } else if constexpr (Layout == volume_layout::bricked) {
+                UInt brick = (x >> 3) + static_cast<uint32_t>(bricksX_) * ((y >> 3) + static_cast<uint32_t>(bricksY_) * (z >> 3));
+                return (brick << 9) + (x & 7u) + ((y & 7u) << 3) + ((z & 7u) << 6);
+            } else if constexpr (enoki::is_array_v<UInt>) {
+                using UInt64P = enoki::Array<uint64_t, UInt::Size>;
+                return UInt(enoki::gather<UInt64P>(morton_[0].data(), x) | enoki::gather<UInt64P>(morton_[1].data(), y) |
+                            enoki::gather<UInt64P>(morton_[2].data(), z));
+            } else {
+                return static_cast<UInt>(morton_[0][x] | morton_[1][y] | morton_[2][z]);
+            }
+        }
+
+        T& operator()(size_t x, size_t y, size_t z) { return data_[offset<size_t>(x, y, z)]; }
+        const T& operator()(size_t x, size_t y, size_t z) const { return data_[offset<size_t>(x, y, z)]; }
+
+        /// Gather a packet of voxels, inactive lanes are zero. Value has to hold T, convert the packet for other types.
+        template <typename Value, typename UInt>
+        Value gather(const UInt& x, const UInt& y, const UInt& z, const enoki::mask_t<UInt>& mask = true) const
+        {
+            static_assert(std::is_same_v<enoki::scalar_t<Value>, std::remove_const_t<T>>, "gather: Value has to hold the voxel type");
+            return enoki::gather<Value>(data_, offset(x, y, z), mask);
+        }
+
+        /// Set every voxel to f(x, y, z)
+        template <typename Function>
+        void fill(Function&& f)
+        {
+            for (size_t z = 0; z < nz_; ++z)
+                for (size_t y = 0; y < ny_; ++y)
+                    for (size_t x = 0; x < nx_; ++x)
+                        (*this)(x, y, z) = f(x, y, z);
+        }
+
+        T* data() { return data_; }
+        const T* data() const { return data_; }
+
+    private:
+        size_t nx_;
+        size_t ny_;
+        size_t nz_;
+        size_t bricksX_ = 0;
+        size_t bricksY_ = 0;
+        std::vector<uint64_t> morton_[3]; // Morton code contribution of each coordinate
+        size_t storage_ = 0;
+
+        std::shared_ptr<void> owner_; // Keeps the storage alive
+        T* data_;
+    };
+
+    /// Line integral of the volume along the ray, using exact intersection lengths with the voxels of the grid
+    template <typename Scalar, typename T, volume_layout Layout>
+    Scalar project(const ray<Scalar>& r, const voxel_grid<Scalar>& grid, const volume<T, Layout>& vol)
+    {
+        Scalar sum = 0;
+        traverse_cells(r, grid, [&](size_t x, size_t y, size_t z, Scalar length) { sum += length * static_cast<Scalar>(vol(x, y, z)); });
+        return sum;
+    }
+
+    /**
+     * Trilinear interpolation of the volume at world positions p, for a packet of positions. Voxel values sit at the
+     * voxel centers of the grid, towards the boundary the nearest value is used, outside of the grid the result is 0.
+     */
+    template <typename FloatP, typename T, volume_layout Layout>
+    FloatP sample(const voxel_grid<enoki::scalar_t<FloatP>>& grid, const volume<T, Layout>& vol, const point3<FloatP>& p)
+    {
+        using Scalar = enoki::scalar_t<FloatP>;
+        using Int32P = enoki::Array<int32_t, FloatP::Size>;
+        using UInt32P = enoki::Array<uint32_t, FloatP::Size>;
+        using VoxelP = enoki::Array<std::remove_const_t<T>, FloatP::Size>;
+
+        const auto lo = grid.min();
+        const auto h = grid.spacing();
+
+        // Continuous voxel coordinates, voxel centers are at whole numbers
+        FloatP u = (p.x() - lo.x()) / h.x() - Scalar{ 0.5 };
+        FloatP v = (p.y() - lo.y()) / h.y() - Scalar{ 0.5 };
+        FloatP w = (p.z() - lo.z()) / h.z() - Scalar{ 0.5 };
+
+        auto inside = u >= Scalar{ -0.5 } && v >= Scalar{ -0.5 } && w >= Scalar{ -0.5 } && u < grid.nx() - Scalar{ 0.5 } &&
+                      v < grid.ny() - Scalar{ 0.5 } && w < grid.nz() - Scalar{ 0.5 };
+
+        u = enoki::clamp(u, Scalar{ 0 }, static_cast<Scalar>(grid.nx() - 1));
+        v = enoki::clamp(v, Scalar{ 0 }, static_cast<Scalar>(grid.ny() - 1));
+        w = enoki::clamp(w, Scalar{ 0 }, static_cast<Scalar>(grid.nz() - 1));
+
+        FloatP fu = enoki::floor(u), fv = enoki::floor(v), fw = enoki::floor(w);
+        FloatP tu = u - fu, tv = v - fv, tw = w - fw;
+
+        UInt32P x0 = UInt32P(Int32P(fu)), y0 = UInt32P(Int32P(fv)), z0 = UInt32P(Int32P(fw));
+        UInt32P x1 = enoki::min(x0 + 1u, static_cast<uint32_t>(grid.nx() - 1));
+        UInt32P y1 = enoki::min(y0 + 1u, static_cast<uint32_t>(grid.ny() - 1));
+        UInt32P z1 = enoki::min(z0 + 1u, static_cast<uint32_t>(grid.nz() - 1));
+
+        auto mask = enoki::reinterpret_array<enoki::mask_t<UInt32P>>(inside);
+        // Gathered with the voxel type, e.g. uint8_t labels, then converted
+        auto at = [&](const UInt32P& x, const UInt32P& y, const UInt32P& z) {
+            return FloatP(vol.template gather<VoxelP>(x, y, z, mask));
+        };
+
+        FloatP v000 = at(x0, y0, z0), v100 = at(x1, y0, z0), v010 = at(x0, y1, z0), v110 = at(x1, y1, z0);
+        FloatP v001 = at(x0, y0, z1), v101 = at(x1, y0, z1), v011 = at(x0, y1, z1), v111 = at(x1, y1, z1);
+
+        FloatP c00 = enoki::fmadd(tu, v100 - v000, v000);
+        FloatP c10 = enoki::fmadd(tu, v110 - v010, v010);
+        FloatP c01 = enoki::fmadd(tu, v101 - v001, v001);
+        FloatP c11 = enoki::fmadd(tu, v111 - v011, v011);
+
+        FloatP c0 = enoki::fmadd(tv, c10 - c00, c00);
+        FloatP c1 = enoki::fmadd(tv, c11 - c01, c01);
+
+        return enoki::select(inside, enoki::fmadd(tw, c1 - c0, c0), FloatP(0));
+    }
+} // namespace tomosect
@@ -0,0 +1,527 @@
+/**
+ *
+ * \file volume_io.hpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#pragma once
+
+#include "TomoSect/mapped_file.hpp"
+#include "TomoSect/projection_stack.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tomosect
+{
+    /**
+     * File formats for volumes and projection stacks, all of them store little endian 32 bit floats, x (or detector
+     * column) running fastest:
+     *  - raw: data only, sizes have to be known
+     *  - mha: MetaImage header followed by the data (.mha), or a separate header file (.mhd) pointing to the data
+     *  - nrrd: NRRD header followed by the data (.nrrd), or a detached header (.nhdr) pointing to the data
+     */
+    enum class image_format { raw, mha, nrrd };
+
+    /// Data offset of a file whose data fills its end, written as -1 in MHA (HeaderSize) and NRRD (byte skip) headers
+    inline constexpr size_t data_at_end = std::numeric_limits<size_t>::max();
+
+    /// Sizes and placement of an image, as stored in the header of a file
+    struct image_header {
+        size_t size[3] = { 1, 1, 1 };
+        double spacing[3] = { 1, 1, 1 };
+        double origin[3] = { 0, 0, 0 }; // Center of the first voxel
+
+        std::string dataFile; // File holding the data, might be the header file itself
+        size_t dataOffset = 0; // Or data_at_end
+
+        size_t numValues() const { return size[0] * size[1] * size[2]; }
+    };
+
+    /// Volume backed by a file mapping, together with the placement stored in the file header
+    template <typename T>
+    struct mapped_volume {
+        volume<T> data;
+        voxel_grid<float> grid;
+    };
+
+    /// Format of a file, deduced from its extension. Unknown extensions are raw files.
+    inline image_format format_of(const std::string& path)
+    {
+        auto ext = std::filesystem::path(path).extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (ext == ".mha" || ext == ".mhd")
+            return image_format::mha;
+        if (ext == ".nrrd" || ext == ".nhdr")
+            return image_format::nrrd;
+        return image_format::raw;
+    }
+} // namespace tomosect
+
+namespace tomosect::details
+{
+    /// Data of files written by us starts at a page boundary, so it can be mapped with large pages
+    inline constexpr size_t image_data_alignment = 4096;
+
+    inline std::string trim(const std::string& s)
+    {
+        auto begin = s.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos)
+            return {};
+        auto end = s.find_last_not_of(" \t\r\n");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    inline std::string lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    /// Parse up to three numbers, ignoring brackets and commas (as used by NRRD vectors)
+    inline size_t parse_numbers(std::string s, double out[3])
+    {
+        std::replace_if(
+            s.begin(), s.end(), [](char c) { return c == '(' || c == ')' || c == ','; }, ' ');
+
+        std::istringstream in(s);
+        size_t n = 0;
+        double value;
+        while (n < 3 && in >> value)
+            out[n++] = value;
+        return n;
+    }
+
+    /// Parse the sizes of a header, they have to be integers >= 0 and the number of values has to fit into memory
+    inline void parse_sizes(const std::string& value, size_t size[3], const char* func, const std::string& path)
+    {
+        double numbers[3] = { 0, 0, 0 };
+        auto n = parse_numbers(value, numbers);
+        for (size_t i = 0; i < n; ++i) {
+            // Also rejects NaN, anything above 2^53 is not exact as a double and far beyond any file anyway
+            if (!(numbers[i] >= 0 && numbers[i] <= 0x1p53 && std::floor(numbers[i]) == numbers[i]))
+                throw std::runtime_error(std::string(func) + ": invalid size " + value + " in " + path);
+            size[i] = static_cast<size_t>(numbers[i]);
+        }
+
+        size_t values = 1;
+        for (size_t i = 0; i < 3; ++i) {
+            if (size[i] != 0 && values > std::numeric_limits<size_t>::max() / sizeof(float) / size[i])
+                throw std::runtime_error(std::string(func) + ": sizes " + value + " are too large in " + path);
+            values *= size[i];
+        }
+    }
+
+    /// Parse the byte offset of the data, -1 places the data at the end of the file
+    inline size_t parse_offset(const std::string& value, const char* func, const std::string& path)
+    {
+        const long long offset = std::stoll(value);
+        if (offset < -1)
+            throw std::runtime_error(std::string(func) + ": invalid data offset " + value + " in " + path);
+        return offset == -1 ? data_at_end : static_cast<size_t>(offset);
+    }
+
+    /// Path of a data file named in a header, relative paths are relative to the header
+    inline std::string data_file_path(const std::string& headerPath, const std::string& dataFile)
+    {
+        auto p = std::filesystem::path(dataFile);
+        return p.is_absolute() ? dataFile : (std::filesystem::path(headerPath).parent_path() / p).string();
+    }
+
+    inline image_header read_mha_header(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("read_mha_header: cannot open " + path);
+
+        image_header header;
+        size_t consumed = 0;
+        size_t ndims = 3;
+        std::string line;
+
+        while (std::getline(in, line)) {
+            consumed += line.size() + 1;
+
+            auto eq = line.find('=');
+            if (eq == std::string::npos)
+                continue;
+
+            auto key = trim(line.substr(0, eq));
+            auto value = trim(line.substr(eq + 1));
+            double numbers[3] = { 0, 0, 0 };
+
+            if (key == "NDims") {
+                ndims = std::stoul(value);
+                if (ndims < 1 || ndims > 3)
+                    throw std::runtime_error("read_mha_header: only 1 to 3 dimensions are supported in " + path);
+            } else if (key == "DimSize") {
+                parse_sizes(value, header.size, "read_mha_header", path);
+            } else if (key == "ElementSpacing" || key == "ElementSize") {
+                auto n = parse_numbers(value, numbers);
+                std::copy(numbers, numbers + n, header.spacing);
+            } else if (key == "Offset" || key == "Origin" || key == "Position") {
+                auto n = parse_numbers(value, numbers);
+                std::copy(numbers, numbers + n, header.origin);
+            } else if (key == "ElementType") {
+                if (value != "MET_FLOAT")
+                    throw std::runtime_error("read_mha_header: only MET_FLOAT data is supported in " + path);
+            } else if (key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB") {
+                if (lower(value) == "true")
+                    throw std::runtime_error("read_mha_header: big endian data is not supported in " + path);
+            } else if (key == "CompressedData") {
+                if (lower(value) == "true")
+                    throw std::runtime_error("read_mha_header: compressed data is not supported in " + path);
+            } else if (key == "ElementNumberOfChannels") {
+                if (std::stoul(value) != 1)
+                    throw std::runtime_error("read_mha_header: only single channel data is supported in " + path);
+            } else if (key == "HeaderSize") {
+                header.dataOffset = parse_offset(value, "read_mha_header", path);
+            } else if (key == "ElementDataFile") {
+                // Always the last entry of the header
+                if (value == "LOCAL") {
+                    header.dataFile = path;
+                    header.dataOffset = consumed;
+                } else {
+                    header.dataFile = data_file_path(path, value);
+                }
+                return header;
+            }
+        }
+
+        throw std::runtime_error("read_mha_header: no ElementDataFile in " + path);
+    }
+
+    inline image_header read_nrrd_header(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("read_nrrd_header: cannot open " + path);
+
+        std::string line;
+        if (!std::getline(in, line) || line.compare(0, 7, "NRRD000") != 0)
+            throw std::runtime_error("read_nrrd_header: not a NRRD file " + path);
+
+        image_header header;
+        size_t consumed = line.size() + 1;
+        size_t byteSkip = 0;
+
+        while (std::getline(in, line)) {
+            consumed += line.size() + 1;
+
+            // An empty line ends the header
+            if (trim(line).empty())
+                break;
+
+            if (line[0] == '#' || line.find(":=") != std::string::npos)
+                continue;
+
+            auto colon = line.find(':');
+            if (colon == std::string::npos)
+                continue;
+
+            auto key = lower(trim(line.substr(0, colon)));
+            auto value = trim(line.substr(colon + 1));
+            double numbers[3] = { 0, 0, 0 };
+
+            if (key == "type") {
+                auto type = lower(value);
+                if (type != "float" && type != "float32")
+                    throw std::runtime_error("read_nrrd_header: only float data is supported in " + path);
+            } else if (key == "dimension") {
+                if (std::stoul(value) < 1 || std::stoul(value) > 3)
+                    throw std::runtime_error("read_nrrd_header: only 1 to 3 dimensions are supported in " + path);
+            } else if (key == "sizes") {
+                parse_sizes(value, header.size, "read_nrrd_header", path);
+            } else if (key == "spacings") {
+                auto n = parse_numbers(value, numbers);
+                std::copy(numbers, numbers + n, header.spacing);
+            } else if (key == "space directions") {
+                // One vector per axis, only axis aligned grids are supported, so the spacing is its length
+                std::istringstream vectors(value);
+                std::string vector;
+                for (size_t i = 0; i < 3 && vectors >> vector; ++i) {
+                    if (vector == "none")
+                        continue;
+
+                    double v[3] = { 0, 0, 0 };
+                    parse_numbers(vector, v);
+                    header.spacing[i] = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                }
+            } else if (key == "space origin") {
+                auto n = parse_numbers(value, numbers);
+                std::copy(numbers, numbers + n, header.origin);
+            } else if (key == "encoding") {
+                if (lower(value) != "raw")
+                    throw std::runtime_error("read_nrrd_header: only raw encoding is supported in " + path);
+            } else if (key == "endian") {
+                if (lower(value) != "little")
+                    throw std::runtime_error("read_nrrd_header: big endian data is not supported in " + path);
+            } else if (key == "data file" || key == "datafile") {
+                header.dataFile = data_file_path(path, value);
+            } else if (key == "byte skip" || key == "byteskip") {
+                byteSkip = parse_offset(value, "read_nrrd_header", path);
+            }
+        }
+
+        // The byte skip counts from the end of the header for attached data
+        if (header.dataFile.empty()) {
+            header.dataFile = path;
+            header.dataOffset = byteSkip == data_at_end ? data_at_end : consumed + byteSkip;
+        } else {
+            header.dataOffset = byteSkip;
+        }
+        return header;
+    }
+
+    inline image_header read_header(const std::string& path)
+    {
+        switch (format_of(path)) {
+        case image_format::mha:
+            return read_mha_header(path);
+        case image_format::nrrd:
+            return read_nrrd_header(path);
+        default:
+            throw std::invalid_argument("read_header: raw files have no header, " + path);
+        }
+    }
+
+    /// Pad the header text with a comment, such that the data following it starts at a page boundary
+    inline std::string pad_header(std::string text, const std::string& comment, const std::string& last)
+    {
+        auto size = text.size() + comment.size() + 1 + last.size();
+        auto padded = (size + image_data_alignment - 1) / image_data_alignment * image_data_alignment;
+
+        return text + comment + std::string(padded - size, ' ') + "\n" + last;
+    }
+
+    /// Header text for the given format, detached headers point to dataFile
+    inline std::string format_header(image_format format, const image_header& header, bool detached)
+    {
+        std::ostringstream out;
+        out.precision(9);
+
+        auto dataName = std::filesystem::path(header.dataFile).filename().string();
+
+        if (format == image_format::mha) {
+            out << "ObjectType = Image\nNDims = 3\nBinaryData = True\nBinaryDataByteOrderMSB = False\nCompressedData = False\n";
+            out << "DimSize = " << header.size[0] << " " << header.size[1] << " " << header.size[2] << "\n";
+            out << "ElementSpacing = " << header.spacing[0] << " " << header.spacing[1] << " " << header.spacing[2] << "\n";
+            out << "Offset = " << header.origin[0] << " " << header.origin[1] << " " << header.origin[2] << "\n";
+            out << "ElementType = MET_FLOAT\n";
+
+            if (detached)
+                return out.str() + "ElementDataFile = " + dataName + "\n";
+            return pad_header(out.str(), "Comment = Padding to align the data", "ElementDataFile = LOCAL\n");
+        }
+
+        out << "NRRD0004\ntype: float\ndimension: 3\nencoding: raw\nendian: little\n";
+        out << "sizes: " << header.size[0] << " " << header.size[1] << " " << header.size[2] << "\n";
+        out << "space dimension: 3\n";
+        out << "space directions: (" << header.spacing[0] << ",0,0) (0," << header.spacing[1] << ",0) (0,0," << header.spacing[2] << ")\n";
+        out << "space origin: (" << header.origin[0] << "," << header.origin[1] << "," << header.origin[2] << ")\n";
+
+        if (detached)
+            return out.str() + "data file: " + dataName + "\n";
+        return pad_header(out.str(), "# Padding to align the data", "\n");
+    }
+
+    /**
+     * Map the float data of a file, offset data_at_end places it at the end of the file. Data at a misaligned offset can
+     * not be used in place, it is copied instead (files written by us are always aligned). Returns the data pointer and
+     * its owner.
+     */
+    template <typename T>
+    std::pair<T*, std::shared_ptr<void>> map_data(const std::string& path, size_t offset, size_t count, map_options options)
+    {
+        static_assert(std::is_same_v<std::remove_const_t<T>, float>, "Only float data is supported");
+
+        // Mutable data needs a writable mapping, by default writes stay private
+        if constexpr (!std::is_const_v<T>) {
+            if (options.mode == map_mode::read_only)
+                options.mode = map_mode::copy_on_write;
+        }
+
+        auto file = std::make_shared<mapped_file>(path, options);
+
+        if (offset == data_at_end && count <= file->size() / sizeof(float))
+            offset = file->size() - count * sizeof(float);
+
+        // Written such that nothing wraps around for huge offsets or counts
+        if (offset > file->size() || count > (file->size() - offset) / sizeof(float))
+            throw std::runtime_error("map_data: file is too small for the data, " + path);
+
+        if (offset % alignof(float) != 0) {
+            auto copy = std::make_shared<std::vector<float>>(count);
+            std::memcpy(copy->data(), file->at<char>(offset), count * sizeof(float));
+            return { copy->data(), copy };
+        }
+
+        auto* data = const_cast<float*>(file->at<float>(offset));
+        return { data, std::move(file) };
+    }
+
+    /// Create a file (or header and data file) for the image described by the header, and map its data writable
+    inline std::pair<float*, std::shared_ptr<void>> create_data(const std::string& path, image_header header, const map_options& options)
+    {
+        auto format = format_of(path);
+        auto ext = lower(std::filesystem::path(path).extension().string());
+        bool detached = ext == ".mhd" || ext == ".nhdr";
+
+        std::string text;
+        if (format != image_format::raw) {
+            header.dataFile = detached ? std::filesystem::path(path).replace_extension(".raw").string() : path;
+            text = format_header(format, header, detached);
+        }
+
+        if (detached) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << text;
+            if (!out)
+                throw std::runtime_error("create_data: cannot write header " + path);
+            text.clear();
+        }
+
+        auto dataPath = detached ? header.dataFile : path;
+        auto file = std::make_shared<mapped_file>(mapped_file::create(dataPath, text.size() + header.numValues() * sizeof(float), options));
+
+        auto* bytes = static_cast<char*>(file->mutableData());
+        if (!text.empty())
+            std::memcpy(bytes, text.data(), text.size());
+
+        return { reinterpret_cast<float*>(bytes + text.size()), std::move(file) };
+    }
+} // namespace tomosect::details
+
+namespace tomosect
+{
+    /**
+     * Map the volume stored in a MHA or NRRD file. With T = const float the file is mapped read-only, with T = float
+     * writes stay private to the process (copy on write), unless options.mode is map_mode::read_write. The grid is
+     * placed as given by spacing and origin in the header.
+     */
+    template <typename T = const float>
+    mapped_volume<T> map_volume(const std::string& path, const map_options& options = {})
+    {
+        auto header = details::read_header(path);
+        auto [data, owner] = details::map_data<T>(header.dataFile, header.dataOffset, header.numValues(), options);
+
+        auto spacing = vec3<float>(header.spacing[0], header.spacing[1], header.spacing[2]);
+        auto min = point3<float>(header.origin[0] - header.spacing[0] / 2, header.origin[1] - header.spacing[1] / 2,
+                                 header.origin[2] - header.spacing[2] / 2);
+
+        return { volume<T>(header.size[0], header.size[1], header.size[2], data, std::move(owner)),
+                 voxel_grid<float>(header.size[0], header.size[1], header.size[2], min, spacing) };
+    }
+
+    /// Map a raw file of nx * ny * nz floats, starting at the given byte offset
+    template <typename T = const float>
+    volume<T> map_raw_volume(const std::string& path, size_t nx, size_t ny, size_t nz, const map_options& options = {}, size_t offset = 0)
+    {
+        auto [data, owner] = details::map_data<T>(path, offset, nx * ny * nz, options);
+        return volume<T>(nx, ny, nz, data, std::move(owner));
+    }
+
+    /// Map a projection stack (cols x rows x views) stored in a MHA or NRRD file, see map_raw_projections for raw files
+    template <typename T = const float>
+    projection_stack<T> map_projections(const std::string& path, const map_options& options = {})
+    {
+        auto header = details::read_header(path);
+        auto [data, owner] = details::map_data<T>(header.dataFile, header.dataOffset, header.numValues(), options);
+
+        return projection_stack<T>(header.size[0], header.size[1], header.size[2], data, std::move(owner));
+    }
+
+    /// Map a raw file of cols * rows * numViews floats, starting at the given byte offset
+    template <typename T = const float>
+    projection_stack<T> map_raw_projections(const std::string& path, size_t cols, size_t rows, size_t numViews,
+                                            const map_options& options = {}, size_t offset = 0)
+    {
+        auto [data, owner] = details::map_data<T>(path, offset, cols * rows * numViews, options);
+        return projection_stack<T>(cols, rows, numViews, data, std::move(owner));
+    }
+
+    /**
+     * Create a zero initialised volume file (format by extension) and map it, writes to the volume go directly to the
+     * file. Useful for reconstructions that do not fit into memory.
+     */
+    inline volume<float> create_volume(const std::string& path, const voxel_grid<float>& grid, const map_options& options = {})
+    {
+        image_header header;
+        header.size[0] = grid.nx();
+        header.size[1] = grid.ny();
+        header.size[2] = grid.nz();
+
+        const float spacing[3] = { grid.spacing().x(), grid.spacing().y(), grid.spacing().z() };
+        const float min[3] = { grid.min().x(), grid.min().y(), grid.min().z() };
+        for (int a = 0; a < 3; ++a) {
+            header.spacing[a] = spacing[a];
+            header.origin[a] = min[a] + spacing[a] / 2;
+        }
+
+        auto [data, owner] = details::create_data(path, header, options);
+        return volume<float>(grid.nx(), grid.ny(), grid.nz(), data, std::move(owner));
+    }
+
+    inline projection_stack<float> create_projections(const std::string& path, size_t cols, size_t rows, size_t numViews,
+                                                      const map_options& options = {})
+    {
+        image_header header;
+        header.size[0] = cols;
+        header.size[1] = rows;
+        header.size[2] = numViews;
+
+        auto [data, owner] = details::create_data(path, header, options);
+        return projection_stack<float>(cols, rows, numViews, data, std::move(owner));
+    }
+
+    /// Write a volume of any layout to a file (format by extension), in linear order
+    template <typename T, volume_layout Layout>
+    void write_volume(const std::string& path, const volume<T, Layout>& vol, const voxel_grid<float>& grid)
+    {
+        if (grid.nx() != vol.nx() || grid.ny() != vol.ny() || grid.nz() != vol.nz())
+            throw std::invalid_argument("write_volume: grid and volume sizes differ");
+
+        map_options options;
+        options.access = map_access::sequential;
+
+        auto out = create_volume(path, grid, options);
+
+        if constexpr (Layout == volume_layout::linear) {
+            std::copy(vol.data(), vol.data() + vol.size(), out.data());
+        } else {
+            float* dst = out.data();
+            for (size_t z = 0; z < vol.nz(); ++z)
+                for (size_t y = 0; y < vol.ny(); ++y)
+                    for (size_t x = 0; x < vol.nx(); ++x)
+                        *dst++ = vol(x, y, z);
+        }
+    }
+
+    template <typename T>
+    void write_projections(const std::string& path, const projection_stack<T>& projections)
+    {
+        map_options options;
+        options.access = map_access::sequential;
+
+        auto out = create_projections(path, projections.cols(), projections.rows(), projections.numViews(), options);
+        std::copy(projections.data(), projections.data() + projections.size(), out.data());
+    }
+} // namespace tomosect
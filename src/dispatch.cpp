@@ -0,0 +1,166 @@
+/**
+ *
+ * \file dispatch.cpp
+ *
+ * Selection of the kernel builds at runtime. Compiled without any instruction set flags, as it runs before it is known
+ * which of them the CPU supports. The builds are modules loaded with dlopen once their level passed the CPU check, so
+ * none of them is mapped into a process whose CPU lacks its instructions.
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "TomoSect/dispatch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(TOMOSECT_KERNEL_DIR)
+#include <dlfcn.h>
+#endif
+
+namespace tomosect
+{
+    namespace
+    {
+        /// Sentinel for CPUs below the lowest level
+        constexpr int unsupported = -1;
+
+#if defined(__x86_64__) || defined(__i386__)
+        uint64_t xgetbv()
+        {
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+        }
+
+        int cpu_level()
+        {
+            unsigned eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_2))
+                return unsupported;
+
+            // AVX needs the OS to save the ymm registers, AVX-512 also the opmask and zmm registers
+            const bool osxsave = ecx & bit_OSXSAVE;
+            const bool avx = (ecx & bit_AVX) && (ecx & bit_FMA) && (ecx & bit_F16C);
+            const uint64_t xcr0 = osxsave ? xgetbv() : 0;
+            if (!avx || (xcr0 & 0x6) != 0x6 || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2))
+                return static_cast<int>(isa_level::sse4_2);
+
+            const unsigned avx512 = bit_AVX512F | bit_AVX512CD | bit_AVX512VL | bit_AVX512BW | bit_AVX512DQ;
+            if ((ebx & avx512) != avx512 || (xcr0 & 0xe6) != 0xe6)
+                return static_cast<int>(isa_level::avx2);
+
+            return static_cast<int>(isa_level::avx512);
+        }
+#else
+        int cpu_level() { return unsupported; }
+#endif
+
+        int detected()
+        {
+            static const int level = cpu_level();
+            return level;
+        }
+
+#if defined(TOMOSECT_KERNEL_DIR)
+        /// Loads the module of a level, which stays loaded until the process exits
+        const kernel_table* load(isa_level isa)
+        {
+            const std::string name = std::string("libtomosect_kernels_") + isa_name(isa) + ".so";
+
+            // Next to where it was built first, then wherever the dynamic loader finds it
+            void* handle = ::dlopen((std::string(TOMOSECT_KERNEL_DIR) + "/" + name).c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!handle)
+                handle = ::dlopen(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!handle) {
+                const char* error = ::dlerror();
+                throw std::runtime_error("kernels_for: cannot load " + name + ": " + (error ? error : "unknown error"));
+            }
+
+            using entry_fn = const kernel_table* (*)();
+            const auto entry = reinterpret_cast<entry_fn>(::dlsym(handle, details::kernel_entry));
+            if (!entry)
+                throw std::runtime_error("kernels_for: " + name + " does not export " + details::kernel_entry);
+            return entry();
+        }
+#endif
+
+        const kernel_table& select()
+        {
+            const int level = detected();
+            if (level == unsupported)
+                throw std::runtime_error("kernels: the CPU does not support SSE4.2");
+
+            auto isa = static_cast<isa_level>(level);
+            if (const char* cap = std::getenv("TOMOSECT_ISA"); cap && *cap) {
+                int limit = unsupported;
+                for (auto l : { isa_level::sse4_2, isa_level::avx2, isa_level::avx512 })
+                    if (std::strcmp(cap, isa_name(l)) == 0)
+                        limit = static_cast<int>(l);
+                if (limit == unsupported)
+                    throw std::runtime_error(std::string("kernels: unknown instruction set level ") + cap + " in TOMOSECT_ISA");
+                isa = static_cast<isa_level>(std::min(level, limit));
+            }
+
+            const kernel_table* table = kernels_for(isa);
+            if (!table)
+                throw std::runtime_error("kernels: built without the kernels of the instruction set levels");
+            return *table;
+        }
+    } // namespace
+
+    const char* isa_name(isa_level isa)
+    {
+        switch (isa) {
+        case isa_level::sse4_2:
+            return "sse4_2";
+        case isa_level::avx2:
+            return "avx2";
+        case isa_level::avx512:
+            return "avx512";
+        }
+        return "unknown";
+    }
+
+    isa_level detect_isa()
+    {
+        const int level = detected();
+        if (level == unsupported)
+            throw std::runtime_error("detect_isa: the CPU does not support SSE4.2");
+        return static_cast<isa_level>(level);
+    }
+
+    const kernel_table* kernels_for(isa_level isa)
+    {
+        if (static_cast<int>(isa) > detected())
+            return nullptr;
+
+#if defined(TOMOSECT_KERNEL_DIR)
+        static std::mutex mutex;
+        static const kernel_table* loaded[3] = {};
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto& table = loaded[static_cast<int>(isa)];
+        if (!table)
+            table = load(isa);
+        return table;
+#else
+        return nullptr;
+#endif
+    }
+
+    const kernel_table& kernels()
+    {
+        static const kernel_table& table = select();
+        return table;
+    }
+} // namespace tomosect
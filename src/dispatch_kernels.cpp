@@ -0,0 +1,103 @@
+/**
+ *
+ * \file dispatch_kernels.cpp
+ *
+ * Kernels of the dispatch table, compiled once per instruction set level with TOMOSECT_KERNEL_ISA set to its name
+ * (sse4_2, avx2 or avx512) and the matching compiler flags. Every build is linked as its own module with hidden
+ * symbols, so the inline functions and templates instantiated here stay with the instruction set they were compiled
+ * for. The only exported symbol is the extern "C" entry returning the table, looked up by src/dispatch.cpp after it
+ * loaded the module.
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "TomoSect/dispatch.hpp"
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/geometry.hpp"
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/traversal.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifndef TOMOSECT_KERNEL_ISA
+#error "TOMOSECT_KERNEL_ISA has to name the instruction set level the kernels are built for"
+#endif
+
+namespace tomosect
+{
+    namespace
+    {
+        using FloatP = pack8<float>;
+        constexpr size_t lanes = 8;
+
+        voxel_grid<float> make_grid(const kernel_grid& grid)
+        {
+            return voxel_grid<float>(grid.n[0], grid.n[1], grid.n[2], point3<float>(grid.min[0], grid.min[1], grid.min[2]),
+                                     vec3<float>(grid.spacing[0], grid.spacing[1], grid.spacing[2]));
+        }
+
+        void intersect_box(const kernel_rays& rays, const float boxMin[3], const float boxMax[3], float* tmin, float* tmax)
+        {
+            const aabb<FloatP> box(point3<FloatP>(boxMin[0], boxMin[1], boxMin[2]), point3<FloatP>(boxMax[0], boxMax[1], boxMax[2]));
+
+            for (size_t first = 0; first < rays.count; first += lanes) {
+                // The last packet repeats its last ray in the lanes past the end
+                const size_t n = std::min(lanes, rays.count - first);
+                FloatP o[3], d[3];
+                for (int a = 0; a < 3; ++a) {
+                    for (size_t lane = 0; lane < lanes; ++lane) {
+                        o[a][lane] = rays.origin[a][first + std::min(lane, n - 1)];
+                        d[a][lane] = rays.dir[a][first + std::min(lane, n - 1)];
+                    }
+                }
+
+                const ray<FloatP> r(point3<FloatP>(o[0], o[1], o[2]), vec3<FloatP>(d[0], d[1], d[2]),
+                                    ray<FloatP>::ray_direction_normalized{});
+                auto [t0, t1, hit] = intersection(r, box, ray_aabb_interval{});
+                const FloatP entry = enoki::select(hit, t0, FloatP(0));
+                const FloatP exit = enoki::select(hit, t1, FloatP(0));
+                for (size_t lane = 0; lane < n; ++lane) {
+                    tmin[first + lane] = entry[lane];
+                    tmax[first + lane] = exit[lane];
+                }
+            }
+        }
+
+        void project_view(const kernel_view& view, const kernel_grid& grid, const float* data, float* out)
+        {
+            const auto g = make_grid(grid);
+            const volume<float> vol(grid.n[0], grid.n[1], grid.n[2], const_cast<float*>(data), nullptr);
+            const point3<float> source(view.source[0], view.source[1], view.source[2]);
+
+            parallel_for(0, view.rows, [&](size_t row) {
+                for (size_t col = 0; col < view.cols; ++col) {
+                    const auto c = static_cast<float>(col);
+                    const auto r = static_cast<float>(row);
+                    const point3<float> target(view.first[0] + c * view.colStep[0] + r * view.rowStep[0],
+                                               view.first[1] + c * view.colStep[1] + r * view.rowStep[1],
+                                               view.first[2] + c * view.colStep[2] + r * view.rowStep[2]);
+                    out[row * view.cols + col] = project(rayFromPoints(source, target), g, vol);
+                }
+            });
+        }
+
+        void backproject_views(const projection_matrix<float>* matrices, const filtered_rows* rows, size_t numViews, size_t cols,
+                               float scale, const kernel_grid& grid, const voxel_box& box, float* output)
+        {
+            const std::vector<projection_matrix<float>> m(matrices, matrices + numViews);
+            const std::vector<filtered_rows> r(rows, rows + numViews);
+            backproject(m, r, cols, scale, make_grid(grid), box, output);
+        }
+    } // namespace
+} // namespace tomosect
+
+/// Table of this build, see details::kernel_entry
+extern "C" TOMOSECT_KERNELS_EXPORT const tomosect::kernel_table* tomosect_kernel_table()
+{
+    using namespace tomosect;
+    static const kernel_table table{ isa_level::TOMOSECT_KERNEL_ISA, intersect_box, project_view, backproject_views };
+    return &table;
+}
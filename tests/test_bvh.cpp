@@ -0,0 +1,283 @@
+/**
+ *
+ * \file test_bvh.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    struct box_bounds {
+        float lo[3], hi[3];
+    };
+
+    std::vector<box_bounds> random_boxes(size_t count, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> position(-1.f, 1.f);
+        std::uniform_real_distribution<float> size(0.01f, 0.1f);
+
+        std::vector<box_bounds> boxes;
+        for (size_t i = 0; i < count; ++i) {
+            box_bounds b;
+            for (int a = 0; a < 3; ++a) {
+                b.lo[a] = position(gen);
+                b.hi[a] = b.lo[a] + size(gen);
+            }
+            boxes.push_back(b);
+        }
+        return boxes;
+    }
+
+    std::vector<aabb<float>> to_aabbs(const std::vector<box_bounds>& boxes)
+    {
+        std::vector<aabb<float>> result;
+        for (const auto& b : boxes)
+            result.emplace_back(point3<float>(b.lo[0], b.lo[1], b.lo[2]), point3<float>(b.hi[0], b.hi[1], b.hi[2]));
+        return result;
+    }
+
+    /// Reference interval of the ray inside the box, with the same conventions as the bvh
+    bool brute_force(const ray<float>& r, const box_bounds& b, float& tEnter, float& tExit)
+    {
+        const float o[3] = { r.origin().x(), r.origin().y(), r.origin().z() };
+        const float d[3] = { r.dir().x(), r.dir().y(), r.dir().z() };
+
+        tEnter = 0;
+        tExit = std::numeric_limits<float>::infinity();
+        for (int a = 0; a < 3; ++a) {
+            float t0 = (b.lo[a] - o[a]) / d[a];
+            float t1 = (b.hi[a] - o[a]) / d[a];
+            tEnter = std::max(tEnter, std::min(t0, t1));
+            tExit = std::min(tExit, std::max(t0, t1));
+        }
+        return tEnter <= tExit;
+    }
+
+    std::vector<ray<float>> random_rays(size_t count, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        std::vector<ray<float>> rays;
+        for (size_t i = 0; i < count; ++i) {
+            point3<float> origin(2 * dist(gen), 2 * dist(gen), 2 * dist(gen));
+            point3<float> target(dist(gen), dist(gen), dist(gen));
+            rays.push_back(rayFromPoints(origin, target));
+        }
+        return rays;
+    }
+
+    void check_nearest(const bvh<float>& tree, const std::vector<box_bounds>& boxes, const std::vector<ray<float>>& rays)
+    {
+        for (const auto& r : rays) {
+            float best = std::numeric_limits<float>::infinity();
+            for (const auto& b : boxes) {
+                float tEnter, tExit;
+                if (brute_force(r, b, tEnter, tExit))
+                    best = std::min(best, tEnter);
+            }
+
+            auto hit = tree.nearest(r);
+            REQUIRE(hit.mask == std::isfinite(best));
+            if (hit.mask) {
+                CHECK(hit.t == doctest::Approx(best));
+
+                float tEnter, tExit;
+                CHECK(brute_force(r, boxes[hit.index], tEnter, tExit));
+                CHECK(tEnter == doctest::Approx(best));
+            }
+        }
+    }
+} // namespace
+
+TEST_CASE("Test bvh construction")
+{
+    auto boxes = random_boxes(2000, 1);
+
+    for (size_t leafSize : { size_t{ 1 }, size_t{ 4 }, size_t{ 16 } }) {
+        bvh_options options;
+        options.maxLeafSize = leafSize;
+        bvh<float> tree(to_aabbs(boxes), options);
+
+        CHECK(tree.size() == boxes.size());
+        CHECK(tree.depth() > 0);
+
+        // Every box is in exactly one leaf, and the leaves respect the size limit
+        std::vector<int> seen(boxes.size(), 0);
+        size_t leafSlots = 0;
+        for (const auto& n : tree.nodes()) {
+            if (!n.leaf())
+                continue;
+            CHECK(n.count <= leafSize);
+            for (uint32_t slot = n.offset; slot < n.offset + n.count; ++slot)
+                ++seen[tree.index(slot)];
+            leafSlots += n.count;
+        }
+        CHECK(leafSlots == boxes.size());
+        CHECK(std::all_of(seen.begin(), seen.end(), [](int s) { return s == 1; }));
+
+        // Inner nodes contain their children, the left child follows its parent
+        const auto& nodes = tree.nodes();
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i].leaf())
+                continue;
+            for (size_t c : { i + 1, size_t{ nodes[i].offset } }) {
+                REQUIRE(c < nodes.size());
+                for (int a = 0; a < 3; ++a) {
+                    CHECK(nodes[c].lo[a] >= nodes[i].lo[a]);
+                    CHECK(nodes[c].hi[a] <= nodes[i].hi[a]);
+                }
+            }
+        }
+    }
+
+    SUBCASE("Empty input")
+    {
+        bvh<float> tree(std::vector<aabb<float>>{});
+        CHECK(tree.empty());
+        CHECK(tree.depth() == 0);
+        CHECK(!tree.nearest(ray<float>(point3<float>(0.f), vec3<float>(1, 0, 0))).mask);
+    }
+
+    SUBCASE("Identical boxes are still split to the leaf size")
+    {
+        std::vector<aabb<float>> same(100, aabb<float>(point3<float>(0.f), point3<float>(1.f)));
+        bvh<float> tree(same);
+        for (const auto& n : tree.nodes())
+            CHECK(n.count <= 4);
+    }
+
+    SUBCASE("Invalid options")
+    {
+        bvh_options options;
+        options.maxLeafSize = 0;
+        CHECK_THROWS_AS(bvh<float>(to_aabbs(boxes), options), std::invalid_argument);
+
+        options = {};
+        options.bins = 1;
+        CHECK_THROWS_AS(bvh<float>(to_aabbs(boxes), options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Test bvh nearest hit")
+{
+    auto boxes = random_boxes(1000, 2);
+    auto rays = random_rays(500, 3);
+
+    SUBCASE("Sequential build")
+    {
+        bvh_options options;
+        options.threads = 1;
+        check_nearest(bvh<float>(to_aabbs(boxes), options), boxes, rays);
+    }
+
+    SUBCASE("Parallel build")
+    {
+        bvh_options options;
+        options.threads = 4;
+        options.parallelGrain = 16;
+        check_nearest(bvh<float>(to_aabbs(boxes), options), boxes, rays);
+    }
+
+    SUBCASE("Ray starting inside a box")
+    {
+        bvh<float> tree(to_aabbs(boxes));
+        const auto& b = boxes[17];
+        point3<float> center((b.lo[0] + b.hi[0]) / 2, (b.lo[1] + b.hi[1]) / 2, (b.lo[2] + b.hi[2]) / 2);
+
+        auto hit = tree.nearest(ray<float>(center, vec3<float>(1, 0.5f, 0.25f)));
+        CHECK(hit.mask);
+        CHECK(hit.t == 0);
+    }
+}
+
+TEST_CASE("Test bvh packet traversal")
+{
+    auto boxes = random_boxes(1000, 4);
+    auto rays = random_rays(64, 5);
+    bvh<float> tree(to_aabbs(boxes));
+
+    using Value = pack8<float>;
+    for (size_t first = 0; first < rays.size(); first += 8) {
+        Value o[3], d[3];
+        for (size_t lane = 0; lane < 8; ++lane) {
+            const auto& r = rays[first + lane];
+            o[0][lane] = r.origin().x();
+            o[1][lane] = r.origin().y();
+            o[2][lane] = r.origin().z();
+            d[0][lane] = r.dir().x();
+            d[1][lane] = r.dir().y();
+            d[2][lane] = r.dir().z();
+        }
+        ray<Value> packet(point3<Value>(o[0], o[1], o[2]), vec3<Value>(d[0], d[1], d[2]), ray<Value>::ray_direction_normalized{});
+
+        auto hit = tree.nearest(packet);
+
+        std::vector<std::vector<bvh_interval<float>>> laneIntervals(8);
+        tree.forEachHit(packet, [&](uint32_t index, const Value& tEnter, const Value& tExit, const auto& mask) {
+            for (size_t lane = 0; lane < 8; ++lane)
+                if (mask[lane])
+                    laneIntervals[lane].push_back({ index, tEnter[lane], tExit[lane] });
+        });
+
+        for (size_t lane = 0; lane < 8; ++lane) {
+            auto single = tree.nearest(rays[first + lane]);
+            CHECK(hit.mask[lane] == single.mask);
+            if (single.mask) {
+                CHECK(hit.t[lane] == doctest::Approx(single.t));
+                CHECK(hit.index[lane] == single.index);
+            }
+
+            auto expected = tree.intervals(rays[first + lane]);
+            auto& actual = laneIntervals[lane];
+            std::sort(actual.begin(), actual.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+            std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+
+            REQUIRE(actual.size() == expected.size());
+            for (size_t i = 0; i < actual.size(); ++i) {
+                CHECK(actual[i].index == expected[i].index);
+                CHECK(actual[i].tEnter == doctest::Approx(expected[i].tEnter));
+                CHECK(actual[i].tExit == doctest::Approx(expected[i].tExit));
+            }
+        }
+    }
+}
+
+TEST_CASE("Test bvh intervals")
+{
+    auto boxes = random_boxes(500, 6);
+    bvh<float> tree(to_aabbs(boxes));
+
+    for (const auto& r : random_rays(200, 7)) {
+        std::vector<bvh_interval<float>> expected;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            float tEnter, tExit;
+            if (brute_force(r, boxes[i], tEnter, tExit))
+                expected.push_back({ static_cast<uint32_t>(i), tEnter, tExit });
+        }
+
+        auto actual = tree.intervals(r);
+        REQUIRE(actual.size() == expected.size());
+        CHECK(std::is_sorted(actual.begin(), actual.end(), [](const auto& a, const auto& b) { return a.tEnter < b.tEnter; }));
+
+        std::sort(actual.begin(), actual.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+        for (size_t i = 0; i < actual.size(); ++i) {
+            CHECK(actual[i].index == expected[i].index);
+            CHECK(actual[i].tEnter == doctest::Approx(expected[i].tEnter));
+            CHECK(actual[i].tExit == doctest::Approx(expected[i].tExit));
+        }
+    }
+}
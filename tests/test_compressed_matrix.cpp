@@ -0,0 +1,125 @@
+/**
+ *
+ * \file test_compressed_matrix.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/compressed_matrix.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    csr_matrix random_matrix(size_t rows, size_t cols, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> weight(0.01f, 2.f);
+        std::uniform_int_distribution<size_t> length(0, 40);
+
+        std::vector<uint64_t> rowPtr{ 0 };
+        std::vector<uint32_t> colIdx;
+        std::vector<float> values;
+
+        for (size_t i = 0; i < rows; ++i) {
+            // Sorted, unique columns with a mix of small and huge gaps
+            std::uniform_int_distribution<uint32_t> start(0, static_cast<uint32_t>(cols / 2));
+            uint32_t c = start(gen);
+            size_t n = length(gen);
+            for (size_t k = 0; k < n && c < cols; ++k) {
+                colIdx.push_back(c);
+                values.push_back(weight(gen));
+                c += 1 + (gen() % 2 == 0 ? gen() % 3 : gen() % 1000);
+            }
+            rowPtr.push_back(colIdx.size());
+        }
+        return csr_matrix(rows, cols, rowPtr, colIdx, values);
+    }
+
+    template <weight_quantization Q>
+    void check_against_csr(const csr_matrix& A, float tolerance)
+    {
+        compressed_matrix<Q> C(A);
+
+        CHECK(C.rows() == A.rows());
+        CHECK(C.cols() == A.cols());
+        CHECK(C.nnz() == A.nnz());
+
+        SUBCASE("Decoded rows")
+        {
+            std::vector<uint32_t> cols;
+            std::vector<float> weights;
+            for (size_t i = 0; i < A.rows(); ++i) {
+                C.decodeRow(i, cols, weights);
+                REQUIRE(cols.size() == A.rowPtr()[i + 1] - A.rowPtr()[i]);
+
+                for (size_t k = 0; k < cols.size(); ++k) {
+                    CHECK(cols[k] == A.colIdx()[A.rowPtr()[i] + k]);
+                    CHECK(weights[k] == doctest::Approx(A.values()[A.rowPtr()[i] + k]).epsilon(tolerance));
+                }
+            }
+        }
+        SUBCASE("Products match the uncompressed matrix")
+        {
+            std::mt19937 gen(7);
+            std::uniform_real_distribution<float> dist(0, 1);
+
+            std::vector<float> x(A.cols());
+            std::vector<float> y(A.rows());
+            for (auto& e : x)
+                e = dist(gen);
+            for (auto& e : y)
+                e = dist(gen);
+
+            std::vector<float> expected(A.rows());
+            std::vector<float> actual(A.rows());
+            spmv(A, x.data(), expected.data());
+            spmv(C, x.data(), actual.data());
+
+            for (size_t i = 0; i < A.rows(); ++i)
+                CHECK(actual[i] == doctest::Approx(expected[i]).epsilon(tolerance));
+
+            std::vector<float> expectedT(A.cols());
+            std::vector<float> actualT(A.cols());
+            spmv_transposed(A, y.data(), expectedT.data());
+            spmv_transposed<pack4<float>>(C, y.data(), actualT.data(), 2);
+
+            for (size_t j = 0; j < A.cols(); ++j)
+                CHECK(actualT[j] == doctest::Approx(expectedT[j]).epsilon(tolerance));
+        }
+    }
+} // namespace
+
+TEST_CASE("Test half conversion")
+{
+    for (float f : { 0.f, 1.f, 0.5f, 0.333333f, 1e-5f, 65504.f, 1e-7f }) {
+        auto h = details::float_to_half(f);
+        CHECK(details::half_to_float(h) == doctest::Approx(f).epsilon(1e-3));
+    }
+    CHECK(details::float_to_half(1.f) == 0x3c00);
+    CHECK(details::float_to_half(-2.f) == 0xc000);
+}
+
+TEST_CASE("Test compressed matrix, 8 bit weights")
+{
+    check_against_csr<weight_quantization::unorm8>(random_matrix(200, 100000, 1), 1e-2);
+}
+
+TEST_CASE("Test compressed matrix, fp16 weights")
+{
+    check_against_csr<weight_quantization::fp16>(random_matrix(200, 100000, 2), 1e-3);
+}
+
+TEST_CASE("Test compressed matrix is smaller")
+{
+    auto A = random_matrix(500, 1000000, 3);
+    compressed_matrix<weight_quantization::unorm8> C(A);
+
+    size_t csrBytes = (A.rows() + 1) * sizeof(uint64_t) + A.nnz() * (sizeof(uint32_t) + sizeof(float));
+    CHECK(C.memoryUsage() < csrBytes / 2);
+}
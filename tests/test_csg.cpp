@@ -0,0 +1,183 @@
+/**
+ *
+ * \file test_csg.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/csg.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    aabb<float> box(float x0, float y0, float z0, float x1, float y1, float z1)
+    {
+        return aabb<float>(point3<float>(x0, y0, z0), point3<float>(x1, y1, z1));
+    }
+
+    /// Block with three holes drilled along z, and a ball carved out of one corner
+    csg_tree<float> drilled_block()
+    {
+        csg_tree<float> tree;
+        auto block = tree.add(box(-0.5f, -0.3f, -0.2f, 0.5f, 0.3f, 0.2f));
+        for (float x : { -0.3f, 0.f, 0.3f }) {
+            auto hole = tree.add(cylinder<float>({ x, 0, 0 }, { 0.08f, 0.08f, 0.5f }));
+            block = tree.subtract(block, hole);
+        }
+        auto ball = tree.add(ellipsoid<float>({ 0.5f, 0.3f, 0.2f }, { 0.15f, 0.15f, 0.15f }));
+        tree.subtract(block, ball);
+        return tree;
+    }
+
+    /// Length of the ray inside the object by sampling contains() at many points
+    float sampled_length(const csg_tree<float>& tree, const ray<float>& r, float tMax = 4.f, int samples = 40000)
+    {
+        const float step = tMax / static_cast<float>(samples);
+        int inside = 0;
+        for (int i = 0; i < samples; ++i) {
+            const float t = (static_cast<float>(i) + 0.5f) * step;
+            if (tree.contains({ r.origin().x() + t * r.dir().x(), r.origin().y() + t * r.dir().y(), r.origin().z() + t * r.dir().z() }))
+                ++inside;
+        }
+        return static_cast<float>(inside) * step;
+    }
+
+    std::vector<ray<float>> random_rays(size_t count, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        std::vector<ray<float>> rays;
+        for (size_t i = 0; i < count; ++i) {
+            point3<float> origin(2 * dist(gen), 2 * dist(gen), 2 * dist(gen));
+            point3<float> target(0.5f * dist(gen), 0.3f * dist(gen), 0.2f * dist(gen));
+            rays.push_back(rayFromPoints(origin, target));
+        }
+        return rays;
+    }
+} // namespace
+
+TEST_CASE("Test csg operations")
+{
+    csg_tree<float> tree;
+    auto a = tree.add(box(0, -1, -1, 2, 1, 1));
+    auto b = tree.add(box(1, -1, -1, 3, 1, 1));
+    ray<float> r(point3<float>(-1, 0, 0), vec3<float>(1, 0, 0));
+
+    SUBCASE("Union")
+    {
+        tree.unite(a, b);
+        auto list = tree.intervalList(r);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].tEnter == doctest::Approx(1));
+        CHECK(list[0].tExit == doctest::Approx(4));
+    }
+
+    SUBCASE("Intersection")
+    {
+        tree.intersect(a, b);
+        auto list = tree.intervalList(r);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].tEnter == doctest::Approx(2));
+        CHECK(list[0].tExit == doctest::Approx(3));
+    }
+
+    SUBCASE("Difference")
+    {
+        tree.subtract(b, a);
+        CHECK(tree.pathLength(r) == doctest::Approx(1));
+
+        // Splitting an interval in two
+        auto c = tree.add(box(0.5f, -2, -2, 1, 2, 2));
+        tree.subtract(a, c);
+        auto list = tree.intervalList(r);
+        REQUIRE(list.size() == 2);
+        CHECK(list[0].tEnter == doctest::Approx(1));
+        CHECK(list[0].tExit == doctest::Approx(1.5));
+        CHECK(list[1].tEnter == doctest::Approx(2));
+        CHECK(list[1].tExit == doctest::Approx(3));
+    }
+
+    SUBCASE("Touching boxes are merged")
+    {
+        auto c = tree.add(box(2, -1, -1, 4, 1, 1));
+        tree.unite(a, c);
+        auto list = tree.intervalList(r);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].tExit == doctest::Approx(5));
+    }
+
+    SUBCASE("Disjoint intersection and origin inside")
+    {
+        auto c = tree.add(box(5, -1, -1, 6, 1, 1));
+        tree.intersect(a, c);
+        CHECK(tree.pathLength(r) == 0);
+
+        tree.unite(a, b);
+        CHECK(tree.pathLength(ray<float>(point3<float>(2.5f, 0, 0), vec3<float>(-1, 0, 0))) == doctest::Approx(2.5));
+    }
+
+    SUBCASE("Invalid trees")
+    {
+        CHECK_THROWS_AS(tree.unite(a, 7), std::out_of_range);
+
+        csg_tree<float, 2> small;
+        auto n = small.unite(small.add(box(0, 0, 0, 1, 1, 1)), small.add(box(2, 0, 0, 3, 1, 1)));
+        CHECK_THROWS_AS(small.unite(n, small.add(box(4, 0, 0, 5, 1, 1))), std::length_error);
+    }
+
+    SUBCASE("Empty tree")
+    {
+        csg_tree<float> empty;
+        CHECK(empty.pathLength(r) == 0);
+        CHECK(!empty.contains({ 0, 0, 0 }));
+    }
+}
+
+TEST_CASE("Test csg drilled block")
+{
+    auto tree = drilled_block();
+    CHECK(tree.size() == 9);
+
+    // Along x through the holes: 1 minus three diameters
+    ray<float> r(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0));
+    CHECK(tree.intervalList(r).size() == 4);
+    CHECK(tree.pathLength(r) == doctest::Approx(1 - 3 * 0.16f));
+
+    // Down a hole
+    CHECK(tree.pathLength(ray<float>(point3<float>(0.3f, 0, 2), vec3<float>(0, 0, -1))) == 0);
+
+    for (const auto& ray : random_rays(100, 17))
+        CHECK(tree.pathLength(ray) == doctest::Approx(sampled_length(tree, ray)).epsilon(0.003));
+
+    SUBCASE("Packets")
+    {
+        auto rays = random_rays(64, 19);
+
+        using Value = pack8<float>;
+        for (size_t first = 0; first < rays.size(); first += 8) {
+            Value o[3], d[3];
+            for (size_t lane = 0; lane < 8; ++lane) {
+                const auto& r = rays[first + lane];
+                o[0][lane] = r.origin().x();
+                o[1][lane] = r.origin().y();
+                o[2][lane] = r.origin().z();
+                d[0][lane] = r.dir().x();
+                d[1][lane] = r.dir().y();
+                d[2][lane] = r.dir().z();
+            }
+            ray<Value> packet(point3<Value>(o[0], o[1], o[2]), vec3<Value>(d[0], d[1], d[2]), ray<Value>::ray_direction_normalized{});
+
+            const Value length = tree.pathLength(packet);
+            for (size_t lane = 0; lane < 8; ++lane)
+                CHECK(length[lane] == doctest::Approx(tree.pathLength(rays[first + lane])));
+        }
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ *
+ * \file test_dispatch.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/dispatch.hpp"
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    /// Levels up to the one of the CPU, all of them have to give the results of the header only code
+    std::vector<const kernel_table*> available()
+    {
+        std::vector<const kernel_table*> result;
+        for (auto isa : { isa_level::sse4_2, isa_level::avx2, isa_level::avx512 })
+            if (const auto* table = kernels_for(isa))
+                result.push_back(table);
+        return result;
+    }
+} // namespace
+
+TEST_CASE("Test kernel selection")
+{
+    const auto isa = detect_isa();
+    CHECK(std::string(isa_name(isa_level::avx2)) == "avx2");
+
+    // The best level is selected and levels above the CPU are not available
+    CHECK(kernels().isa <= isa);
+    CHECK(kernels_for(isa) != nullptr);
+    CHECK(kernels_for(isa_level::sse4_2) != nullptr);
+    // Every level is loaded once and hands out its own table
+    for (const auto* table : available()) {
+        CHECK(table->isa <= isa);
+        CHECK(kernels_for(table->isa) == table);
+    }
+    if (isa != isa_level::avx512)
+        CHECK(kernels_for(isa_level::avx512) == nullptr);
+}
+
+TEST_CASE("Test dispatched kernels")
+{
+    const voxel_grid<float> grid(12, 10, 8, point3<float>(-0.6f, -0.5f, -0.4f), vec3<float>(0.1f));
+    volume<float> vol(12, 10, 8);
+    vol.fill([](size_t x, size_t y, size_t z) { return static_cast<float>((x * 3 + y * 5 + z) % 7); });
+
+    const circular_trajectory<float> trajectory{ 12, 2.f, 1.f, 20, 14, 0.08f, 0.08f, 0.3f };
+    const auto view = trajectory.view(5);
+
+    SUBCASE("Ray box intersection")
+    {
+        // 11 rays, not a multiple of the packet size, some of them missing the box
+        std::vector<float> o[3], d[3];
+        std::vector<ray<float>> rays;
+        for (size_t i = 0; i < 11; ++i) {
+            rays.push_back(view.pixelRay(i * 2, i % 14));
+            const auto origin = rays.back().origin();
+            const auto dir = rays.back().dir();
+            const float values[2][3] = { { origin.x(), origin.y(), origin.z() }, { dir.x(), dir.y(), dir.z() } };
+            for (int a = 0; a < 3; ++a) {
+                o[a].push_back(values[0][a]);
+                d[a].push_back(values[1][a]);
+            }
+        }
+        const kernel_rays batch{ { o[0].data(), o[1].data(), o[2].data() }, { d[0].data(), d[1].data(), d[2].data() }, 11 };
+        const float lo[3] = { -0.6f, -0.5f, -0.4f }, hi[3] = { 0.6f, 0.5f, 0.4f };
+
+        for (const auto* table : available()) {
+            std::vector<float> tmin(11), tmax(11);
+            table->intersectBox(batch, lo, hi, tmin.data(), tmax.data());
+
+            for (size_t i = 0; i < 11; ++i) {
+                auto [t0, t1, hit] = intersection(rays[i], grid.bounds(), ray_aabb_interval{});
+                CHECK(tmin[i] == doctest::Approx(hit ? t0 : 0).epsilon(1e-5));
+                CHECK(tmax[i] == doctest::Approx(hit ? t1 : 0).epsilon(1e-5));
+            }
+        }
+    }
+    SUBCASE("Projection")
+    {
+        for (const auto* table : available()) {
+            std::vector<float> out(view.cols() * view.rows());
+            table->project(kernel_view::from(view), kernel_grid::from(grid), vol.data(), out.data());
+
+            for (size_t row = 0; row < view.rows(); row += 3)
+                for (size_t col = 0; col < view.cols(); col += 2)
+                    CHECK(out[row * view.cols() + col] == doctest::Approx(project(view.pixelRay(col, row), grid, vol)).epsilon(1e-4));
+        }
+    }
+    SUBCASE("Backprojection")
+    {
+        projection_stack<float> filtered(trajectory.cols, trajectory.rows, trajectory.numViews);
+        for (size_t i = 0; i < filtered.size(); ++i)
+            filtered.data()[i] = std::sin(static_cast<float>(i));
+
+        std::vector<projection_matrix<float>> matrices;
+        std::vector<filtered_rows> rows;
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+            rows.push_back({ filtered.view(k), 0, trajectory.rows });
+        }
+
+        const voxel_box box{ 1, 11, 0, 10, 2, 7 };
+        std::vector<float> expected(box.size());
+        backproject(matrices, rows, trajectory.cols, 0.5f, grid, box, expected.data());
+
+        for (const auto* table : available()) {
+            std::vector<float> out(box.size());
+            table->backproject(matrices.data(), rows.data(), matrices.size(), trajectory.cols, 0.5f, kernel_grid::from(grid), box,
+                               out.data());
+            for (size_t i = 0; i < out.size(); ++i)
+                CHECK(out[i] == doctest::Approx(expected[i]).epsilon(1e-4));
+        }
+    }
+}
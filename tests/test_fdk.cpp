@@ -0,0 +1,118 @@
+/**
+ *
+ * \file test_fdk.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/out_of_core.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    circular_trajectory<float> small_trajectory()
+    {
+        return circular_trajectory<float>{ 90, 2.f, 1.f, 48, 64, 0.05f, 0.05f };
+    }
+
+    /// Line integrals through a homogeneous ball of the given radius and attenuation, centered at the origin
+    projection_stack<float> ball_projections(const circular_trajectory<float>& trajectory, float radius, float mu)
+    {
+        projection_stack<float> stack(trajectory.cols, trajectory.rows, trajectory.numViews);
+
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            auto view = trajectory.view(k);
+            for (size_t row = 0; row < trajectory.rows; ++row) {
+                for (size_t col = 0; col < trajectory.cols; ++col) {
+                    auto r = view.pixelRay(col, row);
+                    auto o = r.origin();
+                    auto d = r.dir();
+
+                    // Distance of the ray from the center
+                    float t = -(o.x() * d.x() + o.y() * d.y() + o.z() * d.z());
+                    float px = o.x() + t * d.x(), py = o.y() + t * d.y(), pz = o.z() + t * d.z();
+                    float dist2 = px * px + py * py + pz * pz;
+
+                    stack(col, row, k) = dist2 < radius * radius ? 2 * mu * std::sqrt(radius * radius - dist2) : 0.f;
+                }
+            }
+        }
+        return stack;
+    }
+} // namespace
+
+TEST_CASE("Test projection matrix")
+{
+    auto trajectory = small_trajectory();
+    auto view = trajectory.view(7);
+    auto P = view.projectionMatrix();
+
+    // Points along pixel rays project back onto the pixel
+    for (auto [col, row] : { std::pair<size_t, size_t>{ 0, 0 }, { 13, 5 }, { 47, 63 } }) {
+        auto r = view.pixelRay(col, row);
+        for (float t : { 1.f, 2.f, 2.5f }) {
+            auto p = r.origin() + t * r.dir();
+            auto [u, v, w] = P.project(p.x(), p.y(), p.z());
+
+            CHECK(w > 0);
+            CHECK(u / w == doctest::Approx(col).epsilon(1e-3));
+            CHECK(v / w == doctest::Approx(row).epsilon(1e-3));
+        }
+    }
+
+    // The rotation axis is at sourceDistance from the source
+    auto [u, v, w] = P.project(0, 0, 0);
+    CHECK(w == doctest::Approx(2));
+    CHECK(u / w == doctest::Approx(23.5));
+    CHECK(v / w == doctest::Approx(31.5));
+}
+
+TEST_CASE("Test FDK reconstruction")
+{
+    auto trajectory = small_trajectory();
+    auto grid = voxel_grid<float>(24, 24, 16, point3<float>(-0.6f, -0.6f, -0.4f), vec3<float>(0.05f));
+    auto projections = ball_projections(trajectory, 0.4f, 2.f);
+
+    auto reference = fdk(trajectory, projections, grid);
+
+    SUBCASE("The ball is reconstructed")
+    {
+        // Inside, away from the edge
+        CHECK(reference(12, 12, 8) == doctest::Approx(2).epsilon(0.05));
+        CHECK(reference(9, 12, 8) == doctest::Approx(2).epsilon(0.05));
+
+        // Outside
+        CHECK(std::abs(reference(1, 1, 8)) < 0.2f);
+    }
+    SUBCASE("Slabs only need a part of the detector")
+    {
+        slab_plan<float> plan(trajectory, grid, 600000);
+
+        CHECK(plan.slabs().size() > 1);
+        CHECK(plan.memoryUsage() <= 600000);
+        CHECK(plan.slabs().front().zBegin == 0);
+        CHECK(plan.slabs().back().zEnd == 16);
+
+        for (const auto& slab : plan.slabs())
+            CHECK(slab.numRows < 90 * 64 / 2);
+
+        CHECK_THROWS_AS(slab_plan<float>(trajectory, grid, 1024), std::length_error);
+    }
+    SUBCASE("Out of core result matches the in memory one")
+    {
+        volume<float> result(24, 24, 16, -1.f);
+        fdk_out_of_core(trajectory, projections, grid, result, 600000);
+
+        for (size_t z = 0; z < 16; ++z)
+            for (size_t y = 0; y < 24; ++y)
+                for (size_t x = 0; x < 24; ++x)
+                    CHECK(result(x, y, z) == doctest::Approx(reference(x, y, z)).epsilon(1e-5));
+    }
+}
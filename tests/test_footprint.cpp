@@ -0,0 +1,164 @@
+/**
+ *
+ * \file test_footprint.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/footprint.hpp"
+#include "TomoSect/supersampling.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test ray footprints")
+{
+    // Source 3 away from the detector center, 0.1 wide pixels
+    const auto view = circular_trajectory<float>{ 1, 2.f, 1.f, 21, 11, 0.1f, 0.1f }.view(0);
+
+    SUBCASE("Center pixel")
+    {
+        const auto footprint = pixel_footprint(view, 10, 5);
+        CHECK(footprint.width(0) == doctest::Approx(0));
+        CHECK(footprint.width(3) == doctest::Approx(0.1));
+        CHECK(footprint.width(1.5f) == doctest::Approx(0.05));
+        CHECK(footprint.distance(0.05f) == doctest::Approx(1.5));
+    }
+    SUBCASE("Oblique pixels look smaller")
+    {
+        // Pixel 1 from the center in x: distance sqrt(9 + 1) and cosine 3 / sqrt(10)
+        const auto footprint = pixel_footprint(view, 0, 5);
+        const float distance = std::sqrt(10.f);
+        CHECK(footprint.width(distance) == doctest::Approx(0.1f * 3 / distance));
+    }
+    SUBCASE("Focal spot")
+    {
+        const auto footprint = pixel_footprint(view, 10, 5, 0.04f);
+        CHECK(footprint.width(0) == doctest::Approx(0.04));
+        CHECK(footprint.width(3) == doctest::Approx(0.1));
+
+        // Larger than the pixels, the footprint narrows towards the detector
+        const auto wide = pixel_footprint(view, 10, 5, 0.3f);
+        CHECK(wide.width(3) == doctest::Approx(0.1));
+        CHECK(wide.distance(0.2f) == doctest::Approx(1.5));
+        CHECK(wide.distance(0.4f) == std::numeric_limits<float>::infinity());
+    }
+}
+
+TEST_CASE("Test volume pyramid")
+{
+    voxel_grid<float> grid(5, 4, 3, point3<float>(-1, -1, -1), vec3<float>(0.1f, 0.2f, 0.1f));
+    volume<float> vol(5, 4, 3, 1.f);
+    volume_pyramid<float, float> pyramid(grid, vol);
+
+    // 5x4x3, 3x2x2, 2x1x1, 1x1x1
+    REQUIRE(pyramid.levels() == 4);
+    CHECK(pyramid.level(1).nx() == 3);
+    CHECK(pyramid.level(1).ny() == 2);
+    CHECK(pyramid.level(1).nz() == 2);
+    CHECK(pyramid.level(3).size() == 1);
+    CHECK(pyramid.grid(2).spacing().y() == doctest::Approx(0.8));
+    CHECK(pyramid.grid(2).min().x() == doctest::Approx(-1));
+    CHECK(pyramid.level(0).data() == vol.data());
+
+    // Means of the voxels below, missing ones count as zero
+    CHECK(pyramid.level(1)(0, 0, 0) == doctest::Approx(1));
+    CHECK(pyramid.level(1)(2, 0, 1) == doctest::Approx(0.25));
+
+    // Every level keeps the total
+    for (size_t l = 0; l < pyramid.levels(); ++l) {
+        double sum = 0;
+        const auto& level = pyramid.level(l);
+        for (size_t z = 0; z < level.nz(); ++z)
+            for (size_t y = 0; y < level.ny(); ++y)
+                for (size_t x = 0; x < level.nx(); ++x)
+                    sum += level(x, y, z);
+        CHECK(sum * std::pow(8.0, static_cast<double>(l)) == doctest::Approx(60));
+    }
+
+    // Levels by the largest voxel edge
+    CHECK(pyramid.voxelSize() == doctest::Approx(0.2));
+    CHECK(pyramid.levelFor(0.1f) == 0);
+    CHECK(pyramid.levelFor(0.3f) == 0);
+    CHECK(pyramid.levelFor(0.5f) == 1);
+    CHECK(pyramid.levelFor(0.9f) == 2);
+    CHECK(pyramid.levelFor(100.f) == 3);
+
+    volume_pyramid<float, float> limited(grid, vol, 2);
+    CHECK(limited.levels() == 2);
+
+    volume<float> other(5, 4, 4);
+    CHECK_THROWS_AS((volume_pyramid<float, float>(grid, other)), std::invalid_argument);
+}
+
+TEST_CASE("Test footprint projection")
+{
+    voxel_grid<float> grid(16, 16, 16, point3<float>(-0.5f), vec3<float>(1.f / 16));
+
+    SUBCASE("Narrow footprints trace the volume itself")
+    {
+        volume<float> vol(16, 16, 16);
+        vol.fill([](size_t x, size_t y, size_t z) { return static_cast<float>((x * 7 + y * 3 + z) % 5); });
+        volume_pyramid<float, float> pyramid(grid, vol);
+
+        ray<float> r(point3<float>(-2, 0.13f, -0.21f), vec3<float>(1, 0.1f, 0.2f));
+        CHECK(project_footprint(r, ray_footprint<float>{ 0, 0.01f }, pyramid) == doctest::Approx(project(r, grid, vol)));
+    }
+    SUBCASE("Constant volumes are the same on every level")
+    {
+        volume<float> vol(16, 16, 16, 2.f);
+        volume_pyramid<float, float> pyramid(grid, vol);
+
+        // The footprint grows from a voxel to the whole volume inside of it
+        ray<float> r(point3<float>(-1, -0.9f, 0.1f), vec3<float>(1, 1, 0.2f));
+        const ray_footprint<float> footprint{ 0, 0.3f };
+        CHECK(footprint.width(1.f) > 0.25f);
+        CHECK(project_footprint(r, footprint, pyramid) == doctest::Approx(project(r, grid, vol)));
+        CHECK(project_footprint(ray<float>(point3<float>(-1, 0.7f, 0), vec3<float>(1, 0, 0)), footprint, pyramid) == 0);
+    }
+    SUBCASE("Odd sizes keep the line integral")
+    {
+        voxel_grid<float> odd(5, 5, 5, point3<float>(-0.5f), vec3<float>(0.2f));
+        volume<float> vol(5, 5, 5, 1.f);
+        volume_pyramid<float, float> pyramid(odd, vol);
+
+        // On level 1 the ray crosses two voxels of 1 and one of 0.5 (half the voxels below are missing), 0.4 long each
+        ray<float> r(point3<float>(-1, -0.4f, -0.4f), vec3<float>(1, 0, 0));
+        REQUIRE(pyramid.levelFor(0.5f) == 1);
+        CHECK(project_footprint(r, ray_footprint<float>{ 0.5f, 0 }, pyramid) == doctest::Approx(1));
+        CHECK(project(r, odd, vol) == doctest::Approx(1));
+    }
+    SUBCASE("Footprints filter like supersampling")
+    {
+        // Lines of voxels along the rays, in a checkerboard across them, seen by pixels about three voxels wide
+        volume<float> vol(16, 16, 16);
+        vol.fill([](size_t, size_t y, size_t z) { return static_cast<float>((y + z) % 2 * 2); });
+        volume_pyramid<float, float> pyramid(grid, vol);
+
+        const auto view = circular_trajectory<float>{ 1, 2.f, 1.f, 12, 12, 0.3f, 0.3f }.view(0);
+        const size_t n = view.cols() * view.rows();
+
+        supersampling<float> options;
+        options.subCols = 8;
+        options.subRows = 8;
+        std::vector<float> reference(n), footprint(n);
+        project_supersampled(view, options, grid, vol, reference.data());
+        project_footprint(view, pyramid, footprint.data());
+
+        double centerError = 0, footprintError = 0;
+        for (size_t row = 0; row < view.rows(); ++row) {
+            for (size_t col = 0; col < view.cols(); ++col) {
+                const size_t i = row * view.cols() + col;
+                const double center = project(view.pixelRay(col, row), grid, vol);
+                centerError += (center - reference[i]) * (center - reference[i]);
+                footprintError += (footprint[i] - reference[i]) * (footprint[i] - reference[i]);
+            }
+        }
+        CHECK(footprintError < 0.05 * centerError);
+    }
+}
@@ -0,0 +1,202 @@
+/**
+ *
+ * \file test_frame_ring.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/frame_ring.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace tomosect;
+
+namespace
+{
+    std::string ring_name(const char* test) { return "/tomosect_test_" + std::string(test) + "_" + std::to_string(::getpid()); }
+
+    std::vector<float> frame(size_t pixels, float value) { return std::vector<float>(pixels, value); }
+} // namespace
+
+TEST_CASE("Test frame ring")
+{
+    const auto name = ring_name("frame_ring");
+    frame_ring_writer writer(name, 8, 4, 4);
+    frame_ring_reader reader(name);
+
+    CHECK(reader.cols() == 8);
+    CHECK(reader.rows() == 4);
+
+    std::vector<float> dst(32);
+
+    SUBCASE("Frames arrive in order")
+    {
+        CHECK_FALSE(reader.tryRead(dst.data()));
+
+        writer.publish(5, frame(32, 1.f).data());
+        writer.publish(6, frame(32, 2.f).data());
+
+        auto first = reader.tryRead(dst.data());
+        REQUIRE(first);
+        CHECK(first->sequence == 1);
+        CHECK(first->view == 5);
+        CHECK(dst[31] == 1.f);
+
+        auto second = reader.tryRead(dst.data());
+        REQUIRE(second);
+        CHECK(second->view == 6);
+        CHECK(dst[0] == 2.f);
+
+        CHECK_FALSE(reader.tryRead(dst.data()));
+        CHECK(reader.dropped() == 0);
+    }
+
+    SUBCASE("Frames in place")
+    {
+        float* slot = writer.claim();
+        for (size_t i = 0; i < 32; ++i)
+            slot[i] = static_cast<float>(i);
+        CHECK_FALSE(reader.tryAcquire());
+        CHECK_THROWS_AS(writer.claim(), std::logic_error);
+
+        writer.commit(3, 42);
+
+        auto frame = reader.tryAcquire();
+        REQUIRE(frame);
+        CHECK(frame->info().view == 3);
+        CHECK(frame->info().geometryId == 42);
+        CHECK(reinterpret_cast<uintptr_t>(frame->data()) % 64 == 0);
+        CHECK(frame->data()[17] == 17.f);
+        CHECK(frame->valid());
+        CHECK(frame->release());
+
+        CHECK_THROWS_AS(writer.commit(3), std::logic_error);
+    }
+
+    SUBCASE("Frames overwritten while in use")
+    {
+        writer.publish(0, frame(32, 0.f).data());
+        auto held = reader.tryAcquire();
+        REQUIRE(held);
+
+        for (size_t k = 1; k <= 4; ++k)
+            writer.publish(k, frame(32, static_cast<float>(k)).data());
+
+        CHECK_FALSE(held->valid());
+        CHECK_FALSE(held->release());
+        CHECK(reader.dropped() == 1);
+
+        // Copying reads skip over the broken frame
+        auto info = reader.tryRead(dst.data());
+        REQUIRE(info);
+        CHECK(info->view == 1);
+    }
+
+    SUBCASE("Overwritten frames are dropped")
+    {
+        for (size_t k = 0; k < 10; ++k)
+            writer.publish(k, frame(32, static_cast<float>(k)).data());
+
+        // Only the last four frames are still in the ring
+        auto info = reader.tryRead(dst.data());
+        REQUIRE(info);
+        CHECK(info->view == 6);
+        CHECK(dst[0] == 6.f);
+        CHECK(reader.dropped() == 6);
+    }
+
+    SUBCASE("Reading until closed")
+    {
+        std::thread producer([&] {
+            for (size_t k = 0; k < 3; ++k)
+                writer.publish(k, frame(32, static_cast<float>(k)).data());
+            writer.close();
+        });
+
+        size_t count = 0;
+        while (auto info = reader.read(dst.data()))
+            CHECK(info->view == count++);
+        producer.join();
+
+        CHECK(count + reader.dropped() == 3);
+        CHECK(reader.closed());
+    }
+
+    SUBCASE("Timeout")
+    {
+        CHECK_FALSE(reader.read(dst.data(), std::chrono::milliseconds(1)));
+    }
+}
+
+TEST_CASE("Test blocking frame ring")
+{
+    const auto name = ring_name("frame_ring_block");
+    frame_ring_writer writer(name, 16, 16, 2, ring_policy::block);
+    frame_ring_reader reader(name);
+    CHECK(reader.policy() == ring_policy::block);
+
+    constexpr size_t count = 200;
+    std::thread producer([&] {
+        for (size_t k = 0; k < count; ++k) {
+            float* pixels = writer.claim();
+            std::fill(pixels, pixels + 256, static_cast<float>(k));
+            writer.commit(k, 7);
+        }
+        writer.close();
+    });
+
+    // The writer waits for the reader, so nothing is lost even with a slow reader
+    size_t received = 0;
+    bool intact = true;
+    while (auto frame = reader.acquire()) {
+        std::this_thread::yield();
+        const float* pixels = frame->data();
+        intact &= frame->info().view == received && pixels[0] == static_cast<float>(received) && pixels[255] == pixels[0];
+        intact &= frame->release();
+        ++received;
+    }
+    producer.join();
+
+    CHECK(received == count);
+    CHECK(intact);
+    CHECK(reader.dropped() == 0);
+}
+
+TEST_CASE("Test frame ring closed by destroying the writer")
+{
+    const auto name = ring_name("frame_ring_destroyed");
+    std::vector<float> dst(4);
+
+    std::optional<frame_ring_writer> writer(std::in_place, name, 2, 2, 2);
+    frame_ring_reader reader(name);
+    writer->publish(3, frame(4, 1.f).data());
+    CHECK_FALSE(reader.closed());
+
+    // The reader keeps its mapping, finishes the frame left in the ring and then stops instead of waiting
+    writer.reset();
+    CHECK(reader.closed());
+    auto info = reader.read(dst.data());
+    REQUIRE(info);
+    CHECK(info->view == 3);
+    CHECK_FALSE(reader.read(dst.data()));
+}
+
+TEST_CASE("Test frame ring errors")
+{
+    const auto name = ring_name("frame_ring_errors");
+
+    CHECK_THROWS_AS(frame_ring_reader{ name }, std::system_error);
+
+    frame_ring_writer writer(name, 2, 2, 2);
+    CHECK_THROWS_AS(frame_ring_writer(name, 2, 2, 2), std::system_error);
+    CHECK_THROWS_AS(frame_ring_writer(name + "_empty", 0, 2, 2), std::invalid_argument);
+}
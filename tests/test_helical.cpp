@@ -0,0 +1,129 @@
+/**
+ *
+ * \file test_helical.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/helical.hpp"
+#include "TomoSect/phantom.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    /// Six turns from z = -1.2 to 1.2, 0.4 per turn: pitch 0.75 with about 0.53 of detector height at the axis
+    helical_trajectory<float> small_helix()
+    {
+        return helical_trajectory<float>{ 540, 2.f, 1.f, 48, 16, 0.05f, 0.05f, 90, 0.4f, 0.f, -1.2f };
+    }
+} // namespace
+
+TEST_CASE("Test helical trajectory")
+{
+    const auto trajectory = small_helix();
+
+    CHECK(trajectory.pitch() == doctest::Approx(0.75));
+    CHECK(trajectory.height(45) == doctest::Approx(-1.f));
+    CHECK(trajectory.angle(45) == doctest::Approx(M_PI));
+
+    // One turn later the pose is the same, moved up by the feed
+    const auto a = trajectory.view(10);
+    const auto b = trajectory.view(100);
+    CHECK(b.source.x() == doctest::Approx(a.source.x()).epsilon(1e-4));
+    CHECK(b.source.y() == doctest::Approx(a.source.y()).epsilon(1e-4));
+    CHECK(b.source.z() == doctest::Approx(a.source.z() + 0.4f));
+
+    const auto center = b.detector.coordFromLocal(point2<float>(23.5f, 7.5f));
+    CHECK(center.x() == doctest::Approx(-a.source.x() / 2).epsilon(1e-4));
+    CHECK(center.z() == doctest::Approx(b.source.z()));
+
+    // Poses between views
+    const auto half = trajectory.viewAt(trajectory.angle(10) + trajectory.step() / 2);
+    CHECK(half.source.z() == doctest::Approx((trajectory.height(10) + trajectory.height(11)) / 2));
+
+    SUBCASE("View windows hold all views reaching a point")
+    {
+        const point3<float> points[] = { point3<float>(0, 0, 0), point3<float>(0.5f, -0.3f, 0.2f), point3<float>(-0.2f, 0.6f, -0.9f),
+                                         point3<float>(0, 0, 1.5f) };
+        for (const auto& p : points) {
+            const auto window = trajectory.viewWindow(p);
+            CHECK(window.size() < trajectory.numViews / 2);
+
+            for (size_t k = 0; k < trajectory.numViews; ++k) {
+                auto [u, v, w] = trajectory.view(k).projectionMatrix().project(p.x(), p.y(), p.z());
+                if (v / w > -1 && v / w < 16)
+                    CHECK((k >= window.begin && k < window.end));
+            }
+        }
+
+        // Out of the scanned range and without feed
+        CHECK(trajectory.viewWindow(point3<float>(0, 0, 3)).size() == 0);
+        auto circular = trajectory;
+        circular.feed = 0;
+        CHECK(circular.viewWindow(point3<float>(0, 0, 3)).size() == 540);
+    }
+}
+
+TEST_CASE("Test helical backprojection")
+{
+    const auto trajectory = small_helix();
+    voxel_grid<float> grid(24, 24, 16, point3<float>(-0.6f, -0.6f, -0.4f), vec3<float>(0.05f));
+
+    // Long ellipsoid, longer than the detector is high
+    analytic_phantom<float> phantom;
+    phantom.add(ellipsoid<float>({ 0, 0, 0 }, { 0.4f, 0.4f, 0.8f }), 2.f);
+
+    projection_stack<float> projections(trajectory.cols, trajectory.rows, trajectory.numViews);
+    for (size_t k = 0; k < trajectory.numViews; ++k)
+        project_phantom(trajectory.view(k), phantom, projections.view(k));
+
+    SUBCASE("View windows skip only views without contribution")
+    {
+        std::vector<projection_matrix<float>> matrices;
+        std::vector<filtered_rows> rows;
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            matrices.push_back(trajectory.view(k).projectionMatrix());
+            rows.push_back({ projections.view(k), 0, trajectory.rows });
+        }
+
+        const voxel_box box{ 2, 22, 0, 24, 3, 13 };
+        std::vector<float> all(box.size()), windowed(box.size());
+        backproject(matrices, rows, trajectory.cols, 1.f, grid, box, all.data());
+        backproject(trajectory, projections, 1.f, grid, box, windowed.data());
+
+        for (size_t i = 0; i < all.size(); ++i)
+            CHECK(windowed[i] == doctest::Approx(all[i]).epsilon(1e-4));
+    }
+    SUBCASE("Counts are the views seeing a voxel")
+    {
+        const voxel_box box{ 12, 13, 12, 13, 8, 9 };
+        float sum = 0, count = 0;
+        backproject(trajectory, projections, 1.f, grid, box, &sum, &count);
+
+        // Near the axis a voxel is on the detector for 0.53 / 0.4 turns
+        CHECK(count == doctest::Approx(90 / 0.75).epsilon(0.03));
+    }
+    SUBCASE("Reconstruction")
+    {
+        const auto result = helical_fdk(trajectory, projections, grid);
+
+        CHECK(result(12, 12, 8) == doctest::Approx(2).epsilon(0.05));
+        CHECK(result(9, 12, 2) == doctest::Approx(2).epsilon(0.05));
+        CHECK(result(15, 10, 14) == doctest::Approx(2).epsilon(0.05));
+        CHECK(std::abs(result(1, 1, 8)) < 0.2f);
+    }
+    SUBCASE("Invalid input")
+    {
+        projection_stack<float> other(trajectory.cols, trajectory.rows, 90);
+        CHECK_THROWS_AS(helical_fdk(trajectory, other, grid), std::invalid_argument);
+
+        float value = 0;
+        CHECK_THROWS_AS(backproject(trajectory, other, 1.f, grid, voxel_box{ 0, 1, 0, 1, 0, 1 }, &value), std::invalid_argument);
+    }
+}
@@ -0,0 +1,144 @@
+/**
+ *
+ * \file test_incremental_fdk.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/frame_ring.hpp"
+#include "TomoSect/incremental_fdk.hpp"
+
+#include <cmath>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace tomosect;
+
+namespace
+{
+    circular_trajectory<float> small_trajectory() { return circular_trajectory<float>{ 24, 2.f, 1.f, 32, 16, 0.05f, 0.05f }; }
+
+    projection_stack<float> smooth_projections(const circular_trajectory<float>& trajectory)
+    {
+        projection_stack<float> stack(trajectory.cols, trajectory.rows, trajectory.numViews);
+        for (size_t k = 0; k < trajectory.numViews; ++k)
+            for (size_t row = 0; row < trajectory.rows; ++row)
+                for (size_t col = 0; col < trajectory.cols; ++col)
+                    stack(col, row, k) =
+                        std::cos(0.2f * static_cast<float>(col) - 0.3f * static_cast<float>(k)) + 0.1f * static_cast<float>(row);
+        return stack;
+    }
+
+    float max_difference(const volume<float>& a, const volume<float>& b)
+    {
+        float diff = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            diff = std::max(diff, std::abs(a.data()[i] - b.data()[i]));
+        return diff;
+    }
+} // namespace
+
+TEST_CASE("Test incremental FDK")
+{
+    auto trajectory = small_trajectory();
+    auto grid = voxel_grid<float>(12, 12, 6, point3<float>(-0.3f, -0.3f, -0.15f), vec3<float>(0.05f));
+    auto projections = smooth_projections(trajectory);
+    auto reference = fdk(trajectory, projections, grid);
+
+    incremental_fdk<float> reconstruction(trajectory, grid);
+
+    SUBCASE("All views in any order give the full reconstruction")
+    {
+        for (size_t k = 0; k < trajectory.numViews; k += 2)
+            reconstruction.add(k, projections.view(k));
+
+        auto half = reconstruction.snapshot();
+        CHECK(half.views == trajectory.numViews / 2);
+        CHECK(max_difference(half.data, reference) > 1e-3f);
+
+        std::vector<std::pair<size_t, const float*>> batch;
+        for (size_t k = 1; k < trajectory.numViews; k += 2)
+            batch.emplace_back(k, projections.view(k));
+        reconstruction.add(batch);
+
+        auto full = reconstruction.snapshot();
+        CHECK(full.views == trajectory.numViews);
+        CHECK(max_difference(full.data, reference) < 1e-4f);
+
+        // Snapshots are copies
+        CHECK(max_difference(half.data, full.data) > 1e-3f);
+
+        reconstruction.reset();
+        CHECK(reconstruction.views() == 0);
+        CHECK(reconstruction.snapshot().data.data()[100] == 0.f);
+    }
+
+    SUBCASE("Snapshots while adding")
+    {
+        std::thread producer([&] {
+            for (size_t k = 0; k < trajectory.numViews; ++k)
+                reconstruction.add(k, projections.view(k));
+        });
+
+        size_t last = 0;
+        while (last < trajectory.numViews) {
+            auto snapshot = reconstruction.snapshot();
+            CHECK(snapshot.views >= last);
+            last = snapshot.views;
+        }
+        producer.join();
+
+        CHECK(max_difference(reconstruction.snapshot().data, reference) < 1e-4f);
+    }
+
+    SUBCASE("Frames from a shared memory ring")
+    {
+        const std::string name = "/tomosect_test_incremental_fdk_" + std::to_string(::getpid());
+        frame_ring_writer writer(name, trajectory.cols, trajectory.rows, trajectory.numViews);
+        frame_ring_reader reader(name);
+
+        std::thread producer([&] {
+            for (size_t k = 0; k < trajectory.numViews; ++k)
+                writer.publish(k, projections.view(k));
+            writer.close();
+        });
+
+        size_t count = reconstruction.ingest(reader, 3);
+        producer.join();
+
+        CHECK(count == trajectory.numViews);
+        CHECK(reader.dropped() == 0);
+        CHECK(max_difference(reconstruction.snapshot().data, reference) < 1e-4f);
+    }
+
+    SUBCASE("Frames of other geometries are ignored")
+    {
+        const std::string name = "/tomosect_test_incremental_fdk_geometry_" + std::to_string(::getpid());
+        frame_ring_writer writer(name, trajectory.cols, trajectory.rows, 4, ring_policy::block);
+        frame_ring_reader reader(name);
+
+        std::thread producer([&] {
+            for (size_t k = 0; k < trajectory.numViews; ++k) {
+                writer.publish(k, projections.view(k), 1);
+                writer.publish(k, projections.view(0), 2);
+            }
+            writer.close();
+        });
+
+        size_t count = reconstruction.ingest(reader, 4, 1);
+        producer.join();
+
+        CHECK(count == trajectory.numViews);
+        CHECK(max_difference(reconstruction.snapshot().data, reference) < 1e-4f);
+    }
+
+    SUBCASE("Invalid views")
+    {
+        CHECK_THROWS_AS(reconstruction.add(trajectory.numViews, projections.view(0)), std::out_of_range);
+    }
+}
@@ -108,4 +108,43 @@ TEST_CASE("Intersection Ray Curved Rectangle")
             CHECK(hit_point.z() == -1);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Quadratic roots")
+{
+    SUBCASE("Two roots")
+    {
+        auto [t0, t1, mask] = quadratic_roots<float>(2, -6, 4);
+
+        CHECK(mask);
+        CHECK(t0 == doctest::Approx(1));
+        CHECK(t1 == doctest::Approx(2));
+    }
+    SUBCASE("No roots")
+    {
+        auto [t0, t1, mask] = quadratic_roots<float>(1, 0, 1);
+
+        CHECK(!mask);
+    }
+    SUBCASE("Root close to zero keeps its precision")
+    {
+        // t^2 - 1e4 t + 1 has roots 1e4 and 1e-4, the textbook formula loses the small one in float
+        auto [t0, t1, mask] = quadratic_roots<float>(1, -1e4f, 1);
+
+        CHECK(mask);
+        CHECK(t0 == doctest::Approx(1e-4).epsilon(1e-4));
+        CHECK(t1 == doctest::Approx(1e4));
+    }
+    SUBCASE("Packets")
+    {
+        using pack = pack4<float>;
+        auto [t0, t1, mask] = quadratic_roots<pack>(pack(1), pack(0), pack(-1, -4, 0.5f, -9));
+
+        CHECK(mask[0]);
+        CHECK(mask[1]);
+        CHECK(!mask[2]);
+        CHECK(mask[3]);
+        CHECK(t0[1] == doctest::Approx(-2));
+        CHECK(t1[3] == doctest::Approx(3));
+    }
+}
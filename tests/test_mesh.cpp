@@ -0,0 +1,299 @@
+/**
+ *
+ * \file test_mesh.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/mesh.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    using vertex_list = std::vector<std::array<float, 3>>;
+    using triangle_list = std::vector<std::array<uint32_t, 3>>;
+
+    /// Box with outward facing triangles, appended to the given lists
+    void add_box(vertex_list& vertices, triangle_list& triangles, const std::array<float, 3>& lo, const std::array<float, 3>& hi)
+    {
+        const auto first = static_cast<uint32_t>(vertices.size());
+        for (int i = 0; i < 8; ++i)
+            vertices.push_back({ i & 1 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1], i & 4 ? hi[2] : lo[2] });
+
+        // Two triangles per face, counter clockwise seen from outside
+        const uint32_t faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+        for (const auto& f : faces) {
+            triangles.push_back({ first + f[0], first + f[1], first + f[2] });
+            triangles.push_back({ first + f[0], first + f[2], first + f[3] });
+        }
+    }
+
+    triangle_mesh<float> box_mesh(const std::array<float, 3>& lo, const std::array<float, 3>& hi)
+    {
+        vertex_list vertices;
+        triangle_list triangles;
+        add_box(vertices, triangles, lo, hi);
+        return triangle_mesh<float>(vertices, triangles);
+    }
+
+    /// Sphere of the given radius around the origin, as latitude longitude grid
+    triangle_mesh<float> sphere_mesh(float radius, uint32_t rings, uint32_t segments)
+    {
+        vertex_list vertices;
+        triangle_list triangles;
+
+        for (uint32_t i = 0; i <= rings; ++i) {
+            const float theta = static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(rings);
+            for (uint32_t j = 0; j < segments; ++j) {
+                const float phi = 2 * static_cast<float>(M_PI) * static_cast<float>(j) / static_cast<float>(segments);
+                vertices.push_back(
+                    { radius * std::sin(theta) * std::cos(phi), radius * std::sin(theta) * std::sin(phi), radius * std::cos(theta) });
+            }
+        }
+
+        auto at = [segments](uint32_t i, uint32_t j) { return i * segments + j % segments; };
+        for (uint32_t i = 0; i < rings; ++i) {
+            for (uint32_t j = 0; j < segments; ++j) {
+                if (i > 0)
+                    triangles.push_back({ at(i, j), at(i + 1, j), at(i, j + 1) });
+                if (i + 1 < rings)
+                    triangles.push_back({ at(i, j + 1), at(i + 1, j), at(i + 1, j + 1) });
+            }
+        }
+        return triangle_mesh<float>(vertices, triangles);
+    }
+
+    std::filesystem::path temp_dir()
+    {
+        auto dir = std::filesystem::temp_directory_path() / "tomosect_test_mesh";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+} // namespace
+
+TEST_CASE("Test ray triangle intersection")
+{
+    auto tri = details::prepare_triangle<float>({ 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 });
+
+    const float o[3] = { 0.25f, 0.25f, 0 };
+    const float up[3] = { 0, 0, 1 };
+    auto hit = details::intersect_triangle(o, up, tri);
+    CHECK(hit.mask);
+    CHECK(hit.t == doctest::Approx(1));
+    CHECK(!hit.entering); // The front side faces +z, a ray going up leaves through it
+
+    const float down[3] = { 0, 0, -1 };
+    CHECK(!details::intersect_triangle(o, down, tri).mask);
+
+    const float outside[3] = { 0.75f, 0.75f, 0 };
+    CHECK(!details::intersect_triangle(outside, up, tri).mask);
+}
+
+TEST_CASE("Test triangle mesh path lengths")
+{
+    auto box = box_mesh({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f });
+    CHECK(box.numTriangles() == 12);
+
+    SUBCASE("Box")
+    {
+        CHECK(box.pathLength(ray<float>(point3<float>(-2.f, 0.1f, 0.2f), vec3<float>(1, 0, 0))) == doctest::Approx(1));
+        CHECK(box.pathLength(ray<float>(point3<float>(-2.f, -2.f, 0.1f), vec3<float>(1, 1, 0))) == doctest::Approx(std::sqrt(2.f)));
+        CHECK(box.pathLength(ray<float>(point3<float>(-2.f, 2.f, 0.f), vec3<float>(1, 0, 0))) == 0);
+
+        // Starting inside only the part in front counts
+        CHECK(box.pathLength(ray<float>(point3<float>(0.2f, 0.1f, 0.f), vec3<float>(1, 0, 0))) == doctest::Approx(0.3f));
+
+        auto intervals = box.intervals(ray<float>(point3<float>(0.f, 0.1f, -3.f), vec3<float>(0, 0, 1)));
+        REQUIRE(intervals.size() == 1);
+        CHECK(intervals[0].tEnter == doctest::Approx(2.5f));
+        CHECK(intervals[0].tExit == doctest::Approx(3.5f));
+
+        auto inside = box.intervals(ray<float>(point3<float>(0.f, 0.1f, 0.f), vec3<float>(0, 0, 1)));
+        REQUIRE(inside.size() == 1);
+        CHECK(inside[0].tEnter == 0);
+        CHECK(inside[0].tExit == doctest::Approx(0.5f));
+    }
+
+    SUBCASE("Rays through edges and vertices")
+    {
+        // Along the diagonals of the faces the triangles meet
+        for (float offset : { -0.25f, 0.f, 0.25f }) {
+            CHECK(box.pathLength(ray<float>(point3<float>(offset, offset, -2.f), vec3<float>(0, 0, 1))) == doctest::Approx(1));
+            CHECK(box.crossings(ray<float>(point3<float>(offset, offset, -2.f), vec3<float>(0, 0, 1))).size() == 2);
+        }
+
+        // Through opposite corners
+        ray<float> diagonal(point3<float>(-1.f, -1.f, -1.f), vec3<float>(1, 1, 1));
+        CHECK(box.crossings(diagonal).size() == 2);
+        CHECK(box.pathLength(diagonal) == doctest::Approx(std::sqrt(3.f)));
+    }
+
+    SUBCASE("Several parts")
+    {
+        vertex_list vertices;
+        triangle_list triangles;
+        add_box(vertices, triangles, { 0, 0, 0 }, { 1, 1, 1 });
+        add_box(vertices, triangles, { 2, 0, 0 }, { 4, 1, 1 });
+        add_box(vertices, triangles, { 3, 0.25f, 0.25f }, { 5, 0.75f, 0.75f }); // Overlaps the second one
+        triangle_mesh<float> mesh(vertices, triangles);
+
+        ray<float> r(point3<float>(-1.f, 0.5f, 0.5f), vec3<float>(1, 0, 0));
+
+        auto crossings = mesh.crossings(r);
+        REQUIRE(crossings.size() == 6);
+        CHECK(std::is_sorted(crossings.begin(), crossings.end(), [](const auto& a, const auto& b) { return a.t < b.t; }));
+        CHECK(crossings[0].entering);
+        CHECK(!crossings[1].entering);
+
+        auto intervals = mesh.intervals(r);
+        REQUIRE(intervals.size() == 2);
+        CHECK(intervals[0].tEnter == doctest::Approx(1));
+        CHECK(intervals[0].tExit == doctest::Approx(2));
+        CHECK(intervals[1].tEnter == doctest::Approx(3));
+        CHECK(intervals[1].tExit == doctest::Approx(6));
+    }
+
+    SUBCASE("Sphere")
+    {
+        const float radius = 0.8f;
+        auto sphere = sphere_mesh(radius, 64, 128);
+
+        for (float offset : { 0.f, 0.2f, 0.5f, 0.7f }) {
+            ray<float> r(point3<float>(-3.f, offset, 0.05f), vec3<float>(1, 0, 0));
+            const float expected = 2 * std::sqrt(radius * radius - offset * offset - 0.05f * 0.05f);
+            CHECK(sphere.pathLength(r) == doctest::Approx(expected).epsilon(0.01));
+        }
+    }
+
+    SUBCASE("Invalid vertex index")
+    {
+        CHECK_THROWS_AS(triangle_mesh<float>(vertex_list{ { 0, 0, 0 } }, triangle_list{ { 0, 0, 1 } }), std::out_of_range);
+    }
+}
+
+TEST_CASE("Test triangle mesh packets")
+{
+    auto sphere = sphere_mesh(0.8f, 32, 64);
+
+    using Value = pack8<float>;
+    Value o[3], d[3];
+    std::vector<ray<float>> rays;
+    for (size_t lane = 0; lane < 8; ++lane) {
+        const float t = static_cast<float>(lane);
+        rays.push_back(rayFromPoints(point3<float>(-2.f, 0.1f * t, 0.3f), point3<float>(2.f, 0.05f * t, -0.2f)));
+        o[0][lane] = rays.back().origin().x();
+        o[1][lane] = rays.back().origin().y();
+        o[2][lane] = rays.back().origin().z();
+        d[0][lane] = rays.back().dir().x();
+        d[1][lane] = rays.back().dir().y();
+        d[2][lane] = rays.back().dir().z();
+    }
+    ray<Value> packet(point3<Value>(o[0], o[1], o[2]), vec3<Value>(d[0], d[1], d[2]), ray<Value>::ray_direction_normalized{});
+
+    auto lengths = sphere.pathLength(packet);
+    for (size_t lane = 0; lane < 8; ++lane) {
+        CHECK(lengths[lane] == doctest::Approx(sphere.pathLength(rays[lane])));
+
+        float sum = 0;
+        for (const auto& i : sphere.intervals(rays[lane]))
+            sum += i.tExit - i.tEnter;
+        CHECK(lengths[lane] == doctest::Approx(sum));
+    }
+}
+
+TEST_CASE("Test mesh projection")
+{
+    auto sphere = sphere_mesh(0.5f, 32, 64);
+
+    circular_trajectory<float> trajectory{ 1, 2.f, 1.f, 21, 13, 0.1f, 0.1f };
+    auto view = trajectory.view(0);
+
+    std::vector<float> projection(view.cols() * view.rows());
+    project_mesh(view, sphere, projection.data());
+
+    for (size_t row = 0; row < view.rows(); ++row)
+        for (size_t col = 0; col < view.cols(); ++col)
+            CHECK(projection[row * view.cols() + col] == doctest::Approx(sphere.pathLength(view.pixelRay(col, row))));
+
+    // The central ray goes straight through
+    CHECK(projection[6 * view.cols() + 10] == doctest::Approx(1).epsilon(0.01));
+}
+
+TEST_CASE("Test STL files")
+{
+    auto dir = temp_dir();
+    auto box = box_mesh({ 0, 0, 0 }, { 1, 2, 3 });
+    ray<float> r(point3<float>(0.5f, -1.f, 1.5f), vec3<float>(0, 1, 0));
+
+    SUBCASE("Binary round trip")
+    {
+        auto path = (dir / "box.stl").string();
+        save_stl(path, box);
+        CHECK(std::filesystem::file_size(path) == 84 + 50 * 12);
+
+        auto loaded = load_stl(path);
+        CHECK(loaded.numTriangles() == 12);
+        CHECK(loaded.pathLength(r) == doctest::Approx(2));
+    }
+
+    SUBCASE("ASCII with a flipped facet")
+    {
+        auto path = (dir / "box_ascii.stl").string();
+        {
+            std::ofstream out(path);
+            out << "solid box\n";
+            for (size_t i = 0; i < box.numTriangles(); ++i) {
+                auto tri = box.triangles()[i];
+                const auto& a = box.vertices()[tri[0]];
+                const auto& b = box.vertices()[tri[1]];
+                const auto& c = box.vertices()[tri[2]];
+                float n[3] = { (b[1] - a[1]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[1] - a[1]),
+                               (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]),
+                               (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) };
+
+                // The normal decides the orientation, the second facet is written the wrong way around
+                if (i == 1)
+                    std::swap(tri[1], tri[2]);
+
+                out << "  facet normal " << n[0] << " " << n[1] << " " << n[2] << "\n    outer loop\n";
+                for (uint32_t v : tri)
+                    out << "      vertex " << box.vertices()[v][0] << " " << box.vertices()[v][1] << " " << box.vertices()[v][2] << "\n";
+                out << "    endloop\n  endfacet\n";
+            }
+            out << "endsolid box\n";
+        }
+
+        auto loaded = load_stl(path);
+        CHECK(loaded.numTriangles() == 12);
+        CHECK(loaded.pathLength(r) == doctest::Approx(2));
+    }
+
+    SUBCASE("Invalid files")
+    {
+        auto path = (dir / "invalid.stl").string();
+        {
+            std::ofstream out(path);
+            out << "not an stl file";
+        }
+        CHECK_THROWS_AS(load_stl(path), std::runtime_error);
+
+        {
+            std::ofstream out(path);
+            out << "solid broken\nfacet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nendloop\nendfacet\n";
+        }
+        CHECK_THROWS_AS(load_stl(path), std::runtime_error);
+
+        CHECK_THROWS_AS(load_stl((dir / "missing.stl").string()), std::system_error);
+    }
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,227 @@
+/**
+ *
+ * \file test_monte_carlo.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/monte_carlo.hpp"
+
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    using FloatP = pack8<float>;
+
+    /// One material with energy independent coefficients
+    interaction_table<float> single_material(float photoelectric, float compton, float rayleigh)
+    {
+        auto table = [](float mu) { return material_table<float>({ "water" }, { 10.f, 150.f }, { { mu, mu } }); };
+        return interaction_table<float>(table(photoelectric), table(compton), table(rayleigh));
+    }
+
+    /// Ball of label 1 with the given radius in a 32^3 grid covering [-0.5, 0.5]^3
+    volume<uint8_t> ball_labels(float radius)
+    {
+        volume<uint8_t> labels(32, 32, 32);
+        labels.fill([radius](size_t x, size_t y, size_t z) -> uint8_t {
+            auto c = [](size_t i) { return (static_cast<float>(i) + 0.5f) / 32 - 0.5f; };
+            return c(x) * c(x) + c(y) * c(y) + c(z) * c(z) < radius * radius ? 1 : 0;
+        });
+        return labels;
+    }
+
+    voxel_grid<float> unit_grid() { return voxel_grid<float>(32, 32, 32, point3<float>(-0.5f), vec3<float>(1.f / 32)); }
+
+    projection_view<float> small_view() { return circular_trajectory<float>{ 1, 2.f, 1.f, 16, 16, 0.1f, 0.1f }.view(0); }
+
+    spectrum<float> monochromatic(float energy) { return spectrum<float>{ { energy }, { 1.f } }; }
+
+    /// Mean of the four center pixels
+    double center(const std::vector<double>& image)
+    {
+        return (image[7 * 16 + 7] + image[7 * 16 + 8] + image[8 * 16 + 7] + image[8 * 16 + 8]) / 4;
+    }
+
+    double total(const std::vector<double>& image) { return std::accumulate(image.begin(), image.end(), 0.0); }
+} // namespace
+
+TEST_CASE("Test scattering distributions")
+{
+    random_stream<FloatP> rng(1);
+
+    SUBCASE("Compton scattering follows the Compton formula")
+    {
+        const FloatP energy(100.f);
+        const float k = 100.f / static_cast<float>(electron_rest_energy);
+        for (int i = 0; i < 100; ++i) {
+            FloatP cosTheta, scattered;
+            details::sample_compton(energy, rng, cosTheta, scattered);
+            for (size_t lane = 0; lane < 8; ++lane) {
+                CHECK(cosTheta[lane] >= -1.0001f);
+                CHECK(cosTheta[lane] <= 1.0001f);
+                CHECK(scattered[lane] >= 100.f / (1 + 2 * k) * 0.999f);
+                CHECK(scattered[lane] <= 100.f * 1.001f);
+                CHECK(scattered[lane] == doctest::Approx(100.f / (1 + k * (1 - cosTheta[lane]))).epsilon(1e-4));
+            }
+        }
+    }
+    SUBCASE("Low energy Compton and Rayleigh scattering approach Thomson scattering")
+    {
+        // E[cos] = 0 and E[cos^2] = 2/5 for the phase function (1 + cos^2) / 2
+        double compton[2] = { 0, 0 }, rayleigh[2] = { 0, 0 };
+        const int n = 20000;
+        for (int i = 0; i < n; ++i) {
+            FloatP cosTheta, scattered;
+            details::sample_compton(FloatP(0.5f), rng, cosTheta, scattered);
+            FloatP mu = details::sample_rayleigh(rng);
+            for (size_t lane = 0; lane < 8; ++lane) {
+                compton[0] += cosTheta[lane];
+                compton[1] += cosTheta[lane] * cosTheta[lane];
+                rayleigh[0] += mu[lane];
+                rayleigh[1] += mu[lane] * mu[lane];
+            }
+        }
+        CHECK(std::abs(compton[0] / (8 * n)) < 0.01);
+        CHECK(std::abs(rayleigh[0] / (8 * n)) < 0.01);
+        CHECK(compton[1] / (8 * n) == doctest::Approx(0.4).epsilon(0.02));
+        CHECK(rayleigh[1] / (8 * n) == doctest::Approx(0.4).epsilon(0.02));
+    }
+    SUBCASE("Directions are turned by the scattering angle")
+    {
+        using Direction = std::array<float, 3>;
+        for (auto d0 : { Direction{ 0.6f, 0.f, 0.8f }, Direction{ 0.f, 0.f, -1.f }, Direction{ 0.f, 1.f, 0.f } }) {
+            FloatP d[3] = { FloatP(d0[0]), FloatP(d0[1]), FloatP(d0[2]) };
+            const FloatP cosTheta = enoki::linspace<FloatP>(-0.9f, 0.95f);
+            details::rotate_direction(d, cosTheta, rng.uniform() * 6.f);
+
+            const FloatP length = enoki::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            const FloatP turned = d[0] * d0[0] + d[1] * d0[1] + d[2] * d0[2];
+            for (size_t lane = 0; lane < 8; ++lane) {
+                CHECK(length[lane] == doctest::Approx(1).epsilon(1e-4));
+                CHECK(turned[lane] == doctest::Approx(cosTheta[lane]).epsilon(1e-3));
+            }
+        }
+    }
+}
+
+TEST_CASE("Test interaction table")
+{
+    material_table<float> photo({ "water", "bone" }, { 20.f, 60.f, 100.f }, { { 0.5f, 0.1f, 0.05f }, { 4.f, 0.6f, 0.2f } });
+    material_table<float> compton({ "water", "bone" }, { 20.f, 100.f }, { { 0.2f, 0.17f }, { 0.35f, 0.3f } });
+    material_table<float> rayleigh({ "water", "bone" }, { 20.f, 100.f }, { { 0.05f, 0.01f }, { 0.1f, 0.02f } });
+    interaction_table<float> table(photo, compton, rayleigh, 1.f);
+
+    CHECK(table.numMaterials() == 2);
+    CHECK(table.minEnergy() == 20.f);
+
+    const FloatP energy = enoki::linspace<FloatP>(15.f, 120.f);
+    FloatP totalWater, comptonWater, rayleighWater, totalBone, comptonBone, rayleighBone, totalVacuum, c, r;
+    table.lookup(bvh_index_t<FloatP>(1), energy, totalWater, comptonWater, rayleighWater);
+    table.lookup(bvh_index_t<FloatP>(2), energy, totalBone, comptonBone, rayleighBone);
+    table.lookup(bvh_index_t<FloatP>(0), energy, totalVacuum, c, r);
+    const FloatP majorant = table.majorant(energy);
+
+    for (size_t lane = 0; lane < 8; ++lane) {
+        const float e = energy[lane];
+        const float total = photo.attenuation(0, e) + compton.attenuation(0, e) + rayleigh.attenuation(0, e);
+        CHECK(totalWater[lane] == doctest::Approx(total).epsilon(1e-3));
+        CHECK(comptonBone[lane] == doctest::Approx(compton.attenuation(1, e)).epsilon(1e-3));
+        CHECK(rayleighWater[lane] == doctest::Approx(rayleigh.attenuation(0, e)).epsilon(1e-3));
+        CHECK(totalBone[lane] == doctest::Approx(table.total(1, e)));
+        CHECK(totalVacuum[lane] == 0.f);
+        CHECK(majorant[lane] >= totalBone[lane] * 0.9999f);
+        CHECK(majorant[lane] >= totalWater[lane] * 0.9999f);
+    }
+
+    material_table<float> other({ "air", "bone" }, { 20.f, 100.f }, { { 0.f, 0.f }, { 0.3f, 0.2f } });
+    CHECK_THROWS_AS(interaction_table<float>(photo, other, rayleigh), std::invalid_argument);
+}
+
+TEST_CASE("Test scatter simulation")
+{
+    const auto view = small_view();
+    const auto grid = unit_grid();
+
+    SUBCASE("Without an object everything is primary")
+    {
+        volume<uint8_t> empty(32, 32, 32);
+        auto materials = single_material(2.f, 0.f, 0.f);
+        auto tally = simulate_scatter(view, grid, empty, materials, monochromatic(60.f), 40000);
+
+        CHECK(tally.photons == 40000);
+        CHECK(total(tally.scatter) == 0.0);
+
+        // Every photon arrives with the cos^3 weight of its direction
+        double weight = 0;
+        for (size_t row = 0; row < 16; ++row) {
+            for (size_t col = 0; col < 16; ++col) {
+                auto d = view.pixelRay(col, row).dir();
+                auto n = view.detector.normal();
+                double c = std::abs(d.x() * n.x() + d.y() * n.y() + d.z() * n.z());
+                weight += c * c * c / 256;
+            }
+        }
+        CHECK(total(tally.primary) / 40000 == doctest::Approx(60 * weight).epsilon(0.01));
+    }
+    SUBCASE("Absorption alone attenuates the primary beam")
+    {
+        volume<uint8_t> empty(32, 32, 32);
+        auto labels = ball_labels(0.3f);
+        auto materials = single_material(2.f, 0.f, 0.f);
+
+        auto flat = simulate_scatter(view, grid, empty, materials, monochromatic(60.f), 400000);
+        auto tally = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 400000);
+
+        CHECK(total(tally.scatter) == 0.0);
+        CHECK(center(tally.primary) / center(flat.primary) == doctest::Approx(std::exp(-2.f * 0.6f)).epsilon(0.1));
+    }
+    SUBCASE("Scattering ball")
+    {
+        auto labels = ball_labels(0.3f);
+        auto materials = single_material(0.5f, 1.5f, 0.2f);
+        auto tally = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 200000);
+
+        // About a quarter of the photons pass the ball, a third of them scatter and a fifth of those hit the detector
+        CHECK(total(tally.scatter) > 0.01 * total(tally.primary));
+        CHECK(total(tally.scatter) < 0.03 * total(tally.primary));
+
+        scatter_options options;
+        options.numThreads = 1;
+        auto serial = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 200000, options);
+        options.numThreads = 3;
+        auto threaded = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 200000, options);
+        auto repeated = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 200000, options);
+
+        // The same photons for any number of threads, only the order of the sums differs
+        for (size_t i = 0; i < 256; ++i) {
+            CHECK(threaded.primary[i] == repeated.primary[i]);
+            CHECK(threaded.scatter[i] == repeated.scatter[i]);
+            CHECK(serial.primary[i] == doctest::Approx(threaded.primary[i]).epsilon(1e-9));
+            CHECK(serial.scatter[i] == doctest::Approx(threaded.scatter[i]).epsilon(1e-9));
+        }
+
+        // A different seed gives different photons
+        options.seed = 7;
+        auto reseeded = simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 200000, options);
+        CHECK(total(reseeded.scatter) != total(serial.scatter));
+        CHECK(total(reseeded.scatter) == doctest::Approx(total(serial.scatter)).epsilon(0.05));
+    }
+    SUBCASE("Invalid input")
+    {
+        auto materials = single_material(2.f, 0.f, 0.f);
+        volume<uint8_t> labels(32, 32, 32);
+        labels(3, 4, 5) = 2;
+        CHECK_THROWS_AS(simulate_scatter(view, grid, labels, materials, monochromatic(60.f), 100), std::out_of_range);
+
+        volume<uint8_t> small(16, 16, 16);
+        CHECK_THROWS_AS(simulate_scatter(view, grid, small, materials, monochromatic(60.f), 100), std::invalid_argument);
+    }
+}
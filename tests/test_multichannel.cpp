@@ -0,0 +1,130 @@
+/**
+ *
+ * \file test_multichannel.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/multichannel.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    /// Value of channel c at a voxel, different pattern per channel
+    float channel_value(size_t x, size_t y, size_t z, size_t c)
+    {
+        return static_cast<float>((x + 2 * y + 3 * z + 5 * c) % 7) + static_cast<float>(c);
+    }
+
+    template <volume_layout Layout>
+    multichannel_volume<float, 3, Layout> make_volume(size_t n)
+    {
+        multichannel_volume<float, 3, Layout> vol(n, n, n);
+        vol.fill([](size_t x, size_t y, size_t z) {
+            return std::array<float, 3>{ channel_value(x, y, z, 0), channel_value(x, y, z, 1), channel_value(x, y, z, 2) };
+        });
+        return vol;
+    }
+
+    volume<float> channel_volume(size_t n, size_t c)
+    {
+        volume<float> vol(n, n, n);
+        vol.fill([c](size_t x, size_t y, size_t z) { return channel_value(x, y, z, c); });
+        return vol;
+    }
+} // namespace
+
+TEST_CASE("Test multi-channel forward projection")
+{
+    auto grid = voxel_grid<float>(10, 10, 10, point3<float>(-1.f), vec3<float>(0.2f));
+    auto linear = make_volume<volume_layout::linear>(10);
+    auto bricked = make_volume<volume_layout::bricked>(10);
+    std::vector<volume<float>> separate = { channel_volume(10, 0), channel_volume(10, 1), channel_volume(10, 2) };
+
+    SUBCASE("Every channel matches the single channel projector")
+    {
+        for (auto r : { ray<float>(point3<float>(-2.f, 0.1f, 0.3f), vec3<float>(1.f, 0.2f, -0.1f)),
+                        ray<float>(point3<float>(0.3f, -3.f, -0.7f), vec3<float>(-0.3f, 1.f, 0.4f)),
+                        ray<float>(point3<float>(0.5f, 0.5f, 2.f), vec3<float>(0.f, 0.f, -1.f)) }) {
+            auto sums = project_channels(r, grid, linear);
+            auto bricks = project_channels(r, grid, bricked);
+            for (size_t c = 0; c < 3; ++c) {
+                CHECK(sums[c] == doctest::Approx(project(r, grid, separate[c])));
+                CHECK(bricks[c] == doctest::Approx(sums[c]));
+            }
+        }
+    }
+    SUBCASE("Missing rays are zero")
+    {
+        auto sums = project_channels(ray<float>(point3<float>(-2.f, 3.f, 0.f), vec3<float>(1.f, 0.f, 0.f)), grid, linear);
+        for (size_t c = 0; c < 3; ++c)
+            CHECK(sums[c] == 0.f);
+    }
+    SUBCASE("Views are written as one image per channel")
+    {
+        circular_trajectory<float> trajectory{ 4, 3.f, 1.f, 12, 8, 0.3f, 0.3f };
+        auto view = trajectory.view(1);
+
+        std::vector<float> out(3 * 12 * 8, -1.f);
+        project_channels(view, grid, linear, out.data());
+
+        for (size_t c = 0; c < 3; ++c)
+            for (size_t row = 0; row < 8; row += 3)
+                for (size_t col = 0; col < 12; col += 5)
+                    CHECK(out[c * 96 + row * 12 + col] == doctest::Approx(project(view.pixelRay(col, row), grid, separate[c])));
+    }
+}
+
+TEST_CASE("Test multi-channel FDK")
+{
+    circular_trajectory<float> trajectory{ 60, 2.f, 1.f, 32, 32, 0.06f, 0.06f };
+    auto grid = voxel_grid<float>(16, 16, 12, point3<float>(-0.48f, -0.48f, -0.36f), vec3<float>(0.06f));
+
+    // Two channels with different contents, projected with the multi-channel projector
+    multichannel_volume<float, 2> phantom(16, 16, 12);
+    phantom.fill([](size_t x, size_t y, size_t z) {
+        const float cx = static_cast<float>(x) - 7.5f, cy = static_cast<float>(y) - 7.5f, cz = static_cast<float>(z) - 5.5f;
+        const float r = std::sqrt(cx * cx + cy * cy + cz * cz);
+        return std::array<float, 2>{ r < 5 ? 1.f : 0.f, r < 3 ? 2.f : 0.f };
+    });
+
+    // Copies of a stack share the storage, so every channel gets its own
+    std::vector<projection_stack<float>> channels;
+    for (size_t c = 0; c < 2; ++c)
+        channels.emplace_back(32, 32, 60);
+    std::vector<float> image(2 * 32 * 32);
+    for (size_t k = 0; k < 60; ++k) {
+        project_channels(trajectory.view(k), grid, phantom, image.data());
+        for (size_t c = 0; c < 2; ++c)
+            std::copy(image.begin() + c * 1024, image.begin() + (c + 1) * 1024, channels[c].view(k));
+    }
+
+    auto result = fdk_channels<2>(trajectory, channels, grid);
+
+    SUBCASE("Every channel matches the single channel reconstruction")
+    {
+        for (size_t c = 0; c < 2; ++c) {
+            auto reference = fdk(trajectory, channels[c], grid);
+            for (size_t z = 0; z < 12; z += 3)
+                for (size_t y = 0; y < 16; ++y)
+                    for (size_t x = 0; x < 16; ++x)
+                        CHECK(result(x, y, z)[c] == doctest::Approx(reference(x, y, z)).epsilon(1e-4));
+        }
+    }
+    SUBCASE("Both channels are reconstructed")
+    {
+        CHECK(result(8, 8, 6)[0] == doctest::Approx(1).epsilon(0.15));
+        CHECK(result(8, 8, 6)[1] == doctest::Approx(2).epsilon(0.15));
+        CHECK(std::abs(result(12, 8, 6)[1]) < 0.3f);
+    }
+    SUBCASE("The number of stacks has to match")
+    {
+        CHECK_THROWS_AS(fdk_channels<3>(trajectory, channels, grid), std::invalid_argument);
+    }
+}
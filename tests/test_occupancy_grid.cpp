@@ -0,0 +1,112 @@
+/**
+ *
+ * \file test_occupancy_grid.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/occupancy_grid.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    /// Ball of radius 0.3 with a ramp inside, centered in the unit cube
+    volume<float> ball_volume(size_t n)
+    {
+        volume<float> vol(n, n, n);
+        vol.fill([n](size_t x, size_t y, size_t z) {
+            auto c = [n](size_t i) { return (static_cast<float>(i) + 0.5f) / static_cast<float>(n) - 0.5f; };
+            float r2 = c(x) * c(x) + c(y) * c(y) + c(z) * c(z);
+            return r2 < 0.09f ? 1.f + c(x) : 0.f;
+        });
+        return vol;
+    }
+} // namespace
+
+TEST_CASE("Test occupancy grid")
+{
+    const size_t n = 30;
+    auto grid = voxel_grid<float>(n, n, n, point3<float>(-0.5f), vec3<float>(1.f / n));
+    auto vol = ball_volume(n);
+
+    occupancy_grid<float> occupancy(grid, vol, 8);
+
+    SUBCASE("Bricks")
+    {
+        CHECK(occupancy.nx() == 4);
+        CHECK(occupancy.bricks() == 64);
+
+        // Last brick only has 6 voxels per axis
+        auto last = occupancy.brickVoxels(3, 3, 3);
+        CHECK(last.xBegin == 24);
+        CHECK(last.xEnd == 30);
+        CHECK(occupancy.brickBounds(3, 3, 3).max().x() == doctest::Approx(0.5f));
+
+        // Corners are empty, the center is not
+        CHECK_FALSE(occupancy.occupied(0, 0, 0));
+        CHECK(occupancy.occupied(1, 1, 1));
+        CHECK(occupancy.max(1, 2, 1) > 1.f);
+        CHECK(occupancy.min(0, 0, 0) == 0.f);
+        CHECK(occupancy.occupancy() < 1.0);
+        CHECK(occupancy.occupancy() > 0.0);
+    }
+
+    SUBCASE("Projection skipping empty bricks")
+    {
+        std::vector<ray<float>> rays = { rayFromPoints(point3<float>(-1, -0.8f, -0.7f), point3<float>(1, 0.9f, 0.6f)),
+                                         rayFromPoints(point3<float>(-1, 0.1f, 0.05f), point3<float>(1, 0.1f, 0.05f)),
+                                         rayFromPoints(point3<float>(0.05f, 2, -0.1f), point3<float>(0.05f, -2, 0.2f)),
+                                         rayFromPoints(point3<float>(-1, 0.45f, 0.45f), point3<float>(1, 0.45f, 0.45f)),
+                                         rayFromPoints(point3<float>(0.3f, -0.2f, 2), point3<float>(-0.1f, 0.1f, -2)) };
+
+        for (const auto& r : rays)
+            CHECK(project(r, grid, vol, occupancy) == doctest::Approx(project(r, grid, vol)).epsilon(1e-5));
+
+        // Visited voxels are a subset, in the same order
+        auto r = rays[0];
+        std::vector<size_t> all, skipped;
+        traverse(r, grid, [&](size_t i, float) { all.push_back(i); });
+        traverse_occupied(r, grid, occupancy, [&](size_t x, size_t y, size_t z, float) { skipped.push_back(grid.index(x, y, z)); });
+
+        CHECK(skipped.size() < all.size());
+        size_t j = 0;
+        for (size_t i = 0; i < all.size() && j < skipped.size(); ++i)
+            if (all[i] == skipped[j])
+                ++j;
+        CHECK(j == skipped.size());
+    }
+
+    SUBCASE("Incremental update")
+    {
+        CHECK(occupancy.update(vol) == 0);
+
+        vol(2, 2, 2) = 5.f;
+        occupancy.invalidate(voxel_box{ 2, 3, 2, 3, 2, 3 });
+        CHECK(occupancy.update(vol) == 1);
+        CHECK(occupancy.occupied(0, 0, 0));
+        CHECK(occupancy.max(0, 0, 0) == 5.f);
+
+        // A box across brick boundaries
+        occupancy.invalidate(voxel_box{ 7, 9, 0, 1, 15, 17 });
+        CHECK(occupancy.update(vol) == 4);
+
+        occupancy.invalidate();
+        CHECK(occupancy.update(vol) == 64);
+
+        auto r = rayFromPoints(point3<float>(-1, -0.9f, -0.9f), point3<float>(1, 0.9f, 0.9f));
+        CHECK(project(r, grid, vol, occupancy) == doctest::Approx(project(r, grid, vol)).epsilon(1e-5));
+    }
+
+    SUBCASE("Threshold")
+    {
+        occupancy_grid<float> coarse(grid, vol, 8, 10.f);
+        CHECK(coarse.occupancy() == 0.0);
+    }
+}
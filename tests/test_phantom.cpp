@@ -0,0 +1,118 @@
+/**
+ *
+ * \file test_phantom.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/phantom.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test analytic phantom")
+{
+    analytic_phantom<float> phantom;
+    CHECK(phantom.empty());
+
+    phantom.add(ellipsoid<float>({ 0, 0, 0 }, { 0.8f, 0.8f, 0.8f }), 1.f);
+    phantom.add(ellipsoid<float>({ 0.2f, 0, 0 }, { 0.2f, 0.2f, 0.2f }), -0.5f);
+    phantom.add(cylinder<float>({ -0.4f, 0, 0 }, { 0.1f, 0.1f, 0.5f }), 2.f);
+    CHECK(phantom.size() == 3);
+
+    SUBCASE("Line integrals")
+    {
+        // 1.6 through the big sphere, minus 0.5 * 0.4 through the small one, plus 2 * 0.2 through the cylinder
+        ray<float> r(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0));
+        CHECK(phantom.lineIntegral(r) == doctest::Approx(1.6f - 0.2f + 0.4f));
+
+        // Along the cylinder axis: 1 for its length, and the part of it inside the sphere
+        ray<float> axis(point3<float>(-0.4f, 0, -2), vec3<float>(0, 0, 1));
+        CHECK(phantom.lineIntegral(axis) == doctest::Approx(2 * 1.f + 2 * std::sqrt(0.64f - 0.16f)));
+
+        CHECK(phantom.lineIntegral(ray<float>(point3<float>(-2, 0.9f, 0), vec3<float>(1, 0, 0))) == 0);
+    }
+
+    SUBCASE("Values")
+    {
+        CHECK(phantom.value({ -0.1f, 0.3f, 0 }) == doctest::Approx(1));
+        CHECK(phantom.value({ 0.2f, 0, 0 }) == doctest::Approx(0.5));
+        CHECK(phantom.value({ -0.4f, 0, 0.45f }) == doctest::Approx(3));
+        CHECK(phantom.value({ -0.4f, 0, 0.7f }) == doctest::Approx(0));
+    }
+}
+
+TEST_CASE("Test phantom with csg objects")
+{
+    // Tube around the z axis, inside a sphere
+    csg_tree<float> tube;
+    const auto outer = tube.add(cylinder<float>({ 0, 0, 0 }, { 0.3f, 0.3f, 0.5f }));
+    tube.subtract(outer, tube.add(cylinder<float>({ 0, 0, 0 }, { 0.2f, 0.2f, 0.6f })));
+
+    analytic_phantom<float> phantom;
+    phantom.add(ellipsoid<float>({ 0, 0, 0 }, { 0.8f, 0.8f, 0.8f }), 1.f);
+    phantom.add(tube, 2.f);
+    CHECK(phantom.size() == 2);
+
+    ray<float> r(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0));
+    CHECK(phantom.lineIntegral(r) == doctest::Approx(1.6f + 2 * 0.2f));
+    CHECK(phantom.value({ 0.25f, 0, 0 }) == doctest::Approx(3));
+    CHECK(phantom.value({ 0, 0, 0 }) == doctest::Approx(1));
+}
+
+TEST_CASE("Test Shepp-Logan phantom")
+{
+    auto phantom = shepp_logan_phantom<float>();
+    CHECK(phantom.size() == 10);
+
+    // Skull and brain, and one of the ventricles
+    CHECK(phantom.value({ 0, 0.9f, 0 }) == doctest::Approx(1));
+    CHECK(phantom.value({ 0, 0, 0 }) == doctest::Approx(0.2));
+    CHECK(phantom.value({ 0.22f, 0, 0 }) == doctest::Approx(0));
+    CHECK(phantom.value({ 0, 0, 0.95f }) == 0);
+
+    SUBCASE("Line integrals match numerical integration")
+    {
+        std::mt19937 gen(3);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        for (int i = 0; i < 20; ++i) {
+            point3<float> origin(2.f, 0.6f * dist(gen), 0.6f * dist(gen));
+            point3<float> target(-2.f, 0.6f * dist(gen), 0.6f * dist(gen));
+            auto r = rayFromPoints(origin, target);
+
+            constexpr int samples = 20000;
+            const float length = std::sqrt(16.f + 1.44f * 2);
+            const float step = length / samples;
+            float sum = 0;
+            for (int s = 0; s < samples; ++s) {
+                const float t = (static_cast<float>(s) + 0.5f) * step;
+                const auto p = r.origin() + t * r.dir();
+                sum += phantom.value({ p.x(), p.y(), p.z() });
+            }
+
+            CHECK(phantom.lineIntegral(r) == doctest::Approx(sum * step).epsilon(0.005));
+        }
+    }
+
+    SUBCASE("Projection of a view")
+    {
+        circular_trajectory<float> trajectory{ 4, 3.f, 1.5f, 37, 21, 0.1f, 0.1f };
+        auto view = trajectory.view(1);
+
+        std::vector<float> image(view.cols() * view.rows(), -1.f);
+        project_phantom(view, phantom, image.data());
+
+        for (size_t row = 0; row < view.rows(); ++row)
+            for (size_t col = 0; col < view.cols(); ++col)
+                CHECK(image[row * view.cols() + col] == doctest::Approx(phantom.lineIntegral(view.pixelRay(col, row))));
+
+        // The center pixel goes straight through the phantom
+        CHECK(image[10 * view.cols() + 18] > 0.3f);
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ *
+ * \file test_pipeline.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/pipeline.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+using namespace tomosect;
+
+namespace
+{
+    circular_trajectory<float> small_trajectory() { return circular_trajectory<float>{ 36, 2.f, 1.f, 32, 24, 0.05f, 0.05f }; }
+
+    projection_stack<float> smooth_projections(const circular_trajectory<float>& trajectory)
+    {
+        projection_stack<float> stack(trajectory.cols, trajectory.rows, trajectory.numViews);
+        for (size_t k = 0; k < trajectory.numViews; ++k)
+            for (size_t row = 0; row < trajectory.rows; ++row)
+                for (size_t col = 0; col < trajectory.cols; ++col)
+                    stack(col, row, k) =
+                        std::sin(0.3f * static_cast<float>(col) + 0.1f * static_cast<float>(k)) + 0.05f * static_cast<float>(row);
+        return stack;
+    }
+} // namespace
+
+TEST_CASE("Test pipelined FDK")
+{
+    auto trajectory = small_trajectory();
+    auto grid = voxel_grid<float>(16, 16, 8, point3<float>(-0.4f, -0.4f, -0.2f), vec3<float>(0.05f));
+    auto projections = smooth_projections(trajectory);
+
+    auto reference = fdk(trajectory, projections, grid);
+
+    SUBCASE("Same result as in memory reconstruction")
+    {
+        for (size_t batch : { 1, 3, 8 }) {
+            pipeline_options options;
+            options.queueDepth = 2;
+            options.batchSize = batch;
+            options.filterThreads = 2;
+
+            auto result = fdk_pipelined(trajectory, projections, grid, options);
+
+            float maxDiff = 0;
+            for (size_t i = 0; i < reference.size(); ++i)
+                maxDiff = std::max(maxDiff, std::abs(result.data()[i] - reference.data()[i]));
+            CHECK(maxDiff < 1e-5f);
+        }
+    }
+
+    SUBCASE("Loader only sees the buffer pool")
+    {
+        pipeline_options options;
+        options.queueDepth = 3;
+
+        std::set<float*> buffers;
+        size_t loaded = 0;
+        auto load = [&](size_t k, float* dst) {
+            CHECK(k == loaded++);
+            buffers.insert(dst);
+            std::copy(projections.view(k), projections.view(k) + projections.pixelsPerView(), dst);
+        };
+
+        auto result = fdk_pipelined(trajectory, load, grid, options);
+
+        CHECK(loaded == trajectory.numViews);
+        CHECK(buffers.size() <= options.queueDepth);
+        const size_t center = grid.nx() * grid.ny() * 4 + grid.nx() * 8 + 8;
+        CHECK(result.data()[center] == doctest::Approx(reference.data()[center]));
+    }
+
+    SUBCASE("Errors are propagated")
+    {
+        auto load = [&](size_t k, float*) {
+            if (k == 10)
+                throw std::runtime_error("read failed");
+        };
+
+        CHECK_THROWS_AS(fdk_pipelined(trajectory, load, grid), std::runtime_error);
+    }
+
+    SUBCASE("Mismatching projections")
+    {
+        projection_stack<float> wrong(trajectory.cols, trajectory.rows, trajectory.numViews - 1);
+        CHECK_THROWS_AS(fdk_pipelined(trajectory, wrong, grid), std::invalid_argument);
+    }
+}
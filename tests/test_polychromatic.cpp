@@ -0,0 +1,192 @@
+/**
+ *
+ * \file test_polychromatic.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/polychromatic.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    std::filesystem::path temp_dir()
+    {
+        auto dir = std::filesystem::temp_directory_path() / "tomosect_test_polychromatic";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    std::string write_file(const std::filesystem::path& path, const std::string& content)
+    {
+        std::ofstream(path) << content;
+        return path.string();
+    }
+
+    /// Spectrum over 20 to 120 keV and two materials, attenuation falling with energy
+    polychromatic_model<float> make_model(size_t bins)
+    {
+        spectrum<float> source;
+        for (size_t e = 0; e < bins; ++e) {
+            const float energy = 20.f + 100.f * static_cast<float>(e) / static_cast<float>(bins);
+            source.energies.push_back(energy);
+            source.weights.push_back(energy * (120.f - energy));
+        }
+
+        material_table<float> materials({ "water", "bone" }, { 20.f, 60.f, 120.f }, { { 0.08f, 0.02f, 0.016f }, { 0.6f, 0.06f, 0.03f } });
+        return polychromatic_model<float>(source, materials);
+    }
+} // namespace
+
+TEST_CASE("Test spectrum and material files")
+{
+    auto dir = temp_dir();
+
+    SUBCASE("Spectrum")
+    {
+        auto path = write_file(dir / "spectrum.csv", "# tube at 120 kV\nenergy, counts\n20, 10\n40, 30 # peak\n\n60, 5\n");
+        auto s = load_spectrum(path);
+
+        REQUIRE(s.size() == 3);
+        CHECK(s.energies[1] == 40);
+        CHECK(s.weights[1] == 30);
+    }
+
+    SUBCASE("Materials")
+    {
+        auto path = write_file(dir / "materials.csv", "energy,water,bone\n20,0.08,0.6\n60,0.02,0.06\n120,0.016,0.03\n");
+        auto m = load_materials(path);
+
+        REQUIRE(m.numMaterials() == 2);
+        CHECK(m.names()[1] == "bone");
+        CHECK(m.index("water") == 0);
+        CHECK_THROWS_AS(m.index("lead"), std::out_of_range);
+
+        // Interpolated in between, clamped outside
+        CHECK(m.attenuation(0, 40) == doctest::Approx(0.05));
+        CHECK(m.attenuation(1, 90) == doctest::Approx(0.045));
+        CHECK(m.attenuation(1, 10) == doctest::Approx(0.6));
+        CHECK(m.attenuation(1, 150) == doctest::Approx(0.03));
+    }
+
+    SUBCASE("Invalid files")
+    {
+        CHECK_THROWS_AS(load_spectrum((dir / "missing.csv").string()), std::system_error);
+        CHECK_THROWS_AS(load_spectrum(write_file(dir / "a.csv", "20, 1\n40, x\n")), std::runtime_error);
+        CHECK_THROWS_AS(load_spectrum(write_file(dir / "b.csv", "20, 1\n40, 2, 3\n")), std::runtime_error);
+        CHECK_THROWS_AS(load_spectrum(write_file(dir / "c.csv", "40, 1\n20, 2\n")), std::runtime_error);
+        CHECK_THROWS_AS(load_spectrum(write_file(dir / "d.csv", "# nothing\n")), std::runtime_error);
+        CHECK_THROWS_AS(load_spectrum(write_file(dir / "e.csv", "")), std::runtime_error);
+        CHECK_THROWS_AS(load_materials(write_file(dir / "f.csv", "20, 1\n40, 2\n")), std::runtime_error);
+    }
+}
+
+TEST_CASE("Test polychromatic model")
+{
+    SUBCASE("Single energy is monochromatic")
+    {
+        spectrum<float> source{ { 60.f }, { 100.f } };
+        material_table<float> materials({ "water" }, { 20.f, 100.f }, { { 0.1f, 0.02f } });
+        polychromatic_model<float> model(source, materials);
+
+        const float length = 10.f;
+        CHECK(model.intensity(&length) == doctest::Approx(100 * std::exp(-0.6f)));
+        CHECK(model.projection(&length) == doctest::Approx(0.6));
+    }
+
+    for (size_t bins : { size_t{ 1 }, size_t{ 8 }, size_t{ 37 }, size_t{ 150 } }) {
+        auto model = make_model(bins);
+        CHECK(model.numBins() == bins);
+
+        const float lengths[2] = { 12.f, 1.5f };
+        double expected = 0, flat = 0;
+        for (size_t e = 0; e < bins; ++e) {
+            const float energy = 20.f + 100.f * static_cast<float>(e) / static_cast<float>(bins);
+            const double weight = energy * (120.f - energy);
+            expected += weight * std::exp(-(model.attenuation(0, e) * lengths[0] + model.attenuation(1, e) * lengths[1]));
+            flat += weight;
+        }
+
+        CHECK(model.flatField() == doctest::Approx(flat));
+        CHECK(model.intensity(lengths) == doctest::Approx(expected).epsilon(1e-4));
+
+        const float none[2] = { 0, 0 };
+        CHECK(model.projection(none) == 0);
+    }
+
+    SUBCASE("Beam hardening")
+    {
+        // The effective attenuation drops with the length, as the soft part of the spectrum is absorbed first
+        auto model = make_model(64);
+        float previous = INFINITY;
+        for (float length : { 1.f, 5.f, 20.f, 50.f }) {
+            const float lengths[2] = { length, 0 };
+            const float effective = model.projection(lengths) / length;
+            CHECK(effective < previous);
+            previous = effective;
+        }
+    }
+
+    SUBCASE("Invalid models")
+    {
+        spectrum<float> source{ { 60.f, 80.f }, { 1.f } };
+        material_table<float> materials({ "water" }, { 20.f }, { { 0.1f } });
+        CHECK_THROWS_AS(polychromatic_model<float>(source, materials), std::invalid_argument);
+
+        // The flat field would be zero
+        spectrum<float> dark{ { 60.f, 80.f }, { 0.f, 0.f } };
+        CHECK_THROWS_AS(polychromatic_model<float>(dark, materials), std::invalid_argument);
+
+        CHECK_THROWS_AS(material_table<float>({ "water" }, { 20.f, 30.f }, { { 0.1f } }), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Test polychromatic projection")
+{
+    auto model = make_model(40);
+
+    // Water cube with a bone slab through its middle, in a grid of 16^3 voxels of size 1/16
+    const size_t n = 16;
+    voxel_grid<float> grid(n, n, n, point3<float>(-0.5f), vec3<float>(1.f / n));
+    volume<uint8_t> labels(n, n, n);
+    labels.fill([](size_t x, size_t, size_t) -> uint8_t { return x >= 7 && x < 9 ? 2 : 1; });
+
+    SUBCASE("Path lengths")
+    {
+        float lengths[2] = { 0, 0 };
+        material_path_lengths(ray<float>(point3<float>(-2, 0.01f, 0.02f), vec3<float>(1, 0, 0)), grid, labels, 2, lengths);
+        CHECK(lengths[0] == doctest::Approx(14.f / 16));
+        CHECK(lengths[1] == doctest::Approx(2.f / 16));
+
+        CHECK_THROWS_AS(material_path_lengths(ray<float>(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0)), grid, labels, 1, lengths),
+                        std::out_of_range);
+    }
+
+    SUBCASE("View")
+    {
+        circular_trajectory<float> trajectory{ 4, 3.f, 1.5f, 24, 16, 0.1f, 0.1f };
+        auto view = trajectory.view(1);
+
+        std::vector<float> image(view.cols() * view.rows(), -1.f);
+        project_polychromatic(view, grid, labels, model, image.data());
+
+        for (size_t row = 0; row < view.rows(); ++row) {
+            for (size_t col = 0; col < view.cols(); ++col) {
+                float lengths[2] = { 0, 0 };
+                material_path_lengths(view.pixelRay(col, row), grid, labels, 2, lengths);
+                CHECK(image[row * view.cols() + col] == doctest::Approx(model.projection(lengths)));
+            }
+        }
+        CHECK(image[8 * view.cols() + 12] > 0);
+    }
+}
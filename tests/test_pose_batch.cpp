@@ -0,0 +1,85 @@
+/**
+ *
+ * \file test_pose_batch.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/pose_batch.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test pose batches")
+{
+    // 21 views, not a multiple of the packet size
+    const point2<float> pixels(16, 12);
+    const vec3<float> scale(1.6f, 1.2f, 1.f);
+
+    std::vector<vec3<float>> translations, rotations;
+    std::vector<point3<float>> sources;
+    for (size_t k = 0; k < 21; ++k) {
+        const auto a = static_cast<float>(k);
+        translations.emplace_back(0.1f * std::sin(a), -0.3f + 0.05f * a, 0.2f * std::cos(2 * a));
+        rotations.emplace_back(0.3f * std::sin(0.7f * a), 0.1f * a - 1, 0.29f * a);
+        sources.emplace_back(2 * std::cos(a), 2 * std::sin(a), 0.1f * a);
+    }
+
+    pose_batch<float> batch(pixels, scale, translations, rotations, sources);
+    REQUIRE(batch.size() == 21);
+
+    SUBCASE("Frames match rectangles built one by one")
+    {
+        using Radian = radian<float>;
+        for (size_t k = 0; k < batch.size(); ++k) {
+            const auto& angles = rotations[k];
+            const rectangle<float> expected(pixels, translations[k], scale, Radian(angles.x()), Radian(angles.y()), Radian(angles.z()));
+            const auto detector = batch.detector(k);
+
+            for (const auto& p : { point2<float>(0, 0), point2<float>(15, 0), point2<float>(7.5f, 11) }) {
+                const auto a = detector.coordFromLocal(p);
+                const auto b = expected.coordFromLocal(p);
+                CHECK(a.x() == doctest::Approx(b.x()).epsilon(1e-4));
+                CHECK(a.y() == doctest::Approx(b.y()).epsilon(1e-4));
+                CHECK(a.z() == doctest::Approx(b.z()).epsilon(1e-4));
+            }
+
+            const point3<float> q(0.3f, -0.2f, 0.7f);
+            const auto a = detector.localFromCoord(q);
+            const auto b = expected.localFromCoord(q);
+            CHECK(a.x() == doctest::Approx(b.x()).epsilon(1e-3));
+            CHECK(a.y() == doctest::Approx(b.y()).epsilon(1e-3));
+            CHECK(a.z() == doctest::Approx(b.z()).epsilon(1e-3));
+
+            CHECK(dot(detector.normal(), expected.normal()) == doctest::Approx(1));
+        }
+    }
+    SUBCASE("Views")
+    {
+        const auto views = batch.views();
+        REQUIRE(views.size() == 21);
+        CHECK(views[20].source.z() == doctest::Approx(2));
+        CHECK(views[3].cols() == 16);
+        CHECK(views[3].rows() == 12);
+
+        // Pixel rays hit their pixel
+        const auto r = views[9].pixelRay(4, 5);
+        auto [point, hit] = intersection(r, views[9].detector, ray_rectangle_intersection{});
+        REQUIRE(hit);
+        const auto local = views[9].detector.localFromCoord(point);
+        CHECK(local.x() == doctest::Approx(4).epsilon(1e-3));
+        CHECK(local.y() == doctest::Approx(5).epsilon(1e-3));
+    }
+    SUBCASE("Invalid input")
+    {
+        sources.pop_back();
+        CHECK_THROWS_AS(pose_batch<float>(pixels, scale, translations, rotations, sources), std::invalid_argument);
+
+        pose_batch<float> empty(pixels, scale, {}, {}, {});
+        CHECK(empty.size() == 0);
+    }
+}
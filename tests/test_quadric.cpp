@@ -0,0 +1,162 @@
+/**
+ *
+ * \file test_quadric.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/quadric.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    /// Length of the ray inside the shape by sampling contains() at many points
+    template <typename Shape>
+    float sampled_length(const Shape& shape, const ray<float>& r, float tMax = 4.f, int samples = 40000)
+    {
+        const float step = tMax / static_cast<float>(samples);
+        int inside = 0;
+        for (int i = 0; i < samples; ++i) {
+            const float t = (static_cast<float>(i) + 0.5f) * step;
+            const auto p = r.origin() + vec3<float>(r.dir().x() * t, r.dir().y() * t, r.dir().z() * t);
+            if (shape.contains({ p.x(), p.y(), p.z() }))
+                ++inside;
+        }
+        return static_cast<float>(inside) * step;
+    }
+
+    std::vector<ray<float>> random_rays(size_t count, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        std::vector<ray<float>> rays;
+        for (size_t i = 0; i < count; ++i) {
+            point3<float> origin(2 * dist(gen), 2 * dist(gen), 2 * dist(gen));
+            point3<float> target(0.5f * dist(gen), 0.5f * dist(gen), 0.5f * dist(gen));
+            rays.push_back(rayFromPoints(origin, target));
+        }
+        return rays;
+    }
+
+    template <typename Shape>
+    void check_packets(const Shape& shape)
+    {
+        auto rays = random_rays(64, 11);
+
+        using Value = pack8<float>;
+        for (size_t first = 0; first < rays.size(); first += 8) {
+            Value o[3], d[3];
+            for (size_t lane = 0; lane < 8; ++lane) {
+                const auto& r = rays[first + lane];
+                o[0][lane] = r.origin().x();
+                o[1][lane] = r.origin().y();
+                o[2][lane] = r.origin().z();
+                d[0][lane] = r.dir().x();
+                d[1][lane] = r.dir().y();
+                d[2][lane] = r.dir().z();
+            }
+            ray<Value> packet(point3<Value>(o[0], o[1], o[2]), vec3<Value>(d[0], d[1], d[2]), ray<Value>::ray_direction_normalized{});
+
+            const Value length = shape.chordLength(packet);
+            for (size_t lane = 0; lane < 8; ++lane)
+                CHECK(length[lane] == doctest::Approx(shape.chordLength(rays[first + lane])));
+        }
+    }
+
+    template <typename Shape>
+    void check_bounds(const Shape& shape)
+    {
+        float lo[3], hi[3];
+        shape.bounds(lo, hi);
+
+        std::mt19937 gen(13);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        for (int i = 0; i < 20000; ++i) {
+            std::array<float, 3> p = { dist(gen), dist(gen), dist(gen) };
+            if (!shape.contains(p))
+                continue;
+            for (int a = 0; a < 3; ++a) {
+                CHECK(p[a] >= lo[a]);
+                CHECK(p[a] <= hi[a]);
+            }
+        }
+    }
+} // namespace
+
+TEST_CASE("Test ellipsoid")
+{
+    SUBCASE("Sphere")
+    {
+        ellipsoid<float> sphere({ 0.5f, 0, 0 }, { 0.5f, 0.5f, 0.5f });
+
+        CHECK(sphere.chordLength(ray<float>(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0))) == doctest::Approx(1));
+        CHECK(sphere.chordLength(ray<float>(point3<float>(0.5f, 0.3f, -2), vec3<float>(0, 0, 1))) == doctest::Approx(0.8));
+        CHECK(sphere.chordLength(ray<float>(point3<float>(0.5f, 0.6f, -2), vec3<float>(0, 0, 1))) == 0);
+
+        // Rays starting inside or pointing away
+        CHECK(sphere.chordLength(ray<float>(point3<float>(0.5f, 0, 0), vec3<float>(0, 1, 0))) == doctest::Approx(0.5));
+        CHECK(sphere.chordLength(ray<float>(point3<float>(2, 0, 0), vec3<float>(1, 0, 0))) == 0);
+
+        auto [tEnter, tExit, mask] = sphere.interval(ray<float>(point3<float>(2, 0, 0), vec3<float>(1, 0, 0)));
+        CHECK(mask);
+        CHECK(tEnter == doctest::Approx(-2));
+        CHECK(tExit == doctest::Approx(-1));
+    }
+
+    SUBCASE("Rotated ellipsoid")
+    {
+        ellipsoid<float> e({ 0.1f, -0.2f, 0.05f }, { 0.7f, 0.4f, 0.2f }, { 0.3f, 0.8f, -0.4f });
+
+        for (const auto& r : random_rays(50, 7))
+            CHECK(e.chordLength(r) == doctest::Approx(sampled_length(e, r)).epsilon(0.003));
+
+        check_bounds(e);
+        check_packets(e);
+    }
+
+    SUBCASE("Invalid semi-axes")
+    {
+        CHECK_THROWS_AS(ellipsoid<float>({ 0, 0, 0 }, { 1, 0, 1 }), std::invalid_argument);
+        CHECK_THROWS_AS(ellipsoid<float>({ 0, 0, 0 }, { 1, -1, 1 }), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Test cylinder")
+{
+    SUBCASE("Upright cylinder")
+    {
+        cylinder<float> c({ 0, 0, 0 }, { 0.5f, 0.5f, 0.25f });
+
+        // Through the mantle, along the axis and through a cap
+        CHECK(c.chordLength(ray<float>(point3<float>(-2, 0, 0), vec3<float>(1, 0, 0))) == doctest::Approx(1));
+        CHECK(c.chordLength(ray<float>(point3<float>(0, 0, -2), vec3<float>(0, 0, 1))) == doctest::Approx(0.5));
+        CHECK(c.chordLength(ray<float>(point3<float>(-2, 0, 0.3f), vec3<float>(1, 0, 0))) == 0);
+
+        // Parallel to the axis, inside and outside of the mantle
+        CHECK(c.chordLength(ray<float>(point3<float>(0.4f, 0, -2), vec3<float>(0, 0, 1))) == doctest::Approx(0.5));
+        CHECK(c.chordLength(ray<float>(point3<float>(0.6f, 0, -2), vec3<float>(0, 0, 1))) == 0);
+
+        // Diagonal entering through the top cap and leaving through the mantle
+        ray<float> diagonal(point3<float>(-0.25f, 0, 0.5f), vec3<float>(1, 0, -1));
+        CHECK(c.chordLength(diagonal) == doctest::Approx(sampled_length(c, diagonal)).epsilon(0.003));
+    }
+
+    SUBCASE("Rotated cylinder")
+    {
+        cylinder<float> c({ -0.1f, 0.2f, 0 }, { 0.3f, 0.5f, 0.6f }, { 1.1f, 0.6f, 0.2f });
+
+        for (const auto& r : random_rays(50, 9))
+            CHECK(c.chordLength(r) == doctest::Approx(sampled_length(c, r)).epsilon(0.003));
+
+        check_bounds(c);
+        check_packets(c);
+    }
+}
@@ -0,0 +1,90 @@
+/**
+ *
+ * \file test_random.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/parallel.hpp"
+#include "TomoSect/point.hpp"
+#include "TomoSect/random.hpp"
+#include "TomoSect/vector.hpp"
+
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test random streams")
+{
+    using FloatP = enoki::Array<float, 8>;
+
+    SUBCASE("Streams are reproducible")
+    {
+        random_stream<float> a(3), b(3), c(4);
+        for (int i = 0; i < 10; ++i) {
+            float x = a.uniform();
+            CHECK(x == b.uniform());
+            CHECK(x != c.uniform());
+            CHECK(x >= 0.f);
+            CHECK(x < 1.f);
+        }
+        random_stream<float> seeded(3, 42);
+        random_stream<float> fresh(3);
+        CHECK(seeded.uniform() != fresh.uniform());
+    }
+    SUBCASE("Lanes of a packet are independent")
+    {
+        random_stream<FloatP> packets(0);
+        FloatP x = packets.uniform();
+        for (size_t lane = 1; lane < 8; ++lane)
+            CHECK(x[lane] != x[0]);
+
+        // Lane 0 of stream 1 is not a lane of stream 0
+        random_stream<float> scalar(1);
+        random_stream<FloatP> first(0);
+        CHECK(enoki::none(first.uniform() == FloatP(scalar.uniform())));
+    }
+    SUBCASE("Uniform numbers cover the unit interval evenly")
+    {
+        random_stream<FloatP> packets(7);
+        int histogram[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4000; ++i) {
+            FloatP x = packets.uniform();
+            for (size_t lane = 0; lane < 8; ++lane)
+                ++histogram[static_cast<int>(x[lane] * 4)];
+        }
+        for (int count : histogram)
+            CHECK(count == doctest::Approx(8000).epsilon(0.05));
+    }
+    SUBCASE("Every thread has its own stream")
+    {
+        std::vector<float> first(4);
+        parallel_for(0, 4, [&](size_t i) { first[i] = thread_random_stream<float>().uniform(); }, 1, 4);
+        CHECK(first[0] != first[1]);
+        CHECK(first[2] != first[3]);
+    }
+}
+
+TEST_CASE("Test random vectors and points")
+{
+    // Consecutive calls give different values
+    auto a = vec3<float>::Random();
+    auto b = vec3<float>::Random();
+    CHECK(a.x() != b.x());
+    CHECK(a.y() != a.x());
+
+    auto p = point3<float>::Random();
+    auto q = point3<float>::Random();
+    CHECK(p.x() != q.x());
+    CHECK(p.z() >= 0.f);
+    CHECK(p.z() < 1.f);
+
+    // Given streams are reproducible
+    random_stream<float> s1(5), s2(5);
+    auto u = vec3<float>::Random(s1);
+    auto v = vec3<float>::Random(s2);
+    CHECK(u.x() == v.x());
+    CHECK(u.z() == v.z());
+}
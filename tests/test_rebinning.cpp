@@ -0,0 +1,165 @@
+/**
+ *
+ * \file test_rebinning.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/phantom.hpp"
+#include "TomoSect/rebinning.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    analytic_phantom<float> test_phantom()
+    {
+        analytic_phantom<float> phantom;
+        phantom.add(ellipsoid<float>({ 0, 0, 0 }, { 0.5f, 0.4f, 0.3f }), 1.f);
+        phantom.add(ellipsoid<float>({ 0.2f, -0.1f, 0.05f }, { 0.15f, 0.15f, 0.15f }), 1.f);
+        return phantom;
+    }
+
+    /// Line integrals of all views, on a flat detector or on a cylindrical one with equiangular columns
+    projection_stack<float> scan(const circular_trajectory<float>& trajectory, detector_shape shape, const analytic_phantom<float>& phantom)
+    {
+        projection_stack<float> stack(trajectory.cols, trajectory.rows, trajectory.numViews);
+        const float SDD = trajectory.sourceDistance + trajectory.detectorDistance;
+
+        for (size_t k = 0; k < trajectory.numViews; ++k) {
+            const auto view = trajectory.view(k);
+            if (shape == detector_shape::flat) {
+                project_phantom(view, phantom, stack.view(k));
+                continue;
+            }
+
+            // Column c at fan angle (c - center) * width / SDD, bent around the source from the flat detector's axes
+            const auto first = view.detector.coordFromLocal(point2<float>(0, 0));
+            const auto across = normalize(view.detector.coordFromLocal(point2<float>(1, 0)) - first);
+            const auto up = normalize(view.detector.coordFromLocal(point2<float>(0, 1)) - first);
+            const auto center = normalize(view.detector.center() - view.source);
+            for (size_t row = 0; row < trajectory.rows; ++row) {
+                for (size_t col = 0; col < trajectory.cols; ++col) {
+                    const float gamma = (static_cast<float>(col) - (trajectory.cols - 1) / 2.f) * trajectory.pixelWidth / SDD;
+                    const float v = (static_cast<float>(row) - (trajectory.rows - 1) / 2.f) * trajectory.pixelHeight;
+                    const point3<float> target = view.source + center * (SDD * std::cos(gamma)) + across * (SDD * std::sin(gamma)) + up * v;
+                    stack(col, row, k) = phantom.lineIntegral(rayFromPoints(view.source, target));
+                }
+            }
+        }
+        return stack;
+    }
+} // namespace
+
+TEST_CASE("Test parallel rebinning geometry")
+{
+    circular_trajectory<float> trajectory{ 90, 2.f, 1.f, 24, 8, 0.1f, 0.1f, 0.3f };
+    parallel_rebinning<float> rebinning(trajectory);
+
+    CHECK(rebinning.numViews() == 90);
+    CHECK(rebinning.spacing() == doctest::Approx(0.1f * 2 / 3));
+    CHECK(rebinning.offset(0) == doctest::Approx(-11.5f * 0.2f / 3));
+    CHECK(rebinning.height(7) == doctest::Approx(3.5f * 0.2f / 3));
+
+    for (size_t k : { 0, 17, 60 }) {
+        const float theta = rebinning.angle(k);
+        for (size_t col : { 0, 5, 23 }) {
+            for (size_t row : { 0, 7 }) {
+                const auto r = rebinning.sampleRay(k, col, row);
+
+                // From the source circle, parallel to theta seen from above
+                const auto o = r.origin();
+                const auto d = r.dir();
+                CHECK(std::sqrt(o.x() * o.x() + o.y() * o.y()) == doctest::Approx(2));
+                CHECK(o.z() == doctest::Approx(0));
+                const float planar = std::sqrt(d.x() * d.x() + d.y() * d.y());
+                CHECK(d.x() / planar == doctest::Approx(-std::cos(theta)).epsilon(1e-4));
+                CHECK(d.y() / planar == doctest::Approx(-std::sin(theta)).epsilon(1e-4));
+
+                // Passing the axis at distance |offset| and the row height
+                const float t = -(o.x() * d.x() + o.y() * d.y()) / (planar * planar);
+                const auto closest = o + d * t;
+                const float distance = std::sqrt(closest.x() * closest.x() + closest.y() * closest.y());
+                CHECK(distance == doctest::Approx(std::abs(rebinning.offset(col))).epsilon(1e-3));
+                CHECK(std::abs(closest.z()) == doctest::Approx(std::abs(rebinning.height(row))).epsilon(1e-3));
+            }
+        }
+    }
+}
+
+TEST_CASE("Test parallel rebinning")
+{
+    const auto phantom = test_phantom();
+
+    SUBCASE("Full circle")
+    {
+        for (auto shape : { detector_shape::flat, detector_shape::cylindrical }) {
+            circular_trajectory<float> trajectory{ 360, 2.f, 1.f, 96, 24, 0.025f, 0.025f, 0.2f };
+            parallel_rebinning<float> rebinning(trajectory, shape);
+            CHECK(rebinning.shape() == shape);
+
+            const auto fan = scan(trajectory, shape, phantom);
+            projection_stack<float> parallel(96, 24, 360);
+            rebinning.rebin(fan, parallel);
+
+            // Rebinned values are the line integrals along the rays they were taken from
+            double error = 0, norm = 0;
+            for (size_t k = 0; k < 360; k += 7) {
+                for (size_t row = 0; row < 24; row += 3) {
+                    for (size_t col = 0; col < 96; ++col) {
+                        const double expected = phantom.lineIntegral(rebinning.sampleRay(k, col, row));
+                        error += (parallel(col, row, k) - expected) * (parallel(col, row, k) - expected);
+                        norm += expected * expected;
+                    }
+                }
+            }
+
+            // Linear interpolation, the error is mostly at the edges of the ellipsoids
+            CHECK(std::sqrt(error / norm) < 0.04);
+
+            // Parallel views half a turn apart see the same rays in the mid plane, mirrored
+            const size_t mid = 12;
+            double mirrored = 0;
+            for (size_t col = 0; col < 96; ++col)
+                mirrored += std::abs(parallel(col, mid, 10) - parallel(95 - col, mid, 190));
+            CHECK(mirrored / 96 < 0.02);
+        }
+    }
+
+    SUBCASE("Partial arcs")
+    {
+        // Views only cover the first half turn, samples needing earlier views are zero
+        circular_trajectory<float> trajectory{ 180, 2.f, 1.f, 96, 24, 0.025f, 0.025f, 0.f, static_cast<float>(M_PI) };
+        parallel_rebinning<float> rebinning(trajectory);
+        projection_stack<float> fan = scan(trajectory, detector_shape::flat, phantom);
+        projection_stack<float> parallel(96, 24, 180);
+        rebinning.rebin(fan, parallel);
+
+        // Which of the two edge columns needs earlier views depends on the direction of the columns
+        const bool firstMissing = phantom.lineIntegral(rebinning.sampleRay(0, 30, 12)) > 0 && parallel(30, 12, 0) == 0;
+        const bool lastMissing = phantom.lineIntegral(rebinning.sampleRay(0, 65, 12)) > 0 && parallel(65, 12, 0) == 0;
+        CHECK(firstMissing != lastMissing);
+        CHECK(parallel(48, 12, 90) == doctest::Approx(phantom.lineIntegral(rebinning.sampleRay(90, 48, 12))).epsilon(0.01));
+    }
+    SUBCASE("Invalid input")
+    {
+        circular_trajectory<float> trajectory{ 10, 2.f, 1.f, 16, 4, 0.1f, 0.1f };
+        parallel_rebinning<float> rebinning(trajectory);
+        projection_stack<float> in(16, 4, 10), out(16, 4, 9);
+        CHECK_THROWS_AS(rebinning.rebin(in, out), std::invalid_argument);
+
+        trajectory.rows = 0;
+        CHECK_THROWS_AS((parallel_rebinning<float>(trajectory)), std::invalid_argument);
+
+        // 2^31 values, one more than signed 32 bit offsets reach
+        trajectory.cols = 2048;
+        trajectory.rows = 1024;
+        trajectory.numViews = 1024;
+        CHECK_THROWS_AS((parallel_rebinning<float>(trajectory)), std::out_of_range);
+    }
+}
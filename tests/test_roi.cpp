@@ -0,0 +1,93 @@
+/**
+ *
+ * \file test_roi.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/fdk.hpp"
+#include "TomoSect/roi.hpp"
+
+#include <cmath>
+
+using namespace tomosect;
+
+namespace
+{
+    circular_trajectory<float> small_trajectory() { return circular_trajectory<float>{ 36, 2.f, 1.f, 48, 48, 0.05f, 0.05f }; }
+
+    projection_stack<float> smooth_projections(const circular_trajectory<float>& trajectory)
+    {
+        projection_stack<float> stack(trajectory.cols, trajectory.rows, trajectory.numViews);
+        for (size_t k = 0; k < trajectory.numViews; ++k)
+            for (size_t row = 0; row < trajectory.rows; ++row)
+                for (size_t col = 0; col < trajectory.cols; ++col)
+                    stack(col, row, k) =
+                        std::sin(0.25f * static_cast<float>(col) + 0.2f * static_cast<float>(k)) + 0.03f * static_cast<float>(row);
+        return stack;
+    }
+} // namespace
+
+TEST_CASE("Test voxels inside a box")
+{
+    auto grid = voxel_grid<float>(10, 10, 10, point3<float>(0.f), vec3<float>(1.f));
+
+    // Centers at 2.5, 3.5 and 4.5 are inside
+    auto box = voxels_inside(grid, aabb<float>(point3<float>(2.2f, 0.f, -5.f), point3<float>(4.7f, 10.f, 0.4f)));
+    CHECK(box.xBegin == 2);
+    CHECK(box.xEnd == 5);
+    CHECK(box.yBegin == 0);
+    CHECK(box.yEnd == 10);
+    CHECK(box.size() == 0);
+
+    auto outside = voxels_inside(grid, aabb<float>(point3<float>(20.f), point3<float>(30.f)));
+    CHECK(outside.size() == 0);
+}
+
+TEST_CASE("Test projected box")
+{
+    auto trajectory = small_trajectory();
+    auto P = trajectory.view(0).projectionMatrix();
+
+    // The origin projects onto the detector center
+    auto small = project_box(P, aabb<float>(point3<float>(-0.01f), point3<float>(0.01f)), 48, 48);
+    CHECK(small.colBegin == 23);
+    CHECK(small.colEnd == 25);
+    CHECK(small.rowBegin == 23);
+    CHECK(small.rowEnd == 25);
+
+    auto huge = project_box(P, aabb<float>(point3<float>(-1.f), point3<float>(1.f)), 48, 48);
+    CHECK(huge.size() == 48 * 48);
+
+    // Boxes reaching behind the source use the whole detector
+    auto behind = project_box(P, aabb<float>(point3<float>(1.f, -0.1f, -0.1f), point3<float>(3.f, 0.1f, 0.1f)), 48, 48);
+    CHECK(behind.size() == 48 * 48);
+}
+
+TEST_CASE("Test ROI reconstruction")
+{
+    auto trajectory = small_trajectory();
+    auto grid = voxel_grid<float>(20, 20, 20, point3<float>(-0.5f), vec3<float>(0.05f));
+    auto projections = smooth_projections(trajectory);
+
+    auto full = fdk(trajectory, projections, grid);
+    auto roi = fdk_roi(trajectory, projections, grid, aabb<float>(point3<float>(-0.1f, 0.f, -0.2f), point3<float>(0.15f, 0.2f, 0.05f)));
+
+    CHECK(roi.voxels.nx() == 5);
+    CHECK(roi.voxels.ny() == 4);
+    CHECK(roi.voxels.nz() == 5);
+    CHECK(roi.grid.min().x() == doctest::Approx(-0.1f));
+
+    float maxDiff = 0;
+    for (size_t z = 0; z < roi.voxels.nz(); ++z)
+        for (size_t y = 0; y < roi.voxels.ny(); ++y)
+            for (size_t x = 0; x < roi.voxels.nx(); ++x) {
+                const float expected = full(x + roi.voxels.xBegin, y + roi.voxels.yBegin, z + roi.voxels.zBegin);
+                maxDiff = std::max(maxDiff, std::abs(roi.data(x, y, z) - expected));
+            }
+    CHECK(maxDiff < 1e-5f);
+
+    CHECK_THROWS_AS(fdk_roi(trajectory, projections, grid, aabb<float>(point3<float>(2.f), point3<float>(3.f))), std::invalid_argument);
+}
@@ -0,0 +1,77 @@
+/**
+ *
+ * \file test_spsc_queue.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/spsc_queue.hpp"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test spsc queue capacity")
+{
+    spsc_queue<int> queue(5);
+    CHECK(queue.capacity() == 8);
+
+    for (int i = 0; i < 8; ++i)
+        CHECK(queue.tryPush(i));
+
+    int one_more = 8;
+    CHECK_FALSE(queue.tryPush(one_more));
+
+    CHECK(*queue.tryPop() == 0);
+    CHECK(queue.tryPush(one_more));
+
+    for (int i = 1; i <= 8; ++i)
+        CHECK(*queue.tryPop() == i);
+    CHECK_FALSE(queue.tryPop());
+
+    CHECK_THROWS_AS(spsc_queue<int>(0), std::invalid_argument);
+}
+
+TEST_CASE("Test spsc queue close")
+{
+    spsc_queue<std::unique_ptr<int>> queue(4);
+
+    CHECK(queue.push(std::make_unique<int>(1)));
+    CHECK(queue.push(std::make_unique<int>(2)));
+    queue.close();
+
+    CHECK(queue.closed());
+    CHECK_FALSE(queue.push(std::make_unique<int>(3)));
+
+    // Remaining elements are drained after closing
+    CHECK(**queue.pop() == 1);
+    CHECK(**queue.pop() == 2);
+    CHECK_FALSE(queue.pop());
+}
+
+TEST_CASE("Test spsc queue between threads")
+{
+    constexpr size_t count = 100000;
+    spsc_queue<size_t> queue(16);
+
+    std::thread producer([&] {
+        for (size_t i = 0; i < count; ++i)
+            queue.push(i);
+        queue.close();
+    });
+
+    std::vector<size_t> received;
+    while (auto value = queue.pop())
+        received.push_back(*value);
+    producer.join();
+
+    REQUIRE(received.size() == count);
+    bool inOrder = true;
+    for (size_t i = 0; i < count; ++i)
+        inOrder &= received[i] == i;
+    CHECK(inOrder);
+}
@@ -0,0 +1,197 @@
+/**
+ *
+ * \file test_supersampling.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/phantom.hpp"
+#include "TomoSect/supersampling.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    using FloatP = pack8<float>;
+
+    projection_view<float> small_view() { return circular_trajectory<float>{ 1, 2.f, 1.f, 12, 10, 0.15f, 0.15f, 0.4f }.view(0); }
+
+    /// Reference: mean of the scalar line integrals of all sub-rays of each pixel
+    std::vector<float> reference(const projection_view<float>& view, const supersampling<float>& options,
+                                 const analytic_phantom<float>& phantom)
+    {
+        supersampled_rays<float> rays(view, options);
+        std::vector<float> result(view.cols() * view.rows());
+        for (size_t row = 0; row < view.rows(); ++row) {
+            for (size_t col = 0; col < view.cols(); ++col) {
+                double sum = 0;
+                for (size_t s = 0; s < rays.samplesPerPixel(); ++s)
+                    sum += phantom.lineIntegral(rays.sample(col, row, s));
+                result[row * view.cols() + col] = static_cast<float>(sum / rays.samplesPerPixel());
+            }
+        }
+        return result;
+    }
+} // namespace
+
+TEST_CASE("Test supersampled rays")
+{
+    const auto view = small_view();
+
+    SUBCASE("A single sample is the pixel center ray")
+    {
+        supersampled_rays<float> rays(view, supersampling<float>{});
+        CHECK(rays.samplesPerPixel() == 1);
+        CHECK(rays.samplesPerRow() == 12);
+
+        for (size_t col : { 0, 5, 11 }) {
+            const auto expected = view.pixelRay(col, 3);
+            const auto r = rays.sample(col, 3, 0);
+            CHECK(r.origin().x() == doctest::Approx(expected.origin().x()));
+            CHECK(r.dir().x() == doctest::Approx(expected.dir().x()));
+            CHECK(r.dir().y() == doctest::Approx(expected.dir().y()));
+            CHECK(r.dir().z() == doctest::Approx(expected.dir().z()));
+        }
+    }
+    SUBCASE("Detector samples are stratified over the pixel")
+    {
+        supersampling<float> options;
+        options.subCols = 3;
+        options.subRows = 2;
+        supersampled_rays<float> rays(view, options);
+        CHECK(rays.samplesPerPixel() == 6);
+
+        // Hit points in continuous pixel coordinates: stratum centers around the pixel center
+        const float expected[6][2] = { { -1.f / 3, -0.25f }, { 0, -0.25f }, { 1.f / 3, -0.25f },
+                                       { -1.f / 3, 0.25f },  { 0, 0.25f },  { 1.f / 3, 0.25f } };
+        for (size_t s = 0; s < 6; ++s) {
+            auto [point, hit] = intersection(rays.sample(4, 7, s), view.detector, ray_rectangle_intersection{});
+            REQUIRE(hit);
+            auto local = view.detector.localFromCoord(point);
+            CHECK(local.x() == doctest::Approx(4 + expected[s][0]).epsilon(1e-4));
+            CHECK(local.y() == doctest::Approx(7 + expected[s][1]).epsilon(1e-4));
+        }
+    }
+    SUBCASE("Focal spot samples surround the source")
+    {
+        supersampling<float> options;
+        options.focalCols = 2;
+        options.focalRows = 2;
+        options.focalWidth = 0.02f;
+        options.focalHeight = 0.01f;
+        supersampled_rays<float> rays(view, options);
+        CHECK(rays.samplesPerPixel() == 4);
+
+        // The spot is parallel to the detector: rows along z, columns along the tangent of the source circle
+        const float tangent[2] = { -std::sin(0.4f), std::cos(0.4f) };
+        for (size_t s = 0; s < 4; ++s) {
+            const auto shift = rays.sample(0, 0, s).origin() - view.source;
+            const float alongCols = (s % 2 == 0 ? -0.005f : 0.005f);
+            const float alongRows = (s < 2 ? -0.0025f : 0.0025f);
+            CHECK(shift.x() == doctest::Approx(alongCols * tangent[0]).epsilon(1e-3));
+            CHECK(shift.y() == doctest::Approx(alongCols * tangent[1]).epsilon(1e-3));
+            CHECK(shift.z() == doctest::Approx(alongRows).epsilon(1e-3));
+        }
+    }
+    SUBCASE("Packets hold consecutive samples across pixels")
+    {
+        supersampling<float> options;
+        options.subCols = 3;
+        options.focalCols = 1;
+        options.focalRows = 2;
+        options.focalHeight = 0.01f;
+        supersampled_rays<float> rays(view, options);
+
+        // Samples 4 to 10 of row 2: pixel 0 samples 4 and 5, pixel 1 samples 0 to 4, last lane repeated
+        const auto packet = rays.packet<FloatP>(2, 4, 7);
+        for (size_t lane = 0; lane < 8; ++lane) {
+            const size_t index = 4 + std::min<size_t>(lane, 6);
+            const auto r = rays.sample(index / 6, 2, index % 6);
+            CHECK(packet.origin().z()[lane] == doctest::Approx(r.origin().z()));
+            CHECK(packet.dir().x()[lane] == doctest::Approx(r.dir().x()));
+            CHECK(packet.dir().y()[lane] == doctest::Approx(r.dir().y()));
+            CHECK(packet.dir().z()[lane] == doctest::Approx(r.dir().z()));
+        }
+    }
+    SUBCASE("Invalid options")
+    {
+        supersampling<float> options;
+        options.subRows = 0;
+        CHECK_THROWS_AS(supersampled_rays<float>(view, options), std::invalid_argument);
+
+        options.subRows = 1;
+        options.focalWidth = -1;
+        CHECK_THROWS_AS(supersampled_rays<float>(view, options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Test supersampled projection")
+{
+    const auto view = small_view();
+
+    analytic_phantom<float> phantom;
+    phantom.add(ellipsoid<float>({ 0, 0, 0 }, { 0.5f, 0.4f, 0.45f }), 1.f);
+    phantom.add(ellipsoid<float>({ 0.1f, -0.1f, 0.05f }, { 0.03f, 0.03f, 0.03f }), 2.f);
+
+    auto integrand = [&](const ray<FloatP>& r) { return phantom.lineIntegral(r); };
+
+    SUBCASE("One sample per pixel is the plain projection")
+    {
+        std::vector<float> plain(view.cols() * view.rows()), sampled(plain.size());
+        project_phantom(view, phantom, plain.data());
+        project_supersampled(view, supersampling<float>{}, integrand, sampled.data());
+        for (size_t i = 0; i < plain.size(); ++i)
+            CHECK(sampled[i] == doctest::Approx(plain[i]).epsilon(1e-5));
+    }
+    SUBCASE("Pixels are the mean over their sub-rays")
+    {
+        // 6 samples share packets between pixels, 16 fill whole packets
+        supersampling<float> shared;
+        shared.subCols = 3;
+        shared.subRows = 2;
+
+        supersampling<float> whole;
+        whole.subCols = 2;
+        whole.subRows = 2;
+        whole.focalCols = 2;
+        whole.focalRows = 2;
+        whole.focalWidth = 0.05f;
+        whole.focalHeight = 0.05f;
+
+        for (const auto& options : { shared, whole }) {
+            std::vector<float> sampled(view.cols() * view.rows());
+            project_supersampled(view, options, integrand, sampled.data());
+            const auto expected = reference(view, options, phantom);
+            for (size_t i = 0; i < sampled.size(); ++i)
+                CHECK(sampled[i] == doctest::Approx(expected[i]).epsilon(1e-4));
+        }
+    }
+    SUBCASE("Voxel volumes")
+    {
+        voxel_grid<float> grid(16, 16, 16, point3<float>(-0.5f), vec3<float>(1.f / 16));
+        volume<float> vol(16, 16, 16);
+        vol.fill([](size_t x, size_t y, size_t z) { return static_cast<float>((x + y + z) % 3); });
+
+        supersampling<float> options;
+        options.subCols = 2;
+        options.subRows = 3;
+
+        std::vector<float> sampled(view.cols() * view.rows());
+        project_supersampled(view, options, grid, vol, sampled.data());
+
+        supersampled_rays<float> rays(view, options);
+        for (size_t row : { 2, 5 }) {
+            for (size_t col : { 3, 6, 9 }) {
+                double sum = 0;
+                for (size_t s = 0; s < 6; ++s)
+                    sum += project(rays.sample(col, row, s), grid, vol);
+                CHECK(sampled[row * view.cols() + col] == doctest::Approx(sum / 6).epsilon(1e-4));
+            }
+        }
+    }
+}
@@ -0,0 +1,150 @@
+/**
+ *
+ * \file test_symmetric_matrix.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/symmetric_matrix.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    circular_trajectory<float> small_trajectory(size_t numViews)
+    {
+        circular_trajectory<float> trajectory{ numViews, 2.f, 1.f, 8, 4, 0.15f, 0.15f };
+        trajectory.startAngle = 0.1f;
+        return trajectory;
+    }
+
+    std::vector<float> random_vector(size_t size, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(0, 1);
+
+        std::vector<float> v(size);
+        for (auto& e : v)
+            e = dist(gen);
+        return v;
+    }
+} // namespace
+
+TEST_CASE("Test circular trajectory")
+{
+    auto trajectory = small_trajectory(4);
+    auto view = trajectory.view(1);
+    auto phi = trajectory.angle(1);
+
+    CHECK(trajectory.step() == doctest::Approx(M_PI / 2));
+    CHECK(view.cols() == 8);
+    CHECK(view.rows() == 4);
+    CHECK(view.source.x() == doctest::Approx(2 * std::cos(phi)));
+    CHECK(view.source.y() == doctest::Approx(2 * std::sin(phi)));
+
+    // The central ray hits the rotation axis perpendicular
+    auto corner = view.detector.coordFromLocal(point2<float>(3, 1));
+    auto center = corner + (view.detector.coordFromLocal(point2<float>(4, 2)) - corner) / 2.f;
+    CHECK(center.x() == doctest::Approx(-std::cos(phi)));
+    CHECK(center.y() == doctest::Approx(-std::sin(phi)));
+    CHECK(center.z() == doctest::Approx(0));
+
+    // Neighbouring pixels are one pixel size apart
+    auto step = view.detector.coordFromLocal(point2<float>(1, 0)) - view.detector.coordFromLocal(point2<float>(0, 0));
+    CHECK(enoki::norm(step) == doctest::Approx(0.15f));
+}
+
+TEST_CASE("Test polar grid traversal")
+{
+    auto grid = polar_grid<float>(4, 8, 4, 0.5f, -0.2f, 0.1f);
+
+    CHECK(grid.size() == 128);
+    CHECK(grid.rotate(grid.index(1, 7, 2), 2) == grid.index(1, 1, 2));
+    CHECK(grid.cellOf(point3<float>(-0.3f, 0.01f, 0.05f)) == grid.index(2, 3, 2));
+
+    SUBCASE("Lengths sum up to the chord through the cylinder")
+    {
+        auto r = rayFromPoints(point3<float>(-2, 0.2f, 0.03f), point3<float>(2, -0.1f, -0.04f));
+
+        float sum = 0;
+        size_t cells = 0;
+        traverse(r, grid, [&](size_t cell, float length) {
+            CHECK(cell < grid.size());
+            CHECK(length > 0);
+            sum += length;
+            ++cells;
+        });
+
+        // Distance of the line from the axis in the x-y plane
+        float dxy = std::hypot(4.f, 0.3f);
+        float dist = std::abs(-2 * -0.3f - 0.2f * 4.f) / dxy;
+        float chordXY = 2 * std::sqrt(0.25f - dist * dist);
+
+        CHECK(sum == doctest::Approx(chordXY / std::hypot(r.dir().x(), r.dir().y())).epsilon(1e-4));
+        CHECK(cells > 8);
+    }
+    SUBCASE("Rays missing the cylinder have no cells")
+    {
+        auto r = rayFromPoints(point3<float>(-2, 0.6f, 0), point3<float>(2, 0.6f, 0));
+
+        size_t cells = 0;
+        traverse(r, grid, [&](size_t, float) { ++cells; });
+        CHECK(cells == 0);
+    }
+}
+
+TEST_CASE("Test symmetric system matrix")
+{
+    auto grid = polar_grid<float>(4, 8, 4, 0.5f, -0.2f, 0.1f);
+    auto trajectory = small_trajectory(16);
+
+    auto A = assemble_symmetric_matrix(trajectory, grid);
+
+    auto traverseRay = [&grid](const ray<float>& r, auto&& f) { traverse(r, grid, f); };
+    auto full = assemble_system_matrix(trajectory.views(), grid.size(), traverseRay);
+
+    CHECK(A.rows() == full.rows());
+    CHECK(A.cols() == full.cols());
+
+    SUBCASE("Only one period of views is stored")
+    {
+        // gcd(16, 8) = 8 periods of 2 views
+        CHECK(A.viewsPerPeriod() == 2);
+        CHECK(A.sector().rows() == 2 * 32);
+        CHECK(A.nnz() == full.nnz());
+        CHECK(A.memoryUsage() * 7 < full.nnz() * (sizeof(uint32_t) + sizeof(float)));
+    }
+    SUBCASE("Products match the full matrix")
+    {
+        auto x = random_vector(A.cols(), 1);
+        auto y = random_vector(A.rows(), 2);
+
+        std::vector<float> yFull(A.rows()), ySym(A.rows());
+        spmv(full, x.data(), yFull.data());
+        spmv(A, x.data(), ySym.data());
+
+        for (size_t i = 0; i < A.rows(); ++i)
+            CHECK(ySym[i] == doctest::Approx(yFull[i]).epsilon(1e-3));
+
+        std::vector<float> xFull(A.cols()), xSym(A.cols());
+        spmv_transposed(full, y.data(), xFull.data());
+        spmv_transposed(A, y.data(), xSym.data(), 3);
+
+        for (size_t j = 0; j < A.cols(); ++j)
+            CHECK(xSym[j] == doctest::Approx(xFull[j]).epsilon(1e-3));
+    }
+    SUBCASE("Scans without symmetry store all views")
+    {
+        auto odd = small_trajectory(7);
+        auto B = assemble_symmetric_matrix(odd, grid);
+
+        CHECK(B.viewsPerPeriod() == 7);
+        CHECK(B.sector().rows() == B.rows());
+    }
+}
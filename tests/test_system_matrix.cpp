@@ -0,0 +1,184 @@
+/**
+ *
+ * \file test_system_matrix.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/system_matrix.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    scan_geometry<float> small_geometry(float detectorShift = 0)
+    {
+        using Angle = degree<float>;
+
+        auto grid = voxel_grid<float>(8, 8, 8, point3<float>(-0.2), vec3<float>(0.05));
+
+        std::vector<projection_view<float>> views;
+        views.push_back({ point3<float>(0, 0, -2),
+                          rectangle<float>(point2<float>(8), vec3<float>(detectorShift, 0, 2), Angle(0), Angle(0), Angle(0)) });
+        views.push_back({ point3<float>(0.1, 0, -2),
+                          rectangle<float>(point2<float>(8, 4), vec3<float>(0.1, 0, 2), Angle(0), Angle(0), Angle(0)) });
+
+        return scan_geometry<float>(grid, views);
+    }
+
+    std::vector<float> random_vector(size_t size, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(0, 1);
+
+        std::vector<float> v(size);
+        for (auto& e : v)
+            e = dist(gen);
+        return v;
+    }
+} // namespace
+
+TEST_CASE("Test system matrix assembly")
+{
+    auto geometry = small_geometry();
+    auto A = assemble_system_matrix(geometry);
+
+    CHECK(A.rows() == 8 * 8 + 8 * 4);
+    CHECK(A.cols() == 512);
+    CHECK(A.nnz() > 0);
+    CHECK(A.geometryHash() == geometry.hash());
+
+    SUBCASE("Row sums are the chord lengths through the volume")
+    {
+        for (size_t row = 0; row < 8; ++row) {
+            for (size_t col = 0; col < 8; ++col) {
+                auto r = geometry.pixelRay(0, col, row);
+                auto [tmin, tmax, hit] = intersection(r, geometry.grid().bounds(), ray_aabb_interval{});
+
+                size_t i = row * 8 + col;
+                float sum = 0;
+                for (auto k = A.rowPtr()[i]; k < A.rowPtr()[i + 1]; ++k)
+                    sum += A.values()[k];
+
+                CHECK(sum == doctest::Approx(hit ? tmax - tmin : 0).epsilon(1e-3));
+            }
+        }
+    }
+    SUBCASE("Column indices are sorted")
+    {
+        for (size_t i = 0; i < A.rows(); ++i)
+            for (auto k = A.rowPtr()[i] + 1; k < A.rowPtr()[i + 1]; ++k)
+                CHECK(A.colIdx()[k - 1] < A.colIdx()[k]);
+    }
+    SUBCASE("Transposed product is the adjoint")
+    {
+        auto x = random_vector(A.cols(), 1);
+        auto y = random_vector(A.rows(), 2);
+
+        std::vector<float> Ax(A.rows());
+        std::vector<float> Aty(A.cols());
+        spmv(A, x.data(), Ax.data());
+        spmv_transposed(A, y.data(), Aty.data(), 3);
+
+        double lhs = 0;
+        double rhs = 0;
+        for (size_t i = 0; i < A.rows(); ++i)
+            lhs += double(Ax[i]) * y[i];
+        for (size_t j = 0; j < A.cols(); ++j)
+            rhs += double(x[j]) * Aty[j];
+
+        CHECK(lhs == doctest::Approx(rhs).epsilon(1e-4));
+    }
+}
+
+TEST_CASE("Test system matrix cache")
+{
+    auto dir = std::filesystem::temp_directory_path() / "tomosect_test_system_matrix";
+    std::filesystem::remove_all(dir);
+
+    auto geometry = small_geometry();
+
+    SUBCASE("Save and map")
+    {
+        auto A = assemble_system_matrix(geometry);
+
+        std::filesystem::create_directories(dir);
+        auto path = (dir / "matrix.tsm").string();
+        A.save(path);
+
+        auto B = csr_matrix::map(path);
+        REQUIRE(B.rows() == A.rows());
+        REQUIRE(B.cols() == A.cols());
+        REQUIRE(B.nnz() == A.nnz());
+        CHECK(B.geometryHash() == A.geometryHash());
+        CHECK(std::equal(A.rowPtr(), A.rowPtr() + A.rows() + 1, B.rowPtr()));
+        CHECK(std::equal(A.colIdx(), A.colIdx() + A.nnz(), B.colIdx()));
+        CHECK(std::equal(A.values(), A.values() + A.nnz(), B.values()));
+    }
+    SUBCASE("Geometry keyed lookup")
+    {
+        auto A = load_or_assemble(geometry, dir.string());
+        auto B = load_or_assemble(geometry, dir.string());
+        CHECK(A.nnz() == B.nnz());
+        CHECK(A.geometryHash() == B.geometryHash());
+
+        auto other = small_geometry(0.05f);
+        CHECK(other.hash() != geometry.hash());
+
+        load_or_assemble(other, dir.string());
+
+        size_t files = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(dir))
+            files += entry.path().extension() == ".tsm";
+        CHECK(files == 2);
+    }
+    SUBCASE("Reject garbage")
+    {
+        std::filesystem::create_directories(dir);
+        auto path = (dir / "garbage.tsm").string();
+        std::ofstream(path) << "definitely not a matrix, but long enough to hold a header......";
+
+        CHECK_THROWS_AS(csr_matrix::map(path), std::runtime_error);
+    }
+    SUBCASE("Reject corrupt arrays")
+    {
+        std::filesystem::create_directories(dir);
+        auto path = (dir / "corrupt.tsm").string();
+        const auto A = assemble_system_matrix(geometry);
+        const auto header = details::make_csr_header(A.geometryHash(), A.rows(), A.cols(), A.nnz());
+
+        // Overwrite a single value of a valid file
+        auto corrupt = [&](uint64_t offset, auto value) {
+            A.save(path);
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast<std::streamoff>(offset));
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+
+        corrupt(header.colIdxOffset + 4, static_cast<uint32_t>(A.cols()));
+        CHECK_THROWS_AS(csr_matrix::map(path), std::runtime_error);
+
+        corrupt(header.rowPtrOffset + 8, A.rowPtr()[2] + 1);
+        CHECK_THROWS_AS(csr_matrix::map(path), std::runtime_error);
+
+        corrupt(header.rowPtrOffset + A.rows() * 8, static_cast<uint64_t>(A.nnz() - 1));
+        CHECK_THROWS_AS(csr_matrix::map(path), std::runtime_error);
+
+        corrupt(offsetof(details::csr_file_header, rows), ~uint64_t{ 0 });
+        CHECK_THROWS_AS(csr_matrix::map(path), std::runtime_error);
+
+        A.save(path);
+        CHECK(csr_matrix::map(path).nnz() == A.nnz());
+    }
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,94 @@
+/**
+ *
+ * \file test_tile_culling.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/intersection.hpp"
+#include "TomoSect/scan_geometry.hpp"
+#include "TomoSect/tile_culling.hpp"
+
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    projection_view<float> make_view(float angle)
+    {
+        circular_trajectory<float> trajectory{ 1, 2.f, 1.f, 64, 48, 0.05f, 0.05f };
+        trajectory.startAngle = angle;
+        return trajectory.view(0);
+    }
+
+    bool hits(const projection_view<float>& view, size_t col, size_t row, const aabb<float>& box)
+    {
+        auto [tmin, tmax, hit] = intersection(view.pixelRay(col, row), box, ray_aabb_interval{});
+        return hit && tmax >= 0;
+    }
+} // namespace
+
+TEST_CASE("Test ray frustum")
+{
+    auto apex = point3<float>(0, 0, 0);
+    ray_frustum<float> frustum(apex,
+                               { point3<float>(-1, -1, 1), point3<float>(1, -1, 1), point3<float>(1, 1, 1), point3<float>(-1, 1, 1) });
+
+    CHECK(frustum.mayIntersect(aabb<float>(point3<float>(-0.1f, -0.1f, 2), point3<float>(0.1f, 0.1f, 3))));
+    CHECK(frustum.mayIntersect(aabb<float>(point3<float>(-10, -10, 5), point3<float>(10, 10, 6))));
+
+    // Beside and behind
+    CHECK_FALSE(frustum.mayIntersect(aabb<float>(point3<float>(3, -0.1f, 1), point3<float>(4, 0.1f, 2))));
+    CHECK_FALSE(frustum.mayIntersect(aabb<float>(point3<float>(-0.1f, -0.1f, -3), point3<float>(0.1f, 0.1f, -2))));
+
+    // Orientation of the corners does not matter
+    ray_frustum<float> reversed(apex,
+                                { point3<float>(-1, 1, 1), point3<float>(1, 1, 1), point3<float>(1, -1, 1), point3<float>(-1, -1, 1) });
+    CHECK_FALSE(reversed.mayIntersect(aabb<float>(point3<float>(3, -0.1f, 1), point3<float>(4, 0.1f, 2))));
+    CHECK(reversed.mayIntersect(aabb<float>(point3<float>(-0.1f, -0.1f, 2), point3<float>(0.1f, 0.1f, 3))));
+}
+
+TEST_CASE("Test tile culling")
+{
+    auto box = aabb<float>(point3<float>(-0.3f, -0.2f, -0.25f), point3<float>(0.3f, 0.4f, 0.25f));
+
+    for (float angle : { 0.f, 0.7f, 2.f }) {
+        auto view = make_view(angle);
+
+        std::vector<bool> visited(view.cols() * view.rows(), false);
+        bool consistent = true;
+
+        auto stats = for_each_visible_tile(view, box, 8, [&](const detector_window& tile, tile_class c) {
+            for (size_t row = tile.rowBegin; row < tile.rowEnd; ++row) {
+                for (size_t col = tile.colBegin; col < tile.colEnd; ++col) {
+                    visited[row * view.cols() + col] = true;
+                    if (c == tile_class::inside)
+                        consistent &= hits(view, col, row, box);
+                }
+            }
+        });
+
+        // No ray hitting the box is in a culled tile
+        bool conservative = true;
+        for (size_t row = 0; row < view.rows(); ++row)
+            for (size_t col = 0; col < view.cols(); ++col)
+                conservative &= visited[row * view.cols() + col] || !hits(view, col, row, box);
+
+        CHECK(consistent);
+        CHECK(conservative);
+        CHECK(stats.tiles() == 8 * 6);
+        CHECK(stats.outside > 0);
+        CHECK(stats.inside > 0);
+        CHECK(stats.culledRatio() > 0.2);
+    }
+
+    SUBCASE("Border tiles")
+    {
+        tile_statistics total;
+        total += for_each_visible_tile(make_view(0), box, 10, [](const detector_window& tile, tile_class) { CHECK(tile.size() > 0); });
+        CHECK(total.tiles() == 7 * 5);
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ *
+ * \file test_traversal.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/traversal.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomosect;
+
+TEST_CASE("Test voxel grid")
+{
+    auto grid = voxel_grid<float>(4, 3, 2, point3<float>(-1, 0, 1), vec3<float>(0.5, 1, 2));
+
+    CHECK(grid.size() == 24);
+    CHECK(grid.index(1, 2, 1) == 1 + 4 * (2 + 3 * 1));
+
+    auto max = grid.bounds().max();
+    CHECK(max.x() == doctest::Approx(1));
+    CHECK(max.y() == doctest::Approx(3));
+    CHECK(max.z() == doctest::Approx(5));
+
+    auto c = grid.voxelCenter(0, 0, 0);
+    CHECK(c.x() == doctest::Approx(-0.75));
+    CHECK(c.y() == doctest::Approx(0.5));
+    CHECK(c.z() == doctest::Approx(2));
+}
+
+TEST_CASE("Test voxel traversal")
+{
+    auto grid = voxel_grid<float>(4, 4, 4, point3<float>(0), vec3<float>(1));
+
+    std::vector<size_t> voxels;
+    std::vector<float> lengths;
+    auto collect = [&](size_t voxel, float length) {
+        voxels.push_back(voxel);
+        lengths.push_back(length);
+    };
+
+    SUBCASE("Axis aligned along x")
+    {
+        traverse(ray<float>(point3<float>(-1, 0.5, 0.5), vec3<float>(1, 0, 0)), grid, collect);
+
+        REQUIRE(voxels.size() == 4);
+        for (size_t i = 0; i < 4; ++i) {
+            CHECK(voxels[i] == i);
+            CHECK(lengths[i] == doctest::Approx(1));
+        }
+    }
+    SUBCASE("Axis aligned along negative z")
+    {
+        traverse(ray<float>(point3<float>(2.5, 1.5, 10), vec3<float>(0, 0, -1)), grid, collect);
+
+        REQUIRE(voxels.size() == 4);
+        CHECK(voxels.front() == grid.index(2, 1, 3));
+        CHECK(voxels.back() == grid.index(2, 1, 0));
+    }
+    SUBCASE("Diagonal, lengths sum up to the chord")
+    {
+        auto r = ray<float>(point3<float>(-1, -0.9, -1.1), vec3<float>(1, 1, 1));
+        traverse(r, grid, collect);
+
+        float sum = 0;
+        for (auto l : lengths)
+            sum += l;
+
+        // Enters through z = 0 at t = 1.1, leaves through y = 4 at t = 4.9
+        CHECK(sum == doctest::Approx(3.8 * std::sqrt(3.f)).epsilon(1e-3));
+        CHECK(voxels.front() == grid.index(0, 0, 0));
+        CHECK(voxels.back() == grid.index(3, 3, 3));
+    }
+    SUBCASE("Origin inside the grid")
+    {
+        traverse(ray<float>(point3<float>(1.5, 0.5, 0.5), vec3<float>(1, 0, 0)), grid, collect);
+
+        REQUIRE(voxels.size() == 3);
+        CHECK(lengths[0] == doctest::Approx(0.5));
+    }
+    SUBCASE("Miss")
+    {
+        traverse(ray<float>(point3<float>(-1, 5, 0.5), vec3<float>(1, 0, 0)), grid, collect);
+
+        CHECK(voxels.empty());
+    }
+}
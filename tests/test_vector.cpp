@@ -130,6 +130,29 @@ TEST_CASE("Testing Vector")
                 CHECK(v.y() == pack2<float>{ 8, 10 });
             }
         }
+        SUBCASE("Multiplication with a scalar")
+        {
+            SUBCASE("2D Vector")
+            {
+                auto v1 = vec2<pack2<float>>(pack2<float>{ 2, 3 }, pack2<float>{ 4, 5 });
+                auto s = pack2<float>{ 3, -1 };
+
+                auto v = v1 * s;
+
+                CHECK(v.x() == pack2<float>{ 6, -3 });
+                CHECK(v.y() == pack2<float>{ 12, -5 });
+            }
+            SUBCASE("Scalar times 3D Vector")
+            {
+                auto v1 = vec3<float>(2, -3, 4);
+
+                auto v = 0.5f * v1;
+
+                CHECK(v.x() == 1.f);
+                CHECK(v.y() == -1.5f);
+                CHECK(v.z() == 2.f);
+            }
+        }
         SUBCASE("Coefficient wise addition")
         {
             SUBCASE("2D Vector")
@@ -0,0 +1,143 @@
+/**
+ *
+ * \file test_volume.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/vector.hpp"
+#include "TomoSect/volume.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace tomosect;
+
+namespace
+{
+    template <volume_layout Layout>
+    volume<float, Layout> ramp_volume(size_t nx, size_t ny, size_t nz)
+    {
+        volume<float, Layout> vol(nx, ny, nz);
+        vol.fill([](size_t x, size_t y, size_t z) { return static_cast<float>(x + 10 * y + 100 * z); });
+        return vol;
+    }
+
+    template <volume_layout Layout>
+    void check_offsets_unique(size_t nx, size_t ny, size_t nz)
+    {
+        volume<float, Layout> vol(nx, ny, nz);
+
+        std::vector<bool> used(vol.storageSize(), false);
+        for (size_t z = 0; z < nz; ++z) {
+            for (size_t y = 0; y < ny; ++y) {
+                for (size_t x = 0; x < nx; ++x) {
+                    auto o = vol.offset(x, y, z);
+                    REQUIRE(o < vol.storageSize());
+                    CHECK(!used[o]);
+                    used[o] = true;
+                }
+            }
+        }
+    }
+
+    template <volume_layout Layout>
+    void check_access()
+    {
+        using UInt32P = enoki::Array<uint32_t, 8>;
+        using FloatP = enoki::Array<float, 8>;
+
+        auto vol = ramp_volume<Layout>(11, 6, 9);
+        auto grid = voxel_grid<float>(11, 6, 9, point3<float>(0), vec3<float>(1));
+
+        CHECK(vol(3, 4, 5) == 543.f);
+
+        // Gather matches scalar access
+        auto x = enoki::arange<UInt32P>();
+        auto y = UInt32P(5) - enoki::arange<UInt32P>() / 2u;
+        auto z = UInt32P(2);
+
+        auto values = vol.template gather<FloatP>(x, y, z);
+        for (size_t i = 0; i < 8; ++i)
+            CHECK(values[i] == vol(x[i], y[i], z[i]));
+
+        // Trilinear interpolation is exact for linear functions
+        auto p = point3<FloatP>(FloatP(2.5f) + enoki::arange<FloatP>() * 0.75f, FloatP(1.7f), FloatP(4.2f));
+        auto interpolated = sample(grid, vol, p);
+
+        for (size_t i = 0; i < 8; ++i) {
+            float expected = (p.x()[i] - 0.5f) + 10 * (1.7f - 0.5f) + 100 * (4.2f - 0.5f);
+            CHECK(interpolated[i] == doctest::Approx(expected).epsilon(1e-4));
+        }
+
+        auto outside = sample(grid, vol, point3<FloatP>(FloatP(-1), FloatP(1), FloatP(1)));
+        CHECK(outside[0] == 0.f);
+
+        // Projection does not depend on the layout
+        auto reference = ramp_volume<volume_layout::linear>(11, 6, 9);
+        auto r = rayFromPoints(point3<float>(-3, -2, -1), point3<float>(14, 8, 10));
+
+        CHECK(project(r, grid, vol) == doctest::Approx(project(r, grid, reference)));
+        CHECK(project(r, grid, vol) > 0.f);
+    }
+} // namespace
+
+TEST_CASE("Test volume layouts")
+{
+    SUBCASE("Offsets are unique and inside the storage")
+    {
+        check_offsets_unique<volume_layout::linear>(5, 9, 3);
+        check_offsets_unique<volume_layout::bricked>(5, 9, 17);
+        check_offsets_unique<volume_layout::morton>(5, 9, 17);
+    }
+    SUBCASE("Storage size")
+    {
+        CHECK(volume<float, volume_layout::linear>(5, 9, 3).storageSize() == 135);
+        CHECK(volume<float, volume_layout::bricked>(5, 9, 3).storageSize() == 2 * 512);
+        CHECK(volume<float, volume_layout::morton>(5, 9, 3).storageSize() == 8 * 16 * 4);
+    }
+    SUBCASE("Known offsets")
+    {
+        volume<float, volume_layout::bricked> bricked(16, 16, 16);
+        CHECK(bricked.offset<size_t>(1, 2, 3) == 1 + 8 * 2 + 64 * 3);
+        CHECK(bricked.offset<size_t>(9, 0, 0) == 512 + 1);
+        CHECK(bricked.offset<size_t>(0, 8, 0) == 2 * 512);
+
+        volume<float, volume_layout::morton> morton(4, 4, 4);
+        CHECK(morton.offset<size_t>(1, 0, 0) == 1);
+        CHECK(morton.offset<size_t>(0, 1, 0) == 2);
+        CHECK(morton.offset<size_t>(0, 0, 1) == 4);
+        CHECK(morton.offset<size_t>(3, 3, 3) == 63);
+
+        // Only x has a third bit, it goes on top
+        volume<float, volume_layout::morton> flat(8, 4, 4);
+        CHECK(flat.offset<size_t>(4, 0, 0) == 64);
+    }
+}
+
+TEST_CASE("Test volume access")
+{
+    SUBCASE("Linear") { check_access<volume_layout::linear>(); }
+    SUBCASE("Bricked") { check_access<volume_layout::bricked>(); }
+    SUBCASE("Morton") { check_access<volume_layout::morton>(); }
+}
+
+TEST_CASE("Test sampling integer volumes")
+{
+    using FloatP = enoki::Array<float, 8>;
+
+    // Values above 255 and a size that is not a multiple of 4, the last voxels are read as 16 bit values
+    volume<uint16_t> vol(5, 3, 3);
+    vol.fill([](size_t x, size_t y, size_t z) { return static_cast<uint16_t>(x + 10 * y + 100 * z); });
+    auto grid = voxel_grid<float>(5, 3, 3, point3<float>(0), vec3<float>(1));
+
+    auto p = point3<FloatP>(FloatP(0.5f) + enoki::arange<FloatP>() * 0.5f, FloatP(2.5f), FloatP(1.9f));
+    auto interpolated = sample(grid, vol, p);
+
+    for (size_t i = 0; i < 8; ++i) {
+        float expected = (p.x()[i] - 0.5f) + 10 * 2 + 100 * (1.9f - 0.5f);
+        CHECK(interpolated[i] == doctest::Approx(expected).epsilon(1e-4));
+    }
+}
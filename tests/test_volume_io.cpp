@@ -0,0 +1,226 @@
+/**
+ *
+ * \file test_volume_io.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ */
+
+#include "doctest.h"
+
+#include "TomoSect/volume_io.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace tomosect;
+
+namespace
+{
+    std::filesystem::path temp_dir()
+    {
+        auto dir = std::filesystem::temp_directory_path() / "tomosect_test_volume_io";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    volume<float> ramp_volume(size_t nx, size_t ny, size_t nz)
+    {
+        volume<float> vol(nx, ny, nz);
+        vol.fill([](size_t x, size_t y, size_t z) { return static_cast<float>(x + 10 * y + 100 * z); });
+        return vol;
+    }
+
+    void check_ramp(const volume<const float>& vol)
+    {
+        for (size_t z = 0; z < vol.nz(); ++z)
+            for (size_t y = 0; y < vol.ny(); ++y)
+                for (size_t x = 0; x < vol.nx(); ++x)
+                    CHECK(vol(x, y, z) == static_cast<float>(x + 10 * y + 100 * z));
+    }
+} // namespace
+
+TEST_CASE("Test volume file round trip")
+{
+    auto dir = temp_dir();
+    auto vol = ramp_volume(5, 4, 3);
+    auto grid = voxel_grid<float>(5, 4, 3, point3<float>(-1, -2, -3), vec3<float>(0.5f, 0.25f, 2));
+
+    for (std::string name : { "vol.mha", "vol.mhd", "vol.nrrd", "vol.nhdr" }) {
+        auto path = (dir / name).string();
+        write_volume(path, vol, grid);
+
+        auto mapped = map_volume(path);
+        REQUIRE(mapped.data.nx() == 5);
+        REQUIRE(mapped.data.ny() == 4);
+        REQUIRE(mapped.data.nz() == 3);
+        check_ramp(mapped.data);
+
+        CHECK(mapped.grid.min().x() == doctest::Approx(-1));
+        CHECK(mapped.grid.min().y() == doctest::Approx(-2));
+        CHECK(mapped.grid.min().z() == doctest::Approx(-3));
+        CHECK(mapped.grid.spacing().x() == doctest::Approx(0.5f));
+        CHECK(mapped.grid.spacing().z() == doctest::Approx(2));
+    }
+
+    // Embedded data starts at a page boundary
+    CHECK(std::filesystem::file_size(dir / "vol.mha") == 4096 + 60 * sizeof(float));
+    CHECK(std::filesystem::file_size(dir / "vol.raw") == 60 * sizeof(float));
+
+    SUBCASE("Raw files and other layouts")
+    {
+        volume<float, volume_layout::morton> morton(5, 4, 3);
+        morton.fill([](size_t x, size_t y, size_t z) { return static_cast<float>(x + 10 * y + 100 * z); });
+
+        auto path = (dir / "morton.raw").string();
+        write_volume(path, morton, grid);
+        check_ramp(map_raw_volume(path, 5, 4, 3));
+    }
+    SUBCASE("Copy on write keeps the file untouched")
+    {
+        auto path = (dir / "vol.nrrd").string();
+        {
+            auto mapped = map_volume<float>(path);
+            mapped.data(1, 1, 1) = -1.f;
+            CHECK(mapped.data(1, 1, 1) == -1.f);
+        }
+        check_ramp(map_volume(path).data);
+    }
+    SUBCASE("Created volumes write through to the file")
+    {
+        auto path = (dir / "created.mha").string();
+
+        map_options options;
+        options.hugePages = true;
+        {
+            auto out = create_volume(path, grid, options);
+            out.fill([](size_t x, size_t y, size_t z) { return static_cast<float>(x + 10 * y + 100 * z); });
+        }
+        check_ramp(map_volume(path).data);
+    }
+}
+
+TEST_CASE("Test projection stack files")
+{
+    auto dir = temp_dir();
+
+    projection_stack<float> stack(6, 2, 3);
+    for (size_t k = 0; k < 3; ++k)
+        for (size_t row = 0; row < 2; ++row)
+            for (size_t col = 0; col < 6; ++col)
+                stack(col, row, k) = static_cast<float>(col + 10 * row + 100 * k);
+
+    CHECK(stack.view(2) - stack.data() == 24);
+
+    auto path = (dir / "projections.nrrd").string();
+    write_projections(path, stack);
+
+    map_options options;
+    options.access = map_access::sequential;
+    options.prefetch = true;
+
+    auto mapped = map_projections(path, options);
+    REQUIRE(mapped.cols() == 6);
+    REQUIRE(mapped.rows() == 2);
+    REQUIRE(mapped.numViews() == 3);
+    CHECK(mapped(5, 1, 2) == 215.f);
+    CHECK(mapped.view(1)[0] == 100.f);
+}
+
+TEST_CASE("Test foreign headers")
+{
+    auto dir = temp_dir();
+
+    // Header with misaligned data and a few keys we do not write ourselves
+    {
+        std::ofstream out(dir / "foreign.nrrd", std::ios::binary);
+        out << "NRRD0005\n# comment\ntype: float\ndimension: 2\nsizes: 3 2\nendian: little\nencoding: raw\nspacings: 0.5 2\nkey:=value\n\n";
+        float data[6] = { 1, 2, 3, 4, 5, 6 };
+        out.write(reinterpret_cast<const char*>(data), sizeof(data));
+    }
+
+    auto mapped = map_volume((dir / "foreign.nrrd").string());
+    CHECK(mapped.data.nx() == 3);
+    CHECK(mapped.data.ny() == 2);
+    CHECK(mapped.data.nz() == 1);
+    CHECK(mapped.data(2, 1, 0) == 6.f);
+    CHECK(mapped.grid.spacing().y() == doctest::Approx(2));
+
+    {
+        std::ofstream out(dir / "compressed.mha");
+        out << "NDims = 3\nDimSize = 1 1 1\nElementType = MET_FLOAT\nCompressedData = True\nElementDataFile = LOCAL\n";
+    }
+    CHECK_THROWS_AS(map_volume((dir / "compressed.mha").string()), std::runtime_error);
+
+    {
+        std::ofstream out(dir / "short.mha");
+        out << "NDims = 3\nDimSize = 4 4 4\nElementType = MET_FLOAT\nElementDataFile = LOCAL\n";
+    }
+    CHECK_THROWS_AS(map_volume((dir / "short.mha").string()), std::runtime_error);
+}
+
+TEST_CASE("Test data at the end of the file")
+{
+    auto dir = temp_dir();
+
+    // 3 bytes of junk in front of the data, a misaligned offset -1 has to resolve to
+    {
+        std::ofstream out(dir / "tail.raw", std::ios::binary);
+        float data[6] = { 1, 2, 3, 4, 5, 6 };
+        out.write("abc", 3);
+        out.write(reinterpret_cast<const char*>(data), sizeof(data));
+    }
+
+    SUBCASE("MHA with HeaderSize = -1")
+    {
+        {
+            std::ofstream out(dir / "tail.mhd");
+            out << "NDims = 2\nDimSize = 3 2\nElementType = MET_FLOAT\nHeaderSize = -1\nElementDataFile = tail.raw\n";
+        }
+        auto mapped = map_volume((dir / "tail.mhd").string());
+        CHECK(mapped.data(0, 0, 0) == 1.f);
+        CHECK(mapped.data(2, 1, 0) == 6.f);
+    }
+    SUBCASE("NRRD with byte skip: -1")
+    {
+        {
+            std::ofstream out(dir / "tail.nhdr");
+            out << "NRRD0004\ntype: float\ndimension: 2\nsizes: 3 2\nencoding: raw\nendian: little\nbyte skip: -1\ndata file: tail.raw\n";
+        }
+        auto mapped = map_volume((dir / "tail.nhdr").string());
+        CHECK(mapped.data(0, 0, 0) == 1.f);
+        CHECK(mapped.data(2, 1, 0) == 6.f);
+    }
+    SUBCASE("Invalid offsets and sizes")
+    {
+        {
+            std::ofstream out(dir / "negative.mhd");
+            out << "NDims = 2\nDimSize = 3 2\nElementType = MET_FLOAT\nHeaderSize = -2\nElementDataFile = tail.raw\n";
+        }
+        CHECK_THROWS_AS(map_volume((dir / "negative.mhd").string()), std::runtime_error);
+
+        // More values than the file holds, larger than the file for -1
+        {
+            std::ofstream out(dir / "large.mhd");
+            out << "NDims = 2\nDimSize = 4 2\nElementType = MET_FLOAT\nHeaderSize = -1\nElementDataFile = tail.raw\n";
+        }
+        CHECK_THROWS_AS(map_volume((dir / "large.mhd").string()), std::runtime_error);
+
+        // The product of the sizes does not fit into 64 bit
+        {
+            std::ofstream out(dir / "overflow.nhdr");
+            out << "NRRD0004\ntype: float\ndimension: 3\nsizes: 4294967296 4294967296 4\nencoding: raw\nendian: little\n"
+                << "byte skip: -1\ndata file: tail.raw\n";
+        }
+        CHECK_THROWS_AS(map_volume((dir / "overflow.nhdr").string()), std::runtime_error);
+
+        for (std::string sizes : { "-1 2", "1.5 2" }) {
+            {
+                std::ofstream out(dir / "sizes.mhd");
+                out << "NDims = 2\nDimSize = " << sizes << "\nElementType = MET_FLOAT\nElementDataFile = tail.raw\n";
+            }
+            CHECK_THROWS_AS(map_volume((dir / "sizes.mhd").string()), std::runtime_error);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ *
+ * \file frame_producer.cpp
+ *
+ * \author David Frank (frankd@in.tum.de)
+ *
+ * Stand-in for an acquisition process: publishes simulated projections of a ball for a circular scan into a shared
+ * memory frame ring, at a given frame rate. Frames are written in place, just like a detector driver would.
+ *
+ * Usage: frame_producer <name> [cols=256] [rows=256] [views=360] [fps=100] [slots=16] [geometry id=0] [block]
+ */
+
+#include "TomoSect/frame_ring.hpp"
+#include "TomoSect/scan_geometry.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace tomosect;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <name> [cols=256] [rows=256] [views=360] [fps=100] [slots=16] [geometry id=0] [block]\n";
+        return EXIT_FAILURE;
+    }
+
+    auto arg = [&](int i, unsigned long fallback) { return argc > i ? std::stoul(argv[i]) : fallback; };
+
+    try {
+        const std::string name = argv[1];
+        const size_t cols = arg(2, 256);
+        const size_t rows = arg(3, 256);
+        const size_t views = arg(4, 360);
+        const double fps = static_cast<double>(arg(5, 100));
+        const size_t slots = arg(6, 16);
+        const uint64_t geometryId = arg(7, 0);
+        const auto policy = argc > 8 && std::string(argv[8]) == "block" ? ring_policy::block : ring_policy::overwrite;
+
+        // Detector covers a field of view of radius 0.75 around the rotation axis
+        const float pixelWidth = 2.25f / static_cast<float>(cols);
+        const float pixelHeight = 2.25f / static_cast<float>(rows);
+        circular_trajectory<float> trajectory{ views, 2.f, 1.f, cols, rows, pixelWidth, pixelHeight };
+
+        const float radius = 0.5f;
+        const float mu = 1.f;
+
+        frame_ring_writer writer(name, cols, rows, slots, policy);
+        std::cout << "Publishing " << views << " frames of " << cols << "x" << rows << " to " << name << " at " << fps << " fps\n";
+
+        const auto period = std::chrono::duration<double>(1.0 / fps);
+        auto next = std::chrono::steady_clock::now();
+
+        for (size_t k = 0; k < views; ++k) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+
+            auto view = trajectory.view(k);
+            float* pixels = writer.claim();
+
+            for (size_t row = 0; row < rows; ++row) {
+                for (size_t col = 0; col < cols; ++col) {
+                    auto r = view.pixelRay(col, row);
+                    auto o = r.origin();
+                    auto d = r.dir();
+
+                    // Chord length through the ball from the distance of the ray to its center
+                    float t = -(o.x() * d.x() + o.y() * d.y() + o.z() * d.z());
+                    float px = o.x() + t * d.x(), py = o.y() + t * d.y(), pz = o.z() + t * d.z();
+                    float dist2 = px * px + py * py + pz * pz;
+
+                    pixels[row * cols + col] = dist2 < radius * radius ? 2 * mu * std::sqrt(radius * radius - dist2) : 0.f;
+                }
+            }
+
+            writer.commit(k, geometryId);
+        }
+
+        writer.close();
+
+        // Readers attach by name, give late ones a moment before the ring is removed
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::cout << "Published " << writer.published() << " frames\n";
+    } catch (const std::exception& e) {
+        std::cerr << "frame_producer: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}